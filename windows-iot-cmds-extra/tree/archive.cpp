@@ -0,0 +1,1164 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     ZIP, TAR and TAR.GZ archives listed by tree.com like images
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include <windows.h>
+
+#include "image.h"
+#include "inflate.h"
+#include "stats.h"
+#include "trace.h"
+
+/* bytes of nodes allocated at a time */
+#define ARCHIVE_ARENA		(1024 * 1024)
+
+/* initial slots of the table nodes are looked up in, it grows with the archive */
+#define ARCHIVE_BUCKETS		4096
+
+/* longest path read from an entry, longer ones are cut */
+#define ARCHIVE_PATH_MAX	4096
+
+/* seconds from 1601, where a FILETIME starts, to 1970, where Unix time does */
+#define ARCHIVE_UNIX_EPOCH	11644473600ULL
+
+/* ZIP signatures */
+#define ZIP_CENTRAL		0x02014B50
+#define ZIP_END			0x06054B50
+#define ZIP64_END		0x06064B50
+#define ZIP64_LOCATOR		0x07064B50
+
+/* ZIP extra fields */
+#define ZIP_EXTRA_ZIP64		0x0001
+#define ZIP_EXTRA_NTFS		0x000A
+#define ZIP_EXTRA_TIME		0x5455
+
+/* systems an entry was made on, which tells what its attributes mean */
+#define ZIP_HOST_UNIX		3
+#define ZIP_HOST_OSX		19
+
+/* general purpose flag telling the name is UTF-8 rather than code page 437 */
+#define ZIP_UTF8		0x0800
+
+/* Unix file types */
+#define ARCHIVE_S_IFMT		0170000
+#define ARCHIVE_S_IFDIR		0040000
+
+#define TAR_BLOCK		512
+
+/* longest GNU long name or pax header read, longer ones are skipped */
+#define TAR_EXTRA_MAX		(64 * 1024)
+
+/* an entry of an archive, folders hold their entries as a list */
+typedef struct _ARCHIVE_NODE
+{
+	struct _ARCHIVE_NODE* child;	/* first entry of a folder */
+	struct _ARCHIVE_NODE* next;	/* next entry of the same folder */
+	struct _ARCHIVE_NODE* chain;	/* next node in the same slot of archiveBuckets */
+	struct _ARCHIVE_NODE* parent;
+	FILETIME ftLastWriteTime;
+	ULONGLONG size;
+	DWORD attributes;
+	ULONG hash;
+	USHORT nameLen;
+	wchar_t name[1];
+} ARCHIVE_NODE;
+
+/* where an enumeration of a folder is */
+typedef struct _ARCHIVE_CURSOR
+{
+	const ARCHIVE_NODE* next;
+} ARCHIVE_CURSOR;
+
+/* a TAR stream being read, in pieces of any size */
+typedef struct _TAR_READER
+{
+	BYTE header[TAR_BLOCK];		/* a header split between pieces */
+	UINT headerLen;
+	ULONGLONG skip;			/* bytes of file data and padding still to be passed over */
+	BYTE* extra;			/* GNU long name or pax header being collected */
+	UINT extraLen;
+	UINT extraSize;
+	BYTE extraType;
+	char path[ARCHIVE_PATH_MAX];	/* path of the next entry given by a long name or pax header */
+	UINT pathLen;
+	ULONGLONG size;			/* and its size and time, if a pax header gives them */
+	BOOL bSize;
+	LONGLONG mtime;
+	BOOL bTime;
+	ULONG entries;
+	BOOL bDone;			/* the end of the archive has been reached */
+	BOOL bBad;			/* or a damaged header */
+} TAR_READER;
+
+static ARCHIVE_NODE archiveRoot;
+static ARCHIVE_NODE** archiveBuckets = NULL;
+static ULONG archiveBucketCount = 0;
+static ULONG archiveNodes = 0;
+static BYTE* archiveArena = NULL;
+static SIZE_T archiveArenaLeft = 0;
+static wchar_t archivePath[ARCHIVE_PATH_MAX];
+
+/* the folder the last entry was added to, and its path */
+static wchar_t archiveLast[ARCHIVE_PATH_MAX];
+static size_t archiveLastLen = 0;
+static ARCHIVE_NODE* archiveLastNode = NULL;
+
+/**
+* @name: ArchiveAlloc
+*
+* @return
+* bytes of memory that live as long as the listing
+*/
+static VOID* ArchiveAlloc(SIZE_T bytes)
+{
+	VOID* p = NULL;
+
+	bytes = (bytes + 7) & ~(SIZE_T)7;
+
+	if (bytes > archiveArenaLeft)
+	{
+		archiveArena = (BYTE*)StatsMalloc(ARCHIVE_ARENA);
+
+		if (archiveArena == NULL)
+			exit(-1);
+
+		archiveArenaLeft = ARCHIVE_ARENA;
+	}
+
+	p = archiveArena;
+	archiveArena += bytes;
+	archiveArenaLeft -= bytes;
+	return p;
+}
+
+/**
+* @name: ArchiveReset
+*
+* @return
+* void
+*
+* empties the tree before an archive is read into it
+*/
+static VOID ArchiveReset(VOID)
+{
+	ZeroMemory(&archiveRoot, sizeof(archiveRoot));
+	archiveRoot.attributes = FILE_ATTRIBUTE_DIRECTORY;
+
+	if (archiveBuckets == NULL)
+	{
+		archiveBucketCount = ARCHIVE_BUCKETS;
+		archiveBuckets = (ARCHIVE_NODE**)StatsMalloc(archiveBucketCount * sizeof(ARCHIVE_NODE*));
+
+		if (archiveBuckets == NULL)
+			exit(-1);
+	}
+
+	ZeroMemory(archiveBuckets, archiveBucketCount * sizeof(ARCHIVE_NODE*));
+	archiveNodes = 0;
+	archiveLastLen = 0;
+	archiveLastNode = NULL;
+}
+
+/**
+* @name: ArchiveHash
+*
+* @return
+* hash of the entry named name in the folder parent
+*/
+static ULONG ArchiveHash(const ARCHIVE_NODE* parent, const wchar_t* name, size_t len)
+{
+	ULONG hash = 2166136261UL ^ (ULONG)((ULONG_PTR)parent >> 3);
+	size_t i = 0;
+
+	for (i = 0; i < len; ++i)
+	{
+		hash ^= (ULONG)name[i];
+		hash *= 16777619UL;
+	}
+
+	return hash;
+}
+
+/**
+* @name: ArchiveGrow
+*
+* @return
+* void
+*
+* doubles the slots of archiveBuckets, keeping chains short
+*/
+static VOID ArchiveGrow(VOID)
+{
+	ULONG count = archiveBucketCount * 2;
+	ARCHIVE_NODE** buckets = (ARCHIVE_NODE**)StatsCalloc(count, sizeof(ARCHIVE_NODE*));
+	ULONG i = 0;
+
+	if (buckets == NULL)
+		exit(-1);
+
+	for (i = 0; i < archiveBucketCount; ++i)
+	{
+		ARCHIVE_NODE* node = archiveBuckets[i];
+
+		while (node != NULL)
+		{
+			ARCHIVE_NODE* chain = node->chain;
+
+			node->chain = buckets[node->hash & (count - 1)];
+			buckets[node->hash & (count - 1)] = node;
+			node = chain;
+		}
+	}
+
+	free(archiveBuckets);
+	archiveBuckets = buckets;
+	archiveBucketCount = count;
+}
+
+/**
+* @name: ArchiveChild
+*
+* @return
+* the entry named name of the folder parent, made a folder first if it
+* was a file. The entry is added as an empty folder if it isn't there
+*/
+static ARCHIVE_NODE* ArchiveChild(ARCHIVE_NODE* parent, const wchar_t* name, size_t len)
+{
+	ULONG hash = ArchiveHash(parent, name, len);
+	ARCHIVE_NODE* node = archiveBuckets[hash & (archiveBucketCount - 1)];
+
+	for (; node != NULL; node = node->chain)
+	{
+		if (node->hash == hash && node->parent == parent && node->nameLen == len &&
+			memcmp(node->name, name, len * sizeof(wchar_t)) == 0)
+			return node;
+	}
+
+	/* an archive may hold "a/b" without "a/", or even "a" as a file as well */
+	if (!(parent->attributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		parent->attributes = FILE_ATTRIBUTE_DIRECTORY;
+		parent->size = 0;
+	}
+
+	if (archiveNodes >= archiveBucketCount)
+		ArchiveGrow();
+
+	node = (ARCHIVE_NODE*)ArchiveAlloc(offsetof(ARCHIVE_NODE, name) + len * sizeof(wchar_t));
+	ZeroMemory(node, offsetof(ARCHIVE_NODE, name));
+	memcpy(node->name, name, len * sizeof(wchar_t));
+	node->nameLen = (USHORT)len;
+	node->hash = hash;
+	node->parent = parent;
+	node->attributes = FILE_ATTRIBUTE_DIRECTORY;
+	node->next = parent->child;
+	parent->child = node;
+	node->chain = archiveBuckets[hash & (archiveBucketCount - 1)];
+	archiveBuckets[hash & (archiveBucketCount - 1)] = node;
+	++archiveNodes;
+	return node;
+}
+
+/**
+* @name: ArchiveAdd
+*
+* @param path
+* path of the entry in the archive, with / or \ between names
+*
+* @param bFolder
+* true if the entry is a folder, as is one whose path ends in a separator
+*
+* @param attributes
+* attributes of a file, a folder is given FILE_ATTRIBUTE_DIRECTORY
+*
+* @return
+* void
+*
+* adds an entry and the folders leading to it, which an archive needn't
+* hold entries of. Empty names, "." and ".." are passed over, so a path
+* can't lead out of the archive. An entry already added is replaced, as
+* it would be when the archive is extracted
+*/
+static VOID ArchiveAdd(const wchar_t* path, size_t len, BOOL bFolder, DWORD attributes, ULONGLONG size, const FILETIME* ft)
+{
+	ARCHIVE_NODE* node = &archiveRoot;
+	size_t start = 0;
+	size_t cut = 0;
+
+	while (len > 0 && (path[len - 1] == L'/' || path[len - 1] == L'\\'))
+	{
+		bFolder = TRUE;
+		--len;
+	}
+
+	/* where the name of the entry starts, after the folders leading to it */
+	for (cut = len; cut > 0 && path[cut - 1] != L'/' && path[cut - 1] != L'\\'; --cut)
+		;
+
+	/* the entries of a folder mostly come one after another, so the last one's folder is tried first */
+	if (cut > 0 && cut == archiveLastLen && memcmp(path, archiveLast, cut * sizeof(wchar_t)) == 0)
+	{
+		node = archiveLastNode;
+		start = cut;
+	}
+
+	while (start < len)
+	{
+		size_t end = start;
+
+		while (end < len && path[end] != L'/' && path[end] != L'\\')
+			++end;
+
+		if (end > start && !(end - start == 1 && path[start] == L'.') &&
+			!(end - start == 2 && path[start] == L'.' && path[start + 1] == L'.'))
+		{
+			node = ArchiveChild(node, path + start, (end - start < MAX_PATH) ? end - start : MAX_PATH - 1);
+
+			/* a folder without an entry of its own takes the time of the first entry inside it */
+			if (node->ftLastWriteTime.dwLowDateTime == 0 && node->ftLastWriteTime.dwHighDateTime == 0)
+				node->ftLastWriteTime = *ft;
+		}
+
+		start = end + 1;
+
+		if (start == cut)
+		{
+			memcpy(archiveLast, path, cut * sizeof(wchar_t));
+			archiveLastLen = cut;
+			archiveLastNode = node;
+		}
+	}
+
+	if (node == &archiveRoot)
+		return;
+
+	node->ftLastWriteTime = *ft;
+
+	if (bFolder || node->child != NULL)
+	{
+		node->attributes = FILE_ATTRIBUTE_DIRECTORY | (attributes & ~FILE_ATTRIBUTE_NORMAL);
+		node->size = 0;
+	}
+	else
+	{
+		node->attributes = (attributes != 0) ? attributes : FILE_ATTRIBUTE_NORMAL;
+		node->size = size;
+	}
+}
+
+/**
+* @name: ArchiveUpper
+*
+* @return
+* c upper cased, without a call into the C runtime for ASCII
+*/
+static __forceinline wchar_t ArchiveUpper(wchar_t c)
+{
+	if (c < 0x80)
+		return (c >= L'a' && c <= L'z') ? (wchar_t)(c - (L'a' - L'A')) : c;
+
+	return (wchar_t)towupper(c);
+}
+
+/**
+* @name: ArchiveCompare
+*
+* @return
+* how the names of a and b compare: upper cased first, then as they are,
+* so names differing only in case still come in a fixed order
+*/
+static int ArchiveCompare(const ARCHIVE_NODE* a, const ARCHIVE_NODE* b)
+{
+	USHORT len = (a->nameLen < b->nameLen) ? a->nameLen : b->nameLen;
+	USHORT i = 0;
+
+	for (i = 0; i < len; ++i)
+	{
+		wchar_t upperA = ArchiveUpper(a->name[i]);
+		wchar_t upperB = ArchiveUpper(b->name[i]);
+
+		if (upperA != upperB)
+			return (upperA < upperB) ? -1 : 1;
+	}
+
+	if (a->nameLen != b->nameLen)
+		return (a->nameLen < b->nameLen) ? -1 : 1;
+
+	for (i = 0; i < len; ++i)
+	{
+		if (a->name[i] != b->name[i])
+			return (a->name[i] < b->name[i]) ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/**
+* @name: ArchiveSort
+*
+* @return
+* the list starting at head in name order
+*
+* a merge sort of runs doubling in length, needing no memory of its own
+*/
+static ARCHIVE_NODE* ArchiveSort(ARCHIVE_NODE* head)
+{
+	size_t run = 1;
+
+	for (;;)
+	{
+		ARCHIVE_NODE* list = head;
+		ARCHIVE_NODE** tail = &head;
+		UINT merges = 0;
+
+		while (list != NULL)
+		{
+			ARCHIVE_NODE* a = list;
+			ARCHIVE_NODE* b = list;
+			size_t lenA = 0;
+			size_t lenB = run;
+
+			while (lenA < run && b != NULL)
+			{
+				b = b->next;
+				++lenA;
+			}
+
+			++merges;
+
+			while (lenA > 0 || (lenB > 0 && b != NULL))
+			{
+				ARCHIVE_NODE* node = NULL;
+
+				if (lenA == 0)
+				{
+					node = b;
+					b = b->next;
+					--lenB;
+				}
+				else if (lenB == 0 || b == NULL || ArchiveCompare(a, b) <= 0)
+				{
+					node = a;
+					a = a->next;
+					--lenA;
+				}
+				else
+				{
+					node = b;
+					b = b->next;
+					--lenB;
+				}
+
+				*tail = node;
+				tail = &node->next;
+			}
+
+			list = b;
+		}
+
+		*tail = NULL;
+
+		if (merges <= 1)
+			return head;
+
+		run *= 2;
+	}
+}
+
+/**
+* @name: ArchiveFinish
+*
+* @return
+* void
+*
+* sorts the entries of every folder once the whole archive is read
+*/
+static VOID ArchiveFinish(VOID)
+{
+	ULONG i = 0;
+
+	archiveRoot.child = ArchiveSort(archiveRoot.child);
+
+	for (i = 0; i < archiveBucketCount; ++i)
+	{
+		ARCHIVE_NODE* node = archiveBuckets[i];
+
+		for (; node != NULL; node = node->chain)
+		{
+			if (node->child != NULL && node->child->next != NULL)
+				node->child = ArchiveSort(node->child);
+		}
+	}
+}
+
+/**
+* @name: ArchiveName
+*
+* @param bUtf8
+* true if str is UTF-8, else code page 437 as DOS tools wrote
+*
+* @return
+* characters of the path in archivePath, which is cut to fit
+*/
+static size_t ArchiveName(const BYTE* str, size_t len, BOOL bUtf8)
+{
+	int n = 0;
+
+	/* every byte makes at most one UTF-16 code unit */
+	if (len > ARCHIVE_PATH_MAX)
+		len = ARCHIVE_PATH_MAX;
+
+	if (len == 0)
+		return 0;
+
+	n = MultiByteToWideChar(bUtf8 ? CP_UTF8 : 437, 0, (const char*)str, (int)len, archivePath, ARCHIVE_PATH_MAX);
+	return (n > 0) ? (size_t)n : 0;
+}
+
+/**
+* @name: ArchiveUnixTime
+*
+* @return
+* void
+*/
+static VOID ArchiveUnixTime(LONGLONG seconds, FILETIME* ft)
+{
+	ULONGLONG ticks = (ULONGLONG)(seconds + (LONGLONG)ARCHIVE_UNIX_EPOCH) * 10000000ULL;
+
+	ft->dwLowDateTime = (DWORD)ticks;
+	ft->dwHighDateTime = (DWORD)(ticks >> 32);
+}
+
+/**
+* @name: ZipExtra
+*
+* @param bZip64Size
+* true if the size of the entry didn't fit in its header and is in a ZIP64 field
+*
+* @return
+* void
+*
+* takes the size and time of an entry from the extra fields that hold them
+*/
+static VOID ZipExtra(const BYTE* extra, UINT len, BOOL bZip64Size, ULONGLONG* size, FILETIME* ft)
+{
+	UINT pos = 0;
+
+	while (pos + 4 <= len)
+	{
+		WORD id = ImageWord(extra + pos);
+		WORD fieldLen = ImageWord(extra + pos + 2);
+		const BYTE* field = extra + pos + 4;
+
+		if (pos + 4 + fieldLen > len)
+			break;
+
+		if (id == ZIP_EXTRA_ZIP64 && bZip64Size && fieldLen >= 8)
+		{
+			/* the uncompressed size comes first when it is there */
+			*size = ImageQword(field);
+		}
+		else if (id == ZIP_EXTRA_TIME && fieldLen >= 5 && (field[0] & 1))
+		{
+			ArchiveUnixTime((LONG)ImageDword(field + 1), ft);
+		}
+		else if (id == ZIP_EXTRA_NTFS && fieldLen >= 32 && ImageWord(field + 4) == 1 && ImageWord(field + 6) >= 24)
+		{
+			ft->dwLowDateTime = ImageDword(field + 8);
+			ft->dwHighDateTime = ImageDword(field + 12);
+		}
+
+		pos += 4 + fieldLen;
+	}
+}
+
+/**
+* @name: ZipMount
+*
+* recognises ZIP archives, see IMAGE_FS
+*
+* only the central directory at the end of the archive is read, in one
+* pass. It lists every entry, so the data and local headers before it are
+* never touched, whatever the archive's size
+*/
+static BOOL ZipMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	ULONGLONG span = 0;
+	ULONGLONG end = 0;
+	ULONGLONG limit = 0;
+	ULONGLONG entries = 0;
+	ULONGLONG cdSize = 0;
+	ULONGLONG cdOffset = 0;
+	ULONGLONG cdEnd = 0;
+	ULONGLONG pos = 0;
+	ULONGLONG i = 0;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	BOOL bFound = FALSE;
+
+	if (size < 22)
+		return FALSE;
+
+	/* the end record is followed by a comment of up to 64 KB */
+	limit = (size > 22 + 0xFFFF) ? size - 22 - 0xFFFF : 0;
+
+	for (end = size - 22; ; --end)
+	{
+		if (ImageDword(base + end) == ZIP_END && end + 22 + ImageWord(base + end + 20) <= size)
+		{
+			bFound = TRUE;
+			break;
+		}
+
+		if (end == limit)
+			break;
+	}
+
+	if (!bFound)
+		return FALSE;
+
+	span = TraceBegin();
+	entries = ImageWord(base + end + 10);
+	cdSize = ImageDword(base + end + 12);
+	cdOffset = ImageDword(base + end + 16);
+	cdEnd = end;
+
+	/* ZIP64 keeps the real values in a record the locator before the end record points to */
+	if (end >= 20 && ImageDword(base + end - 20) == ZIP64_LOCATOR)
+	{
+		ULONGLONG record = ImageQword(base + end - 20 + 8);
+
+		/* with data in front of the archive the record is where it would be without extensions */
+		if (size < 56 || record > size - 56 || ImageDword(base + record) != ZIP64_END)
+			record = (end >= 76) ? end - 76 : size;
+
+		if (size >= 56 && record <= size - 56 && ImageDword(base + record) == ZIP64_END)
+		{
+			entries = ImageQword(base + record + 32);
+			cdSize = ImageQword(base + record + 40);
+			cdOffset = ImageQword(base + record + 48);
+			cdEnd = record;
+		}
+	}
+
+	/* a self extracting archive has a program in front of it, which the offsets don't count */
+	if (cdSize > cdEnd)
+		return FALSE;
+
+	if (entries == 0 || cdOffset > cdEnd)
+		cdOffset = cdEnd;
+
+	if (entries > 0 && (cdOffset + 4 > cdEnd || ImageDword(base + cdOffset) != ZIP_CENTRAL))
+	{
+		cdOffset = cdEnd - cdSize;
+
+		if (ImageDword(base + cdOffset) != ZIP_CENTRAL)
+			return FALSE;
+	}
+
+	label[0] = L'\0';
+	*serial = 0;
+	ArchiveReset();
+
+	range.VirtualAddress = (PVOID)(base + cdOffset);
+	range.NumberOfBytes = (SIZE_T)(cdEnd - cdOffset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+	/* a damaged directory lists the entries before the damage */
+	for (pos = cdOffset, i = 0; i < entries && pos + 46 <= cdEnd && ImageDword(base + pos) == ZIP_CENTRAL; ++i)
+	{
+		const BYTE* entry = base + pos;
+		BYTE host = entry[5];
+		WORD flags = ImageWord(entry + 8);
+		WORD nameLen = ImageWord(entry + 28);
+		WORD extraLen = ImageWord(entry + 30);
+		WORD commentLen = ImageWord(entry + 32);
+		DWORD external = ImageDword(entry + 38);
+		ULONGLONG fileSize = ImageDword(entry + 24);
+		DWORD attributes = 0;
+		BOOL bFolder = FALSE;
+		FILETIME local;
+		FILETIME ft;
+		size_t len = 0;
+
+		if (pos + 46 + nameLen + extraLen + commentLen > cdEnd)
+			break;
+
+		ZeroMemory(&ft, sizeof(ft));
+
+		if (DosDateTimeToFileTime(ImageWord(entry + 14), ImageWord(entry + 12), &local))
+			LocalFileTimeToFileTime(&local, &ft);
+
+		ZipExtra(entry + 46 + nameLen, extraLen, fileSize == 0xFFFFFFFF, &fileSize, &ft);
+
+		if (host == ZIP_HOST_UNIX || host == ZIP_HOST_OSX)
+		{
+			/* the Unix mode is in the upper half, only the type and write permission matter */
+			bFolder = ((external >> 16) & ARCHIVE_S_IFMT) == ARCHIVE_S_IFDIR;
+
+			if ((external >> 16) != 0 && !((external >> 16) & 0222))
+				attributes |= FILE_ATTRIBUTE_READONLY;
+		}
+		else
+		{
+			attributes = external & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE);
+			bFolder = (external & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		}
+
+		len = ArchiveName(entry + 46, nameLen, (flags & ZIP_UTF8) != 0);
+		ArchiveAdd(archivePath, len, bFolder, attributes, fileSize, &ft);
+
+		pos += 46 + nameLen + extraLen + commentLen;
+	}
+
+	ArchiveFinish();
+	TraceEnd("image", "archive_read", span, NULL, "entries", (ULONG)i);
+
+	ZeroMemory(root, sizeof(*root));
+	root->first = (ULONGLONG)(ULONG_PTR)&archiveRoot;
+	return TRUE;
+}
+
+/**
+* @name: TarNumber
+*
+* @return
+* the number in a header field, as octal digits or, if the first byte
+* has its top bit set, as a big endian binary number as GNU tar writes
+* values octal can't hold
+*/
+static ULONGLONG TarNumber(const BYTE* field, UINT len)
+{
+	ULONGLONG value = 0;
+	UINT i = 0;
+
+	if (field[0] & 0x80)
+	{
+		value = field[0] & 0x3F;
+
+		for (i = 1; i < len; ++i)
+			value = (value << 8) | field[i];
+
+		return value;
+	}
+
+	while (i < len && field[i] == ' ')
+		++i;
+
+	for (; i < len && field[i] >= '0' && field[i] <= '7'; ++i)
+		value = (value << 3) | (ULONGLONG)(field[i] - '0');
+
+	return value;
+}
+
+/**
+* @name: TarChecksum
+*
+* @return
+* true if the checksum of the header matches, summed as unsigned or, as
+* some old tar programs did, as signed bytes
+*/
+static BOOL TarChecksum(const BYTE* header)
+{
+	ULONGLONG stored = TarNumber(header + 148, 8);
+	ULONG unsignedSum = 0;
+	LONG signedSum = 0;
+	UINT i = 0;
+
+	for (i = 0; i < TAR_BLOCK; ++i)
+	{
+		BYTE c = (i >= 148 && i < 156) ? ' ' : header[i];
+
+		unsignedSum += c;
+		signedSum += (signed char)c;
+	}
+
+	return stored == unsignedSum || (LONGLONG)stored == signedSum;
+}
+
+/**
+* @name: TarDecimal
+*
+* @return
+* the decimal number at the start of the len bytes at str, which may be
+* negative. A pax value isn't terminated, it ends where the record does
+*/
+static LONGLONG TarDecimal(const char* str, UINT len)
+{
+	ULONGLONG value = 0;
+	BOOL bNegative = (len > 0 && str[0] == '-');
+	UINT i = bNegative ? 1 : 0;
+
+	for (; i < len && str[i] >= '0' && str[i] <= '9'; ++i)
+		value = value * 10 + (ULONGLONG)(str[i] - '0');
+
+	return bNegative ? -(LONGLONG)value : (LONGLONG)value;
+}
+
+/**
+* @name: TarPax
+*
+* @return
+* void
+*
+* takes the path, size and time of the next entry from a pax header,
+* records of the form "length key=value\n"
+*/
+static VOID TarPax(TAR_READER* r)
+{
+	UINT pos = 0;
+
+	while (pos < r->extraLen)
+	{
+		UINT recordLen = 0;
+		UINT key = pos;
+		UINT value = 0;
+		UINT valueEnd = 0;
+
+		while (key < r->extraLen && r->extra[key] >= '0' && r->extra[key] <= '9')
+			recordLen = recordLen * 10 + (r->extra[key++] - '0');
+
+		if (recordLen == 0 || recordLen > r->extraLen - pos || key >= r->extraLen || r->extra[key] != ' ')
+			break;
+
+		++key;
+		valueEnd = pos + recordLen - 1;
+
+		for (value = key; value < valueEnd && r->extra[value] != '='; ++value)
+			;
+
+		if (value < valueEnd)
+		{
+			UINT keyLen = value - key;
+			UINT valueLen = valueEnd - ++value;
+			const char* str = (const char*)r->extra + value;
+
+			if (keyLen == 4 && memcmp(r->extra + key, "path", 4) == 0 && valueLen < ARCHIVE_PATH_MAX)
+			{
+				memcpy(r->path, str, valueLen);
+				r->pathLen = valueLen;
+			}
+			else if (keyLen == 4 && memcmp(r->extra + key, "size", 4) == 0)
+			{
+				r->size = (ULONGLONG)TarDecimal(str, valueLen);
+				r->bSize = TRUE;
+			}
+			else if (keyLen == 5 && memcmp(r->extra + key, "mtime", 5) == 0)
+			{
+				/* a fraction of a second may follow, which is dropped */
+				r->mtime = TarDecimal(str, valueLen);
+				r->bTime = TRUE;
+			}
+		}
+
+		pos += recordLen;
+	}
+}
+
+/**
+* @name: TarHeader
+*
+* @return
+* void
+*
+* adds the entry a header describes, or takes in a header that describes
+* the next one, and tells how much data follows it
+*/
+static VOID TarHeader(TAR_READER* r, const BYTE* header)
+{
+	static const BYTE zero[TAR_BLOCK] = { 0 };
+	ULONGLONG dataSize = 0;
+	ULONGLONG fileSize = 0;
+	BYTE type = header[156];
+	DWORD attributes = 0;
+	FILETIME ft;
+	size_t len = 0;
+
+	/* the archive ends with blocks of zeros, everything after them is padding */
+	if (memcmp(header, zero, TAR_BLOCK) == 0)
+	{
+		r->bDone = TRUE;
+		return;
+	}
+
+	if (!TarChecksum(header))
+	{
+		r->bBad = TRUE;
+		return;
+	}
+
+	dataSize = TarNumber(header + 124, 12);
+
+	/* links, devices and folders have no data, whatever size they say */
+	if (type >= '1' && type <= '6')
+		dataSize = 0;
+
+	r->skip = (dataSize + TAR_BLOCK - 1) & ~(ULONGLONG)(TAR_BLOCK - 1);
+
+	if (type == 'L' || type == 'x')
+	{
+		/* the long name or pax header is collected, then its padding passed over */
+		if (dataSize <= TAR_EXTRA_MAX)
+		{
+			r->extraType = type;
+			r->extraSize = (UINT)dataSize;
+			r->extraLen = 0;
+			r->skip -= dataSize;
+		}
+
+		return;
+	}
+
+	/* global pax headers, long link names, volume labels and the like aren't entries */
+	if (type != '0' && type != '\0' && type != '7' && type != 'S' && type != 'D' && (type < '1' || type > '6'))
+		return;
+
+	if (r->pathLen > 0)
+	{
+		len = ArchiveName((const BYTE*)r->path, r->pathLen, TRUE);
+	}
+	else
+	{
+		char path[256];
+		UINT n = 0;
+
+		/* a POSIX header may have the path split in two, GNU keeps other things where the prefix would be */
+		if (memcmp(header + 257, "ustar", 5) == 0 && header[262] == '\0' && header[345] != '\0')
+		{
+			while (n < 155 && header[345 + n] != '\0')
+			{
+				path[n] = (char)header[345 + n];
+				++n;
+			}
+
+			path[n++] = '/';
+		}
+
+		for (len = 0; len < 100 && header[len] != '\0'; ++len)
+			path[n++] = (char)header[len];
+
+		len = ArchiveName((const BYTE*)path, n, TRUE);
+	}
+
+	fileSize = (type == 'S') ? TarNumber(header + 483, 12) : dataSize;
+
+	if (r->bSize)
+		fileSize = r->size;
+
+	ArchiveUnixTime(r->bTime ? r->mtime : (LONGLONG)TarNumber(header + 136, 12), &ft);
+
+	if ((TarNumber(header + 100, 8) & 0222) == 0)
+		attributes |= FILE_ATTRIBUTE_READONLY;
+
+	ArchiveAdd(archivePath, len, type == '5' || type == 'D', attributes, fileSize, &ft);
+	++r->entries;
+
+	r->pathLen = 0;
+	r->bSize = FALSE;
+	r->bTime = FALSE;
+}
+
+/**
+* @name: TarFeed
+*
+* @return
+* true if more of the archive is wanted
+*
+* reads the next len bytes of a TAR stream. Headers are read in place when
+* a piece holds them whole and file data is only ever counted past, so a
+* whole archive mapped into memory is read without touching its data
+*/
+static BOOL TarFeed(VOID* context, const BYTE* data, SIZE_T len)
+{
+	TAR_READER* r = (TAR_READER*)context;
+
+	while (len > 0 && !r->bDone && !r->bBad)
+	{
+		if (r->extraLen < r->extraSize)
+		{
+			UINT n = (len < r->extraSize - r->extraLen) ? (UINT)len : r->extraSize - r->extraLen;
+
+			memcpy(r->extra + r->extraLen, data, n);
+			r->extraLen += n;
+			data += n;
+			len -= n;
+
+			if (r->extraLen < r->extraSize)
+				continue;
+
+			if (r->extraType == 'L')
+			{
+				/* the name ends with a NUL, which is counted in the size */
+				while (r->extraLen > 0 && r->extra[r->extraLen - 1] == '\0')
+					--r->extraLen;
+
+				r->pathLen = (r->extraLen < ARCHIVE_PATH_MAX) ? r->extraLen : ARCHIVE_PATH_MAX;
+				memcpy(r->path, r->extra, r->pathLen);
+			}
+			else
+			{
+				TarPax(r);
+			}
+
+			r->extraSize = r->extraLen = 0;
+		}
+		else if (r->skip > 0)
+		{
+			SIZE_T n = (len < r->skip) ? len : (SIZE_T)r->skip;
+
+			data += n;
+			len -= n;
+			r->skip -= n;
+		}
+		else if (r->headerLen == 0 && len >= TAR_BLOCK)
+		{
+			TarHeader(r, data);
+			data += TAR_BLOCK;
+			len -= TAR_BLOCK;
+		}
+		else
+		{
+			UINT n = (len < TAR_BLOCK - r->headerLen) ? (UINT)len : TAR_BLOCK - r->headerLen;
+
+			memcpy(r->header + r->headerLen, data, n);
+			r->headerLen += n;
+			data += n;
+			len -= n;
+
+			if (r->headerLen == TAR_BLOCK)
+			{
+				r->headerLen = 0;
+				TarHeader(r, r->header);
+			}
+		}
+	}
+
+	return !r->bDone && !r->bBad;
+}
+
+/**
+* @name: TarMount
+*
+* recognises TAR archives, whether gzip compressed or not, see IMAGE_FS
+*
+* a TAR archive has no directory, its headers are spread between the
+* files. Without compression they are read where they lie, passing over
+* the data between them. Compressed ones have to be decompressed as a
+* stream, but only the headers are kept of what comes out
+*/
+static BOOL TarMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	ULONGLONG span = 0;
+	TAR_READER* r = NULL;
+	BOOL bGzip = (size >= 18 && base[0] == 0x1F && base[1] == 0x8B);
+	ULONG entries = 0;
+
+	/* most files fail the checksum of the first header, a compressed one has to be decompressed first */
+	if (!bGzip && (size < TAR_BLOCK || !TarChecksum(base)))
+		return FALSE;
+
+	span = TraceBegin();
+
+	r = (TAR_READER*)StatsCalloc(1, sizeof(TAR_READER));
+
+	if (r == NULL)
+		exit(-1);
+
+	r->extra = (BYTE*)StatsMalloc(TAR_EXTRA_MAX);
+
+	if (r->extra == NULL)
+		exit(-1);
+
+	ArchiveReset();
+
+	/* a damaged archive lists the entries before the damage */
+	if (bGzip)
+		InflateGzip(base, size, TarFeed, r);
+	else
+		TarFeed(r, base, (SIZE_T)size);
+
+	entries = r->entries;
+	free(r->extra);
+	free(r);
+
+	if (entries == 0)
+		return FALSE;
+
+	ArchiveFinish();
+	TraceEnd("image", "archive_read", span, NULL, "entries", entries);
+
+	label[0] = L'\0';
+	*serial = 0;
+	ZeroMemory(root, sizeof(*root));
+	root->first = (ULONGLONG)(ULONG_PTR)&archiveRoot;
+	return TRUE;
+}
+
+/**
+* @name: ArchiveDirOpen
+*
+* starts enumerating a folder, see IMAGE_FS
+*/
+static VOID* ArchiveDirOpen(const IMAGE_DIR* dir)
+{
+	ARCHIVE_CURSOR* cursor = (ARCHIVE_CURSOR*)StatsMalloc(sizeof(ARCHIVE_CURSOR));
+
+	if (cursor == NULL)
+		exit(-1);
+
+	cursor->next = ((const ARCHIVE_NODE*)(ULONG_PTR)dir->first)->child;
+	return cursor;
+}
+
+/**
+* @name: ArchiveDirNext
+*
+* returns the next entry of a folder, see IMAGE_FS. Archives keep a single
+* time, which is given as all three
+*/
+static BOOL ArchiveDirNext(VOID* pCursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir)
+{
+	ARCHIVE_CURSOR* cursor = (ARCHIVE_CURSOR*)pCursor;
+	const ARCHIVE_NODE* node = cursor->next;
+
+	if (node == NULL)
+		return FALSE;
+
+	cursor->next = node->next;
+
+	ZeroMemory(data, sizeof(*data));
+	data->dwFileAttributes = node->attributes;
+	data->ftCreationTime = node->ftLastWriteTime;
+	data->ftLastWriteTime = node->ftLastWriteTime;
+	data->ftLastAccessTime = node->ftLastWriteTime;
+	data->nFileSizeHigh = (DWORD)(node->size >> 32);
+	data->nFileSizeLow = (DWORD)node->size;
+	memcpy(data->cFileName, node->name, node->nameLen * sizeof(wchar_t));
+	data->cFileName[node->nameLen] = L'\0';
+
+	if (node->attributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		ZeroMemory(dir, sizeof(*dir));
+		dir->first = (ULONGLONG)(ULONG_PTR)node;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: ArchiveDirClose
+*
+* ends an enumeration, see IMAGE_FS
+*/
+static VOID ArchiveDirClose(VOID* cursor)
+{
+	free(cursor);
+}
+
+const IMAGE_FS zipFs = { ZipMount, ArchiveDirOpen, ArchiveDirNext, ArchiveDirClose };
+const IMAGE_FS tarFs = { TarMount, ArchiveDirOpen, ArchiveDirNext, ArchiveDirClose };
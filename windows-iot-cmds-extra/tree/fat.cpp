@@ -0,0 +1,683 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     FAT12, FAT16, FAT32 and exFAT volumes inside images for tree.com's /IMAGE option
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "image.h"
+#include "stats.h"
+
+/* bytes of a directory entry, in FAT and exFAT alike */
+#define FAT_ENTRY 32
+
+/* characters of a long name a single entry holds, and most entries a long name takes */
+#define FAT_LFN_CHARS 13
+#define FAT_LFN_PARTS 20
+
+/* IMAGE_DIR flags */
+#define FAT_DIR_FIXED		0x1	/* FAT12/16 root, length bytes from first, not in the cluster heap */
+#define FAT_DIR_CONTIGUOUS	0x2	/* exFAT NoFatChain, length bytes from cluster first on */
+
+/* layout of the mounted volume, set once by FatMount or ExfatMount */
+static const BYTE* fatBase = NULL;
+static ULONGLONG fatSize = 0;
+static UINT fatBits = 0;		/* 12, 16 or 32 bits per FAT entry */
+static ULONGLONG fatTable = 0;		/* offset of the first FAT */
+static ULONGLONG fatHeap = 0;		/* offset of cluster 2 */
+static ULONG fatClusterSize = 0;
+static ULONG fatClusters = 0;		/* clusters in the heap */
+static BOOL bExfat = FALSE;
+static IMAGE_DIR fatRootDir;
+
+/* position in a directory, entries are read straight from the mapped image */
+typedef struct _FAT_CURSOR
+{
+	ULONGLONG offset;	/* of the next entry */
+	ULONGLONG runEnd;	/* end of the contiguous bytes offset lies in */
+	ULONG cluster;		/* cluster holding offset, 0 if runEnd is the end of the directory */
+	ULONG steps;		/* clusters followed, a chain longer than the heap loops */
+	wchar_t name[FAT_LFN_CHARS * FAT_LFN_PARTS + 1];	/* long name being collected */
+	UINT namePart;		/* FAT: long name entry expected next, 0 if none */
+	BOOL bLongName;		/* FAT: name holds a complete long name */
+	BYTE checksum;		/* FAT: of the short name the long name belongs to */
+} FAT_CURSOR;
+
+/**
+* @name: FatNextCluster
+*
+* @return
+* the cluster following cluster in its chain, or 0 at the end of the chain
+*/
+static ULONG FatNextCluster(ULONG cluster)
+{
+	ULONGLONG offset = 0;
+	ULONG next = 0;
+
+	if (fatBits == 12)
+	{
+		offset = fatTable + cluster + cluster / 2;
+		if (offset + 2 > fatSize)
+			return 0;
+
+		next = ImageWord(fatBase + offset);
+		next = (cluster & 1) ? next >> 4 : next & 0xFFF;
+	}
+	else if (fatBits == 16)
+	{
+		offset = fatTable + (ULONGLONG)cluster * 2;
+		if (offset + 2 > fatSize)
+			return 0;
+
+		next = ImageWord(fatBase + offset);
+	}
+	else
+	{
+		offset = fatTable + (ULONGLONG)cluster * 4;
+		if (offset + 4 > fatSize)
+			return 0;
+
+		/* FAT32 keeps the top four bits reserved, exFAT uses them */
+		next = ImageDword(fatBase + offset) & (bExfat ? 0xFFFFFFFF : 0x0FFFFFFF);
+	}
+
+	/* free, bad and end of chain markers all lie outside the heap, a cluster leading to itself ends the chain too */
+	return (next >= 2 && next - 2 < fatClusters && next != cluster) ? next : 0;
+}
+
+/**
+* @name: FatSeek
+*
+* @return
+* false if cluster is not in the heap
+*
+* points cursor at the start of cluster
+*/
+static BOOL FatSeek(FAT_CURSOR* cursor, ULONG cluster)
+{
+	ULONGLONG offset = fatHeap + (ULONGLONG)(cluster - 2) * fatClusterSize;
+
+	if (cluster < 2 || cluster - 2 >= fatClusters || offset + fatClusterSize > fatSize)
+		return FALSE;
+
+	cursor->offset = offset;
+	cursor->runEnd = offset + fatClusterSize;
+	cursor->cluster = cluster;
+	return TRUE;
+}
+
+/**
+* @name: FatNextEntry
+*
+* @return
+* the next 32 byte entry of the directory, or NULL at its end
+*/
+static const BYTE* FatNextEntry(FAT_CURSOR* cursor)
+{
+	const BYTE* entry = NULL;
+
+	if (cursor->offset >= cursor->runEnd)
+	{
+		if (cursor->cluster == 0 || ++cursor->steps > fatClusters ||
+			!FatSeek(cursor, FatNextCluster(cursor->cluster)))
+			return NULL;
+	}
+
+	entry = fatBase + cursor->offset;
+	cursor->offset += FAT_ENTRY;
+	return entry;
+}
+
+/**
+* @name: FatDirInit
+*
+* @return
+* void
+*
+* points cursor at the first entry of dir
+*/
+static VOID FatDirInit(FAT_CURSOR* cursor, const IMAGE_DIR* dir)
+{
+	ZeroMemory(cursor, sizeof(*cursor));
+
+	if (dir->flags & FAT_DIR_FIXED)
+	{
+		cursor->offset = dir->first;
+		cursor->runEnd = (dir->first + dir->length <= fatSize) ? dir->first + dir->length : dir->first;
+	}
+	else if (FatSeek(cursor, (ULONG)dir->first) && (dir->flags & FAT_DIR_CONTIGUOUS))
+	{
+		/* no chain to follow, the directory simply continues */
+		cursor->cluster = 0;
+		cursor->runEnd = cursor->offset + dir->length;
+
+		if (dir->length > (ULONGLONG)(fatClusters - (dir->first - 2)) * fatClusterSize)
+			cursor->runEnd = cursor->offset;
+	}
+}
+
+/**
+* @name: FatDirOpen
+*
+* starts enumerating a directory, see IMAGE_FS
+*/
+static VOID* FatDirOpen(const IMAGE_DIR* dir)
+{
+	FAT_CURSOR* cursor = (FAT_CURSOR*)StatsMalloc(sizeof(FAT_CURSOR));
+
+	if (cursor == NULL)
+		exit(-1);
+
+	FatDirInit(cursor, dir);
+	return cursor;
+}
+
+/**
+* @name: FatDirClose
+*
+* ends an enumeration, see IMAGE_FS
+*/
+static VOID FatDirClose(VOID* cursor)
+{
+	free(cursor);
+}
+
+/**
+* @name: FatTime
+*
+* @param bUtc
+* true if date and time are UTC already, else they are local time as FAT keeps it
+*
+* @return
+* void
+*/
+static VOID FatTime(WORD date, WORD time, BOOL bUtc, FILETIME* ft)
+{
+	FILETIME local;
+
+	ZeroMemory(ft, sizeof(*ft));
+
+	if (date == 0 || !DosDateTimeToFileTime(date, time, &local))
+		return;
+
+	if (bUtc)
+		*ft = local;
+	else
+		LocalFileTimeToFileTime(&local, ft);
+}
+
+/**
+* @name: FatShortName
+*
+* @return
+* void
+*
+* turns an 8.3 name into NAME.EXT, lower casing either part as Windows NT
+* marks it to, and reading the rest in the OEM code page FAT uses
+*/
+static VOID FatShortName(const BYTE* entry, wchar_t* name)
+{
+	char str[13];
+	size_t base = 8;
+	size_t ext = 3;
+	size_t n = 0;
+	size_t i = 0;
+
+	while (base > 0 && entry[base - 1] == ' ')
+		--base;
+
+	while (ext > 0 && entry[8 + ext - 1] == ' ')
+		--ext;
+
+	for (i = 0; i < base; ++i)
+	{
+		char c = (char)entry[i];
+
+		/* 0xE5 marks deleted entries, so a name starting with it is stored as 0x05 */
+		if (i == 0 && c == 0x05)
+			c = (char)0xE5;
+
+		str[n++] = (entry[12] & 0x08) && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+
+	if (ext > 0)
+		str[n++] = '.';
+
+	for (i = 0; i < ext; ++i)
+	{
+		char c = (char)entry[8 + i];
+
+		str[n++] = (entry[12] & 0x10) && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+
+	n = MultiByteToWideChar(437, 0, str, (int)n, name, MAX_PATH - 1);
+	name[n] = L'\0';
+}
+
+/**
+* @name: FatDirNext
+*
+* returns the next entry of a FAT directory, see IMAGE_FS
+*/
+static BOOL FatDirNext(VOID* pCursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir)
+{
+	FAT_CURSOR* cursor = (FAT_CURSOR*)pCursor;
+	const BYTE* entry = NULL;
+
+	while ((entry = FatNextEntry(cursor)) != NULL)
+	{
+		BYTE attributes = entry[11];
+		BYTE checksum = 0;
+		ULONG cluster = 0;
+		UINT i = 0;
+
+		/* the end of the directory */
+		if (entry[0] == 0x00)
+		{
+			cursor->runEnd = cursor->offset;
+			cursor->cluster = 0;
+			return FALSE;
+		}
+
+		/* deleted entries and the volume label end any long name too */
+		if (entry[0] == 0xE5 || ((attributes & 0x3F) != 0x0F && (attributes & 0x08)))
+		{
+			cursor->namePart = 0;
+			cursor->bLongName = FALSE;
+			continue;
+		}
+
+		if ((attributes & 0x3F) == 0x0F)
+		{
+			/* a long name comes in pieces of 13 characters, last piece first */
+			static const BYTE chars[FAT_LFN_CHARS] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+			UINT part = entry[0] & 0x1F;
+
+			if (entry[0] & 0x40)
+			{
+				cursor->namePart = part;
+				cursor->checksum = entry[13];
+				cursor->bLongName = FALSE;
+			}
+
+			if (part == 0 || part > FAT_LFN_PARTS || part != cursor->namePart || entry[13] != cursor->checksum)
+			{
+				cursor->namePart = 0;
+				cursor->bLongName = FALSE;
+				continue;
+			}
+
+			if (entry[0] & 0x40)
+				cursor->name[part * FAT_LFN_CHARS] = L'\0';
+
+			for (i = 0; i < FAT_LFN_CHARS; ++i)
+			{
+				WORD c = ImageWord(entry + chars[i]);
+
+				/* the name ends with a NUL, padded with 0xFFFF */
+				cursor->name[(part - 1) * FAT_LFN_CHARS + i] = (c == 0xFFFF) ? L'\0' : (wchar_t)c;
+			}
+
+			cursor->bLongName = (--cursor->namePart == 0);
+			continue;
+		}
+
+		ZeroMemory(data, sizeof(*data));
+
+		for (i = 0; i < 11; ++i)
+			checksum = (BYTE)(((checksum & 1) << 7) + (checksum >> 1) + entry[i]);
+
+		/* a long name left behind by a system unaware of it belongs to another short name */
+		if (cursor->bLongName && checksum == cursor->checksum && cursor->name[0] != L'\0')
+			wcsncpy_s(data->cFileName, MAX_PATH, cursor->name, _TRUNCATE);
+		else
+			FatShortName(entry, data->cFileName);
+
+		cursor->namePart = 0;
+		cursor->bLongName = FALSE;
+
+		data->dwFileAttributes = attributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN |
+			FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE);
+
+		if (data->dwFileAttributes == 0)
+			data->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+
+		FatTime(ImageWord(entry + 16), ImageWord(entry + 14), FALSE, &data->ftCreationTime);
+		FatTime(ImageWord(entry + 18), 0, FALSE, &data->ftLastAccessTime);
+		FatTime(ImageWord(entry + 24), ImageWord(entry + 22), FALSE, &data->ftLastWriteTime);
+
+		if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			cluster = ImageWord(entry + 26);
+
+			if (fatBits == 32)
+				cluster |= (ULONG)ImageWord(entry + 20) << 16;
+
+			/* ".." of a folder in the root points at cluster 0 */
+			if (cluster == 0)
+			{
+				*dir = fatRootDir;
+			}
+			else
+			{
+				dir->first = cluster;
+				dir->length = 0;
+				dir->flags = 0;
+			}
+		}
+		else
+		{
+			data->nFileSizeLow = ImageDword(entry + 28);
+		}
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+* @name: FatOemName
+*
+* @return
+* void
+*
+* reads an 11 byte volume label in the OEM code page, without its trailing spaces
+*/
+static VOID FatOemName(const BYTE* str, wchar_t* name, size_t len)
+{
+	int n = 11;
+
+	while (n > 0 && str[n - 1] == ' ')
+		--n;
+
+	n = MultiByteToWideChar(437, 0, (const char*)str, n, name, (int)len - 1);
+	name[n] = L'\0';
+}
+
+/**
+* @name: FatMount
+*
+* recognises FAT12, FAT16 and FAT32 volumes, see IMAGE_FS
+*/
+static BOOL FatMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	FAT_CURSOR cursor;
+	const BYTE* entry = NULL;
+	ULONG bytesPerSector = 0;
+	ULONG sectorsPerCluster = 0;
+	ULONG reserved = 0;
+	ULONG fats = 0;
+	ULONG rootEntries = 0;
+	ULONG sectors = 0;
+	ULONG fatSectors = 0;
+	ULONG rootSectors = 0;
+	ULONG clusters = 0;
+	ULONG ext = 0;
+
+	/* a jump to the boot code, the boot signature and a sane media descriptor */
+	if (size < 512 || (base[0] != 0xEB && base[0] != 0xE9) || base[510] != 0x55 || base[511] != 0xAA ||
+		(base[21] != 0xF0 && base[21] < 0xF8))
+		return FALSE;
+
+	bytesPerSector = ImageWord(base + 11);
+	sectorsPerCluster = base[13];
+	reserved = ImageWord(base + 14);
+	fats = base[16];
+	rootEntries = ImageWord(base + 17);
+	sectors = ImageWord(base + 19) ? ImageWord(base + 19) : ImageDword(base + 32);
+	fatSectors = ImageWord(base + 22) ? ImageWord(base + 22) : ImageDword(base + 36);
+
+	if (bytesPerSector < 512 || bytesPerSector > 4096 || (bytesPerSector & (bytesPerSector - 1)) ||
+		sectorsPerCluster == 0 || (sectorsPerCluster & (sectorsPerCluster - 1)) ||
+		reserved == 0 || fats == 0 || fatSectors == 0)
+		return FALSE;
+
+	rootSectors = (rootEntries * FAT_ENTRY + bytesPerSector - 1) / bytesPerSector;
+
+	if ((ULONGLONG)reserved + (ULONGLONG)fats * fatSectors + rootSectors >= sectors)
+		return FALSE;
+
+	/* the FAT type follows from the cluster count alone */
+	clusters = (ULONG)((sectors - reserved - (ULONGLONG)fats * fatSectors - rootSectors) / sectorsPerCluster);
+
+	fatBase = base;
+	fatSize = size;
+	fatBits = (clusters < 4085) ? 12 : (clusters < 65525) ? 16 : 32;
+	fatTable = (ULONGLONG)reserved * bytesPerSector;
+	fatHeap = ((ULONGLONG)reserved + (ULONGLONG)fats * fatSectors + rootSectors) * bytesPerSector;
+	fatClusterSize = sectorsPerCluster * bytesPerSector;
+	fatClusters = clusters;
+	bExfat = FALSE;
+
+	ZeroMemory(&fatRootDir, sizeof(fatRootDir));
+
+	if (fatBits == 32)
+	{
+		fatRootDir.first = ImageDword(base + 44);
+	}
+	else
+	{
+		fatRootDir.first = ((ULONGLONG)reserved + (ULONGLONG)fats * fatSectors) * bytesPerSector;
+		fatRootDir.length = (ULONGLONG)rootEntries * FAT_ENTRY;
+		fatRootDir.flags = FAT_DIR_FIXED;
+	}
+
+	*root = fatRootDir;
+
+	/* the extended boot record holds the serial number and a copy of the label */
+	ext = (fatBits == 32) ? 0x42 : 0x26;
+	*serial = (base[ext] == 0x29) ? ImageDword(base + ext + 1) : 0;
+	label[0] = L'\0';
+
+	if (base[ext] == 0x29 && memcmp(base + ext + 5, "NO NAME    ", 11) != 0)
+		FatOemName(base + ext + 5, label, labelLen);
+
+	/* Windows goes by the label in the root directory, which is the one kept up to date */
+	FatDirInit(&cursor, &fatRootDir);
+
+	while ((entry = FatNextEntry(&cursor)) != NULL && entry[0] != 0x00)
+	{
+		if (entry[0] != 0xE5 && (entry[11] & 0x3F) != 0x0F && (entry[11] & 0x08))
+		{
+			FatOemName(entry, label, labelLen);
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: ExfatTime
+*
+* @param stamp
+* date in the high and time in the low 16 bits, as FAT keeps them
+*
+* @param centiseconds
+* 10 ms units to be added to stamp
+*
+* @param utcOffset
+* if bit 7 is set, the offset from UTC of stamp in 15 minute units, else stamp is local time
+*
+* @return
+* void
+*/
+static VOID ExfatTime(DWORD stamp, BYTE centiseconds, BYTE utcOffset, FILETIME* ft)
+{
+	ULARGE_INTEGER time;
+	LONG offset = utcOffset & 0x7F;
+
+	FatTime(HIWORD(stamp), LOWORD(stamp), (utcOffset & 0x80) != 0, ft);
+
+	if (ft->dwLowDateTime == 0 && ft->dwHighDateTime == 0)
+		return;
+
+	/* the offset is a signed 7 bit number */
+	if (offset & 0x40)
+		offset -= 0x80;
+
+	time.LowPart = ft->dwLowDateTime;
+	time.HighPart = ft->dwHighDateTime;
+	time.QuadPart += (ULONGLONG)centiseconds * 100000;
+
+	if (utcOffset & 0x80)
+		time.QuadPart -= (LONGLONG)offset * 15 * 60 * 10000000;
+
+	ft->dwLowDateTime = time.LowPart;
+	ft->dwHighDateTime = time.HighPart;
+}
+
+/**
+* @name: ExfatDirNext
+*
+* returns the next entry of an exFAT directory, see IMAGE_FS
+*
+* every file is a set of entries: a file entry with its attributes and
+* times, a stream extension with its size and clusters, and as many name
+* entries as its name needs, 15 characters each
+*/
+static BOOL ExfatDirNext(VOID* pCursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir)
+{
+	FAT_CURSOR* cursor = (FAT_CURSOR*)pCursor;
+	const BYTE* entry = NULL;
+	UINT secondaries = 0;	/* entries of the set still to come, 0 outside a set */
+	UINT nameLen = 0;
+	UINT have = 0;
+	ULONGLONG length = 0;
+
+	while ((entry = FatNextEntry(cursor)) != NULL)
+	{
+		BYTE type = entry[0];
+		UINT i = 0;
+
+		/* the end of the directory */
+		if (type == 0x00)
+		{
+			cursor->runEnd = cursor->offset;
+			cursor->cluster = 0;
+			return FALSE;
+		}
+
+		if (type == 0x85)
+		{
+			ZeroMemory(data, sizeof(*data));
+			ZeroMemory(dir, sizeof(*dir));
+			secondaries = entry[1];
+			nameLen = 0;
+			have = 0;
+			length = 0;
+
+			data->dwFileAttributes = ImageWord(entry + 4) & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN |
+				FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_ARCHIVE);
+
+			if (data->dwFileAttributes == 0)
+				data->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+
+			ExfatTime(ImageDword(entry + 8), entry[20], entry[22], &data->ftCreationTime);
+			ExfatTime(ImageDword(entry + 12), entry[21], entry[23], &data->ftLastWriteTime);
+			ExfatTime(ImageDword(entry + 16), 0, entry[24], &data->ftLastAccessTime);
+			continue;
+		}
+
+		/* unused entries, other primary entries and a set cut short are all skipped */
+		if (secondaries == 0 || (type & 0xC0) != 0xC0)
+		{
+			secondaries = 0;
+			continue;
+		}
+
+		if (type == 0xC0)
+		{
+			nameLen = entry[3];
+			length = ImageQword(entry + 24);
+
+			dir->first = ImageDword(entry + 20);
+			dir->length = length;
+			dir->flags = (entry[1] & 0x02) ? FAT_DIR_CONTIGUOUS : 0;
+		}
+		else if (type == 0xC1)
+		{
+			for (i = 0; i < 15 && have < nameLen && have < MAX_PATH - 1; ++i)
+				data->cFileName[have++] = (wchar_t)ImageWord(entry + 2 + 2 * i);
+		}
+
+		if (--secondaries == 0 && have > 0)
+		{
+			data->cFileName[have] = L'\0';
+
+			if (!(data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				data->nFileSizeHigh = (DWORD)(length >> 32);
+				data->nFileSizeLow = (DWORD)length;
+			}
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+* @name: ExfatMount
+*
+* recognises exFAT volumes, see IMAGE_FS
+*/
+static BOOL ExfatMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	FAT_CURSOR cursor;
+	const BYTE* entry = NULL;
+	UINT sectorShift = 0;
+	UINT clusterShift = 0;
+
+	if (size < 512 || memcmp(base + 3, "EXFAT   ", 8) != 0 || base[510] != 0x55 || base[511] != 0xAA)
+		return FALSE;
+
+	sectorShift = base[108];
+	clusterShift = base[109];
+
+	if (sectorShift < 9 || sectorShift > 12 || sectorShift + clusterShift > 25)
+		return FALSE;
+
+	fatBase = base;
+	fatSize = size;
+	fatBits = 32;
+	fatTable = (ULONGLONG)ImageDword(base + 80) << sectorShift;
+	fatHeap = (ULONGLONG)ImageDword(base + 88) << sectorShift;
+	fatClusterSize = 1UL << (sectorShift + clusterShift);
+	fatClusters = ImageDword(base + 92);
+	bExfat = TRUE;
+
+	ZeroMemory(&fatRootDir, sizeof(fatRootDir));
+	fatRootDir.first = ImageDword(base + 96);
+	*root = fatRootDir;
+	*serial = ImageDword(base + 100);
+	label[0] = L'\0';
+
+	/* the label is an entry of its own in the root directory */
+	FatDirInit(&cursor, &fatRootDir);
+
+	while ((entry = FatNextEntry(&cursor)) != NULL && entry[0] != 0x00)
+	{
+		if (entry[0] == 0x83)
+		{
+			UINT len = (entry[1] <= 11 && entry[1] < labelLen) ? entry[1] : 0;
+			UINT i = 0;
+
+			for (i = 0; i < len; ++i)
+				label[i] = (wchar_t)ImageWord(entry + 2 + 2 * i);
+
+			label[len] = L'\0';
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+const IMAGE_FS fatFs = { FatMount, FatDirOpen, FatDirNext, FatDirClose };
+const IMAGE_FS exfatFs = { ExfatMount, FatDirOpen, ExfatDirNext, FatDirClose };
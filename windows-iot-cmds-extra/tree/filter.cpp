@@ -0,0 +1,415 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     File filters selected by tree.com's /SIZE, /NEWER, /OLDER, /ATTR and /FIND options
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "filter.h"
+#include "stats.h"
+
+/* most filters that can be given on one command line */
+#define FILTER_MAX 16
+
+/* a single test, all of which must pass */
+typedef enum _FILTER_OP
+{
+	FILTER_ATTR,		/* (attributes & mask) == value */
+	FILTER_SIZE_ABOVE,	/* size > value */
+	FILTER_SIZE_BELOW,	/* size < value */
+	FILTER_SIZE_EQUAL,	/* size == value */
+	FILTER_NEWER,		/* last write time >= value */
+	FILTER_OLDER,		/* last write time < value */
+	FILTER_NAME		/* name matches filterName */
+} FILTER_OP;
+
+typedef struct _FILTER_INSN
+{
+	FILTER_OP op;
+	DWORD mask;
+	ULONGLONG value;
+} FILTER_INSN;
+
+BOOL bFilter = FALSE;
+
+/*
+ * the options compiled into tests on the fields WIN32_FIND_DATA already
+ * holds: sizes are scaled to bytes and dates converted to FILETIME up front,
+ * and all attribute letters are folded into the single first test
+ */
+static FILTER_INSN filterProgram[FILTER_MAX];
+static UINT filterLen = 0;
+
+/* with /FIND, the upper cased pattern names are matched against, see FilterWildcard */
+static wchar_t* filterName = NULL;
+
+/* attribute letters as used by DIR /A */
+static const struct
+{
+	wchar_t letter;
+	DWORD attribute;
+} filterAttrs[] =
+{
+	{ L'R', FILE_ATTRIBUTE_READONLY },
+	{ L'H', FILE_ATTRIBUTE_HIDDEN },
+	{ L'S', FILE_ATTRIBUTE_SYSTEM },
+	{ L'A', FILE_ATTRIBUTE_ARCHIVE },
+	{ L'C', FILE_ATTRIBUTE_COMPRESSED },
+	{ L'E', FILE_ATTRIBUTE_ENCRYPTED },
+	{ L'I', FILE_ATTRIBUTE_NOT_CONTENT_INDEXED },
+	{ L'L', FILE_ATTRIBUTE_REPARSE_POINT },
+	{ L'O', FILE_ATTRIBUTE_OFFLINE },
+	{ L'T', FILE_ATTRIBUTE_TEMPORARY }
+};
+
+/**
+* @name: FilterAppend
+*
+* @return
+* the new test, or NULL if there are too many
+*/
+static FILTER_INSN* FilterAppend(FILTER_OP op)
+{
+	if (filterLen == FILTER_MAX)
+		return NULL;
+
+	bFilter = TRUE;
+	filterProgram[filterLen].op = op;
+	filterProgram[filterLen].mask = 0;
+	filterProgram[filterLen].value = 0;
+	return &filterProgram[filterLen++];
+}
+
+/**
+* @name: FilterAddSize
+*
+* @param strSize
+* [+|-]number[K|M|G|T]: larger than, smaller than or exactly that many bytes
+*
+* @return
+* false if strSize is malformed, negative, not finite or past 2^64 bytes
+*/
+BOOL FilterAddSize(const wchar_t* strSize)
+{
+	FILTER_OP op = FILTER_SIZE_EQUAL;
+	FILTER_INSN* insn = NULL;
+	wchar_t* end = NULL;
+	double size = 0;
+
+	if (*strSize == L'+')
+	{
+		op = FILTER_SIZE_ABOVE;
+		++strSize;
+	}
+	else if (*strSize == L'-')
+	{
+		op = FILTER_SIZE_BELOW;
+		++strSize;
+	}
+
+	size = wcstod(strSize, &end);
+	if (end == strSize || !(size >= 0))
+		return FALSE;
+
+	switch (towupper(*end))
+	{
+	case L'T':	size *= 1024;	/* fall through */
+	case L'G':	size *= 1024;	/* fall through */
+	case L'M':	size *= 1024;	/* fall through */
+	case L'K':	size *= 1024; ++end; break;
+	default:	break;
+	}
+
+	if (towupper(*end) == L'B')
+		++end;
+
+	/* 2^64 is exact as a double, anything from there on, and inf or nan, has no ULONGLONG */
+	if (*end != L'\0' || !(size >= 0 && size < 18446744073709551616.0) || (insn = FilterAppend(op)) == NULL)
+		return FALSE;
+
+	insn->value = (ULONGLONG)size;
+	return TRUE;
+}
+
+/**
+* @name: FilterAddTime
+*
+* @param strTime
+* YYYY-MM-DD[THH:MM[:SS]] in UTC, like the times written by /JSON
+*
+* @param bNewer
+* true to keep files written at or after strTime, false for those before
+*
+* @return
+* false if strTime is malformed, has anything after the time or a field out of range
+*/
+BOOL FilterAddTime(const wchar_t* strTime, BOOL bNewer)
+{
+	SYSTEMTIME st;
+	FILETIME ft;
+	FILTER_INSN* insn = NULL;
+	UINT year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+	int endDate = -1, endMinute = -1, endSecond = -1;
+	int end = -1;
+	int fields = swscanf_s(strTime, L"%4u-%2u-%2u%nT%2u:%2u%n:%2u%n",
+		&year, &month, &day, &endDate, &hour, &minute, &endMinute, &second, &endSecond);
+
+	/* %n records how far each form got, the one matched must have used up all of strTime */
+	if (fields == 3)
+		end = endDate;
+	else if (fields == 5)
+		end = endMinute;
+	else if (fields == 6)
+		end = endSecond;
+
+	if (end < 0 || strTime[end] != L'\0')
+		return FALSE;
+
+	if (year < 1601 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59)
+		return FALSE;
+
+	ZeroMemory(&st, sizeof(st));
+	st.wYear = (WORD)year;
+	st.wMonth = (WORD)month;
+	st.wDay = (WORD)day;
+	st.wHour = (WORD)hour;
+	st.wMinute = (WORD)minute;
+	st.wSecond = (WORD)second;
+
+	if (!SystemTimeToFileTime(&st, &ft) || (insn = FilterAppend(bNewer ? FILTER_NEWER : FILTER_OLDER)) == NULL)
+		return FALSE;
+
+	insn->value = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+	return TRUE;
+}
+
+/**
+* @name: FilterAddAttr
+*
+* @param strAttr
+* attribute letters, each one prefixed with - if it must not be set
+*
+* @return
+* false if strAttr holds an unknown letter
+*/
+BOOL FilterAddAttr(const wchar_t* strAttr)
+{
+	FILTER_INSN* insn = NULL;
+	BOOL bNot = FALSE;
+	UINT i = 0;
+
+	/* every attribute test goes into one, kept first as it is the cheapest */
+	if (filterLen > 0 && filterProgram[0].op == FILTER_ATTR)
+	{
+		insn = &filterProgram[0];
+	}
+	else
+	{
+		if (FilterAppend(FILTER_ATTR) == NULL)
+			return FALSE;
+
+		MoveMemory(&filterProgram[1], &filterProgram[0], (filterLen - 1) * sizeof(FILTER_INSN));
+		insn = &filterProgram[0];
+		insn->op = FILTER_ATTR;
+		insn->mask = 0;
+		insn->value = 0;
+	}
+
+	for (; *strAttr != L'\0'; ++strAttr)
+	{
+		if (*strAttr == L'-')
+		{
+			bNot = TRUE;
+			continue;
+		}
+
+		for (i = 0; i < _countof(filterAttrs); ++i)
+		{
+			if (filterAttrs[i].letter == towupper(*strAttr))
+				break;
+		}
+
+		if (i == _countof(filterAttrs))
+			return FALSE;
+
+		insn->mask |= filterAttrs[i].attribute;
+
+		if (bNot)
+			insn->value &= ~(ULONGLONG)filterAttrs[i].attribute;
+		else
+			insn->value |= filterAttrs[i].attribute;
+
+		bNot = FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: FilterAddName
+*
+* @param strName
+* text found anywhere in the names of the files listed, or if it holds * or ?,
+* a pattern their whole names have to match. Case is ignored
+*
+* @return
+* false if a name was already given
+*/
+BOOL FilterAddName(const wchar_t* strName)
+{
+	size_t len = wcslen(strName);
+	BOOL bPlain = wcspbrk(strName, L"*?") == NULL;
+	size_t i = 0;
+
+	if (filterName != NULL || FilterAppend(FILTER_NAME) == NULL)
+		return FALSE;
+
+	filterName = (wchar_t*)StatsMalloc((len + 3) * sizeof(wchar_t));
+
+	if (filterName == NULL)
+		exit(-1);
+
+	/* plain text is looked for anywhere in the name */
+	if (bPlain)
+		filterName[i++] = L'*';
+
+	for (; *strName != L'\0'; ++strName)
+		filterName[i++] = FilterUpper(*strName);
+
+	if (bPlain)
+		filterName[i++] = L'*';
+
+	filterName[i] = L'\0';
+	return TRUE;
+}
+
+/**
+* @name: FilterWildcard
+*
+* @param pattern
+* upper cased, * stands for any characters and ? for any one character
+*
+* @return
+* true if the whole name matches pattern, without regard to case
+*/
+BOOL FilterWildcard(const wchar_t* pattern, const wchar_t* name, size_t nameLen)
+{
+	const wchar_t* star = NULL;
+	size_t starName = 0;
+	size_t i = 0;
+
+	while (i < nameLen)
+	{
+		wchar_t c = FilterUpper(name[i]);
+
+		if (*pattern == L'?' || (*pattern != L'*' && *pattern != L'\0' && *pattern == c))
+		{
+			++pattern;
+			++i;
+		}
+		else if (*pattern == L'*')
+		{
+			/* try the rest of the pattern at each position from here on */
+			star = ++pattern;
+			starName = i;
+		}
+		else if (star != NULL)
+		{
+			pattern = star;
+			i = ++starName;
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+
+	while (*pattern == L'*')
+		++pattern;
+
+	return *pattern == L'\0';
+}
+
+/**
+* @name: FilterName
+*
+* @param name
+* of a folder, which the other filters don't apply to
+*
+* @return
+* true if /FIND was given and name matches it
+*/
+BOOL FilterName(const wchar_t* name)
+{
+	return filterName != NULL && FilterWildcard(filterName, name, wcslen(name));
+}
+
+/**
+* @name: FilterHasName
+*
+* @return
+* true if /FIND was given
+*/
+BOOL FilterHasName(VOID)
+{
+	return filterName != NULL;
+}
+
+/**
+* @name: FilterRun
+*
+* @param entry
+* file as returned by enumeration
+*
+* @return
+* true if the file passes every test
+*/
+BOOL FilterRun(const WIN32_FIND_DATA* entry)
+{
+	ULONGLONG size = ((ULONGLONG)entry->nFileSizeHigh << 32) | entry->nFileSizeLow;
+	ULONGLONG time = ((ULONGLONG)entry->ftLastWriteTime.dwHighDateTime << 32) | entry->ftLastWriteTime.dwLowDateTime;
+	UINT i = 0;
+
+	for (i = 0; i < filterLen; ++i)
+	{
+		const FILTER_INSN* insn = &filterProgram[i];
+
+		switch (insn->op)
+		{
+		case FILTER_ATTR:
+			if ((entry->dwFileAttributes & insn->mask) != insn->value)
+				return FALSE;
+			break;
+		case FILTER_SIZE_ABOVE:
+			if (size <= insn->value)
+				return FALSE;
+			break;
+		case FILTER_SIZE_BELOW:
+			if (size >= insn->value)
+				return FALSE;
+			break;
+		case FILTER_SIZE_EQUAL:
+			if (size != insn->value)
+				return FALSE;
+			break;
+		case FILTER_NEWER:
+			if (time < insn->value)
+				return FALSE;
+			break;
+		case FILTER_OLDER:
+			if (time >= insn->value)
+				return FALSE;
+			break;
+		case FILTER_NAME:
+			if (!FilterWildcard(filterName, entry->cFileName, wcslen(entry->cFileName)))
+				return FALSE;
+			break;
+		}
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,50 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     File filters selected by tree.com's /SIZE, /NEWER, /OLDER, /ATTR and /FIND options
+*/
+
+#pragma once
+
+#include <wctype.h>
+#include <windows.h>
+
+/* if this flag is true, files are only listed if they pass every filter */
+extern BOOL bFilter;
+
+BOOL FilterAddSize(const wchar_t* strSize);
+BOOL FilterAddTime(const wchar_t* strTime, BOOL bNewer);
+BOOL FilterAddAttr(const wchar_t* strAttr);
+BOOL FilterAddName(const wchar_t* strName);
+BOOL FilterRun(const WIN32_FIND_DATA* entry);
+BOOL FilterName(const wchar_t* name);
+BOOL FilterHasName(VOID);
+BOOL FilterWildcard(const wchar_t* pattern, const wchar_t* name, size_t nameLen);
+
+/**
+* @name: FilterMatch
+*
+* @param entry
+* file as returned by enumeration
+*
+* @return
+* true if the file is to be listed
+*/
+static __forceinline BOOL FilterMatch(const WIN32_FIND_DATA* entry)
+{
+	return !bFilter || FilterRun(entry);
+}
+
+/**
+* @name: FilterUpper
+*
+* @return
+* c upper cased, without calling into the CRT for ASCII
+*/
+static __forceinline wchar_t FilterUpper(wchar_t c)
+{
+	if (c < 0x80)
+		return (c >= L'a' && c <= L'z') ? (wchar_t)(c - (L'a' - L'A')) : c;
+
+	return (wchar_t)towupper(c);
+}
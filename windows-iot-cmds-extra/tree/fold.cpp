@@ -0,0 +1,155 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Signatures of listed subtrees behind tree.com's /FOLD option
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "fold.h"
+#include "hash.h"
+#include "stats.h"
+
+/* slots of the table when it is first needed, always a power of two */
+#define FOLD_SLOTS_MIN 4096
+
+/* bytes of slots and paths, signatures seen past this are not recorded */
+#define FOLD_MEMORY_MAX (64 * 1024 * 1024)
+
+/* the first folder found with a signature, the one the others refer to */
+typedef struct _FOLD_ENTRY
+{
+	BYTE signature[HASH_SIZE];
+	wchar_t* strPath;	/* NULL for an empty slot */
+} FOLD_ENTRY;
+
+/* open addressed table of the signatures seen so far */
+static FOLD_ENTRY* foldTable = NULL;
+static size_t foldSlots = 0;
+static size_t foldCount = 0;
+
+/* bytes held by the table and its paths */
+static size_t foldBytes = 0;
+
+/**
+* @name: FoldSlot
+*
+* @return
+* slot signature is in, or the empty slot it would go to
+*
+* the signature is a SHA-256 digest, so any of its bytes are as good a hash as any
+*/
+static FOLD_ENTRY* FoldSlot(FOLD_ENTRY* table, size_t slots, const BYTE* signature)
+{
+	size_t i = 0;
+
+	memcpy(&i, signature, sizeof(i));
+
+	for (i &= slots - 1; ; i = (i + 1) & (slots - 1))
+	{
+		if (table[i].strPath == NULL || memcmp(table[i].signature, signature, HASH_SIZE) == 0)
+			return &table[i];
+	}
+}
+
+/**
+* @name: FoldGrow
+*
+* @return
+* true if the table has room for one more signature
+*/
+static BOOL FoldGrow(VOID)
+{
+	size_t slots = (foldSlots == 0) ? FOLD_SLOTS_MIN : 2 * foldSlots;
+	FOLD_ENTRY* table = NULL;
+	size_t i = 0;
+
+	/* keep the table at most three quarters full */
+	if (4 * (foldCount + 1) <= 3 * foldSlots)
+		return TRUE;
+
+	if (foldBytes + slots * sizeof(FOLD_ENTRY) > FOLD_MEMORY_MAX)
+		return FALSE;
+
+	table = (FOLD_ENTRY*)StatsCalloc(slots, sizeof(FOLD_ENTRY));
+	if (table == NULL)
+		exit(-1);
+
+	for (i = 0; i < foldSlots; ++i)
+	{
+		if (foldTable[i].strPath != NULL)
+			*FoldSlot(table, slots, foldTable[i].signature) = foldTable[i];
+	}
+
+	free(foldTable);
+	foldBytes += (slots - foldSlots) * sizeof(FOLD_ENTRY);
+	foldTable = table;
+	foldSlots = slots;
+	return TRUE;
+}
+
+/**
+* @name: FoldFind
+*
+* @param signature
+* hash of the shape of a listed folder, computed bottom-up from the names
+* and sizes of what is below it
+*
+* @param strPath
+* path of that folder
+*
+* @return
+* path of the first folder seen with the same signature, else NULL, in
+* which case strPath is recorded as that first folder unless the table
+* is full
+*/
+const wchar_t* FoldFind(const BYTE* signature, const wchar_t* strPath)
+{
+	size_t len = wcslen(strPath) + 1;
+	FOLD_ENTRY* slot = NULL;
+
+	if (foldTable != NULL)
+	{
+		slot = FoldSlot(foldTable, foldSlots, signature);
+
+		if (slot->strPath != NULL)
+			return slot->strPath;
+	}
+
+	if (foldBytes + len * sizeof(wchar_t) > FOLD_MEMORY_MAX || !FoldGrow())
+		return NULL;
+
+	slot = FoldSlot(foldTable, foldSlots, signature);
+	memcpy(slot->signature, signature, HASH_SIZE);
+
+	slot->strPath = (wchar_t*)StatsMalloc(len * sizeof(wchar_t));
+	if (slot->strPath == NULL)
+		exit(-1);
+
+	memcpy(slot->strPath, strPath, len * sizeof(wchar_t));
+	foldBytes += len * sizeof(wchar_t);
+	++foldCount;
+	return NULL;
+}
+
+/**
+* @name: FoldFree
+*
+* @return
+* void
+*/
+VOID FoldFree(VOID)
+{
+	size_t i = 0;
+
+	for (i = 0; i < foldSlots; ++i)
+		free(foldTable[i].strPath);
+
+	free(foldTable);
+	foldTable = NULL;
+	foldSlots = 0;
+	foldCount = 0;
+	foldBytes = 0;
+}
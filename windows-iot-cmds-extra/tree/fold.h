@@ -0,0 +1,12 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Signatures of listed subtrees behind tree.com's /FOLD option
+*/
+
+#pragma once
+
+#include <windows.h>
+
+const wchar_t* FoldFind(const BYTE* signature, const wchar_t* strPath);
+VOID FoldFree(VOID);
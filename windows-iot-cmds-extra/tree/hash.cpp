@@ -0,0 +1,241 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     SHA-256 digests for tree.com's /HASHTREE and /FOLD options
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "hash.h"
+#include "stats.h"
+
+/* bytes of a file read at a time by HashFile */
+#define HASH_READ (1024 * 1024)
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const DWORD hashRounds[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* a buffer for HashFile, only ever used by the traversal thread */
+static BYTE* hashBuffer = NULL;
+
+/**
+* @name: HashBlock
+*
+* @return
+* void
+*
+* mixes one 64 byte block into the state
+*/
+static VOID HashBlock(DWORD* state, const BYTE* block)
+{
+	DWORD w[64];
+	DWORD a = state[0], b = state[1], c = state[2], d = state[3];
+	DWORD e = state[4], f = state[5], g = state[6], h = state[7];
+	UINT i = 0;
+
+	for (i = 0; i < 16; ++i)
+		w[i] = ((DWORD)block[4 * i] << 24) | ((DWORD)block[4 * i + 1] << 16) | ((DWORD)block[4 * i + 2] << 8) | block[4 * i + 3];
+
+	for (; i < 64; ++i)
+	{
+		DWORD s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		DWORD s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	for (i = 0; i < 64; ++i)
+	{
+		DWORD t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + hashRounds[i] + w[i];
+		DWORD t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+/**
+* @name: HashInit
+*
+* @return
+* void
+*/
+VOID HashInit(HASH_CONTEXT* ctx)
+{
+	static const DWORD initial[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memcpy(ctx->state, initial, sizeof(initial));
+	ctx->length = 0;
+	ctx->blockLen = 0;
+}
+
+/**
+* @name: HashUpdate
+*
+* @return
+* void
+*
+* adds len bytes to what is being hashed
+*/
+VOID HashUpdate(HASH_CONTEXT* ctx, const VOID* data, size_t len)
+{
+	const BYTE* p = (const BYTE*)data;
+
+	ctx->length += len;
+
+	if (ctx->blockLen > 0)
+	{
+		size_t n = (len < 64 - ctx->blockLen) ? len : 64 - ctx->blockLen;
+
+		memcpy(ctx->block + ctx->blockLen, p, n);
+		ctx->blockLen += (UINT)n;
+		p += n;
+		len -= n;
+
+		if (ctx->blockLen < 64)
+			return;
+
+		HashBlock(ctx->state, ctx->block);
+		ctx->blockLen = 0;
+	}
+
+	/* whole blocks are hashed where they are */
+	for (; len >= 64; p += 64, len -= 64)
+		HashBlock(ctx->state, p);
+
+	memcpy(ctx->block, p, len);
+	ctx->blockLen = (UINT)len;
+}
+
+/**
+* @name: HashFinal
+*
+* @param digest
+* receives HASH_SIZE bytes
+*
+* @return
+* void
+*/
+VOID HashFinal(HASH_CONTEXT* ctx, BYTE* digest)
+{
+	ULONGLONG bits = ctx->length * 8;
+	BYTE pad[72];
+	size_t padLen = ((ctx->blockLen < 56) ? 56 : 120) - ctx->blockLen;
+	UINT i = 0;
+
+	ZeroMemory(pad, sizeof(pad));
+	pad[0] = 0x80;
+
+	for (i = 0; i < 8; ++i)
+		pad[padLen + i] = (BYTE)(bits >> (56 - 8 * i));
+
+	HashUpdate(ctx, pad, padLen + 8);
+
+	for (i = 0; i < 8; ++i)
+	{
+		digest[4 * i] = (BYTE)(ctx->state[i] >> 24);
+		digest[4 * i + 1] = (BYTE)(ctx->state[i] >> 16);
+		digest[4 * i + 2] = (BYTE)(ctx->state[i] >> 8);
+		digest[4 * i + 3] = (BYTE)ctx->state[i];
+	}
+}
+
+/**
+* @name: HashFile
+*
+* @param digest
+* receives HASH_SIZE bytes, all zero if the file can't be read
+*
+* @return
+* false if the file can't be read
+*/
+BOOL HashFile(const wchar_t* strPath, BYTE* digest)
+{
+	HASH_CONTEXT ctx;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	DWORD read = 0;
+	BOOL ret = TRUE;
+
+	ZeroMemory(digest, HASH_SIZE);
+
+	hFile = CreateFile(strPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (hashBuffer == NULL)
+	{
+		hashBuffer = (BYTE*)StatsMalloc(HASH_READ);
+
+		if (hashBuffer == NULL)
+			exit(-1);
+	}
+
+	HashInit(&ctx);
+
+	while ((ret = ReadFile(hFile, hashBuffer, HASH_READ, &read, NULL)) && read > 0)
+		HashUpdate(&ctx, hashBuffer, read);
+
+	CloseHandle(hFile);
+
+	if (!ret)
+		return FALSE;
+
+	HashFinal(&ctx, digest);
+	return TRUE;
+}
+
+/**
+* @name: HashFormat
+*
+* @param str
+* receives HASH_HEX lower case hex digits and a terminating null
+*
+* @return
+* void
+*/
+VOID HashFormat(const BYTE* digest, wchar_t* str)
+{
+	static const wchar_t hex[] = L"0123456789abcdef";
+	UINT i = 0;
+
+	for (i = 0; i < HASH_SIZE; ++i)
+	{
+		str[2 * i] = hex[digest[i] >> 4];
+		str[2 * i + 1] = hex[digest[i] & 15];
+	}
+
+	str[HASH_HEX] = L'\0';
+}
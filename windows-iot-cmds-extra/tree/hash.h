@@ -0,0 +1,28 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     SHA-256 digests for tree.com's /HASHTREE and /FOLD options
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* bytes of a digest, and characters of one written in hex */
+#define HASH_SIZE 32
+#define HASH_HEX (2 * HASH_SIZE)
+
+/* a digest being computed */
+typedef struct _HASH_CONTEXT
+{
+	DWORD state[8];
+	ULONGLONG length;	/* bytes hashed so far */
+	BYTE block[64];
+	UINT blockLen;		/* bytes of block waiting for the rest of it */
+} HASH_CONTEXT;
+
+VOID HashInit(HASH_CONTEXT* ctx);
+VOID HashUpdate(HASH_CONTEXT* ctx, const VOID* data, size_t len);
+VOID HashFinal(HASH_CONTEXT* ctx, BYTE* digest);
+BOOL HashFile(const wchar_t* strPath, BYTE* digest);
+VOID HashFormat(const BYTE* digest, wchar_t* str);
@@ -0,0 +1,631 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     File system images listed by tree.com's /IMAGE option
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <strsafe.h>
+
+#include "image.h"
+#include "listing.h"
+#include "stats.h"
+
+/* sector size partition tables are laid out in */
+#define IMAGE_SECTOR 512
+
+/* most partitions considered, GPT tables usually have room for this many */
+#define IMAGE_PARTITIONS_MAX 128
+
+/* slots of the path table when it is first needed, always a power of two */
+#define IMAGE_PATH_SLOTS_MIN 1024
+
+/* bytes of slots and paths, folders found past this are searched for again when opened */
+#define IMAGE_PATH_MEMORY_MAX (64 * 1024 * 1024)
+
+/* file systems tried in turn on the selected volume, an index has the most telling header */
+static const IMAGE_FS* imageFileSystems[] = { &indexFs, &fatFs, &exfatFs, &ntfsFs, &tarFs, &zipFs };
+
+/* the whole image, mapped read only by ImageInit */
+static const BYTE* imageBase = NULL;
+static ULONGLONG imageSize = 0;
+
+/* the mounted volume */
+static const IMAGE_FS* imageFs = NULL;
+static IMAGE_DIR imageRoot;
+static wchar_t imageLabel[MAX_PATH] = L"";
+static DWORD imageSerial = 0;
+
+/* a folder found while listing, see ImagePathInsert */
+typedef struct _IMAGE_PATH
+{
+	wchar_t* strPath;	/* below IMAGE_ROOT, starting with a backslash */
+	ULONG hash;
+	IMAGE_DIR dir;
+} IMAGE_PATH;
+
+/*
+ * every folder returned so far, by path. FindFirst is only given a path,
+ * so without these reaching a folder would mean searching every one of
+ * its parents again, from the root down
+ */
+static IMAGE_PATH* imagePaths = NULL;
+static size_t imagePathSlots = 0;
+static size_t imagePathCount = 0;
+
+/* bytes held by the table and its paths */
+static size_t imagePathBytes = 0;
+
+static SRWLOCK imagePathLock = SRWLOCK_INIT;
+
+/* an open enumeration */
+typedef struct _IMAGE_FIND
+{
+	VOID* cursor;		/* of the file system */
+	wchar_t* strDir;	/* path of the folder below IMAGE_ROOT */
+	size_t dirLen;
+	BOOL bNoExtension;	/* "*." pattern, only names without an extension match */
+} IMAGE_FIND;
+
+/**
+* @name: ImageHash
+*
+* @return
+* FNV-1a hash of the len characters at str
+*/
+static ULONG ImageHash(const wchar_t* str, size_t len)
+{
+	ULONG hash = 2166136261UL;
+	size_t i = 0;
+
+	for (i = 0; i < len; ++i)
+		hash = (hash ^ str[i]) * 16777619UL;
+
+	return hash;
+}
+
+/**
+* @name: ImagePathLookup
+*
+* @param dir
+* receives the folder at the len characters at strPath, if it is known
+*
+* @return
+* true if the folder is known
+*/
+static BOOL ImagePathLookup(const wchar_t* strPath, size_t len, IMAGE_DIR* dir)
+{
+	ULONG hash = ImageHash(strPath, len);
+	BOOL ret = FALSE;
+	size_t i = 0;
+
+	AcquireSRWLockShared(&imagePathLock);
+
+	for (i = hash & (imagePathSlots - 1); imagePathSlots > 0 && imagePaths[i].strPath != NULL;
+		i = (i + 1) & (imagePathSlots - 1))
+	{
+		if (imagePaths[i].hash == hash && wcsncmp(imagePaths[i].strPath, strPath, len) == 0 &&
+			imagePaths[i].strPath[len] == L'\0')
+		{
+			*dir = imagePaths[i].dir;
+			ret = TRUE;
+			break;
+		}
+	}
+
+	ReleaseSRWLockShared(&imagePathLock);
+	return ret;
+}
+
+/**
+* @name: ImagePathInsert
+*
+* @return
+* void
+*
+* remembers the folder at the len characters at strPath, unless it already
+* is or the table is full. A folder that isn't remembered is only slower
+* to open, see ImageResolve
+*/
+static VOID ImagePathInsert(const wchar_t* strPath, size_t len, const IMAGE_DIR* dir)
+{
+	ULONG hash = ImageHash(strPath, len);
+	size_t i = 0;
+
+	AcquireSRWLockExclusive(&imagePathLock);
+
+	if (imagePathBytes + (len + 1) * sizeof(wchar_t) > IMAGE_PATH_MEMORY_MAX)
+	{
+		ReleaseSRWLockExclusive(&imagePathLock);
+		return;
+	}
+
+	/* open addressing, kept at most half full */
+	if (2 * (imagePathCount + 1) > imagePathSlots)
+	{
+		IMAGE_PATH* old = imagePaths;
+		size_t oldSlots = imagePathSlots;
+		size_t slots = (oldSlots > 0) ? 2 * oldSlots : IMAGE_PATH_SLOTS_MIN;
+
+		if (imagePathBytes + (slots - oldSlots) * sizeof(IMAGE_PATH) > IMAGE_PATH_MEMORY_MAX)
+		{
+			ReleaseSRWLockExclusive(&imagePathLock);
+			return;
+		}
+
+		imagePaths = (IMAGE_PATH*)StatsCalloc(slots, sizeof(IMAGE_PATH));
+		if (imagePaths == NULL)
+			exit(-1);
+
+		imagePathSlots = slots;
+		imagePathBytes += (slots - oldSlots) * sizeof(IMAGE_PATH);
+
+		for (i = 0; i < oldSlots; ++i)
+		{
+			size_t j = 0;
+
+			if (old[i].strPath == NULL)
+				continue;
+
+			for (j = old[i].hash & (imagePathSlots - 1); imagePaths[j].strPath != NULL;
+				j = (j + 1) & (imagePathSlots - 1))
+				;
+
+			imagePaths[j] = old[i];
+		}
+
+		free(old);
+	}
+
+	for (i = hash & (imagePathSlots - 1); imagePaths[i].strPath != NULL; i = (i + 1) & (imagePathSlots - 1))
+	{
+		if (imagePaths[i].hash == hash && wcsncmp(imagePaths[i].strPath, strPath, len) == 0 &&
+			imagePaths[i].strPath[len] == L'\0')
+		{
+			ReleaseSRWLockExclusive(&imagePathLock);
+			return;
+		}
+	}
+
+	imagePaths[i].strPath = (wchar_t*)StatsMalloc((len + 1) * sizeof(wchar_t));
+	if (imagePaths[i].strPath == NULL)
+		exit(-1);
+
+	memcpy(imagePaths[i].strPath, strPath, len * sizeof(wchar_t));
+	imagePaths[i].strPath[len] = L'\0';
+	imagePaths[i].hash = hash;
+	imagePaths[i].dir = *dir;
+	imagePathBytes += (len + 1) * sizeof(wchar_t);
+	++imagePathCount;
+
+	ReleaseSRWLockExclusive(&imagePathLock);
+}
+
+/**
+* @name: ImageResolve
+*
+* @param strPath
+* path of a folder below IMAGE_ROOT, empty or starting with a backslash
+*
+* @param dir
+* receives the folder
+*
+* @return
+* false if there is no such folder
+*
+* folders the traversal reaches have been returned by enumeration before,
+* so they are known already. Any other path is searched for a component
+* at a time, comparing names without regard to case as Windows does
+*/
+static BOOL ImageResolve(const wchar_t* strPath, size_t len, IMAGE_DIR* dir)
+{
+	IMAGE_DIR parent;
+	WIN32_FIND_DATA data;
+	const wchar_t* name = NULL;
+	size_t nameLen = 0;
+	size_t parentLen = len;
+	VOID* cursor = NULL;
+	BOOL ret = FALSE;
+
+	if (len == 0)
+	{
+		*dir = imageRoot;
+		return TRUE;
+	}
+
+	if (ImagePathLookup(strPath, len, dir))
+		return TRUE;
+
+	while (parentLen > 0 && strPath[parentLen - 1] != L'\\')
+		--parentLen;
+
+	if (parentLen == 0)
+		return FALSE;
+
+	name = strPath + parentLen;
+	nameLen = len - parentLen;
+
+	if (!ImageResolve(strPath, parentLen - 1, &parent))
+		return FALSE;
+
+	cursor = imageFs->DirOpen(&parent);
+
+	while (imageFs->DirNext(cursor, &data, dir))
+	{
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+			wcslen(data.cFileName) == nameLen && _wcsnicmp(data.cFileName, name, nameLen) == 0)
+		{
+			ret = TRUE;
+			break;
+		}
+	}
+
+	imageFs->DirClose(cursor);
+
+	if (ret)
+		ImagePathInsert(strPath, len, dir);
+
+	return ret;
+}
+
+/**
+* @name: ImageNext
+*
+* @return
+* false once the folder holds no more matching entries
+*
+* folders are remembered on their way to the traversal, see ImagePathInsert
+*/
+static BOOL ImageNext(IMAGE_FIND* find, LPWIN32_FIND_DATAW pFindData)
+{
+	IMAGE_DIR dir;
+	wchar_t strPath[STR_MAX];
+	BOOL bDots = FALSE;
+	size_t nameLen = 0;
+
+	do
+	{
+		if (!imageFs->DirNext(find->cursor, pFindData, &dir))
+			return FALSE;
+
+		bDots = wcscmp(pFindData->cFileName, L".") == 0 || wcscmp(pFindData->cFileName, L"..") == 0;
+	} while (find->bNoExtension && !bDots && wcschr(pFindData->cFileName, L'.') != NULL);
+
+	nameLen = wcslen(pFindData->cFileName);
+
+	if ((pFindData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !bDots &&
+		find->dirLen + 1 + nameLen < _countof(strPath))
+	{
+		memcpy(strPath, find->strDir, find->dirLen * sizeof(wchar_t));
+		strPath[find->dirLen] = L'\\';
+		memcpy(strPath + find->dirLen + 1, pFindData->cFileName, nameLen * sizeof(wchar_t));
+		ImagePathInsert(strPath, find->dirLen + 1 + nameLen, &dir);
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: ImageFindFirst
+*
+* FindFirstFile for images, see ENUM_SOURCE
+*/
+static HANDLE WINAPI ImageFindFirst(LPCWSTR strPattern, LPWIN32_FIND_DATAW pFindData)
+{
+	const size_t rootLen = _countof(IMAGE_ROOT) - 1;
+	const wchar_t* end = wcsrchr(strPattern, L'\\');
+	IMAGE_FIND* find = NULL;
+	IMAGE_DIR dir;
+
+	if (end == NULL || _wcsnicmp(strPattern, IMAGE_ROOT, rootLen) != 0 ||
+		(strPattern + rootLen != end && strPattern[rootLen] != L'\\') ||
+		!ImageResolve(strPattern + rootLen, end - strPattern - rootLen, &dir))
+	{
+		SetLastError(ERROR_PATH_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	find = (IMAGE_FIND*)StatsMalloc(sizeof(IMAGE_FIND));
+	if (find == NULL)
+		exit(-1);
+
+	find->dirLen = end - strPattern - rootLen;
+	find->strDir = (wchar_t*)StatsMalloc((find->dirLen + 1) * sizeof(wchar_t));
+	if (find->strDir == NULL)
+		exit(-1);
+
+	memcpy(find->strDir, strPattern + rootLen, find->dirLen * sizeof(wchar_t));
+	find->strDir[find->dirLen] = L'\0';
+	find->bNoExtension = wcscmp(end, L"\\*.") == 0;
+	find->cursor = imageFs->DirOpen(&dir);
+
+	if (!ImageNext(find, pFindData))
+	{
+		imageFs->DirClose(find->cursor);
+		free(find->strDir);
+		free(find);
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return (HANDLE)find;
+}
+
+/**
+* @name: ImageFindNext
+*
+* FindNextFile for images, see ENUM_SOURCE
+*/
+static BOOL WINAPI ImageFindNext(HANDLE hFind, LPWIN32_FIND_DATAW pFindData)
+{
+	if (!ImageNext((IMAGE_FIND*)hFind, pFindData))
+	{
+		SetLastError(ERROR_NO_MORE_FILES);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: ImageFindClose
+*
+* FindClose for images, see ENUM_SOURCE
+*/
+static BOOL WINAPI ImageFindClose(HANDLE hFind)
+{
+	IMAGE_FIND* find = (IMAGE_FIND*)hFind;
+
+	imageFs->DirClose(find->cursor);
+	free(find->strDir);
+	free(find);
+	return TRUE;
+}
+
+const ENUM_SOURCE imageSource = { ImageFindFirst, ImageFindNext, ImageFindClose };
+
+/**
+* @name: ImageMount
+*
+* @param offset
+* where the volume starts in the image
+*
+* @param size
+* bytes of the volume, cut to what the image holds
+*
+* @return
+* true if one of imageFileSystems recognised the volume
+*/
+static BOOL ImageMount(ULONGLONG offset, ULONGLONG size)
+{
+	UINT i = 0;
+
+	if (offset >= imageSize)
+		return FALSE;
+
+	if (size > imageSize - offset)
+		size = imageSize - offset;
+
+	for (i = 0; i < _countof(imageFileSystems); ++i)
+	{
+		if (imageFileSystems[i]->Mount(imageBase + offset, size, imageLabel, _countof(imageLabel), &imageSerial, &imageRoot))
+		{
+			imageFs = imageFileSystems[i];
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+* @name: ImageSelectVolume
+*
+* @param partition
+* number of the partition to be mounted, counting MBR or GPT entries from 1,
+* or 0 for the image itself if it holds no partition table, else for the
+* first partition holding a known file system
+*
+* @return
+* true if a volume was mounted
+*/
+static BOOL ImageSelectVolume(UINT partition)
+{
+	ULONGLONG start[IMAGE_PARTITIONS_MAX];
+	ULONGLONG length[IMAGE_PARTITIONS_MAX];
+	UINT count = 0;
+	UINT i = 0;
+
+	/* a card formatted without partitions, or an image of a single partition */
+	if (partition == 0 && ImageMount(0, imageSize))
+		return TRUE;
+
+	if (imageSize < 2 * IMAGE_SECTOR || imageBase[510] != 0x55 || imageBase[511] != 0xAA)
+		return FALSE;
+
+	if (imageBase[446 + 4] == 0xEE)
+	{
+		/* a protective MBR, the partitions are in the GPT that follows */
+		const BYTE* header = imageBase + IMAGE_SECTOR;
+		/* sectors in the image, LBAs at or past it are refused before being turned into offsets */
+		ULONGLONG sectors = imageSize / IMAGE_SECTOR;
+		ULONGLONG table = 0;
+		DWORD entries = 0;
+		DWORD entrySize = 0;
+
+		if (memcmp(header, "EFI PART", 8) != 0)
+			return FALSE;
+
+		table = ImageQword(header + 72);
+		entries = ImageDword(header + 80);
+		entrySize = ImageDword(header + 84);
+
+		if (table >= sectors || entrySize < 48 || entrySize > IMAGE_SECTOR || entrySize % 8 != 0)
+			return FALSE;
+
+		table *= IMAGE_SECTOR;
+
+		for (i = 0; i < entries && count < IMAGE_PARTITIONS_MAX; ++i)
+		{
+			const BYTE* entry = NULL;
+			static const BYTE unused[16] = { 0 };
+			ULONGLONG first = 0;
+			ULONGLONG last = 0;
+
+			if ((ULONGLONG)(i + 1) * entrySize > imageSize - table)
+				break;
+
+			entry = imageBase + table + (ULONGLONG)i * entrySize;
+			first = ImageQword(entry + 32);
+			last = ImageQword(entry + 40);
+
+			/* an entry in use whose sectors aren't all in the image is kept unusable, so the others keep their numbers */
+			start[count] = 0;
+			length[count] = 0;
+
+			if (memcmp(entry, unused, sizeof(unused)) != 0 && first <= last && last < sectors)
+			{
+				start[count] = first * IMAGE_SECTOR;
+				length[count] = (last - first + 1) * IMAGE_SECTOR;
+			}
+
+			++count;
+		}
+	}
+	else
+	{
+		/* the four primary partitions, numbered by their slot as Linux does */
+		for (i = 0; i < 4; ++i)
+		{
+			const BYTE* entry = imageBase + 446 + 16 * i;
+
+			start[count] = (ULONGLONG)ImageDword(entry + 8) * IMAGE_SECTOR;
+			length[count] = (entry[4] == 0) ? 0 : (ULONGLONG)ImageDword(entry + 12) * IMAGE_SECTOR;
+			++count;
+		}
+	}
+
+	if (partition > 0)
+		return partition <= count && length[partition - 1] > 0 && ImageMount(start[partition - 1], length[partition - 1]);
+
+	for (i = 0; i < count; ++i)
+	{
+		if (length[i] > 0 && ImageMount(start[i], length[i]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+* @name: ImageInit
+*
+* @param strSpec
+* file[,partition], see ImageSelectVolume
+*
+* @return
+* false if the image can't be read or holds no known file system
+*
+* the image is mapped into memory as a whole and only the pages holding
+* file system structures are ever read, file contents are never touched.
+* A 32 bit build can only map images up to the free address space
+*/
+BOOL ImageInit(const wchar_t* strSpec)
+{
+	wchar_t strFile[MAX_PATH];
+	const wchar_t* comma = wcsrchr(strSpec, L',');
+	UINT partition = 0;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	HANDLE hMapping = NULL;
+	LARGE_INTEGER size;
+
+	if (FAILED(StringCchCopy(strFile, MAX_PATH, strSpec)))
+		return FALSE;
+
+	/* a trailing number is a partition, a file name may hold commas too */
+	if (comma != NULL && comma[1] != L'\0' && wcsspn(comma + 1, L"0123456789") == wcslen(comma + 1))
+	{
+		partition = (UINT)wcstoul(comma + 1, NULL, 10);
+		strFile[comma - strSpec] = L'\0';
+	}
+
+	hFile = CreateFile(strFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0 || (ULONGLONG)size.QuadPart > (SIZE_T)-1)
+	{
+		CloseHandle(hFile);
+		return FALSE;
+	}
+
+	/* the view keeps the file open */
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+
+	if (hMapping == NULL)
+		return FALSE;
+
+	imageBase = (const BYTE*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+
+	if (imageBase == NULL)
+		return FALSE;
+
+	imageSize = (ULONGLONG)size.QuadPart;
+	return ImageSelectVolume(partition);
+}
+
+/**
+* @name: ImageFree
+*
+* @return
+* void
+*
+* releases the folders remembered while listing and unmaps the image
+*/
+VOID ImageFree(VOID)
+{
+	size_t i = 0;
+
+	for (i = 0; i < imagePathSlots; ++i)
+		free(imagePaths[i].strPath);
+
+	free(imagePaths);
+	imagePaths = NULL;
+	imagePathSlots = 0;
+	imagePathCount = 0;
+	imagePathBytes = 0;
+
+	if (imageBase != NULL)
+		UnmapViewOfFile(imageBase);
+
+	imageBase = NULL;
+	imageSize = 0;
+	imageFs = NULL;
+}
+
+/**
+* @name: ImageLabel
+*
+* @return
+* volume label of the mounted volume, may be empty
+*/
+const wchar_t* ImageLabel(VOID)
+{
+	return imageLabel;
+}
+
+/**
+* @name: ImageSerial
+*
+* @return
+* serial number of the mounted volume
+*/
+DWORD ImageSerial(VOID)
+{
+	return imageSerial;
+}
@@ -0,0 +1,82 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     File system images listed by tree.com's /IMAGE option
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include "source.h"
+
+/* path of the root folder of an image */
+#define IMAGE_ROOT L"IMAGE:"
+
+/* a directory inside an image, what the members mean is up to the file system */
+typedef struct _IMAGE_DIR
+{
+	ULONGLONG first;	/* where its entries start, such as a cluster number */
+	ULONGLONG length;	/* bytes of entries, 0 if only the file system knows */
+	DWORD flags;
+} IMAGE_DIR;
+
+/*
+ * a file system an image may hold. Mount is given the volume mapped into
+ * memory and tells whether it is of this kind. The directory calls may be
+ * made from several threads at once
+ */
+typedef struct _IMAGE_FS
+{
+	BOOL (*Mount)(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root);
+	VOID* (*DirOpen)(const IMAGE_DIR* dir);
+	BOOL (*DirNext)(VOID* cursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir);	/* dir is only set for folders */
+	VOID (*DirClose)(VOID* cursor);
+} IMAGE_FS;
+
+extern const IMAGE_FS indexFs;
+extern const IMAGE_FS fatFs;
+extern const IMAGE_FS exfatFs;
+extern const IMAGE_FS ntfsFs;
+extern const IMAGE_FS tarFs;
+extern const IMAGE_FS zipFs;
+
+extern const ENUM_SOURCE imageSource;
+
+BOOL ImageInit(const wchar_t* strSpec);
+VOID ImageFree(VOID);
+const wchar_t* ImageLabel(VOID);
+DWORD ImageSerial(VOID);
+
+/**
+* @name: ImageWord
+*
+* @return
+* the little endian 16 bit value at p, which need not be aligned
+*/
+static __forceinline WORD ImageWord(const BYTE* p)
+{
+	return (WORD)(p[0] | (p[1] << 8));
+}
+
+/**
+* @name: ImageDword
+*
+* @return
+* the little endian 32 bit value at p, which need not be aligned
+*/
+static __forceinline DWORD ImageDword(const BYTE* p)
+{
+	return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+/**
+* @name: ImageQword
+*
+* @return
+* the little endian 64 bit value at p, which need not be aligned
+*/
+static __forceinline ULONGLONG ImageQword(const BYTE* p)
+{
+	return (ULONGLONG)ImageDword(p) | ((ULONGLONG)ImageDword(p + 4) << 32);
+}
@@ -0,0 +1,913 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Name index behind tree.com's /INDEX and /LOCATE options
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "filter.h"
+#include "image.h"
+#include "index.h"
+#include "stats.h"
+#include "trace.h"
+
+/* "TRIX" read as a little endian number */
+#define INDEX_MAGIC		0x58495254
+#define INDEX_VERSION		1
+
+/* characters of the volume label kept */
+#define INDEX_LABEL_MAX		64
+
+/* slots of the trigram table when building starts, always a power of two */
+#define INDEX_TRIGRAM_SLOTS	65536
+
+/* slots of the entry and name arrays when building starts */
+#define INDEX_BUILD_SLOTS	1024
+
+/* bytes of the postings of a trigram when first seen, most are only ever in a few names */
+#define INDEX_POSTING_BYTES	16
+
+/* bytes written to the index file at a time */
+#define INDEX_WRITE_BUFFER	(1024 * 1024)
+
+/* sections of the file start on 8 byte boundaries */
+#define INDEX_ALIGN(x)		(((x) + 7) & ~(ULONGLONG)7)
+
+/*
+ * an index file starts with this header. The entries, the names, the
+ * trigram table and the postings follow, each stored as it is used, so
+ * that a query only maps the file and reads the pages it needs
+ */
+typedef struct _INDEX_HEADER
+{
+	DWORD magic;
+	DWORD version;
+	DWORD charSize;			/* bytes of a character of the names */
+	DWORD serial;			/* of the indexed volume */
+	wchar_t label[INDEX_LABEL_MAX];	/* of the indexed volume */
+	ULONGLONG entryCount;
+	ULONGLONG entries;		/* offset of the entries */
+	ULONGLONG names;		/* offset of the names, each followed by a NUL */
+	ULONGLONG nameChars;
+	ULONGLONG trigrams;		/* offset of the trigram table, sorted by key */
+	ULONGLONG trigramCount;
+	ULONGLONG postings;		/* offset of the postings */
+	ULONGLONG postingBytes;
+} INDEX_HEADER;
+
+/*
+ * a file or folder. Entry 0 is the indexed folder itself, named by its
+ * full path. The entries of a folder follow each other, files first, and
+ * are numbered after those of the folder they are in
+ */
+typedef struct _INDEX_ENTRY
+{
+	DWORD parent;		/* folder holding the entry */
+	DWORD first;		/* of a folder, its first entry */
+	DWORD count;		/* of a folder, its number of entries */
+	DWORD name;		/* offset of the name, in characters */
+	DWORD attributes;
+	WORD nameLen;		/* characters */
+	WORD reserved;
+	FILETIME ftLastWrite;
+	ULONGLONG size;
+} INDEX_ENTRY;
+
+/*
+ * three consecutive characters of names, upper cased. Its postings list the
+ * entries whose names hold it in ascending order, each as the difference
+ * to the one before in 7 bit groups, lowest first, the top bit set on all
+ * but the last group
+ */
+typedef struct _INDEX_TRIGRAM
+{
+	ULONGLONG key;		/* the characters, the first one in the highest bits */
+	ULONGLONG offset;	/* of its postings from the start of all postings */
+	DWORD count;		/* entries in the postings */
+	DWORD bytes;		/* of the postings */
+} INDEX_TRIGRAM;
+
+/* postings of a trigram while building */
+typedef struct _INDEX_POSTING
+{
+	ULONGLONG key;
+	DWORD last;		/* last entry added, 0 if none yet */
+	DWORD count;
+	BYTE* data;		/* NULL for an empty slot */
+	size_t used;
+	size_t size;
+} INDEX_POSTING;
+
+/* an open enumeration, see IMAGE_FS */
+typedef struct _INDEX_CURSOR
+{
+	ULONGLONG folder;
+	ULONGLONG next;
+	ULONGLONG end;
+} INDEX_CURSOR;
+
+/* the index being built, see IndexInit */
+static INDEX_ENTRY* indexBuild = NULL;
+static size_t indexBuildCount = 0;
+static size_t indexBuildSlots = 0;
+static wchar_t* indexBuildNames = NULL;
+static size_t indexBuildChars = 0;
+static size_t indexBuildCharSlots = 0;
+static INDEX_POSTING* indexPostings = NULL;
+static size_t indexPostingSlots = 0;
+static size_t indexPostingCount = 0;
+
+/* output buffer of IndexWrite */
+static HANDLE hIndexFile = INVALID_HANDLE_VALUE;
+static BYTE* indexOut = NULL;
+static size_t indexOutUsed = 0;
+static BOOL bIndexOutFailed = FALSE;
+
+/* the mounted index, see IndexMount */
+static const INDEX_HEADER* indexHeader = NULL;
+static const INDEX_ENTRY* indexEntries = NULL;
+static const wchar_t* indexNames = NULL;
+static const INDEX_TRIGRAM* indexTrigrams = NULL;
+static const BYTE* indexPostingData = NULL;
+
+/* with /LOCATE, nonzero for the entries found and the folders holding them, the others are not listed */
+static BYTE* indexShown = NULL;
+
+/**
+* @name: IndexGrow
+*
+* @param arr
+* array of *slots elements of size bytes, reallocated to hold at least need
+*
+* @param first
+* slots to start with if the array is empty, doubled from then on
+*
+* @return
+* void
+*/
+static VOID IndexGrow(VOID** arr, size_t* slots, size_t need, size_t size, size_t first)
+{
+	size_t grown = (*slots > 0) ? *slots : first;
+
+	if (need <= *slots)
+		return;
+
+	while (grown < need)
+		grown *= 2;
+
+	*arr = StatsRealloc(*arr, grown * size);
+	if (*arr == NULL)
+		exit(-1);
+
+	*slots = grown;
+}
+
+/**
+* @name: IndexKey
+*
+* @return
+* key of the trigram starting at str, which must hold three characters
+*/
+static __forceinline ULONGLONG IndexKey(const wchar_t* str)
+{
+	return ((ULONGLONG)(FilterUpper(str[0]) & 0xFFFF) << 32) |
+		((ULONGLONG)(FilterUpper(str[1]) & 0xFFFF) << 16) |
+		(ULONGLONG)(FilterUpper(str[2]) & 0xFFFF);
+}
+
+/**
+* @name: IndexPostingSlot
+*
+* @return
+* slot of the trigram key in table, or the empty slot it would go to
+*/
+static INDEX_POSTING* IndexPostingSlot(INDEX_POSTING* table, size_t slots, ULONGLONG key)
+{
+	size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+
+	for (i &= slots - 1; ; i = (i + 1) & (slots - 1))
+	{
+		if (table[i].data == NULL || table[i].key == key)
+			return &table[i];
+	}
+}
+
+/**
+* @name: IndexAddTrigram
+*
+* @return
+* void
+*
+* adds entry to the postings of key. Entries are added in ascending
+* order, so a trigram found twice in one name is only added once
+*/
+static VOID IndexAddTrigram(ULONGLONG key, DWORD entry)
+{
+	INDEX_POSTING* posting = NULL;
+	DWORD delta = 0;
+
+	/* kept at most half full */
+	if (2 * (indexPostingCount + 1) > indexPostingSlots)
+	{
+		size_t slots = (indexPostingSlots > 0) ? 2 * indexPostingSlots : INDEX_TRIGRAM_SLOTS;
+		INDEX_POSTING* table = (INDEX_POSTING*)StatsCalloc(slots, sizeof(INDEX_POSTING));
+		size_t i = 0;
+
+		if (table == NULL)
+			exit(-1);
+
+		for (i = 0; i < indexPostingSlots; ++i)
+		{
+			if (indexPostings[i].data != NULL)
+				*IndexPostingSlot(table, slots, indexPostings[i].key) = indexPostings[i];
+		}
+
+		free(indexPostings);
+		indexPostings = table;
+		indexPostingSlots = slots;
+	}
+
+	posting = IndexPostingSlot(indexPostings, indexPostingSlots, key);
+
+	if (posting->data == NULL)
+	{
+		posting->key = key;
+		++indexPostingCount;
+	}
+	else if (posting->last == entry)
+	{
+		return;
+	}
+
+	/* 5 bytes are enough for any 32 bit delta */
+	IndexGrow((VOID**)&posting->data, &posting->size, posting->used + 5, 1, INDEX_POSTING_BYTES);
+
+	for (delta = entry - posting->last; delta >= 0x80; delta >>= 7)
+		posting->data[posting->used++] = (BYTE)(delta | 0x80);
+
+	posting->data[posting->used++] = (BYTE)delta;
+	posting->last = entry;
+	++posting->count;
+}
+
+/**
+* @name: IndexAppend
+*
+* @return
+* number of the new entry
+*/
+static DWORD IndexAppend(DWORD parent, const WIN32_FIND_DATA* data)
+{
+	size_t nameLen = wcslen(data->cFileName);
+	INDEX_ENTRY* entry = NULL;
+	size_t i = 0;
+
+	/* entries and name offsets are 32 bit */
+	if (indexBuildCount >= MAXDWORD || indexBuildChars + nameLen + 1 > MAXDWORD)
+	{
+		fwprintf(stderr, L"Too many entries to index\n");
+		exit(-1);
+	}
+
+	IndexGrow((VOID**)&indexBuild, &indexBuildSlots, indexBuildCount + 1, sizeof(INDEX_ENTRY), INDEX_BUILD_SLOTS);
+	IndexGrow((VOID**)&indexBuildNames, &indexBuildCharSlots, indexBuildChars + nameLen + 1, sizeof(wchar_t), INDEX_BUILD_SLOTS);
+
+	entry = &indexBuild[indexBuildCount];
+	ZeroMemory(entry, sizeof(*entry));
+	entry->parent = parent;
+	entry->name = (DWORD)indexBuildChars;
+	entry->nameLen = (WORD)nameLen;
+	entry->attributes = data->dwFileAttributes;
+	entry->ftLastWrite = data->ftLastWriteTime;
+	entry->size = ((ULONGLONG)data->nFileSizeHigh << 32) | data->nFileSizeLow;
+
+	memcpy(indexBuildNames + indexBuildChars, data->cFileName, (nameLen + 1) * sizeof(wchar_t));
+	indexBuildChars += nameLen + 1;
+
+	for (i = 0; i + 3 <= nameLen; ++i)
+		IndexAddTrigram(IndexKey(data->cFileName + i), (DWORD)indexBuildCount);
+
+	return (DWORD)indexBuildCount++;
+}
+
+/**
+* @name: IndexInit
+*
+* @param strRoot
+* full path of the folder to be indexed, which becomes entry 0
+*
+* @return
+* void
+*/
+VOID IndexInit(const wchar_t* strRoot)
+{
+	size_t len = wcslen(strRoot) + 1;
+
+	IndexGrow((VOID**)&indexBuild, &indexBuildSlots, 1, sizeof(INDEX_ENTRY), INDEX_BUILD_SLOTS);
+	IndexGrow((VOID**)&indexBuildNames, &indexBuildCharSlots, len, sizeof(wchar_t), INDEX_BUILD_SLOTS);
+
+	ZeroMemory(indexBuild, sizeof(INDEX_ENTRY));
+	indexBuild->nameLen = (WORD)min(len - 1, 0xFFFF);
+	indexBuild->attributes = FILE_ATTRIBUTE_DIRECTORY;
+
+	memcpy(indexBuildNames, strRoot, len * sizeof(wchar_t));
+	indexBuildChars = len;
+	indexBuildCount = 1;
+}
+
+/**
+* @name: IndexAddFolder
+*
+* @param folder
+* number of a folder entry, 0 for the indexed folder
+*
+* @return
+* number of the entry of arrFile[0], the entries of the sub folders follow
+* those of the files. Each folder is to be added once
+*/
+DWORD IndexAddFolder(DWORD folder, const WIN32_FIND_DATA* arrFile, UINT fileCount,
+	const WIN32_FIND_DATA* arrFolder, UINT folderCount)
+{
+	DWORD first = (DWORD)indexBuildCount;
+	UINT i = 0;
+
+	for (i = 0; i < fileCount; ++i)
+		IndexAppend(folder, &arrFile[i]);
+
+	for (i = 0; i < folderCount; ++i)
+		IndexAppend(folder, &arrFolder[i]);
+
+	indexBuild[folder].first = first;
+	indexBuild[folder].count = fileCount + folderCount;
+	return first;
+}
+
+/**
+* @name: IndexPut
+*
+* @return
+* void
+*
+* writes len bytes at data to the index file through indexOut, or zeros if data is NULL
+*/
+static VOID IndexPut(const VOID* data, size_t len)
+{
+	DWORD written = 0;
+
+	while (len > 0 && !bIndexOutFailed)
+	{
+		size_t n = min(len, INDEX_WRITE_BUFFER - indexOutUsed);
+
+		if (data != NULL)
+		{
+			memcpy(indexOut + indexOutUsed, data, n);
+			data = (const BYTE*)data + n;
+		}
+		else
+		{
+			ZeroMemory(indexOut + indexOutUsed, n);
+		}
+
+		indexOutUsed += n;
+		len -= n;
+
+		if (indexOutUsed == INDEX_WRITE_BUFFER)
+		{
+			if (!WriteFile(hIndexFile, indexOut, (DWORD)indexOutUsed, &written, NULL) || written != indexOutUsed)
+				bIndexOutFailed = TRUE;
+
+			indexOutUsed = 0;
+		}
+	}
+}
+
+/**
+* @name: IndexCompareKeys
+*
+* @return
+* how the keys of two trigrams compare, empty slots last
+*/
+static int IndexCompareKeys(const void* a, const void* b)
+{
+	const INDEX_POSTING* x = (const INDEX_POSTING*)a;
+	const INDEX_POSTING* y = (const INDEX_POSTING*)b;
+
+	if ((x->data == NULL) != (y->data == NULL))
+		return (x->data == NULL) ? 1 : -1;
+
+	return (x->key < y->key) ? -1 : (x->key > y->key) ? 1 : 0;
+}
+
+/**
+* @name: IndexWrite
+*
+* @param strFile
+* index file to be written, replaced if it exists
+*
+* @param strLabel
+* label of the indexed volume, cut to INDEX_LABEL_MAX - 1 characters
+*
+* @return
+* true if the file was written
+*
+* the index built since IndexInit is released either way
+*/
+BOOL IndexWrite(const wchar_t* strFile, const wchar_t* strLabel, DWORD serial)
+{
+	ULONGLONG span = TraceBegin();
+	INDEX_HEADER header;
+	INDEX_TRIGRAM trigram;
+	ULONGLONG offset = 0;
+	DWORD written = 0;
+	size_t labelLen = min(wcslen(strLabel), INDEX_LABEL_MAX - 1);
+	size_t i = 0;
+
+	qsort(indexPostings, indexPostingSlots, sizeof(INDEX_POSTING), IndexCompareKeys);
+
+	ZeroMemory(&header, sizeof(header));
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.charSize = sizeof(wchar_t);
+	header.serial = serial;
+	memcpy(header.label, strLabel, labelLen * sizeof(wchar_t));
+	header.entryCount = indexBuildCount;
+	header.entries = INDEX_ALIGN(sizeof(header));
+	header.names = INDEX_ALIGN(header.entries + indexBuildCount * sizeof(INDEX_ENTRY));
+	header.nameChars = indexBuildChars;
+	header.trigrams = INDEX_ALIGN(header.names + indexBuildChars * sizeof(wchar_t));
+	header.trigramCount = indexPostingCount;
+	header.postings = header.trigrams + indexPostingCount * sizeof(INDEX_TRIGRAM);
+
+	for (i = 0; i < indexPostingCount; ++i)
+		header.postingBytes += indexPostings[i].used;
+
+	hIndexFile = CreateFile(strFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	bIndexOutFailed = (hIndexFile == INVALID_HANDLE_VALUE);
+
+	if (!bIndexOutFailed)
+	{
+		indexOut = (BYTE*)StatsMalloc(INDEX_WRITE_BUFFER);
+		if (indexOut == NULL)
+			exit(-1);
+
+		indexOutUsed = 0;
+
+		IndexPut(&header, sizeof(header));
+		IndexPut(NULL, (size_t)(header.entries - sizeof(header)));
+		IndexPut(indexBuild, indexBuildCount * sizeof(INDEX_ENTRY));
+		IndexPut(NULL, (size_t)(header.names - header.entries - indexBuildCount * sizeof(INDEX_ENTRY)));
+		IndexPut(indexBuildNames, indexBuildChars * sizeof(wchar_t));
+		IndexPut(NULL, (size_t)(header.trigrams - header.names - indexBuildChars * sizeof(wchar_t)));
+
+		for (i = 0; i < indexPostingCount; ++i)
+		{
+			trigram.key = indexPostings[i].key;
+			trigram.offset = offset;
+			trigram.count = indexPostings[i].count;
+			trigram.bytes = (DWORD)indexPostings[i].used;
+			IndexPut(&trigram, sizeof(trigram));
+			offset += indexPostings[i].used;
+		}
+
+		for (i = 0; i < indexPostingCount; ++i)
+			IndexPut(indexPostings[i].data, indexPostings[i].used);
+
+		if (indexOutUsed > 0 && !bIndexOutFailed &&
+			(!WriteFile(hIndexFile, indexOut, (DWORD)indexOutUsed, &written, NULL) || written != indexOutUsed))
+			bIndexOutFailed = TRUE;
+
+		CloseHandle(hIndexFile);
+		hIndexFile = INVALID_HANDLE_VALUE;
+		free(indexOut);
+		indexOut = NULL;
+
+		/* don't leave half an index behind */
+		if (bIndexOutFailed)
+			DeleteFile(strFile);
+	}
+
+	for (i = 0; i < indexPostingCount; ++i)
+		free(indexPostings[i].data);
+
+	free(indexPostings);
+	free(indexBuild);
+	free(indexBuildNames);
+	indexPostings = NULL;
+	indexBuild = NULL;
+	indexBuildNames = NULL;
+	indexPostingSlots = indexPostingCount = 0;
+	indexBuildSlots = indexBuildCount = 0;
+	indexBuildCharSlots = indexBuildChars = 0;
+
+	TraceEnd("index", "write", span, strFile, "entries", header.entryCount);
+	return !bIndexOutFailed;
+}
+
+/**
+* @name: IndexMount
+*
+* recognises an index file written by IndexWrite, see IMAGE_FS
+*/
+static BOOL IndexMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	const INDEX_HEADER* header = (const INDEX_HEADER*)base;
+	const INDEX_ENTRY* entries = NULL;
+
+	if (size < sizeof(INDEX_HEADER) || header->magic != INDEX_MAGIC ||
+		header->version != INDEX_VERSION || header->charSize != sizeof(wchar_t))
+		return FALSE;
+
+	/* every section lies within the file, and is aligned for what it holds */
+	if (header->entryCount == 0 || header->entryCount > MAXDWORD ||
+		header->entries % 8 != 0 || header->entries > size ||
+		header->entryCount > (size - header->entries) / sizeof(INDEX_ENTRY) ||
+		header->names % 8 != 0 || header->names > size ||
+		header->nameChars > (size - header->names) / sizeof(wchar_t) ||
+		header->trigrams % 8 != 0 || header->trigrams > size ||
+		header->trigramCount > (size - header->trigrams) / sizeof(INDEX_TRIGRAM) ||
+		header->postings > size || header->postingBytes > size - header->postings)
+		return FALSE;
+
+	entries = (const INDEX_ENTRY*)(base + header->entries);
+
+	/* the indexed path is handed out as a string */
+	if ((ULONGLONG)entries[0].name + entries[0].nameLen >= header->nameChars ||
+		((const wchar_t*)(base + header->names))[entries[0].name + entries[0].nameLen] != L'\0')
+		return FALSE;
+
+	indexHeader = header;
+	indexEntries = entries;
+	indexNames = (const wchar_t*)(base + header->names);
+	indexTrigrams = (const INDEX_TRIGRAM*)(base + header->trigrams);
+	indexPostingData = base + header->postings;
+
+	memcpy(label, header->label, min(labelLen, (size_t)INDEX_LABEL_MAX) * sizeof(wchar_t));
+	label[min(labelLen, (size_t)INDEX_LABEL_MAX) - 1] = L'\0';
+	*serial = header->serial;
+
+	ZeroMemory(root, sizeof(*root));
+	return TRUE;
+}
+
+/**
+* @name: IndexDirOpen
+*
+* starts enumerating a folder, see IMAGE_FS
+*/
+static VOID* IndexDirOpen(const IMAGE_DIR* dir)
+{
+	INDEX_CURSOR* cursor = (INDEX_CURSOR*)StatsMalloc(sizeof(INDEX_CURSOR));
+	const INDEX_ENTRY* folder = &indexEntries[dir->first];
+
+	if (cursor == NULL)
+		exit(-1);
+
+	/* entries come after the folder holding them, so even a damaged index has no cycles */
+	cursor->folder = dir->first;
+	cursor->next = max((ULONGLONG)folder->first, dir->first + 1);
+	cursor->end = min((ULONGLONG)folder->first + folder->count, indexHeader->entryCount);
+	return cursor;
+}
+
+/**
+* @name: IndexDirNext
+*
+* returns the next entry of a folder, see IMAGE_FS. With /LOCATE only the
+* entries found and the folders leading to them are returned. An entry is
+* only returned in the folder it names as its parent, so no entry can be
+* listed twice
+*/
+static BOOL IndexDirNext(VOID* pCursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir)
+{
+	INDEX_CURSOR* cursor = (INDEX_CURSOR*)pCursor;
+	const INDEX_ENTRY* entry = NULL;
+	size_t nameLen = 0;
+
+	while (cursor->next < cursor->end && (indexEntries[cursor->next].parent != cursor->folder ||
+		(indexShown != NULL && !indexShown[cursor->next])))
+		++cursor->next;
+
+	if (cursor->next >= cursor->end)
+		return FALSE;
+
+	entry = &indexEntries[cursor->next];
+
+	ZeroMemory(data, sizeof(*data));
+	data->dwFileAttributes = entry->attributes;
+	data->ftCreationTime = entry->ftLastWrite;
+	data->ftLastWriteTime = entry->ftLastWrite;
+	data->ftLastAccessTime = entry->ftLastWrite;
+	data->nFileSizeHigh = (DWORD)(entry->size >> 32);
+	data->nFileSizeLow = (DWORD)entry->size;
+
+	/* a damaged entry is shown without a name rather than read beyond the names */
+	if ((ULONGLONG)entry->name + entry->nameLen <= indexHeader->nameChars)
+		nameLen = min((size_t)entry->nameLen, (size_t)MAX_PATH - 1);
+
+	memcpy(data->cFileName, indexNames + entry->name, nameLen * sizeof(wchar_t));
+	data->cFileName[nameLen] = L'\0';
+
+	if (entry->attributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		ZeroMemory(dir, sizeof(*dir));
+		dir->first = cursor->next;
+	}
+
+	++cursor->next;
+	return TRUE;
+}
+
+/**
+* @name: IndexDirClose
+*
+* ends an enumeration, see IMAGE_FS
+*/
+static VOID IndexDirClose(VOID* cursor)
+{
+	free(cursor);
+}
+
+const IMAGE_FS indexFs = { IndexMount, IndexDirOpen, IndexDirNext, IndexDirClose };
+
+/**
+* @name: IndexRoot
+*
+* @return
+* full path of the folder the mounted index was built from
+*/
+const wchar_t* IndexRoot(VOID)
+{
+	return indexNames + indexEntries[0].name;
+}
+
+/**
+* @name: IndexFind
+*
+* @return
+* the trigram key in the table of the mounted index, or NULL
+*/
+static const INDEX_TRIGRAM* IndexFind(ULONGLONG key)
+{
+	size_t low = 0;
+	size_t high = (size_t)indexHeader->trigramCount;
+
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if (indexTrigrams[mid].key < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < indexHeader->trigramCount && indexTrigrams[low].key == key &&
+		indexTrigrams[low].offset <= indexHeader->postingBytes &&
+		indexTrigrams[low].bytes <= indexHeader->postingBytes - indexTrigrams[low].offset)
+		return &indexTrigrams[low];
+
+	return NULL;
+}
+
+/**
+* @name: IndexNextPosting
+*
+* @param id
+* the entry before, updated to the next one
+*
+* @return
+* false at the end of the postings
+*/
+static __forceinline BOOL IndexNextPosting(const BYTE** p, const BYTE* end, ULONGLONG* id)
+{
+	ULONGLONG delta = 0;
+	UINT shift = 0;
+
+	while (*p < end && shift < 35)
+	{
+		BYTE b = *(*p)++;
+
+		delta |= (ULONGLONG)(b & 0x7F) << shift;
+		shift += 7;
+
+		if (!(b & 0x80))
+		{
+			*id += delta;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+* @name: IndexCompareCounts
+*
+* @return
+* how the posting counts of two trigrams compare
+*/
+static int IndexCompareCounts(const void* a, const void* b)
+{
+	DWORD x = (*(const INDEX_TRIGRAM* const*)a)->count;
+	DWORD y = (*(const INDEX_TRIGRAM* const*)b)->count;
+
+	return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/**
+* @name: IndexCheck
+*
+* @return
+* void
+*
+* counts the entry as found if its name matches, and marks it and the
+* folders holding it as shown
+*/
+static VOID IndexCheck(const wchar_t* pattern, ULONGLONG id, ULONGLONG* hits)
+{
+	const INDEX_ENTRY* entry = NULL;
+
+	if (id == 0 || id >= indexHeader->entryCount)
+		return;
+
+	entry = &indexEntries[id];
+
+	if ((ULONGLONG)entry->name + entry->nameLen > indexHeader->nameChars ||
+		!FilterWildcard(pattern, indexNames + entry->name, entry->nameLen))
+		return;
+
+	++*hits;
+
+	/* each step marks another entry, so a damaged parent can't loop */
+	while (id < indexHeader->entryCount && !indexShown[id])
+	{
+		indexShown[id] = 1;
+		id = indexEntries[id].parent;
+	}
+}
+
+/**
+* @name: IndexSearch
+*
+* @param pattern
+* upper cased, see FilterWildcard
+*
+* @param found
+* room for a trigram per character of pattern
+*
+* @return
+* void
+*
+* candidates are the entries whose names hold every trigram of pattern,
+* found by intersecting their postings from the shortest up, and are then
+* checked against pattern itself. A pattern without a run of three
+* characters has no trigrams, so every name is checked
+*/
+static VOID IndexSearch(const wchar_t* pattern, const INDEX_TRIGRAM** found, ULONGLONG* hits)
+{
+	ULONGLONG* candidates = NULL;
+	const BYTE* p = NULL;
+	const BYTE* end = NULL;
+	ULONGLONG id = 0;
+	size_t foundCount = 0;
+	size_t count = 0;
+	size_t run = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	/* every trigram of the runs between wildcards, once each */
+	for (i = 0; pattern[i] != L'\0'; ++i)
+	{
+		const INDEX_TRIGRAM* trigram = NULL;
+
+		run = (pattern[i] == L'*' || pattern[i] == L'?') ? 0 : run + 1;
+
+		if (run < 3)
+			continue;
+
+		trigram = IndexFind(IndexKey(pattern + i - 2));
+
+		/* no name holds it, so none matches */
+		if (trigram == NULL)
+			return;
+
+		for (j = 0; j < foundCount && found[j] != trigram; ++j)
+			;
+
+		if (j == foundCount)
+			found[foundCount++] = trigram;
+	}
+
+	if (foundCount == 0)
+	{
+		for (i = 1; i < indexHeader->entryCount; ++i)
+			IndexCheck(pattern, i, hits);
+
+		return;
+	}
+
+	qsort(found, foundCount, sizeof(const INDEX_TRIGRAM*), IndexCompareCounts);
+
+	candidates = (ULONGLONG*)StatsMalloc(((size_t)found[0]->count + 1) * sizeof(ULONGLONG));
+	if (candidates == NULL)
+		exit(-1);
+
+	/* the shortest postings are the first candidates, the others can only drop some */
+	p = indexPostingData + found[0]->offset;
+	end = p + found[0]->bytes;
+
+	while (count <= found[0]->count && IndexNextPosting(&p, end, &id))
+		candidates[count++] = id;
+
+	for (i = 1; i < foundCount && count > 0; ++i)
+	{
+		size_t kept = 0;
+
+		p = indexPostingData + found[i]->offset;
+		end = p + found[i]->bytes;
+		id = 0;
+		j = 0;
+
+		while (j < count && IndexNextPosting(&p, end, &id))
+		{
+			while (j < count && candidates[j] < id)
+				++j;
+
+			if (j < count && candidates[j] == id)
+				candidates[kept++] = candidates[j++];
+		}
+
+		count = kept;
+	}
+
+	for (i = 0; i < count; ++i)
+		IndexCheck(pattern, candidates[i], hits);
+
+	free(candidates);
+}
+
+/**
+* @name: IndexLocate
+*
+* @param strPattern
+* text found anywhere in the names looked for, or if it holds * or ?, a
+* pattern the whole name has to match. Case is ignored
+*
+* @param hits
+* receives the number of entries found
+*
+* @return
+* false if no index is mounted
+*
+* from then on only the entries found and the folders leading to them are listed
+*/
+BOOL IndexLocate(const wchar_t* strPattern, ULONGLONG* hits)
+{
+	ULONGLONG span = TraceBegin();
+	size_t len = wcslen(strPattern);
+	wchar_t* pattern = NULL;
+	const INDEX_TRIGRAM** found = NULL;
+	size_t i = 0;
+
+	*hits = 0;
+
+	if (indexHeader == NULL)
+		return FALSE;
+
+	indexShown = (BYTE*)StatsCalloc((size_t)indexHeader->entryCount, 1);
+	pattern = (wchar_t*)StatsMalloc((len + 3) * sizeof(wchar_t));
+	found = (const INDEX_TRIGRAM**)StatsMalloc((len + 3) * sizeof(const INDEX_TRIGRAM*));
+	if (indexShown == NULL || pattern == NULL || found == NULL)
+		exit(-1);
+
+	/* the listed folder is always shown */
+	indexShown[0] = 1;
+
+	/* plain text is looked for anywhere in the name */
+	if (wcspbrk(strPattern, L"*?") == NULL)
+	{
+		pattern[0] = L'*';
+		memcpy(pattern + 1, strPattern, len * sizeof(wchar_t));
+		pattern[len + 1] = L'*';
+		pattern[len + 2] = L'\0';
+	}
+	else
+	{
+		memcpy(pattern, strPattern, (len + 1) * sizeof(wchar_t));
+	}
+
+	for (i = 0; pattern[i] != L'\0'; ++i)
+		pattern[i] = FilterUpper(pattern[i]);
+
+	IndexSearch(pattern, found, hits);
+
+	free(found);
+	free(pattern);
+
+	TraceEnd("index", "locate", span, strPattern, "hits", *hits);
+	return TRUE;
+}
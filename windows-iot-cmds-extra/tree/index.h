@@ -0,0 +1,16 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Name index behind tree.com's /INDEX and /LOCATE options
+*/
+
+#pragma once
+
+#include <windows.h>
+
+VOID IndexInit(const wchar_t* strRoot);
+DWORD IndexAddFolder(DWORD folder, const WIN32_FIND_DATA* arrFile, UINT fileCount,
+	const WIN32_FIND_DATA* arrFolder, UINT folderCount);
+BOOL IndexWrite(const wchar_t* strFile, const wchar_t* strLabel, DWORD serial);
+BOOL IndexLocate(const wchar_t* strPattern, ULONGLONG* hits);
+const wchar_t* IndexRoot(VOID);
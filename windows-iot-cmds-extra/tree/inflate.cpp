@@ -0,0 +1,610 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Streaming gzip decompression for tree.com's archive listings
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "image.h"
+#include "inflate.h"
+#include "stats.h"
+
+/* distance matches may reach back */
+#define INFLATE_WINDOW		32768
+
+/* decompressed bytes handed on at a time, the window is kept in front of them */
+#define INFLATE_BUFFER		(1024 * 1024)
+
+/* longest code, and longest code decoded by a single table lookup */
+#define INFLATE_MAX_BITS	15
+#define INFLATE_FAST_BITS	10
+
+/* a canonical Huffman code */
+typedef struct _INFLATE_HUFFMAN
+{
+	USHORT fast[1 << INFLATE_FAST_BITS];	/* symbol << 4 | length of codes up to INFLATE_FAST_BITS long, 0 if longer */
+	USHORT count[INFLATE_MAX_BITS + 1];	/* codes of each length */
+	USHORT symbol[288];			/* symbols in code order */
+} INFLATE_HUFFMAN;
+
+/* a deflate stream being decompressed */
+typedef struct _INFLATE
+{
+	const BYTE* in;
+	const BYTE* inEnd;
+	ULONGLONG bits;		/* read ahead, least significant bit first */
+	UINT bitCount;
+	UINT overrun;		/* zero bytes made up past the end of the input */
+	BYTE* out;
+	SIZE_T outPos;
+	SIZE_T flushed;		/* bytes of out already handed on */
+	INFLATE_OUTPUT output;
+	VOID* context;
+	BOOL bStopped;
+	INFLATE_HUFFMAN lencode;
+	INFLATE_HUFFMAN distcode;
+} INFLATE;
+
+static const USHORT lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const BYTE lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const USHORT distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const BYTE distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/* order code length code lengths are stored in */
+static const BYTE lengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/**
+* @name: InflateRefill
+*
+* @return
+* void
+*
+* tops the bit buffer up to at least 57 bits, with zero bytes once the
+* input has run out, which InflateDamaged then notices being used
+*/
+static __forceinline VOID InflateRefill(INFLATE* s)
+{
+	while (s->bitCount <= 56)
+	{
+		if (s->in < s->inEnd)
+			s->bits |= (ULONGLONG)*s->in++ << s->bitCount;
+		else
+			++s->overrun;
+
+		s->bitCount += 8;
+	}
+}
+
+/**
+* @name: InflateBits
+*
+* @return
+* the next n bits of the stream, n being at most 32
+*/
+static __forceinline UINT InflateBits(INFLATE* s, UINT n)
+{
+	UINT value = 0;
+
+	if (s->bitCount < n)
+		InflateRefill(s);
+
+	value = (UINT)(s->bits & ((1ULL << n) - 1));
+	s->bits >>= n;
+	s->bitCount -= n;
+	return value;
+}
+
+/**
+* @name: InflateDamaged
+*
+* @return
+* true if bits past the end of the input have been used
+*/
+static __forceinline BOOL InflateDamaged(const INFLATE* s)
+{
+	return s->overrun * 8 > s->bitCount;
+}
+
+/**
+* @name: InflateBuild
+*
+* @param lengths
+* code length of each of the n symbols, 0 for symbols without a code
+*
+* @return
+* false if the lengths describe more codes than there is room for
+*/
+static BOOL InflateBuild(INFLATE_HUFFMAN* h, const BYTE* lengths, UINT n)
+{
+	USHORT offset[INFLATE_MAX_BITS + 1];
+	int left = 1;
+	UINT code = 0;
+	UINT index = 0;
+	UINT len = 0;
+	UINT i = 0;
+
+	ZeroMemory(h->count, sizeof(h->count));
+	ZeroMemory(h->fast, sizeof(h->fast));
+
+	for (i = 0; i < n; ++i)
+		++h->count[lengths[i]];
+
+	h->count[0] = 0;
+
+	/* an incomplete code is allowed, a lookup of a missing code fails instead */
+	for (len = 1; len <= INFLATE_MAX_BITS; ++len)
+	{
+		left <<= 1;
+		left -= h->count[len];
+
+		if (left < 0)
+			return FALSE;
+	}
+
+	offset[1] = 0;
+
+	for (len = 1; len < INFLATE_MAX_BITS; ++len)
+		offset[len + 1] = offset[len] + h->count[len];
+
+	for (i = 0; i < n; ++i)
+	{
+		if (lengths[i] != 0)
+			h->symbol[offset[lengths[i]]++] = (USHORT)i;
+	}
+
+	/* codes are stored most significant bit first, the table is indexed the other way round */
+	for (len = 1; len <= INFLATE_FAST_BITS; ++len)
+	{
+		for (i = 0; i < h->count[len]; ++i, ++code, ++index)
+		{
+			UINT reversed = 0;
+			UINT bit = 0;
+			UINT fill = 0;
+
+			for (bit = 0; bit < len; ++bit)
+				reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+
+			for (fill = reversed; fill < (1U << INFLATE_FAST_BITS); fill += 1U << len)
+				h->fast[fill] = (USHORT)((h->symbol[index] << 4) | len);
+		}
+
+		code <<= 1;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: InflateDecode
+*
+* @return
+* the next symbol of the code h, or -1 if the stream holds no valid code
+*/
+static __forceinline int InflateDecode(INFLATE* s, const INFLATE_HUFFMAN* h)
+{
+	UINT entry = 0;
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	UINT len = 0;
+
+	if (s->bitCount < INFLATE_MAX_BITS)
+		InflateRefill(s);
+
+	entry = h->fast[s->bits & ((1 << INFLATE_FAST_BITS) - 1)];
+
+	if (entry != 0)
+	{
+		s->bits >>= entry & 15;
+		s->bitCount -= entry & 15;
+		return (int)(entry >> 4);
+	}
+
+	/* a long code, decoded a bit at a time */
+	for (len = 1; len <= INFLATE_MAX_BITS; ++len)
+	{
+		int count = h->count[len];
+
+		code |= (int)(s->bits & 1);
+		s->bits >>= 1;
+		--s->bitCount;
+
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return -1;
+}
+
+/**
+* @name: InflateFlush
+*
+* @return
+* void
+*
+* hands on everything decompressed since the last flush, then keeps only
+* the window matches may still refer to
+*/
+static VOID InflateFlush(INFLATE* s)
+{
+	if (s->outPos > s->flushed && !s->bStopped)
+		s->bStopped = !s->output(s->context, s->out + s->flushed, s->outPos - s->flushed);
+
+	if (s->outPos > INFLATE_WINDOW)
+	{
+		memmove(s->out, s->out + s->outPos - INFLATE_WINDOW, INFLATE_WINDOW);
+		s->outPos = INFLATE_WINDOW;
+	}
+
+	s->flushed = s->outPos;
+}
+
+/**
+* @name: InflateStored
+*
+* @return
+* false if the block is damaged
+*/
+static BOOL InflateStored(INFLATE* s)
+{
+	UINT len = 0;
+	UINT nlen = 0;
+
+	/* the length starts at the next byte */
+	InflateBits(s, s->bitCount & 7);
+	len = InflateBits(s, 16);
+	nlen = InflateBits(s, 16);
+
+	if (len != (~nlen & 0xFFFF) || InflateDamaged(s))
+		return FALSE;
+
+	/* what was read ahead comes first */
+	while (len > 0 && s->bitCount >= 8 && !InflateDamaged(s))
+	{
+		if (s->outPos == INFLATE_BUFFER)
+			InflateFlush(s);
+
+		s->out[s->outPos++] = (BYTE)InflateBits(s, 8);
+		--len;
+	}
+
+	if (InflateDamaged(s) || (SIZE_T)(s->inEnd - s->in) < len)
+		return FALSE;
+
+	while (len > 0 && !s->bStopped)
+	{
+		UINT n = len;
+
+		if (s->outPos == INFLATE_BUFFER)
+			InflateFlush(s);
+
+		if (n > INFLATE_BUFFER - s->outPos)
+			n = (UINT)(INFLATE_BUFFER - s->outPos);
+
+		memcpy(s->out + s->outPos, s->in, n);
+		s->outPos += n;
+		s->in += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: InflateCodes
+*
+* @return
+* false if the block is damaged
+*
+* decompresses a block with the codes in s->lencode and s->distcode
+*/
+static BOOL InflateCodes(INFLATE* s)
+{
+	for (;;)
+	{
+		int symbol = InflateDecode(s, &s->lencode);
+
+		if (symbol < 0 || InflateDamaged(s))
+			return FALSE;
+
+		if (symbol < 256)
+		{
+			if (s->outPos == INFLATE_BUFFER)
+			{
+				InflateFlush(s);
+
+				if (s->bStopped)
+					return TRUE;
+			}
+
+			s->out[s->outPos++] = (BYTE)symbol;
+		}
+		else if (symbol == 256)
+		{
+			return TRUE;
+		}
+		else
+		{
+			UINT len = 0;
+			UINT dist = 0;
+			BYTE* dst = NULL;
+			const BYTE* src = NULL;
+			UINT i = 0;
+
+			symbol -= 257;
+
+			if (symbol >= 29)
+				return FALSE;
+
+			len = lengthBase[symbol] + InflateBits(s, lengthExtra[symbol]);
+			symbol = InflateDecode(s, &s->distcode);
+
+			if (symbol < 0 || symbol >= 30)
+				return FALSE;
+
+			dist = distBase[symbol] + InflateBits(s, distExtra[symbol]);
+
+			if (s->outPos + len > INFLATE_BUFFER)
+			{
+				InflateFlush(s);
+
+				if (s->bStopped)
+					return TRUE;
+			}
+
+			if (dist > s->outPos)
+				return FALSE;
+
+			/* the source may overlap what is being written, so bytes are copied one at a time */
+			dst = s->out + s->outPos;
+			src = dst - dist;
+
+			for (i = 0; i < len; ++i)
+				dst[i] = src[i];
+
+			s->outPos += len;
+		}
+	}
+}
+
+/**
+* @name: InflateFixed
+*
+* @return
+* void
+*
+* sets up the codes every fixed block uses
+*/
+static VOID InflateFixed(INFLATE* s)
+{
+	BYTE lengths[288];
+	UINT i = 0;
+
+	for (i = 0; i < 144; ++i)
+		lengths[i] = 8;
+
+	for (; i < 256; ++i)
+		lengths[i] = 9;
+
+	for (; i < 280; ++i)
+		lengths[i] = 7;
+
+	for (; i < 288; ++i)
+		lengths[i] = 8;
+
+	InflateBuild(&s->lencode, lengths, 288);
+
+	for (i = 0; i < 30; ++i)
+		lengths[i] = 5;
+
+	InflateBuild(&s->distcode, lengths, 30);
+}
+
+/**
+* @name: InflateDynamic
+*
+* @return
+* false if the codes of the block are damaged
+*
+* reads the codes a dynamic block describes itself with
+*/
+static BOOL InflateDynamic(INFLATE* s)
+{
+	BYTE lengths[288 + 30];
+	UINT nlen = InflateBits(s, 5) + 257;
+	UINT ndist = InflateBits(s, 5) + 1;
+	UINT ncode = InflateBits(s, 4) + 4;
+	UINT i = 0;
+
+	if (nlen > 286 || ndist > 30)
+		return FALSE;
+
+	ZeroMemory(lengths, sizeof(lengths));
+
+	for (i = 0; i < ncode; ++i)
+		lengths[lengthOrder[i]] = (BYTE)InflateBits(s, 3);
+
+	if (!InflateBuild(&s->lencode, lengths, 19))
+		return FALSE;
+
+	/* the lengths of both codes, run length encoded with the code just read */
+	for (i = 0; i < nlen + ndist;)
+	{
+		int symbol = InflateDecode(s, &s->lencode);
+		UINT repeat = 0;
+		BYTE len = 0;
+
+		if (symbol < 0 || InflateDamaged(s))
+			return FALSE;
+
+		if (symbol < 16)
+		{
+			lengths[i++] = (BYTE)symbol;
+			continue;
+		}
+
+		if (symbol == 16)
+		{
+			if (i == 0)
+				return FALSE;
+
+			len = lengths[i - 1];
+			repeat = 3 + InflateBits(s, 2);
+		}
+		else if (symbol == 17)
+		{
+			repeat = 3 + InflateBits(s, 3);
+		}
+		else
+		{
+			repeat = 11 + InflateBits(s, 7);
+		}
+
+		if (i + repeat > nlen + ndist)
+			return FALSE;
+
+		while (repeat-- > 0)
+			lengths[i++] = len;
+	}
+
+	/* a block without an end of block code could never end */
+	if (lengths[256] == 0)
+		return FALSE;
+
+	return InflateBuild(&s->lencode, lengths, nlen) && InflateBuild(&s->distcode, lengths + nlen, ndist);
+}
+
+/**
+* @name: InflateRaw
+*
+* @return
+* false if the stream is damaged
+*
+* decompresses a deflate stream up to its last block
+*/
+static BOOL InflateRaw(INFLATE* s)
+{
+	BOOL bLast = FALSE;
+
+	while (!bLast && !s->bStopped)
+	{
+		UINT type = 0;
+		BOOL ret = FALSE;
+
+		bLast = InflateBits(s, 1);
+		type = InflateBits(s, 2);
+
+		if (type == 0)
+			ret = InflateStored(s);
+		else if (type == 1)
+			ret = (InflateFixed(s), InflateCodes(s));
+		else if (type == 2)
+			ret = InflateDynamic(s) && InflateCodes(s);
+
+		if (!ret || InflateDamaged(s))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: InflateGzip
+*
+* @param output
+* called with the decompressed data as it comes, see INFLATE_OUTPUT
+*
+* @return
+* false if data is not gzip compressed or is damaged before output stopped
+*
+* decompresses every member of a gzip file in turn. Nothing is kept but a
+* window of recent output, so data of any size takes the same memory. The
+* CRC of the data is not checked, only its structure
+*/
+BOOL InflateGzip(const BYTE* data, ULONGLONG size, INFLATE_OUTPUT output, VOID* context)
+{
+	INFLATE* s = NULL;
+	ULONGLONG pos = 0;
+	BOOL ret = TRUE;
+
+	if (size < 18 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8)
+		return FALSE;
+
+	s = (INFLATE*)StatsCalloc(1, sizeof(INFLATE));
+
+	if (s == NULL)
+		exit(-1);
+
+	s->out = (BYTE*)StatsMalloc(INFLATE_BUFFER);
+
+	if (s->out == NULL)
+		exit(-1);
+
+	s->output = output;
+	s->context = context;
+
+	while (ret && !s->bStopped && pos <= size && size - pos >= 18 && data[pos] == 0x1F && data[pos + 1] == 0x8B && data[pos + 2] == 8)
+	{
+		BYTE flags = data[pos + 3];
+		ULONGLONG p = pos + 10;
+
+		/* extra field, name, comment and header CRC, each only if its flag is set */
+		if (flags & 0x04)
+			p += 2 + ImageWord(data + p);
+
+		if (flags & 0x08)
+		{
+			while (p < size && data[p] != 0)
+				++p;
+
+			++p;
+		}
+
+		if (flags & 0x10)
+		{
+			while (p < size && data[p] != 0)
+				++p;
+
+			++p;
+		}
+
+		if (flags & 0x02)
+			p += 2;
+
+		if (p >= size || (flags & 0xE0) != 0)
+		{
+			ret = FALSE;
+			break;
+		}
+
+		s->in = data + p;
+		s->inEnd = data + size;
+		s->bits = 0;
+		s->bitCount = 0;
+		s->overrun = 0;
+
+		ret = InflateRaw(s);
+
+		/* the CRC and length of the member follow its last whole byte */
+		pos = (ULONGLONG)(s->in - data) + s->overrun - s->bitCount / 8 + 8;
+	}
+
+	if (ret)
+		InflateFlush(s);
+
+	free(s->out);
+	free(s);
+	return ret;
+}
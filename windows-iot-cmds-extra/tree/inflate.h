@@ -0,0 +1,17 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Streaming gzip decompression for tree.com's archive listings
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/*
+ * receives the next len bytes of decompressed data, which are only valid
+ * during the call. Returning false stops decompression
+ */
+typedef BOOL (*INFLATE_OUTPUT)(VOID* context, const BYTE* data, SIZE_T len);
+
+BOOL InflateGzip(const BYTE* data, ULONGLONG size, INFLATE_OUTPUT output, VOID* context);
@@ -0,0 +1,147 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Entry and time limits, and Ctrl+C handling, for tree.com
+*/
+
+#include <windows.h>
+#include <strsafe.h>
+
+#include "limit.h"
+
+volatile LIMIT_REASON limitReason = LIMIT_NONE;
+
+/* entries that may still be written, 0 if unlimited */
+static ULONGLONG limitMax = 0;
+static ULONGLONG limitWritten = 0;
+
+/* performance counter value at which the traversal stops, 0 if unlimited */
+static ULONGLONG limitDeadline = 0;
+static DWORD limitTimeout = 0;
+
+/**
+* @name: LimitCtrlHandler
+*
+* @return
+* true if the event was handled
+*
+* runs on a thread of its own: the first Ctrl+C only asks the traversal to
+* stop, so that everything written so far is still flushed. A second one
+* falls through to the default handler and ends the process right away
+*/
+static BOOL WINAPI LimitCtrlHandler(DWORD dwCtrlType)
+{
+	if (dwCtrlType != CTRL_C_EVENT && dwCtrlType != CTRL_BREAK_EVENT)
+		return FALSE;
+
+	if (limitReason == LIMIT_CANCEL)
+		return FALSE;
+
+	limitReason = LIMIT_CANCEL;
+	return TRUE;
+}
+
+/**
+* @name: LimitInit
+*
+* @param maxEntries
+* entries written before the traversal stops, 0 for no limit
+*
+* @param timeout
+* milliseconds from now after which the traversal stops, 0 for no limit
+*
+* @return
+* void
+*/
+VOID LimitInit(ULONGLONG maxEntries, DWORD timeout)
+{
+	LARGE_INTEGER now;
+	LARGE_INTEGER frequency;
+
+	limitMax = maxEntries;
+	limitTimeout = timeout;
+
+	if (timeout > 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&now);
+		limitDeadline = now.QuadPart + timeout * frequency.QuadPart / 1000;
+	}
+
+	SetConsoleCtrlHandler(LimitCtrlHandler, TRUE);
+}
+
+/**
+* @name: LimitCheckTime
+*
+* @return
+* true if the deadline has passed
+*/
+BOOL LimitCheckTime(VOID)
+{
+	LARGE_INTEGER now;
+
+	if (limitDeadline == 0)
+		return FALSE;
+
+	QueryPerformanceCounter(&now);
+
+	if ((ULONGLONG)now.QuadPart < limitDeadline)
+		return FALSE;
+
+	if (limitReason == LIMIT_NONE)
+		limitReason = LIMIT_TIME;
+
+	return TRUE;
+}
+
+/**
+* @name: LimitEntry
+*
+* @return
+* true if one more entry may be written, which is then counted
+*
+* only the traversal's own thread writes entries, so the count needs no lock
+*/
+BOOL LimitEntry(VOID)
+{
+	if (LimitStopped())
+		return FALSE;
+
+	if (limitMax > 0 && limitWritten == limitMax)
+	{
+		limitReason = LIMIT_ENTRIES;
+		return FALSE;
+	}
+
+	++limitWritten;
+	return TRUE;
+}
+
+/**
+* @name: LimitDescribe
+*
+* @param str
+* receives why the listing was truncated, or an empty string if it wasn't
+*
+* @return
+* void
+*/
+VOID LimitDescribe(wchar_t* str, size_t len)
+{
+	switch (limitReason)
+	{
+	case LIMIT_ENTRIES:
+		StringCchPrintf(str, len, L"limit of %llu entries reached", limitMax);
+		break;
+	case LIMIT_TIME:
+		StringCchPrintf(str, len, L"time limit of %lu ms reached", limitTimeout);
+		break;
+	case LIMIT_CANCEL:
+		StringCchCopy(str, len, L"cancelled");
+		break;
+	default:
+		StringCchCopy(str, len, L"");
+		break;
+	}
+}
@@ -0,0 +1,37 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Entry and time limits, and Ctrl+C handling, for tree.com
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* why the traversal stopped early */
+typedef enum _LIMIT_REASON
+{
+	LIMIT_NONE,
+	LIMIT_ENTRIES,	/* /MAX:N entries were written */
+	LIMIT_TIME,	/* /TIMEOUT:ms went by */
+	LIMIT_CANCEL	/* Ctrl+C or Ctrl+Break was pressed */
+} LIMIT_REASON;
+
+/* set once the traversal must stop, it is never reset */
+extern volatile LIMIT_REASON limitReason;
+
+VOID LimitInit(ULONGLONG maxEntries, DWORD timeout);
+BOOL LimitCheckTime(VOID);
+BOOL LimitEntry(VOID);
+VOID LimitDescribe(wchar_t* str, size_t len);
+
+/**
+* @name: LimitStopped
+*
+* @return
+* true if no further folders may be opened nor entries written
+*/
+static __forceinline BOOL LimitStopped(VOID)
+{
+	return limitReason != LIMIT_NONE || LimitCheckTime();
+}
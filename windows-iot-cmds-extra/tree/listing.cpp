@@ -0,0 +1,446 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Folder enumeration and read ahead of sibling folders for tree.com
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "filter.h"
+#include "limit.h"
+#include "listing.h"
+#include "stats.h"
+#include "trace.h"
+
+const ENUM_SOURCE diskSource = { FindFirstFileW, FindNextFileW, FindClose };
+
+const ENUM_SOURCE* pEnumSource = &diskSource;
+
+UINT prefetchDepth = 4;
+
+UINT entryCap = 0;
+
+BOOL bKeepFiles = TRUE;
+
+/* slots of an entry array when its first entry is kept, doubled from then on */
+#define LISTING_SLOTS_MIN 16
+
+struct _PREFETCH
+{
+	wchar_t* strPath;
+	BOOL bWantHasSubFolder;
+	BOOL bDone;		/* listing is complete, guarded by prefetchLock */
+	DIR_LISTING listing;
+};
+
+/* shared by all read aheads, which only ever hold it to publish or check bDone */
+static SRWLOCK prefetchLock = SRWLOCK_INIT;
+static CONDITION_VARIABLE prefetchDone = CONDITION_VARIABLE_INIT;
+
+/**
+* @name: TimedFindFirstFile
+*
+* FindFirstFile of the selected source, counted and timed for --stats
+*/
+static HANDLE TimedFindFirstFile(const wchar_t* strPattern, WIN32_FIND_DATA* pFindData)
+{
+	ULONGLONG start = StatsBegin();
+	HANDLE hFind = pEnumSource->FindFirst(strPattern, pFindData);
+
+	StatsEnd(STAT_DIR_OPEN, start);
+	return hFind;
+}
+
+/**
+* @name: TimedFindNextFile
+*
+* FindNextFile of the selected source, counted and timed for --stats
+*/
+static BOOL TimedFindNextFile(HANDLE hFind, WIN32_FIND_DATA* pFindData)
+{
+	ULONGLONG start = StatsBegin();
+	BOOL ret = pEnumSource->FindNext(hFind, pFindData);
+
+	StatsEnd(STAT_DIR_ENUM, start);
+	return ret;
+}
+
+/**
+* @name: ListingAppend
+*
+* @param arr
+* array of *count entries in *slots slots, grown by doubling
+*
+* @return
+* void
+*/
+static VOID ListingAppend(WIN32_FIND_DATA** arr, UINT* count, UINT* slots, const WIN32_FIND_DATA* entry)
+{
+	if (*count == *slots)
+	{
+		*slots = (*slots > 0) ? 2 * *slots : LISTING_SLOTS_MIN;
+		*arr = (WIN32_FIND_DATA*)StatsRealloc(*arr, *slots * sizeof(WIN32_FIND_DATA));
+
+		if (*arr == NULL)
+			exit(-1);
+	}
+
+	(*arr)[(*count)++] = *entry;
+}
+
+/**
+* @name: HasSubFolder
+*
+* @param strPath
+* Must specify folder name
+*
+* @return
+* true if folder has sub folders, else will return false
+*/
+BOOL HasSubFolder(const wchar_t *strPath)
+{
+	ULONGLONG start = StatsBegin();
+	ULONGLONG span = TraceBegin();
+	BOOL ret = FALSE;
+	WIN32_FIND_DATA FindFileData;
+	HANDLE hFind = NULL;
+	wchar_t folderPath[STR_MAX] = L"";
+
+	ZeroMemory(folderPath, sizeof(folderPath));
+
+	wcscat_s(folderPath, STR_MAX, strPath);
+	wcscat_s(folderPath, STR_MAX, L"\\*.");
+
+	hFind = TimedFindFirstFile(folderPath, &FindFileData);
+
+	/* a folder without "." and "..", as an exFAT one or a FAT root, may hold no match at all */
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		StatsEnd(STAT_HAS_SUBFOLDER, start);
+		TraceEnd("dir", "has_subfolder", span, strPath, NULL, 0);
+		return FALSE;
+	}
+
+	do
+	{
+		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (wcscmp(FindFileData.cFileName, L".") == 0 ||
+				wcscmp(FindFileData.cFileName, L"..") == 0)
+			{
+				continue;
+			}
+
+			ret = TRUE;  /* found subfolder */
+			break;
+		}
+	} while (TimedFindNextFile(hFind, &FindFileData));
+
+	pEnumSource->FindClose(hFind);
+	StatsEnd(STAT_HAS_SUBFOLDER, start);
+	TraceEnd("dir", "has_subfolder", span, strPath, NULL, 0);
+	return ret;
+}
+
+/**
+* @name: ReadListing
+*
+* @param strPath
+* Must specify folder name
+*
+* @param bWantHasSubFolder
+* if true and the folder holds files, HasSubFolder is looked up as well
+*
+* @param listing
+* receives the entries, to be released with FreeListing
+*
+* @return
+* void
+*
+* files are only kept if they pass the filters. At most entryCap folders
+* and entryCap files are kept, and no files without bKeepFiles, the rest
+* are only counted, so a folder of any size costs no more memory than the cap.
+* May run on any thread, everything it touches is its own. Once the
+* traversal has to stop, folders are no longer opened and enumeration
+* ends early, leaving listing partial
+*/
+VOID ReadListing(const wchar_t* strPath, BOOL bWantHasSubFolder, DIR_LISTING* listing)
+{
+	WIN32_FIND_DATA FindFileData;
+	HANDLE hFind = NULL;
+	ULONGLONG span = TraceBegin();
+	wchar_t tmp[STR_MAX] = L"";
+
+	ZeroMemory(listing, sizeof(*listing));
+	ZeroMemory(&FindFileData, sizeof(FindFileData));
+
+	if (LimitStopped())
+		return;
+
+	ZeroMemory(tmp, sizeof(tmp));
+	wcscat_s(tmp, STR_MAX, strPath);
+	wcscat_s(tmp, STR_MAX, L"\\*.*");
+	hFind = TimedFindFirstFile(tmp, &FindFileData);
+	TraceEnd("dir", "open", span, strPath, NULL, 0);
+
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	span = TraceBegin();
+
+	do
+	{
+		StatsCount(STAT_ENTRIES, 1);
+
+		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (wcscmp(FindFileData.cFileName, L".") == 0 ||
+				wcscmp(FindFileData.cFileName, L"..") == 0)
+				continue;
+
+			if (entryCap > 0 && listing->folderCount == entryCap)
+			{
+				++listing->moreFolders;
+				continue;
+			}
+
+			ListingAppend(&listing->arrFolder, &listing->folderCount, &listing->folderSlots, &FindFileData);
+		}
+		else
+		{
+			/* files failing a filter are neither kept nor counted */
+			if (!FilterMatch(&FindFileData))
+				continue;
+
+			if (!bKeepFiles || (entryCap > 0 && listing->fileCount == entryCap))
+			{
+				++listing->moreFiles;
+				listing->moreBytes += ((ULONGLONG)FindFileData.nFileSizeHigh << 32) | FindFileData.nFileSizeLow;
+				continue;
+			}
+
+			ListingAppend(&listing->arrFile, &listing->fileCount, &listing->fileSlots, &FindFileData);
+		}
+	} while (!LimitStopped() && TimedFindNextFile(hFind, &FindFileData));
+
+	TraceEnd("dir", "enumerate", span, NULL, "entries",
+		listing->folderCount + listing->fileCount + listing->moreFolders + listing->moreFiles);
+	span = TraceBegin();
+	pEnumSource->FindClose(hFind);
+	TraceEnd("dir", "close", span, NULL, NULL, 0);
+
+	listing->bOpened = TRUE;
+
+	if (bWantHasSubFolder && listing->fileCount > 0)
+		listing->bHasSubFolder = HasSubFolder(strPath);
+}
+
+/**
+* @name: FreeListing
+*
+* @return
+* void
+*/
+VOID FreeListing(DIR_LISTING* listing)
+{
+	free(listing->arrFolder);
+	free(listing->arrFile);
+	ZeroMemory(listing, sizeof(*listing));
+}
+
+/**
+* @name: PrefetchCallback
+*
+* @return
+* void
+*
+* reads one folder on a thread pool thread
+*/
+static VOID CALLBACK PrefetchCallback(PTP_CALLBACK_INSTANCE instance, PVOID context)
+{
+	PREFETCH* prefetch = (PREFETCH*)context;
+
+	UNREFERENCED_PARAMETER(instance);
+
+	TraceThreadName("prefetch");
+	ReadListing(prefetch->strPath, prefetch->bWantHasSubFolder, &prefetch->listing);
+
+	AcquireSRWLockExclusive(&prefetchLock);
+	prefetch->bDone = TRUE;
+	WakeAllConditionVariable(&prefetchDone);
+	ReleaseSRWLockExclusive(&prefetchLock);
+}
+
+/**
+* @name: PrefetchSubmit
+*
+* @return
+* the read ahead of the sub folder name of strPath, or NULL if it could not be started
+*/
+static PREFETCH* PrefetchSubmit(const wchar_t* strPath, const wchar_t* name, BOOL bWantHasSubFolder)
+{
+	size_t pathLen = wcslen(strPath);
+	size_t nameLen = wcslen(name);
+	PREFETCH* prefetch = NULL;
+
+	/* same limit as the traversal, which won't descend any further either */
+	if (pathLen + nameLen + 6 > STR_MAX)
+		return NULL;
+
+	prefetch = (PREFETCH*)StatsCalloc(1, sizeof(PREFETCH));
+	if (prefetch == NULL)
+		exit(-1);
+
+	prefetch->strPath = (wchar_t*)StatsMalloc((pathLen + nameLen + 2) * sizeof(wchar_t));
+	if (prefetch->strPath == NULL)
+		exit(-1);
+
+	memcpy(prefetch->strPath, strPath, pathLen * sizeof(wchar_t));
+	prefetch->strPath[pathLen] = L'\\';
+	memcpy(prefetch->strPath + pathLen + 1, name, (nameLen + 1) * sizeof(wchar_t));
+	prefetch->bWantHasSubFolder = bWantHasSubFolder;
+
+	if (!TrySubmitThreadpoolCallback(PrefetchCallback, prefetch, NULL))
+	{
+		free(prefetch->strPath);
+		free(prefetch);
+		return NULL;
+	}
+
+	return prefetch;
+}
+
+/**
+* @name: PrefetchOpen
+*
+* @param window
+* read ahead state, to be released with PrefetchClose
+*
+* @param strPath
+* folder holding arrFolder, must stay valid until PrefetchClose
+*
+* @param arrFolder
+* sub folders, in the order they will be descended into
+*
+* @param bWantHasSubFolder
+* passed on to ReadListing for every sub folder
+*
+* @return
+* void
+*/
+VOID PrefetchOpen(PREFETCH_WINDOW* window, const wchar_t* strPath,
+	const WIN32_FIND_DATA* arrFolder, UINT count, BOOL bWantHasSubFolder)
+{
+	ZeroMemory(window, sizeof(*window));
+
+	/* a single sub folder has no sibling to read ahead */
+	if (prefetchDepth == 0 || count < 2)
+		return;
+
+	window->arrPending = (PREFETCH**)StatsCalloc(count, sizeof(PREFETCH*));
+	if (window->arrPending == NULL)
+		exit(-1);
+
+	window->strPath = strPath;
+	window->arrFolder = arrFolder;
+	window->count = count;
+	window->next = 1;
+	window->bWantHasSubFolder = bWantHasSubFolder;
+}
+
+/**
+* @name: PrefetchTake
+*
+* @param index
+* sub folder about to be descended into
+*
+* @return
+* its read ahead for PrefetchWait, or NULL if it must be read with ReadListing
+*
+* starts reading the next prefetchDepth siblings of index, so they are
+* enumerated while index is being written out. The folder at index itself
+* is only read ahead if an earlier call started it
+*/
+PREFETCH* PrefetchTake(PREFETCH_WINDOW* window, UINT index)
+{
+	PREFETCH* prefetch = NULL;
+
+	if (window->arrPending == NULL)
+		return NULL;
+
+	if (window->next <= index)
+		window->next = index + 1;
+
+	while (window->next < window->count && window->next <= index + prefetchDepth)
+	{
+		/* spoofed entries, such as the summary of folders beyond the cap, can't be read */
+		if (window->arrFolder[window->next].dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			window->arrPending[window->next] = PrefetchSubmit(window->strPath,
+				window->arrFolder[window->next].cFileName, window->bWantHasSubFolder);
+		}
+
+		++window->next;
+	}
+
+	prefetch = window->arrPending[index];
+	window->arrPending[index] = NULL;
+	return prefetch;
+}
+
+/**
+* @name: PrefetchWait
+*
+* @param prefetch
+* read ahead returned by PrefetchTake, released here
+*
+* @param listing
+* receives the entries, to be released with FreeListing
+*
+* @return
+* void
+*/
+VOID PrefetchWait(PREFETCH* prefetch, DIR_LISTING* listing)
+{
+	ULONGLONG span = TraceBegin();
+
+	AcquireSRWLockExclusive(&prefetchLock);
+	while (!prefetch->bDone)
+		SleepConditionVariableSRW(&prefetchDone, &prefetchLock, INFINITE, 0);
+	ReleaseSRWLockExclusive(&prefetchLock);
+
+	TraceEnd("dir", "prefetch_wait", span, prefetch->strPath, NULL, 0);
+
+	*listing = prefetch->listing;
+	free(prefetch->strPath);
+	free(prefetch);
+}
+
+/**
+* @name: PrefetchClose
+*
+* @return
+* void
+*
+* waits for and discards read aheads that were never taken
+*/
+VOID PrefetchClose(PREFETCH_WINDOW* window)
+{
+	UINT i = 0;
+
+	for (i = 0; window->arrPending != NULL && i < window->next; ++i)
+	{
+		if (window->arrPending[i] != NULL)
+		{
+			DIR_LISTING listing;
+
+			PrefetchWait(window->arrPending[i], &listing);
+			FreeListing(&listing);
+		}
+	}
+
+	free(window->arrPending);
+	window->arrPending = NULL;
+}
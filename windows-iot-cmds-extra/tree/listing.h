@@ -0,0 +1,66 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Folder enumeration and read ahead of sibling folders for tree.com
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include "source.h"
+
+/* longest path, in characters, the traversal descends into */
+#define STR_MAX 2048
+
+/* entries of one folder, without . and .. */
+typedef struct _DIR_LISTING
+{
+	WIN32_FIND_DATA* arrFolder;
+	UINT folderCount;
+	UINT folderSlots;	/* allocated for arrFolder */
+	WIN32_FIND_DATA* arrFile;
+	UINT fileCount;
+	UINT fileSlots;		/* allocated for arrFile */
+	BOOL bOpened;		/* false if the folder could not be listed */
+	BOOL bHasSubFolder;	/* HasSubFolder of the folder, only if it was asked for */
+	ULONGLONG moreFolders;	/* sub folders beyond entryCap, counted but not kept */
+	ULONGLONG moreFiles;	/* files beyond entryCap, counted but not kept */
+	ULONGLONG moreBytes;	/* total size of those files */
+} DIR_LISTING;
+
+/* a folder being read on a thread pool thread */
+typedef struct _PREFETCH PREFETCH;
+
+/* read ahead state of the sub folders of one folder, kept by the caller */
+typedef struct _PREFETCH_WINDOW
+{
+	const wchar_t* strPath;
+	const WIN32_FIND_DATA* arrFolder;
+	UINT count;
+	PREFETCH** arrPending;	/* one per sub folder, NULL once taken or if never read ahead */
+	UINT next;		/* first sub folder not read ahead yet */
+	BOOL bWantHasSubFolder;
+} PREFETCH_WINDOW;
+
+/* largest /PREFETCH, each folder read ahead holds a thread pool work item and its listing */
+#define PREFETCH_DEPTH_MAX 1024
+
+/* number of sibling folders read ahead of the one being descended into, 0 turns it off */
+extern UINT prefetchDepth;
+
+/* most folders and most files kept per folder, 0 keeps them all */
+extern UINT entryCap;
+
+/* if this flag is false, files are only counted in moreFiles and moreBytes, as /C needs no more */
+extern BOOL bKeepFiles;
+
+BOOL HasSubFolder(const wchar_t* strPath);
+VOID ReadListing(const wchar_t* strPath, BOOL bWantHasSubFolder, DIR_LISTING* listing);
+VOID FreeListing(DIR_LISTING* listing);
+
+VOID PrefetchOpen(PREFETCH_WINDOW* window, const wchar_t* strPath,
+	const WIN32_FIND_DATA* arrFolder, UINT count, BOOL bWantHasSubFolder);
+PREFETCH* PrefetchTake(PREFETCH_WINDOW* window, UINT index);
+VOID PrefetchWait(PREFETCH* prefetch, DIR_LISTING* listing);
+VOID PrefetchClose(PREFETCH_WINDOW* window);
@@ -7,8 +7,6 @@
 * Adapted for use in Windows IoT by Brian McKenzie (mckenzba@gmail.com)
 */
 
-#include <io.h>
-#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,9 +14,22 @@
 #include <windows.h>
 #include <strsafe.h>
 
-#define STR_MAX 2048
+#include "filter.h"
+#include "fold.h"
+#include "hash.h"
+#include "image.h"
+#include "index.h"
+#include "limit.h"
+#include "listing.h"
+#include "output.h"
+#include "prune.h"
+#include "synth.h"
+#include "stats.h"
+#include "trace.h"
+#include "utf8.h"
 
-static VOID GetDirectoryStructure(wchar_t* strPath, UINT width, const wchar_t* prevLine);
+static VOID GetDirectoryStructure(wchar_t* strPath, UINT width, const wchar_t* prefix, PREFETCH* prefetch);
+static VOID HashEntry(HASH_CONTEXT* ctx, BYTE type, const WIN32_FIND_DATA* entry, const BYTE* digest);
 
 /* if this flag is set to true, files will also be listed */
 BOOL bShowFiles = FALSE;
@@ -29,55 +40,301 @@ BOOL bUseAscii = FALSE;
 /* if this flag is true, a path has been specified and folders/files will be listed from there */
 BOOL bSetPath = FALSE;
 
+/* output formats selectable from the command line */
+typedef enum
+{
+	OUTPUT_TREE,	/* box drawing characters, identical to tree.com */
+	OUTPUT_JSON,	/* a single nested JSON document */
+	OUTPUT_NDJSON	/* one JSON object per line, with depth and parent path */
+} OUTPUT_FORMAT;
+
+/* selects how the folder structure is written to stdout */
+OUTPUT_FORMAT outputFormat = OUTPUT_TREE;
+
+/* bytes of output that may be queued for the writer thread, 0 writes synchronously */
+size_t outputQueueSize = 1024 * 1024;
+
+/* if this flag is true, the --stats report is written as JSON */
+BOOL bStatsJson = FALSE;
+
+/* entries written before the listing is truncated, 0 for no limit */
+ULONGLONG maxEntries = 0;
+
+/* milliseconds after which the listing is truncated, 0 for no limit */
+DWORD timeout = 0;
+
+/* if this flag is true, folders without a matching file below them are left out */
+BOOL bPrune = FALSE;
+
+/* if this flag is true, a folder listing the same as one before it refers to that one instead */
+BOOL bFold = FALSE;
+
+/* with /INDEX, full path of the index written, or read by /LOCATE */
+wchar_t strIndexFile[MAX_PATH] = L"";
+
+/* with /LOCATE, the text or pattern looked for in the index */
+const wchar_t* strLocate = NULL;
+
+/* if this flag is true, folders are hashed instead of listed, see HashDirectoryStructure */
+BOOL bHashTree = FALSE;
+
+/* with /HASHTREE:D the hash of every folder is written, not only that of the listed one */
+BOOL bHashFolders = FALSE;
+
+/* with /HASHTREE:C the contents of files are hashed as well */
+BOOL bHashContents = FALSE;
+
+/* if this flag is true, folders, files and bytes are counted instead of listed, see CountDirectoryStructure */
+BOOL bCount = FALSE;
+
+/* if this flag is true, the full path of each entry is written instead of a tree, see PathDirectoryStructure */
+BOOL bPaths = FALSE;
+
+/* with /P0, paths are ended by a NUL character instead of a new line */
+BOOL bPathsNul = FALSE;
+
+/* with /P /PRUNE, characters of the path of the deepest folder written so far on the way down, see PathShow */
+static size_t pathShownLen = 0;
+
+/**
+* @name: ParseNumber
+*
+* @param str
+* decimal digits and nothing else
+*
+* @param max
+* largest value accepted
+*
+* @return
+* false if str is empty, holds anything but digits or is above max
+*/
+static BOOL ParseNumber(const wchar_t* str, ULONGLONG max, ULONGLONG* value)
+{
+	ULONGLONG n = 0;
+
+	if (*str == L'\0')
+		return FALSE;
+
+	for (; *str != L'\0'; ++str)
+	{
+		if (*str < L'0' || *str > L'9' || n > (max - (*str - L'0')) / 10)
+			return FALSE;
+
+		n = n * 10 + (*str - L'0');
+	}
+
+	*value = n;
+	return TRUE;
+}
+
 static VOID PrintUsage(VOID)
 {
 	fwprintf(stderr,
 		L"Graphically displays the folder structure of a drive or path.\n\n"
-		L"TREE [drive:][path] [/F] [/A]\n\n"
-		L"   /F   Display the names of the files in each folder.\n"
-		L"   /A   Use ASCII instead of extended characters.\n\n"
+		L"TREE [drive:][path] [/F] [/A] [/C] [/P | /P0] [/JSON | /NDJSON] [/BUF:kb]\n"
+		L"     [/PREFETCH:n] [/MAX:n] [/TIMEOUT:ms] [/CAP:n]\n"
+		L"     [/SIZE:[+|-]n[K|M|G|T]] [/NEWER:date] [/OLDER:date] [/ATTR:[-]RHSACEILOT]\n"
+		L"     [/FIND:text] [/PRUNE] [/FOLD] [/HASHTREE[:[D][C]]]\n"
+		L"     [--stats[:json]] [--trace:file]\n"
+		L"     [/SYNTH:fanout,depth,files[,namelen[,unicode[,latency[,seed]]]]]\n"
+		L"     [/IMAGE:file[,partition]] [/INDEX:file [/LOCATE:text]]\n\n"
+		L"   /F        Display the names of the files in each folder.\n"
+		L"   /A        Use ASCII instead of extended characters.\n"
+		L"   /C        Count the folders below the folder, the files /F would list\n"
+		L"             and the bytes in them, instead of listing them.\n"
+		L"   /P        Write the full path of each folder, and of each file with /F,\n"
+		L"             one per line instead of drawing a tree. /P0 ends each path\n"
+		L"             with a NUL character instead, for tools reading -print0 or\n"
+		L"             -0 input. With /FIND only the files and folders it finds are\n"
+		L"             written, with /PRUNE the files and the folders holding one.\n"
+		L"   /JSON     Write the structure as a single nested JSON document.\n"
+		L"   /NDJSON   Write one JSON object per line, with depth and parent path.\n"
+		L"   /BUF:kb   Output queued ahead of a slow console or pipe (default 1024,\n"
+		L"             0 writes synchronously).\n"
+		L"   /PREFETCH:n\n"
+		L"             Sibling folders read ahead while a folder is written out\n"
+		L"             (default 4, 0 reads each folder only when it is reached).\n"
+		L"   /MAX:n    Stop after writing n entries.\n"
+		L"   /TIMEOUT:ms\n"
+		L"             Stop once ms milliseconds have passed. A truncated listing,\n"
+		L"             also one cut short by Ctrl+C, ends with a line saying so.\n"
+		L"   /CAP:n    List at most n folders and n files of each folder, followed\n"
+		L"             by a line counting the ones left out.\n"
+		L"   /SIZE     List only files larger (+), smaller (-) or exactly as large\n"
+		L"             as n bytes, kilobytes, megabytes and so on.\n"
+		L"   /NEWER    List only files last written on or after date, given as\n"
+		L"             YYYY-MM-DD[THH:MM[:SS]] in UTC.\n"
+		L"   /OLDER    List only files last written before date.\n"
+		L"   /ATTR     List only files with the given attributes, or without those\n"
+		L"             prefixed by -.\n"
+		L"   /FIND     List only files and folders whose names hold text, or match\n"
+		L"             it if it holds * or ?, along with the folders leading to them.\n"
+		L"             Case is ignored. /JSON, /NDJSON and /P write what is found at\n"
+		L"             once, a tree holds each folder back until it is known whether\n"
+		L"             one after it is found, with all below it, as /PRUNE does.\n"
+		L"   /PRUNE    Leave out folders without a listed file anywhere below them.\n"
+		L"             Output held back meanwhile goes to a temporary file past 32 MB.\n"
+		L"   /FOLD     List folders holding the same names and file sizes as one\n"
+		L"             listed before them as \"= same as\" that folder. Folders whose\n"
+		L"             output grows past 16 MB before they are read are listed anyway.\n"
+		L"   /HASHTREE Write a SHA-256 hash of the names, sizes and times of the files\n"
+		L"             and folders below the folder instead of listing them. Folders\n"
+		L"             holding the same entries hash the same, so two copies only\n"
+		L"             differ below folders whose hashes do: D writes the hash of\n"
+		L"             every folder, C hashes the contents of files too.\n"
+		L"   --stats   Report enumeration and output counters and timings to stderr\n"
+		L"             at exit, as a table or with :json as a JSON object.\n"
+		L"   --trace   Write a Chrome trace event file of directory and output\n"
+		L"             spans at exit, for chrome://tracing or Perfetto.\n"
+		L"   /SYNTH    List a generated tree instead of the disk: folders with fanout\n"
+		L"             sub folders down to depth, files files each, names namelen\n"
+		L"             characters long on average with unicode percent non ASCII, and\n"
+		L"             latency microseconds to open each folder.\n"
+		L"   /IMAGE    List the FAT, exFAT or NTFS volume in a disk or partition image\n"
+		L"             file without mounting it: the partition numbered partition,\n"
+		L"             else the first one that can be read. ZIP, TAR and TAR.GZ\n"
+		L"             archives are listed without extracting them. A drive:path\n"
+		L"             naming such a file rather than a folder lists it the same way.\n"
+		L"   /INDEX    Write an index of the names below the folder to file instead\n"
+		L"             of listing it. A drive:path naming an index lists the folder\n"
+		L"             as it was when indexed.\n"
+		L"   /LOCATE   List the entries in the index given by /INDEX whose names hold\n"
+		L"             text, or match it if it holds * or ?, along with the folders\n"
+		L"             leading to them. Case is ignored.\n\n"
+		L"Names are read and formatted as UTF-16 and written to a file or pipe as\n"
+		L"UTF-8. What in a name is not valid Unicode is written as U+FFFD, or with\n"
+		L"/JSON and /NDJSON as \\u escapes.\n\n"
 	);
 }
 
+/*
+ * connector strings of the extended (FALSE) and ASCII (TRUE) glyph sets,
+ * resolved at compile time so the line renderers never test bUseAscii
+ */
+template <BOOL bAscii>
+struct TreeGlyphs
+{
+	static const wchar_t vertical[];	/* '│' continues a connecting line */
+	static const wchar_t branch[];		/* '├───' folder with more folders below it */
+	static const wchar_t lastBranch[];	/* '└───' last folder of its parent */
+	static const wchar_t fileLine[];	/* '│   ' file in a folder that has sub folders */
+	static const wchar_t fileBlank[];	/* file in a folder without sub folders */
+};
+
+template <> const wchar_t TreeGlyphs<FALSE>::vertical[] = L"\u2502";
+template <> const wchar_t TreeGlyphs<FALSE>::branch[] = L"\u251c\u2500\u2500\u2500";
+template <> const wchar_t TreeGlyphs<FALSE>::lastBranch[] = L"\u2514\u2500\u2500\u2500";
+template <> const wchar_t TreeGlyphs<FALSE>::fileLine[] = L"\u2502   ";
+template <> const wchar_t TreeGlyphs<FALSE>::fileBlank[] = L"     ";
+
+template <> const wchar_t TreeGlyphs<TRUE>::vertical[] = L"|";
+template <> const wchar_t TreeGlyphs<TRUE>::branch[] = L"+---";
+template <> const wchar_t TreeGlyphs<TRUE>::lastBranch[] = L"\\---";
+template <> const wchar_t TreeGlyphs<TRUE>::fileLine[] = L"|   ";
+template <> const wchar_t TreeGlyphs<TRUE>::fileBlank[] = L"     ";
+
 /**
-* @name: HasSubFolder
+* @name: DrawTreeLines
 *
-* @param strPath
-* Must specify folder name
+* @param bAscii
+* selects the glyph set at compile time
+*
+* @param bFolder
+* true if arrEntry holds folders, which are descended into after being drawn,
+* reading the next prefetchDepth of them ahead
+*
+* see DrawTree for the remaining parameters
 *
 * @return
-* true if folder has sub folders, else will return false
+* void
+*
+* every line is assembled from spans of known length: the prefix handed down
+* by the parent, the connector and the name. The prefix of a sub folder is
+* the line buffer itself, with the connector swapped for its continuation
 */
-static BOOL HasSubFolder(const wchar_t *strPath)
+template <BOOL bAscii, BOOL bFolder>
+static VOID DrawTreeLines(const wchar_t* strPath,
+	const WIN32_FIND_DATA *arrEntry,
+	const size_t szArr,
+	UINT width,
+	const wchar_t *prefix,
+	BOOL bHasSubFolder)
 {
-	BOOL ret = FALSE;
-	WIN32_FIND_DATA FindFileData;
-	HANDLE hFind = NULL;
-	wchar_t folderPath[STR_MAX] = L"";
+	typedef TreeGlyphs<bAscii> Glyphs;
 
-	ZeroMemory(folderPath, sizeof(folderPath));
+	/* folders pick their connector by position, files by their parent alone */
+	const wchar_t* connector[2] = { Glyphs::branch, Glyphs::lastBranch };
+	size_t connectorLen[2] = { _countof(Glyphs::branch) - 1, _countof(Glyphs::lastBranch) - 1 };
+	size_t prefixLen = width - 1;
+	size_t pathLen = bFolder ? wcslen(strPath) : 0;
+	/* sub folders are only descended into while their lines still fit */
+	BOOL bDescend = bFolder && width + 4 + MAX_PATH <= STR_MAX;
+	PREFETCH_WINDOW window;
+	wchar_t line[STR_MAX];
+	UINT i = 0;
 
-	wcscat_s(folderPath, STR_MAX, strPath);
-	wcscat_s(folderPath, STR_MAX, L"\\*.");
+	if (bDescend)
+		PrefetchOpen(&window, strPath, arrEntry, (UINT)szArr, bShowFiles);
 
-	hFind = FindFirstFile(folderPath, &FindFileData);
-	do
+	if (!bFolder)
 	{
-		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-		{
-			if (wcscmp(FindFileData.cFileName, L".") == 0 ||
-				wcscmp(FindFileData.cFileName, L"..") == 0)
-			{
-				continue;
-			}
+		connector[0] = bHasSubFolder ? Glyphs::fileLine : Glyphs::fileBlank;
+		connectorLen[0] = bHasSubFolder ? _countof(Glyphs::fileLine) - 1 : _countof(Glyphs::fileBlank) - 1;
+		connector[1] = connector[0];
+		connectorLen[1] = connectorLen[0];
+	}
+
+	/* the prefix is the same for every entry of this folder */
+	memcpy(line, prefix, prefixLen * sizeof(wchar_t));
 
-			ret = TRUE;  /* found subfolder */
+	for (i = 0; i < szArr; ++i)
+	{
+		BOOL isLast = (szArr - 1 == i);
+		size_t nameLen = wcslen(arrEntry[i].cFileName);
+		size_t len = prefixLen;
+
+		/* the blank line closing a file list is not an entry of its own */
+		if ((bFolder || !isLast) && !LimitEntry())
 			break;
+
+		memcpy(line + len, connector[isLast], connectorLen[isLast] * sizeof(wchar_t));
+		len += connectorLen[isLast];
+		memcpy(line + len, arrEntry[i].cFileName, nameLen * sizeof(wchar_t));
+		len += nameLen;
+
+		OutputWrite(line, len);
+		OutputNewLine();
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (bDescend && pathLen + nameLen + 6 <= STR_MAX &&
+			(arrEntry[i].dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			wchar_t *str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+			if (str == NULL)
+				exit(-1);
+
+			memcpy(str, strPath, pathLen * sizeof(wchar_t));
+			str[pathLen] = L'\\';
+			memcpy(str + pathLen + 1, arrEntry[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+
+			/*
+			 * below '├───' the connecting line continues as '│   ',
+			 * below '└───' it ends and only spaces are added
+			 */
+			line[prefixLen] = isLast ? L' ' : Glyphs::vertical[0];
+			line[prefixLen + 1] = L' ';
+			line[prefixLen + 2] = L' ';
+			line[prefixLen + 3] = L' ';
+
+			GetDirectoryStructure(str, width + 4, line, PrefetchTake(&window, i));
+
+			free(str);
 		}
-	} while (FindNextFile(hFind, &FindFileData));
+	}
 
-	FindClose(hFind);
-	return ret;
+	if (bDescend)
+		PrefetchClose(&window);
 }
 
 /**
@@ -93,8 +350,11 @@ static BOOL HasSubFolder(const wchar_t *strPath)
 * specifies drawing distance for correct formatting of tree structure being drawn on console screen
 * used internally for adding spaces
 *
-* @param prevLine
-* used internally for formatting reasons
+* @param prefix
+* connecting lines drawn in front of every entry, exactly width - 1 characters long
+*
+* @param bHasSubFolder
+* when drawing files, whether strPath has sub folders as told by HasSubFolder
 *
 * @return
 * void
@@ -103,252 +363,1725 @@ static VOID DrawTree(const wchar_t* strPath,
 	const WIN32_FIND_DATA *arrFolder,
 	const size_t szArr,
 	UINT width,
-	const wchar_t *prevLine,
-	BOOL drawfolder)
+	const wchar_t *prefix,
+	BOOL drawfolder,
+	BOOL bHasSubFolder)
 {
-	BOOL bHasSubFolder = HasSubFolder(strPath);
-	UINT i = 0;
-
-	/* this will format the spaces required for correct formatting */
-	for (i = 0; i < szArr; ++i)
+	if (bUseAscii)
+	{
+		if (drawfolder)
+			DrawTreeLines<TRUE, TRUE>(strPath, arrFolder, szArr, width, prefix, bHasSubFolder);
+		else
+			DrawTreeLines<TRUE, FALSE>(strPath, arrFolder, szArr, width, prefix, bHasSubFolder);
+	}
+	else
 	{
-		wchar_t *consoleOut = (wchar_t*)malloc(sizeof(wchar_t) * STR_MAX);
-		UINT j = 0;
-		wchar_t str[STR_MAX];
+		if (drawfolder)
+			DrawTreeLines<FALSE, TRUE>(strPath, arrFolder, szArr, width, prefix, bHasSubFolder);
+		else
+			DrawTreeLines<FALSE, FALSE>(strPath, arrFolder, szArr, width, prefix, bHasSubFolder);
+	}
+}
+
+/* number of characters JsonWriteString collects before handing them to the output writer */
+#define JSON_CHUNK 512
+
+/**
+* @name: JsonWriteString
+*
+* @param str
+* string to be written as a quoted JSON string
+*
+* @return
+* void
+*
+* escapes quotes, backslashes, control characters and unpaired surrogates,
+* handing the result to the output writer in fixed size chunks
+*/
+static VOID JsonWriteString(const wchar_t* str)
+{
+	/* room for one chunk plus the longest escape sequence */
+	wchar_t buf[JSON_CHUNK + 16];
+	size_t n = 0;
+
+	buf[n++] = L'"';
 
-		wcscpy_s(consoleOut, STR_MAX, L"");
-		wcscpy_s(str, STR_MAX, L"");
+	for (; *str != L'\0'; ++str)
+	{
+		wchar_t c = *str;
 
-		for (j = 0; j < width - 1; ++j)
+		if (n >= JSON_CHUNK)
 		{
-			/*
-			 * if the previous line has '├' or '│' then the current line will
-			 * add '│' to continue the connecting line
-			 */
-			if (prevLine[j] == L'\u251c' || prevLine[j] == L'\u2502' ||
-				(BYTE)prevLine[j] == L'+' || (BYTE)prevLine[j] == L'|')
-			{
-				if (!bUseAscii)
-				{
-					wchar_t a[] = { L'\u2502', L'\u0000' };
-					wcscat_s(consoleOut, STR_MAX, a);
-				}
-				else
-				{
-					wcscat_s(consoleOut, STR_MAX, L"|");
-				}
-			}
-			else
-			{
-				wcscat_s(consoleOut, STR_MAX, L" ");
-			}
+			OutputWrite(buf, n);
+			n = 0;
 		}
 
-		if (szArr - 1 != i)
+		switch (c)
 		{
-			if (drawfolder)
-			{
-				/* will add '├───Folder name */
-				if (bUseAscii)
-					StringCchPrintf(str, STR_MAX, L"+---%s", (wchar_t*)arrFolder[i].cFileName);
-				else
-					StringCchPrintf(str, STR_MAX, L"%c%c%c%c%s", L'\u251c', L'\u2500', L'\u2500', L'\u2500', (wchar_t*)arrFolder[i].cFileName);
-			}
-			else
+		case L'"':	buf[n++] = L'\\'; buf[n++] = L'"'; break;
+		case L'\\':	buf[n++] = L'\\'; buf[n++] = L'\\'; break;
+		case L'\b':	buf[n++] = L'\\'; buf[n++] = L'b'; break;
+		case L'\f':	buf[n++] = L'\\'; buf[n++] = L'f'; break;
+		case L'\n':	buf[n++] = L'\\'; buf[n++] = L'n'; break;
+		case L'\r':	buf[n++] = L'\\'; buf[n++] = L'r'; break;
+		case L'\t':	buf[n++] = L'\\'; buf[n++] = L't'; break;
+		default:
+			if (c >= 0xD800 && c <= 0xDBFF && str[1] >= 0xDC00 && str[1] <= 0xDFFF)
 			{
-				if (bHasSubFolder)
-				{
-					/* will add '│   FileName' */
-					if (bUseAscii)
-						StringCchPrintf(str, STR_MAX, L"|   %s", (wchar_t*)arrFolder[i].cFileName);
-					else
-						StringCchPrintf(str, STR_MAX, L"%c   %s", L'\u2502', (wchar_t*)arrFolder[i].cFileName);
-				}
-				else
-				{
-					/* will add '    FileName' */
-					StringCchPrintf(str, STR_MAX, L"     %s", (wchar_t*)arrFolder[i].cFileName);
-				}
+				/* a valid surrogate pair is copied as is */
+				buf[n++] = c;
+				buf[n++] = *++str;
 			}
-		}
-		else
-		{
-			if (drawfolder)
+			else if (c < 0x20 || (c >= 0xD800 && c <= 0xDFFF))
 			{
-				/* '└───Folder name' */
-				if (bUseAscii)
-					StringCchPrintf(str, STR_MAX, L"\\---%s", (wchar_t*)arrFolder[i].cFileName);
-				else
-					StringCchPrintf(str, STR_MAX, L"%c%c%c%c%s", L'\u2514', L'\u2500', L'\u2500', L'\u2500', (wchar_t*)arrFolder[i].cFileName);
+				/* control characters and unpaired surrogates can't be encoded directly */
+				StringCchPrintf(&buf[n], 7, L"\\u%04x", (UINT)c);
+				n += 6;
 			}
 			else
 			{
-				if (bHasSubFolder)
-				{
-					/* '│   FileName' */
-					if (bUseAscii)
-						StringCchPrintf(str, STR_MAX, L"|   %s", (wchar_t*)arrFolder[i].cFileName);
-					else
-						StringCchPrintf(str, STR_MAX, L"%c   %s", L'\u2502', (wchar_t*)arrFolder[i].cFileName);
-				}
-				else
-				{
-					/* '    FileName' */
-					StringCchPrintf(str, STR_MAX, L"     %s", (wchar_t*)arrFolder[i].cFileName);
-				}
+				buf[n++] = c;
 			}
+			break;
 		}
+	}
 
-		wcscat_s(consoleOut, STR_MAX, str);
-		wprintf(L"%s\n", consoleOut);
+	buf[n++] = L'"';
+	OutputWrite(buf, n);
+}
 
-		if (drawfolder)
-		{
-			wchar_t *str = (wchar_t*)malloc(STR_MAX * sizeof(wchar_t));
-			ZeroMemory(str, STR_MAX * sizeof(wchar_t));
+/**
+* @name: JsonWriteFields
+*
+* @param entry
+* find data of the file or folder to be described
+*
+* @param strPath
+* full path of the folder containing entry, only written when depth is not zero
+*
+* @param depth
+* nesting level of entry below the listed folder, starting at 1
+*
+* @return
+* void
+*
+* writes the members shared by JSON and NDJSON entries, without the enclosing braces.
+* Everything but the names is plain ASCII, so it is formatted as UTF-8 directly
+*/
+static VOID JsonWriteFields(const WIN32_FIND_DATA* entry, const wchar_t* strPath, UINT depth)
+{
+	BOOL isFolder = (entry->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	char str[64];
+	SYSTEMTIME st;
 
-			wcscat_s(str, STR_MAX, strPath);
-			wcscat_s(str, STR_MAX, L"\\");
-			wcscat_s(str, STR_MAX, arrFolder[i].cFileName);
-			GetDirectoryStructure(str, width + 4, consoleOut);
+	OutputWriteString(isFolder ? "\"type\":\"directory\",\"name\":" : "\"type\":\"file\",\"name\":");
+	JsonWriteString(entry->cFileName);
 
-			free(str);
-		}
-		free(consoleOut);
+	if (outputFormat == OUTPUT_NDJSON)
+	{
+		StringCchPrintfA(str, _countof(str), ",\"depth\":%u,\"parent\":", depth);
+		OutputWriteString(str);
+		JsonWriteString(strPath);
+	}
+
+	if (!isFolder)
+	{
+		StringCchPrintfA(str, _countof(str), ",\"size\":%llu",
+			((ULONGLONG)entry->nFileSizeHigh << 32) | entry->nFileSizeLow);
+		OutputWriteString(str);
+	}
+
+	if (FileTimeToSystemTime(&entry->ftLastWriteTime, &st))
+	{
+		StringCchPrintfA(str, _countof(str), ",\"modified\":\"%04u-%02u-%02uT%02u:%02u:%02uZ\"",
+			st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+		OutputWriteString(str);
 	}
 }
 
 /**
-* @name: GetDirectoryStructure
+* @name: JsonWriteMore
+*
+* @param bFiles
+* true if count files of bytes in total were left out, else count folders
+*
+* @return
+* void
+*
+* writes the object standing in for the entries of a folder beyond /CAP
+*/
+static VOID JsonWriteMore(const wchar_t* strPath, UINT depth, BOOL first,
+	BOOL bFiles, ULONGLONG count, ULONGLONG bytes)
+{
+	char str[96];
+
+	OutputWriteString((outputFormat == OUTPUT_JSON && !first) ? ",{" : "{");
+	StringCchPrintfA(str, _countof(str), bFiles ? "\"type\":\"more\",\"files\":%llu" :
+		"\"type\":\"more\",\"directories\":%llu", count);
+	OutputWriteString(str);
+
+	if (outputFormat == OUTPUT_NDJSON)
+	{
+		StringCchPrintfA(str, _countof(str), ",\"depth\":%u,\"parent\":", depth);
+		OutputWriteString(str);
+		JsonWriteString(strPath);
+	}
+
+	if (bFiles)
+	{
+		StringCchPrintfA(str, _countof(str), ",\"size\":%llu", bytes);
+		OutputWriteString(str);
+	}
+
+	OutputWrite("}", 1);
+
+	if (outputFormat == OUTPUT_NDJSON)
+		OutputNewLine();
+}
+
+/**
+* @name: WriteJson
 *
 * @param strPath
 * Must specify folder name
 *
+* @param listing
+* entries of strPath: files are only written if bShowFiles is set, sub folders
+* are descended into after being written. Entries beyond the cap are
+* summarised by a "more" object
+*
 * @param width
-* specifies drawing distance for correct formatting of tree structure being drawn on console screen
+* drawing distance of strPath, used to derive the nesting depth of its entries
 *
-* @param prevLine
-* specifies the previous line written on console, is used for correct formatting
 * @return
 * void
+*
+* entries are written as soon as they are known, so memory use is bounded by
+* the largest single folder rather than by the size of the whole structure
 */
-static VOID
-GetDirectoryStructure(wchar_t* strPath, UINT width, const wchar_t* prevLine)
+static VOID WriteJson(const wchar_t* strPath,
+	const DIR_LISTING* listing,
+	UINT width)
 {
-	WIN32_FIND_DATA FindFileData;
-	HANDLE hFind = NULL;
-	/* will fill up with names of all sub folders */
-	WIN32_FIND_DATA* arrFolder = NULL;
-	UINT arrFoldersz = 0;
-	/* will fill up with names of all sub folders */
-	WIN32_FIND_DATA* arrFile = NULL;
-	UINT arrFilesz = 0;
-
-	ZeroMemory(&FindFileData, sizeof(FindFileData));
-
-	static wchar_t tmp[STR_MAX] = L"";
-	ZeroMemory(tmp, sizeof(tmp));
-	wcscat_s(tmp, STR_MAX,  strPath);
-	wcscat_s(tmp, STR_MAX, L"\\*.*");
-	hFind = FindFirstFile(tmp, &FindFileData);
-
-	if (hFind == INVALID_HANDLE_VALUE)
-		return;
+	const WIN32_FIND_DATA* arrFile = listing->arrFile;
+	const size_t szFile = listing->fileCount;
+	const WIN32_FIND_DATA* arrFolder = listing->arrFolder;
+	const size_t szFolder = listing->folderCount;
+	UINT depth = (width - 1) / 4 + 1;
+	BOOL first = TRUE;
+	PREFETCH_WINDOW window;
+	size_t i = 0;
 
-	do
+	for (i = 0; bShowFiles && i < szFile && LimitEntry(); ++i)
 	{
-		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-		{
-			if (wcscmp(FindFileData.cFileName, L".") == 0 ||
-				wcscmp(FindFileData.cFileName, L"..") == 0)
-				continue;
+		OutputWriteString((outputFormat == OUTPUT_JSON && !first) ? ",{" : "{");
+		JsonWriteFields(&arrFile[i], strPath, depth);
+		OutputWrite("}", 1);
 
-			++arrFoldersz;
-			arrFolder = (WIN32_FIND_DATA*)realloc(arrFolder, arrFoldersz * sizeof(FindFileData));
+		if (outputFormat == OUTPUT_NDJSON)
+			OutputNewLine();
 
-			if (arrFolder == NULL)
-				exit(-1);
+		first = FALSE;
+	}
+
+	if (bShowFiles && i == szFile && listing->moreFiles > 0 && LimitEntry())
+	{
+		JsonWriteMore(strPath, depth, first, TRUE, listing->moreFiles, listing->moreBytes);
+		first = FALSE;
+	}
 
-			arrFolder[arrFoldersz - 1] = FindFileData;
+	PrefetchOpen(&window, strPath, arrFolder, (UINT)szFolder, FALSE);
 
+	for (i = 0; i < szFolder && LimitEntry(); ++i)
+	{
+		wchar_t *str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+		if (str == NULL)
+			exit(-1);
+
+		OutputWriteString((outputFormat == OUTPUT_JSON && !first) ? ",{" : "{");
+		JsonWriteFields(&arrFolder[i], strPath, depth);
+
+		if (outputFormat == OUTPUT_JSON)
+		{
+			OutputWriteString(",\"contents\":[");
 		}
 		else
 		{
-			++arrFilesz;
-			arrFile = (WIN32_FIND_DATA*)realloc(arrFile, arrFilesz * sizeof(FindFileData));
+			OutputWrite("}", 1);
+			OutputNewLine();
+		}
 
-			if (arrFile == NULL)
-				exit(-1);
+		first = FALSE;
 
-			arrFile[arrFilesz - 1] = FindFileData;
+		/* skip folders whose path would not fit, as the tree does */
+		if (wcslen(strPath) + wcslen(arrFolder[i].cFileName) + 6 <= STR_MAX)
+		{
+			ZeroMemory(str, STR_MAX * sizeof(wchar_t));
+			wcscat_s(str, STR_MAX, strPath);
+			wcscat_s(str, STR_MAX, L"\\");
+			wcscat_s(str, STR_MAX, arrFolder[i].cFileName);
+			GetDirectoryStructure(str, width + 4, NULL, PrefetchTake(&window, (UINT)i));
 		}
-	} while (FindNextFile(hFind, &FindFileData));
 
-	FindClose(hFind);
+		if (outputFormat == OUTPUT_JSON)
+			OutputWrite("]}", 2);
 
-	if (bShowFiles)
-	{
-		/* spoof find data so DrawTree will leave blank line below each file listing */
-		if (arrFilesz > 0)
-		{
-			++arrFilesz;
-			arrFile = (WIN32_FIND_DATA*)realloc(arrFile, arrFilesz * sizeof(FindFileData));
+		free(str);
+	}
 
-			if (arrFile == NULL)
-				exit(-1);
+	PrefetchClose(&window);
 
-			wcscpy_s(arrFile[arrFilesz - 1].cFileName, MAX_PATH, L" ");
-		}
+	if (i == szFolder && listing->moreFolders > 0 && LimitEntry())
+		JsonWriteMore(strPath, depth, first, FALSE, listing->moreFolders, 0);
+}
 
-		DrawTree(strPath, arrFile, arrFilesz, width, prevLine, FALSE);
-	}
+/**
+* @name: AppendSpoof
+*
+* @param name
+* text drawn in place of a name
+*
+* @return
+* void
+*
+* appends find data that is drawn like an entry but stands for something
+* else. It has no attributes, so it is never descended into
+*/
+static VOID AppendSpoof(WIN32_FIND_DATA** arr, UINT* count, const wchar_t* name)
+{
+	++*count;
+	*arr = (WIN32_FIND_DATA*)StatsRealloc(*arr, *count * sizeof(WIN32_FIND_DATA));
 
-	DrawTree(strPath, arrFolder, arrFoldersz, width, prevLine, TRUE);
+	if (*arr == NULL)
+		exit(-1);
 
-	free(arrFolder);
-	free(arrFile);
+	ZeroMemory(&(*arr)[*count - 1], sizeof(WIN32_FIND_DATA));
+	wcscpy_s((*arr)[*count - 1].cFileName, MAX_PATH, name);
 }
 
 /**
-* @name: main
-* standard main functionality as required by C/C++ for application startup
+* @name: DescribeMore
+*
+* @param bFiles
+* true if count files of bytes in total were left out, else count folders
 *
 * @return
-* error /success value
+* void
+*
+* formats the line standing in for the entries of a folder beyond /CAP,
+* such as "... 184,233 more files (2.1 GB)"
 */
-int wmain(int argc, wchar_t* argv[])
+static VOID DescribeMore(wchar_t* str, size_t len, BOOL bFiles, ULONGLONG count, ULONGLONG bytes)
 {
-	DWORD dwSerial = 0;
-	wchar_t dwName[MAX_PATH] = L"";
-	wchar_t* strPath = NULL;
-	DWORD sz = 0;
-	wchar_t specifiedPath[MAX_PATH] = L"";
-	int i;
+	static const wchar_t* units[] = { L"KB", L"MB", L"GB", L"TB", L"PB", L"EB" };
+	wchar_t digits[32];
+	wchar_t number[48];
+	wchar_t size[32];
+	double scaled = (double)bytes / 1024;
+	size_t n = 0;
+	size_t i = 0;
+	size_t out = 0;
+	UINT unit = 0;
 
-	/* this is necessary if tree is called in non-ascii mode (default) */
-	_setmode(_fileno(stdout), _O_U8TEXT);
+	/* group the digits in threes */
+	StringCchPrintf(digits, _countof(digits), L"%llu", count);
+	n = wcslen(digits);
 
-	/* parse the command line */
-	for (i = 1; i < argc; ++i)
+	for (i = 0; i < n; ++i)
 	{
-		if (argv[i][0] == L'-' || argv[i][0] == L'/')
+		if (i > 0 && (n - i) % 3 == 0)
+			number[out++] = L',';
+
+		number[out++] = digits[i];
+	}
+
+	number[out] = L'\0';
+
+	if (!bFiles)
+	{
+		StringCchPrintf(str, len, L"... %s more folder%s", number, count == 1 ? L"" : L"s");
+		return;
+	}
+
+	if (bytes < 1024)
+	{
+		StringCchPrintf(size, _countof(size), L"%llu bytes", bytes);
+	}
+	else
+	{
+		while (scaled >= 1024 && unit + 1 < _countof(units))
 		{
-			switch (towlower(argv[i][1]))
-			{
-			case L'?':
-				/* will print help and exit after */
-				PrintUsage();
-				return 0;
-			case L'f':
-				/* if set to true, will populate all the files within the folder structure */
-				bShowFiles = TRUE;
-				break;
-			case L'a':
-				bUseAscii = TRUE;
-				break;
-			default:
-				break;
-			}
+			scaled /= 1024;
+			++unit;
+		}
+
+		StringCchPrintf(size, _countof(size), L"%.1f %s", scaled, units[unit]);
+	}
+
+	StringCchPrintf(str, len, L"... %s more file%s (%s)", number, count == 1 ? L"" : L"s", size);
+}
+
+/**
+* @name: GetDirectoryStructure
+*
+* @param strPath
+* Must specify folder name
+*
+* @param width
+* specifies drawing distance for correct formatting of tree structure being drawn on console screen
+*
+* @param prefix
+* connecting lines drawn in front of every entry, exactly width - 1 characters long
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @return
+* void
+*/
+static VOID
+GetDirectoryStructure(wchar_t* strPath, UINT width, const wchar_t* prefix, PREFETCH* prefetch)
+{
+	DIR_LISTING listing;
+	wchar_t summary[MAX_PATH];
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	UINT entries = 0;
+
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, bShowFiles && outputFormat == OUTPUT_TREE, &listing);
+
+	if (!listing.bOpened)
+	{
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	entries = listing.folderCount + listing.fileCount + (UINT)(listing.moreFolders + listing.moreFiles);
+
+	if (outputFormat != OUTPUT_TREE)
+	{
+		WriteJson(strPath, &listing, width);
+
+		FreeListing(&listing);
+		TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+		return;
+	}
+
+	if (bShowFiles)
+	{
+		/* files beyond the cap are summarised on a line of their own */
+		if (listing.moreFiles > 0)
+		{
+			DescribeMore(summary, _countof(summary), TRUE, listing.moreFiles, listing.moreBytes);
+			AppendSpoof(&listing.arrFile, &listing.fileCount, summary);
+		}
+
+		/* spoof find data so DrawTree will leave blank line below each file listing */
+		if (listing.fileCount > 0)
+			AppendSpoof(&listing.arrFile, &listing.fileCount, L" ");
+
+		DrawTree(strPath, listing.arrFile, listing.fileCount, width, prefix, FALSE, listing.bHasSubFolder);
+	}
+
+	/* folders beyond the cap are summarised as a last folder, which isn't descended into */
+	if (listing.moreFolders > 0)
+	{
+		DescribeMore(summary, _countof(summary), FALSE, listing.moreFolders, 0);
+		AppendSpoof(&listing.arrFolder, &listing.folderCount, summary);
+	}
+
+	DrawTree(strPath, listing.arrFolder, listing.folderCount, width, prefix, TRUE, FALSE);
+
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/* connecting lines in front of the entries of the folder last opened by PruneRenderTree */
+static wchar_t prunePrefix[STR_MAX];
+
+/**
+* @name: PruneRenderTree
+*
+* @param bAscii
+* selects the glyph set at compile time
+*
+* @param record
+* a line whose connectors are known
+*
+* @return
+* void
+*
+* draws the lines DrawTreeLines would, except that connectors follow the
+* visible folders only. Records come in traversal order, so the prefix of a
+* folder is always set up by its own entry before any of its contents is drawn
+*/
+template <BOOL bAscii>
+static VOID PruneRenderTree(const PRUNE_RECORD* record)
+{
+	typedef TreeGlyphs<bAscii> Glyphs;
+
+	const wchar_t* name = (record->kind == PRUNE_BLANK) ? L" " : record->name;
+	size_t prefixLen = 0;
+	wchar_t line[STR_MAX];
+	size_t len = 0;
+
+	if (record->kind == PRUNE_CLOSE)
+		return;
+
+	/* the blank line closing a file list is not an entry of its own */
+	if (record->kind == PRUNE_BLANK ? LimitStopped() : !LimitEntry())
+		return;
+
+	if (record->kind == PRUNE_OPEN)
+	{
+		prefixLen = 4 * (record->depth - 1);
+		memcpy(line, prunePrefix, prefixLen * sizeof(wchar_t));
+		memcpy(line + prefixLen, record->last == PRUNE_YES ? Glyphs::lastBranch : Glyphs::branch, 4 * sizeof(wchar_t));
+
+		/* the same continuation DrawTreeLines hands down to a sub folder */
+		prunePrefix[prefixLen] = (record->last == PRUNE_YES) ? L' ' : Glyphs::vertical[0];
+		prunePrefix[prefixLen + 1] = L' ';
+		prunePrefix[prefixLen + 2] = L' ';
+		prunePrefix[prefixLen + 3] = L' ';
+		len = prefixLen + 4;
+	}
+	else
+	{
+		/* files line up with a connecting line only if a visible sub folder follows */
+		const wchar_t* connector = (record->hasVisibleSub == PRUNE_YES) ? Glyphs::fileLine : Glyphs::fileBlank;
+		size_t connectorLen = wcslen(connector);
+
+		prefixLen = 4 * record->depth;
+		memcpy(line, prunePrefix, prefixLen * sizeof(wchar_t));
+		memcpy(line + prefixLen, connector, connectorLen * sizeof(wchar_t));
+		len = prefixLen + connectorLen;
+	}
+
+	/* the path a folded folder refers to may be longer than a name */
+	if (record->kind == PRUNE_SAME)
+	{
+		OutputWrite(line, len);
+		OutputWriteString(L"= same as ");
+		OutputWriteString(record->name);
+		OutputNewLine();
+		return;
+	}
+
+	memcpy(line + len, name, wcslen(name) * sizeof(wchar_t));
+	len += wcslen(name);
+
+	OutputWrite(line, len);
+	OutputNewLine();
+}
+
+/* what PruneRenderJson keeps about a folder whose entry it has written and not yet closed */
+typedef struct _PRUNE_JSON_FOLDER
+{
+	size_t pathLen;		/* length of the part of prunePath leading to it */
+	BOOL bOpened;		/* its own entry was written */
+	BOOL bWritten;		/* an entry inside it was written */
+} PRUNE_JSON_FOLDER;
+
+/* path of the folder last opened by PruneRenderJson, held folders don't keep theirs */
+static wchar_t prunePath[STR_MAX];
+
+/* the folders leading to prunePath by depth, the listed one first */
+static PRUNE_JSON_FOLDER pruneJsonFolders[STR_MAX / 4 + 1];
+
+/**
+* @name: PruneRenderJson
+*
+* @param record
+* an entry known to be visible
+*
+* @return
+* void
+*
+* writes what WriteJson would, tracking in each folder whether an entry
+* has been written to it yet to place the commas. The paths of the folders
+* are put together from their names as they are opened, like prunePrefix
+*/
+static VOID PruneRenderJson(const PRUNE_RECORD* record)
+{
+	PRUNE_JSON_FOLDER* folder = &pruneJsonFolders[record->depth];
+	PRUNE_JSON_FOLDER* parent = (record->depth > 0) ? folder - 1 : NULL;
+	size_t nameLen = 0;
+	WIN32_FIND_DATA entry;
+	char depth[48];
+
+	switch (record->kind)
+	{
+	case PRUNE_OPEN:
+		/* prunePath still ends at parent, it is extended once the entry is written */
+		nameLen = wcslen(record->name);
+		folder->pathLen = parent->pathLen;
+		folder->bOpened = FALSE;
+		folder->bWritten = FALSE;
+
+		if (!LimitEntry())
+			return;
+
+		if (record->bSummary)
+		{
+			JsonWriteMore(prunePath, record->depth, !parent->bWritten, FALSE, record->count, 0);
+			parent->bWritten = TRUE;
+			return;
+		}
+
+		ZeroMemory(&entry, sizeof(entry));
+		entry.dwFileAttributes = record->attributes;
+		entry.ftLastWriteTime = record->ftLastWrite;
+		wcscpy_s(entry.cFileName, MAX_PATH, record->name);
+
+		OutputWriteString((outputFormat == OUTPUT_JSON && parent->bWritten) ? ",{" : "{");
+		JsonWriteFields(&entry, prunePath, record->depth);
+
+		if (outputFormat == OUTPUT_JSON)
+		{
+			OutputWriteString(",\"contents\":[");
+		}
+		else
+		{
+			OutputWrite("}", 1);
+			OutputNewLine();
+		}
+
+		folder->bOpened = TRUE;
+		parent->bWritten = TRUE;
+
+		/* a folder whose path would not fit has not been descended into, nothing refers to it */
+		if (parent->pathLen + nameLen + 2 <= STR_MAX)
+		{
+			prunePath[parent->pathLen] = L'\\';
+			memcpy(prunePath + parent->pathLen + 1, record->name, (nameLen + 1) * sizeof(wchar_t));
+			folder->pathLen = parent->pathLen + 1 + nameLen;
+		}
+		break;
+
+	case PRUNE_CLOSE:
+		if (outputFormat == OUTPUT_JSON && folder->bOpened)
+			OutputWrite("]}", 2);
+
+		prunePath[parent->pathLen] = L'\0';
+		break;
+
+	case PRUNE_FILE:
+		if (!LimitEntry())
+			return;
+
+		ZeroMemory(&entry, sizeof(entry));
+		entry.dwFileAttributes = record->attributes;
+		entry.ftLastWriteTime = record->ftLastWrite;
+		entry.nFileSizeHigh = (DWORD)(record->fileSize >> 32);
+		entry.nFileSizeLow = (DWORD)record->fileSize;
+		wcscpy_s(entry.cFileName, MAX_PATH, record->name);
+
+		OutputWriteString((outputFormat == OUTPUT_JSON && folder->bWritten) ? ",{" : "{");
+		JsonWriteFields(&entry, prunePath, record->depth + 1);
+		OutputWrite("}", 1);
+
+		if (outputFormat == OUTPUT_NDJSON)
+			OutputNewLine();
+
+		folder->bWritten = TRUE;
+		break;
+
+	case PRUNE_MORE:
+		if (!LimitEntry())
+			return;
+
+		JsonWriteMore(prunePath, record->depth + 1, !folder->bWritten, TRUE, record->count, record->fileSize);
+		folder->bWritten = TRUE;
+		break;
+
+	case PRUNE_SAME:
+		if (!LimitEntry())
+			return;
+
+		OutputWriteString((outputFormat == OUTPUT_JSON && folder->bWritten) ? ",{" : "{");
+		OutputWriteString("\"type\":\"same\"");
+
+		if (outputFormat == OUTPUT_NDJSON)
+		{
+			StringCchPrintfA(depth, _countof(depth), ",\"depth\":%u,\"parent\":", record->depth + 1);
+			OutputWriteString(depth);
+			JsonWriteString(prunePath);
+		}
+
+		OutputWriteString(",\"path\":");
+		JsonWriteString(record->name);
+		OutputWrite("}", 1);
+
+		if (outputFormat == OUTPUT_NDJSON)
+			OutputNewLine();
+
+		folder->bWritten = TRUE;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+* @name: FoldShape
+*
+* @return
+* void
+*
+* adds an entry to the signature of its folder as HashEntry would, but
+* without the last write time, which a copy of the folder doesn't keep
+*/
+static VOID FoldShape(HASH_CONTEXT* ctx, BYTE type, const WIN32_FIND_DATA* entry, const BYTE* signature)
+{
+	WIN32_FIND_DATA shape = *entry;
+
+	ZeroMemory(&shape.ftLastWriteTime, sizeof(shape.ftLastWriteTime));
+	HashEntry(ctx, type, &shape, signature);
+}
+
+/**
+* @name: FoldSubFolder
+*
+* @param node
+* a sub folder that has been read but not closed yet
+*
+* @param signature
+* hash of everything below node, see PruneDirectoryStructure
+*
+* @param lines
+* entries listed below node
+*
+* @return
+* void
+*
+* replaces the contents of node by the path of the first folder with the
+* same signature, or records node as that folder if there is none yet
+*/
+static VOID FoldSubFolder(PRUNE_NODE* node, const BYTE* signature, ULONGLONG lines)
+{
+	const wchar_t* strSame = NULL;
+
+	/* the reference takes a line of its own, and a folder that isn't shown can't be referred to */
+	if (lines < 2 || node->visible != PRUNE_YES || LimitStopped())
+		return;
+
+	strSame = FoldFind(signature, node->strPath);
+
+	/* like a list of files, the reference ends with a blank line */
+	if (strSame != NULL && PruneFold(node, strSame) && bShowFiles && outputFormat == OUTPUT_TREE)
+		PruneBlank(node);
+}
+
+/**
+* @name: PruneDirectoryStructure
+*
+* @param node
+* folder to be read, its path in node->strPath
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @param signature
+* with /FOLD, receives a hash of the names and file sizes of everything
+* below node, which folders listing the same share
+*
+* @param lines
+* with /FOLD, receives the number of entries listed below node
+*
+* @return
+* void
+*
+* the /PRUNE and /FOLD counterpart of GetDirectoryStructure. Instead of
+* drawing, the entries are handed to the prune queue, which holds them back
+* until it is known whether a listed file follows below them and whether
+* the folders they are in are folded
+*/
+static VOID PruneDirectoryStructure(PRUNE_NODE* node, PREFETCH* prefetch, BYTE* signature, ULONGLONG* lines)
+{
+	const wchar_t* strPath = node->strPath;
+	DIR_LISTING listing;
+	wchar_t summary[MAX_PATH];
+	WIN32_FIND_DATA entry;
+	HASH_CONTEXT shape;
+	BYTE subSignature[HASH_SIZE];
+	ULONGLONG subLines = 0;
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	size_t pathLen = wcslen(strPath);
+	/* sub folders are only descended into while their lines still fit */
+	BOOL bDescend = 4 * node->depth + 4 + MAX_PATH <= STR_MAX;
+	PREFETCH_WINDOW window;
+	UINT entries = 0;
+	UINT i = 0;
+
+	/* connectors follow the visible sub folders, so HasSubFolder is of no use */
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, FALSE, &listing);
+
+	*lines = 0;
+
+	if (bFold)
+		HashInit(&shape);
+
+	if (!listing.bOpened)
+	{
+		PruneEndFolders(node);
+
+		/* an unreadable folder doesn't list the same as an empty one */
+		if (bFold)
+		{
+			HashUpdate(&shape, "X", 1);
+			HashFinal(&shape, signature);
+		}
+
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	entries = listing.folderCount + listing.fileCount + (UINT)(listing.moreFolders + listing.moreFiles);
+
+	/* a folder holding a listed file is shown along with all its parents */
+	if (listing.fileCount > 0 || listing.moreFiles > 0)
+		PruneShow(node);
+
+	if (listing.moreFiles > 0)
+		DescribeMore(summary, _countof(summary), TRUE, listing.moreFiles, listing.moreBytes);
+
+	/* files count even when they aren't listed, two folders holding different files are not the same */
+	if (bFold)
+	{
+		for (i = 0; i < listing.fileCount; ++i)
+			FoldShape(&shape, 'F', &listing.arrFile[i], NULL);
+
+		if (listing.moreFiles > 0)
+		{
+			ZeroMemory(&entry, sizeof(entry));
+			wcscpy_s(entry.cFileName, MAX_PATH, summary);
+			entry.nFileSizeHigh = (DWORD)(listing.moreBytes >> 32);
+			entry.nFileSizeLow = (DWORD)listing.moreBytes;
+			FoldShape(&shape, 'M', &entry, NULL);
+		}
+
+		if (bShowFiles)
+			*lines += listing.fileCount + (listing.moreFiles > 0 ? 1 : 0);
+	}
+
+	if (bShowFiles)
+	{
+		for (i = 0; i < listing.fileCount; ++i)
+			PruneFile(node, &listing.arrFile[i]);
+
+		if (listing.moreFiles > 0)
+			PruneMore(node, summary, listing.moreFiles, listing.moreBytes);
+
+		if (outputFormat == OUTPUT_TREE && (listing.fileCount > 0 || listing.moreFiles > 0))
+			PruneBlank(node);
+	}
+
+	if (bDescend)
+		PrefetchOpen(&window, strPath, listing.arrFolder, listing.folderCount, FALSE);
+
+	for (i = 0; i < listing.folderCount && !LimitStopped(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFolder[i].cFileName);
+		PRUNE_NODE* sub = NULL;
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (bDescend && pathLen + nameLen + 6 <= STR_MAX)
+		{
+			wchar_t *str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+			if (str == NULL)
+				exit(-1);
+
+			memcpy(str, strPath, pathLen * sizeof(wchar_t));
+			str[pathLen] = L'\\';
+			memcpy(str + pathLen + 1, listing.arrFolder[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+
+			sub = PruneOpen(node, &listing.arrFolder[i], str, FALSE, 0);
+			free(str);
+
+			/* /FOLD alone shows every folder, /FIND those it finds */
+			if (!bPrune || FilterName(listing.arrFolder[i].cFileName))
+				PruneShow(sub);
+
+			PruneDirectoryStructure(sub, PrefetchTake(&window, i), subSignature, &subLines);
+
+			if (bFold)
+			{
+				FoldShape(&shape, 'D', &listing.arrFolder[i], subSignature);
+				*lines += 1 + subLines;
+
+				FoldSubFolder(sub, subSignature, subLines);
+			}
+		}
+		else
+		{
+			/* not read, so nothing is known to be below it */
+			sub = PruneOpen(node, &listing.arrFolder[i], NULL, FALSE, 0);
+
+			if (!bPrune || FilterName(listing.arrFolder[i].cFileName))
+				PruneShow(sub);
+
+			if (bFold)
+			{
+				FoldShape(&shape, 'X', &listing.arrFolder[i], NULL);
+				*lines += 1;
+			}
+		}
+
+		PruneClose(sub);
+	}
+
+	if (bDescend)
+		PrefetchClose(&window);
+
+	/* folders beyond the cap can't be told apart, they are summarised if this folder is shown anyway */
+	if (i == listing.folderCount && listing.moreFolders > 0)
+	{
+		PRUNE_NODE* sub = NULL;
+
+		ZeroMemory(&entry, sizeof(entry));
+		DescribeMore(entry.cFileName, MAX_PATH, FALSE, listing.moreFolders, 0);
+
+		sub = PruneOpen(node, &entry, NULL, TRUE, listing.moreFolders);
+
+		if (node->visible == PRUNE_YES)
+			PruneShow(sub);
+
+		if (bFold)
+		{
+			FoldShape(&shape, 'M', &entry, NULL);
+			*lines += 1;
+		}
+
+		PruneClose(sub);
+	}
+
+	PruneEndFolders(node);
+
+	if (bFold)
+		HashFinal(&shape, signature);
+
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/**
+* @name: HashCompareNames
+*
+* @return
+* how the names of two entries compare, ordinally, so that a folder hashes
+* the same whatever order its file system returns the entries in
+*/
+static int HashCompareNames(const void* a, const void* b)
+{
+	return wcscmp(((const WIN32_FIND_DATA*)a)->cFileName, ((const WIN32_FIND_DATA*)b)->cFileName);
+}
+
+/**
+* @name: HashEntry
+*
+* @param type
+* 'F' for a file, 'D' for a folder. /FOLD also uses 'X' for a folder not
+* read and 'M' for the entries beyond /CAP, sized as the files left out
+*
+* @param digest
+* hash of a folder, or of the contents of a file with /HASHTREE:C, else NULL
+*
+* @return
+* void
+*
+* adds an entry to the hash of its folder: the type, the length and UTF-8
+* bytes of the name, then for a file or 'M' its size and last write time, both
+* as 8 little endian bytes, followed by digest if there is one
+*/
+static VOID HashEntry(HASH_CONTEXT* ctx, BYTE type, const WIN32_FIND_DATA* entry, const BYTE* digest)
+{
+	char name[UTF8_MAX_BYTES(MAX_PATH)];
+	size_t nameLen = Utf16ToUtf8(name, entry->cFileName, wcslen(entry->cFileName));
+	BYTE header[3];
+	BYTE fields[16];
+	ULONGLONG size = ((ULONGLONG)entry->nFileSizeHigh << 32) | entry->nFileSizeLow;
+	ULONGLONG time = ((ULONGLONG)entry->ftLastWriteTime.dwHighDateTime << 32) | entry->ftLastWriteTime.dwLowDateTime;
+	UINT i = 0;
+
+	header[0] = type;
+	header[1] = (BYTE)nameLen;
+	header[2] = (BYTE)(nameLen >> 8);
+	HashUpdate(ctx, header, sizeof(header));
+	HashUpdate(ctx, name, nameLen);
+
+	if (type == 'F' || type == 'M')
+	{
+		for (i = 0; i < 8; ++i)
+		{
+			fields[i] = (BYTE)(size >> (8 * i));
+			fields[8 + i] = (BYTE)(time >> (8 * i));
+		}
+
+		HashUpdate(ctx, fields, sizeof(fields));
+	}
+
+	if (digest != NULL)
+		HashUpdate(ctx, digest, HASH_SIZE);
+}
+
+/* true until the first folder hash is written to a JSON document, which needs no comma */
+static BOOL bHashFirst = TRUE;
+
+/**
+* @name: HashWriteFolder
+*
+* @param strRelative
+* path of the folder below the listed one, starting with a backslash, or
+* empty for the listed folder itself
+*
+* @return
+* void
+*
+* writes "hash  .\path", a line per folder that sorts and diffs as text
+*/
+static VOID HashWriteFolder(const wchar_t* strRelative, const BYTE* digest)
+{
+	wchar_t hex[HASH_HEX + 1];
+	wchar_t str[STR_MAX];
+
+	HashFormat(digest, hex);
+	StringCchPrintf(str, _countof(str), L".%s", strRelative);
+
+	if (outputFormat == OUTPUT_TREE)
+	{
+		OutputWrite(hex, HASH_HEX);
+		OutputWrite(L"  ", 2);
+		OutputWriteString(str);
+		OutputNewLine();
+		return;
+	}
+
+	OutputWriteString((outputFormat == OUTPUT_JSON && !bHashFirst) ? ",{\"type\":\"directory\",\"path\":" : "{\"type\":\"directory\",\"path\":");
+	JsonWriteString(str);
+	OutputWriteString(",\"hash\":");
+	JsonWriteString(hex);
+	OutputWrite("}", 1);
+
+	if (outputFormat == OUTPUT_NDJSON)
+		OutputNewLine();
+
+	bHashFirst = FALSE;
+}
+
+/**
+* @name: HashDirectoryStructure
+*
+* @param rootLen
+* length of the path of the listed folder, which strPath starts with
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @param digest
+* receives the hash of the folder, HASH_SIZE bytes
+*
+* @return
+* void
+*
+* the /HASHTREE counterpart of GetDirectoryStructure. A folder is hashed
+* once all its sub folders are, from the entries of its files and those
+* of its sub folders along with their hashes, each in name order. Nothing
+* but a hash per folder is kept while the sub folders are read. A folder
+* that can't be read, or whose path would not fit, hashes as having the
+* single entry 'X'
+*/
+static VOID HashDirectoryStructure(const wchar_t* strPath, size_t rootLen, PREFETCH* prefetch, BYTE* digest)
+{
+	DIR_LISTING listing;
+	HASH_CONTEXT ctx;
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	size_t pathLen = wcslen(strPath);
+	PREFETCH_WINDOW window;
+	BYTE sub[HASH_SIZE];
+	wchar_t* str = NULL;
+	UINT entries = 0;
+	UINT i = 0;
+
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, FALSE, &listing);
+
+	HashInit(&ctx);
+
+	if (!listing.bOpened)
+	{
+		HashUpdate(&ctx, "X", 1);
+		HashFinal(&ctx, digest);
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	entries = listing.folderCount + listing.fileCount;
+
+	str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+	if (str == NULL)
+		exit(-1);
+
+	memcpy(str, strPath, pathLen * sizeof(wchar_t));
+	str[pathLen] = L'\\';
+
+	qsort(listing.arrFile, listing.fileCount, sizeof(WIN32_FIND_DATA), HashCompareNames);
+	qsort(listing.arrFolder, listing.folderCount, sizeof(WIN32_FIND_DATA), HashCompareNames);
+
+	for (i = 0; i < listing.fileCount; ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFile[i].cFileName);
+
+		if (bHashContents && pathLen + nameLen + 2 <= STR_MAX)
+		{
+			memcpy(str + pathLen + 1, listing.arrFile[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+			HashFile(str, sub);
+		}
+		else if (bHashContents)
+		{
+			ZeroMemory(sub, sizeof(sub));
+		}
+
+		HashEntry(&ctx, 'F', &listing.arrFile[i], bHashContents ? sub : NULL);
+	}
+
+	PrefetchOpen(&window, strPath, listing.arrFolder, listing.folderCount, FALSE);
+
+	for (i = 0; i < listing.folderCount && !LimitStopped(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFolder[i].cFileName);
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (pathLen + nameLen + 6 <= STR_MAX)
+		{
+			memcpy(str + pathLen + 1, listing.arrFolder[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+			HashDirectoryStructure(str, rootLen, PrefetchTake(&window, i), sub);
+		}
+		else
+		{
+			HASH_CONTEXT unread;
+
+			HashInit(&unread);
+			HashUpdate(&unread, "X", 1);
+			HashFinal(&unread, sub);
+		}
+
+		HashEntry(&ctx, 'D', &listing.arrFolder[i], sub);
+	}
+
+	PrefetchClose(&window);
+	HashFinal(&ctx, digest);
+
+	/* the listed folder is written by wmain, after all the others */
+	if (bHashFolders && pathLen > rootLen)
+		HashWriteFolder(strPath + rootLen, digest);
+
+	free(str);
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/**
+* @name: IndexDirectoryStructure
+*
+* @param strPath
+* Must specify folder name
+*
+* @param folder
+* number of the index entry of strPath
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @param folders
+* incremented by the number of sub folders found
+*
+* @param files
+* incremented by the number of files found
+*
+* @return
+* void
+*
+* the /INDEX counterpart of GetDirectoryStructure. The entries of a folder
+* are added to the index as soon as it has been read, so the entries of
+* every folder are numbered one after the other
+*/
+static VOID IndexDirectoryStructure(const wchar_t* strPath, DWORD folder, PREFETCH* prefetch,
+	ULONGLONG* folders, ULONGLONG* files)
+{
+	DIR_LISTING listing;
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	size_t pathLen = wcslen(strPath);
+	PREFETCH_WINDOW window;
+	wchar_t* str = NULL;
+	DWORD first = 0;
+	UINT entries = 0;
+	UINT i = 0;
+
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, FALSE, &listing);
+
+	if (!listing.bOpened)
+	{
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	entries = listing.folderCount + listing.fileCount;
+
+	first = IndexAddFolder(folder, listing.arrFile, listing.fileCount, listing.arrFolder, listing.folderCount);
+	*files += listing.fileCount;
+	*folders += listing.folderCount;
+
+	str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+	if (str == NULL)
+		exit(-1);
+
+	memcpy(str, strPath, pathLen * sizeof(wchar_t));
+	str[pathLen] = L'\\';
+
+	PrefetchOpen(&window, strPath, listing.arrFolder, listing.folderCount, FALSE);
+
+	for (i = 0; i < listing.folderCount && !LimitStopped(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFolder[i].cFileName);
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (pathLen + nameLen + 6 <= STR_MAX)
+		{
+			memcpy(str + pathLen + 1, listing.arrFolder[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+			IndexDirectoryStructure(str, first + listing.fileCount + i, PrefetchTake(&window, i), folders, files);
+		}
+	}
+
+	PrefetchClose(&window);
+
+	free(str);
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/**
+* @name: CountDirectoryStructure
+*
+* @param strPath
+* Must specify folder name
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @param folders
+* incremented by the number of sub folders found
+*
+* @param files
+* incremented by the number of files found
+*
+* @param bytes
+* incremented by the size of those files
+*
+* @return
+* void
+*
+* the /C counterpart of GetDirectoryStructure. Nothing is written, so the
+* time taken is that of reading the folders, sibling folders being read on
+* other threads as set by /PREFETCH
+*/
+static VOID CountDirectoryStructure(const wchar_t* strPath, PREFETCH* prefetch,
+	ULONGLONG* folders, ULONGLONG* files, ULONGLONG* bytes)
+{
+	DIR_LISTING listing;
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	size_t pathLen = wcslen(strPath);
+	PREFETCH_WINDOW window;
+	wchar_t* str = NULL;
+	UINT entries = 0;
+	UINT i = 0;
+
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, FALSE, &listing);
+
+	if (!listing.bOpened)
+	{
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	/* without bKeepFiles the files were only counted, in moreFiles and moreBytes */
+	entries = listing.folderCount + listing.fileCount + (UINT)listing.moreFiles;
+	*files += listing.fileCount + listing.moreFiles;
+	*folders += listing.folderCount;
+	*bytes += listing.moreBytes;
+
+	for (i = 0; i < listing.fileCount; ++i)
+		*bytes += ((ULONGLONG)listing.arrFile[i].nFileSizeHigh << 32) | listing.arrFile[i].nFileSizeLow;
+
+	str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+	if (str == NULL)
+		exit(-1);
+
+	memcpy(str, strPath, pathLen * sizeof(wchar_t));
+	str[pathLen] = L'\\';
+
+	PrefetchOpen(&window, strPath, listing.arrFolder, listing.folderCount, FALSE);
+
+	for (i = 0; i < listing.folderCount && !LimitStopped(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFolder[i].cFileName);
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (pathLen + nameLen + 6 <= STR_MAX)
+		{
+			memcpy(str + pathLen + 1, listing.arrFolder[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+			CountDirectoryStructure(str, PrefetchTake(&window, i), folders, files, bytes);
+		}
+	}
+
+	PrefetchClose(&window);
+
+	free(str);
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/**
+* @name: PathWrite
+*
+* @param strPath
+* full path of an entry
+*
+* @param len
+* characters in strPath
+*
+* @return
+* void
+*/
+static __forceinline VOID PathWrite(const wchar_t* strPath, size_t len)
+{
+	OutputWrite(strPath, len);
+
+	if (bPathsNul)
+		OutputWrite("", 1);
+	else
+		OutputNewLine();
+}
+
+/**
+* @name: PathShow
+*
+* @param strPath
+* path of a folder holding a listed file
+*
+* @param pathLen
+* characters in strPath
+*
+* @return
+* void
+*
+* with /P /PRUNE, a folder is only written once a listed file is found
+* below it. Its parents that are not written yet come first, in the order
+* /P would have written them
+*/
+static VOID PathShow(const wchar_t* strPath, size_t pathLen)
+{
+	size_t i = 0;
+
+	for (i = pathShownLen + 1; i <= pathLen; ++i)
+	{
+		if (i < pathLen && strPath[i] != L'\\')
+			continue;
+
+		if (!LimitEntry())
+			return;
+
+		PathWrite(strPath, i);
+		pathShownLen = i;
+	}
+}
+
+/**
+* @name: PathDirectoryStructure
+*
+* @param strPath
+* path of the folder, in a buffer of STR_MAX characters shared by the whole
+* traversal: the name of each entry is put after it and taken off again, so
+* no path is copied or built more than once
+*
+* @param pathLen
+* characters in strPath
+*
+* @param prefetch
+* the folder read ahead by PrefetchTake, or NULL to read it now
+*
+* @return
+* void
+*
+* the /P counterpart of GetDirectoryStructure, writing the full path of each
+* file and sub folder, each sub folder followed by what is below it
+*/
+static VOID PathDirectoryStructure(wchar_t* strPath, size_t pathLen, PREFETCH* prefetch)
+{
+	DIR_LISTING listing;
+	/* span of this folder for --trace, including its sub folders */
+	ULONGLONG spanFolder = TraceBegin();
+	PREFETCH_WINDOW window;
+	/* where the names of the entries go, a drive root already ends with a backslash */
+	size_t nameStart = (pathLen > 0 && strPath[pathLen - 1] == L'\\') ? pathLen : pathLen + 1;
+	UINT entries = 0;
+	UINT i = 0;
+
+	if (prefetch != NULL)
+		PrefetchWait(prefetch, &listing);
+	else
+		ReadListing(strPath, FALSE, &listing);
+
+	if (!listing.bOpened)
+	{
+		TraceEnd("dir", "folder", spanFolder, strPath, NULL, 0);
+		return;
+	}
+
+	entries = listing.folderCount + listing.fileCount;
+
+	/* /PRUNE writes a folder once it is known to hold a listed file */
+	if (bPrune && !FilterHasName() && listing.fileCount > 0 && pathLen > pathShownLen)
+		PathShow(strPath, pathLen);
+
+	/* the buffer is shared, so the sub folders read ahead are named before it changes */
+	PrefetchOpen(&window, strPath, listing.arrFolder, listing.folderCount, FALSE);
+	strPath[nameStart - 1] = L'\\';
+
+	for (i = 0; bShowFiles && i < listing.fileCount && LimitEntry(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFile[i].cFileName);
+
+		if (nameStart + nameLen < STR_MAX)
+		{
+			memcpy(strPath + nameStart, listing.arrFile[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+			PathWrite(strPath, nameStart + nameLen);
+		}
+	}
+
+	for (i = 0; i < listing.folderCount && !LimitStopped(); ++i)
+	{
+		size_t nameLen = wcslen(listing.arrFolder[i].cFileName);
+		/* /FIND writes the folders it finds, /PRUNE those PathShow finds a listed file below */
+		BOOL bWrite = bPrune ? FilterName(listing.arrFolder[i].cFileName) : TRUE;
+		PREFETCH* sub = NULL;
+		wchar_t saved = L'\0';
+
+		if (nameStart + nameLen >= STR_MAX)
+			continue;
+
+		memcpy(strPath + nameStart, listing.arrFolder[i].cFileName, (nameLen + 1) * sizeof(wchar_t));
+
+		if (bWrite && !LimitEntry())
+			break;
+
+		if (bWrite)
+			PathWrite(strPath, nameStart + nameLen);
+
+		/* skip folders whose path and "\\*.*" would not fit, FindFirstFile couldn't open them anyway */
+		if (pathLen + nameLen + 6 > STR_MAX)
+			continue;
+
+		/*
+		 * PrefetchTake names the siblings it reads ahead by the path of this folder. Only
+		 * the folders descended into are taken, PrefetchClose releases the others read ahead
+		 */
+		saved = strPath[pathLen];
+		strPath[pathLen] = L'\0';
+		sub = PrefetchTake(&window, i);
+		strPath[pathLen] = saved;
+
+		PathDirectoryStructure(strPath, nameStart + nameLen, sub);
+
+		/* what was written below stays written, but siblings have paths of their own */
+		if (pathShownLen > pathLen)
+			pathShownLen = pathLen;
+	}
+
+	PrefetchClose(&window);
+
+	strPath[pathLen] = L'\0';
+	FreeListing(&listing);
+	TraceEnd("dir", "folder", spanFolder, strPath, "entries", entries);
+}
+
+/**
+* @name: main
+* standard main functionality as required by C/C++ for application startup
+*
+* @return
+* error /success value
+*/
+int wmain(int argc, wchar_t* argv[])
+{
+	DWORD dwSerial = 0;
+	wchar_t dwName[MAX_PATH] = L"";
+	wchar_t* strPath = NULL;
+	const wchar_t* strSourceRoot = NULL;	/* root of a source listed without a current directory */
+	DWORD sz = 0;
+	wchar_t specifiedPath[MAX_PATH] = L"";
+	BOOL bPathIsImage = FALSE;
+	BOOL bHeader = FALSE;
+	DWORD attributes = 0;
+	char serial[64];
+	wchar_t truncated[64];
+	ULONGLONG number = 0;
+	int i;
+
+	/* parse the command line */
+	for (i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] == L'-' || argv[i][0] == L'/')
+		{
+			if (_wcsicmp(argv[i], L"--stats") == 0 || _wcsicmp(argv[i], L"--stats:json") == 0)
+			{
+				StatsInit();
+				bStatsJson = argv[i][7] != L'\0';
+				continue;
+			}
+
+			if (_wcsnicmp(argv[i], L"--trace:", 8) == 0)
+			{
+				/* opened right away, so a relative name is taken from where tree was started */
+				if (!TraceInit(&argv[i][8]))
+					fwprintf(stderr, L"Cannot create trace file - %s\n", &argv[i][8]);
+
+				TraceThreadName("traversal");
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"JSON") == 0)
+			{
+				outputFormat = OUTPUT_JSON;
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"NDJSON") == 0)
+			{
+				outputFormat = OUTPUT_NDJSON;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"SYNTH:", 6) == 0)
+			{
+				if (!SynthInit(&argv[i][7]))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				pEnumSource = &synthSource;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"IMAGE:", 6) == 0)
+			{
+				if (!ImageInit(&argv[i][7]))
+				{
+					fwprintf(stderr, L"Cannot read image - %s\n", &argv[i][7]);
+					return 0;
+				}
+
+				pEnumSource = &imageSource;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"INDEX:", 6) == 0)
+			{
+				/* made absolute now, the current directory changes to the listed folder */
+				_wfullpath(strIndexFile, &argv[i][7], MAX_PATH);
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"LOCATE:", 7) == 0)
+			{
+				strLocate = &argv[i][8];
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"MAX:", 4) == 0)
+			{
+				if (!ParseNumber(&argv[i][5], MAXULONGLONG, &maxEntries))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"CAP:", 4) == 0)
+			{
+				if (!ParseNumber(&argv[i][5], MAXUINT, &number))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				entryCap = (UINT)number;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"SIZE:", 5) == 0 ||
+				_wcsnicmp(&argv[i][1], L"NEWER:", 6) == 0 ||
+				_wcsnicmp(&argv[i][1], L"OLDER:", 6) == 0 ||
+				_wcsnicmp(&argv[i][1], L"ATTR:", 5) == 0)
+			{
+				const wchar_t* value = wcschr(argv[i], L':') + 1;
+				BOOL bValid = FALSE;
+
+				if (towupper(argv[i][1]) == L'S')
+					bValid = FilterAddSize(value);
+				else if (towupper(argv[i][1]) == L'A')
+					bValid = FilterAddAttr(value);
+				else
+					bValid = FilterAddTime(value, towupper(argv[i][1]) == L'N');
+
+				if (!bValid)
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				continue;
+			}
+
+			/* found names are shown with the folders leading to them, as /PRUNE does for files */
+			if (_wcsnicmp(&argv[i][1], L"FIND:", 5) == 0)
+			{
+				if (!FilterAddName(&argv[i][6]))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				bPrune = TRUE;
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"HASHTREE") == 0 || _wcsnicmp(&argv[i][1], L"HASHTREE:", 9) == 0)
+			{
+				const wchar_t* flags = (argv[i][9] == L':') ? &argv[i][10] : L"";
+
+				bHashTree = TRUE;
+				bHashFolders = wcspbrk(flags, L"Dd") != NULL;
+				bHashContents = wcspbrk(flags, L"Cc") != NULL;
+
+				if (wcsspn(flags, L"DdCc") != wcslen(flags))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"PRUNE") == 0)
+			{
+				bPrune = TRUE;
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"FOLD") == 0)
+			{
+				bFold = TRUE;
+				continue;
+			}
+
+			if (_wcsicmp(&argv[i][1], L"P") == 0 || _wcsicmp(&argv[i][1], L"P0") == 0)
+			{
+				bPaths = TRUE;
+				bPathsNul = argv[i][2] == L'0';
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"TIMEOUT:", 8) == 0)
+			{
+				/* INFINITE is not a timeout */
+				if (!ParseNumber(&argv[i][9], INFINITE - 1, &number))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				timeout = (DWORD)number;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"PREFETCH:", 9) == 0)
+			{
+				if (!ParseNumber(&argv[i][10], PREFETCH_DEPTH_MAX, &number))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				prefetchDepth = (UINT)number;
+				continue;
+			}
+
+			if (_wcsnicmp(&argv[i][1], L"BUF:", 4) == 0)
+			{
+				if (!ParseNumber(&argv[i][5], OUTPUT_QUEUE_KB_MAX, &number))
+				{
+					fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+					return 0;
+				}
+
+				outputQueueSize = (size_t)number * 1024;
+				continue;
+			}
+
+			/* the rest are single letters, anything longer such as a bare /CAP is not one of them */
+			if (argv[i][1] == L'\0' || argv[i][2] != L'\0')
+			{
+				fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+				return 0;
+			}
+
+			switch (towlower(argv[i][1]))
+			{
+			case L'?':
+				/* will print help and exit after */
+				PrintUsage();
+				return 0;
+			case L'f':
+				/* if set to true, will populate all the files within the folder structure */
+				bShowFiles = TRUE;
+				break;
+			case L'a':
+				bUseAscii = TRUE;
+				break;
+			case L'c':
+				bCount = TRUE;
+				break;
+			default:
+				fwprintf(stderr, L"Invalid switch - %s\n", argv[i]);
+				return 0;
+			}
 		}
 		else
 		{
@@ -368,45 +2101,348 @@ int wmain(int argc, wchar_t* argv[])
 		}
 	}
 
-	/* display banner */
-	GetVolumeInformation(NULL, dwName, MAX_PATH, &dwSerial, NULL, NULL, NULL, 0);
-	wprintf(L"Folder PATH listing for volume %s\n", dwName);
-	wprintf(L"Volume serial number is %X-%X\n", dwSerial >> 16, dwSerial & 0xffff);
+	/* /LOCATE lists what it finds in the index as an image, in place of a path */
+	if (strLocate != NULL)
+	{
+		ULONGLONG hits = 0;
+
+		if (strIndexFile[0] == L'\0' || bSetPath || pEnumSource != &diskSource)
+		{
+			fwprintf(stderr, L"Invalid switch - /LOCATE needs /INDEX:file and nothing else to list\n");
+			return 0;
+		}
+
+		if (!ImageInit(strIndexFile) || !IndexLocate(strLocate, &hits))
+		{
+			fwprintf(stderr, L"Cannot read index - %s\n", strIndexFile);
+			return 0;
+		}
+
+		pEnumSource = &imageSource;
+		bShowFiles = TRUE;
+	}
+	else if (strIndexFile[0] != L'\0')
+	{
+		/* an index holds every entry, and is written instead of a listing */
+		if (outputFormat != OUTPUT_TREE)
+		{
+			fwprintf(stderr, L"Invalid switch - /INDEX writes no JSON\n");
+			return 0;
+		}
+
+		entryCap = 0;
+	}
+
+	/* a path naming a file rather than a folder is an image or archive to be listed, as in tree /F payload.zip */
+	if (bSetPath == TRUE && pEnumSource == &diskSource)
+	{
+		attributes = GetFileAttributes(specifiedPath);
+
+		if (attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			if (!ImageInit(specifiedPath))
+			{
+				fwprintf(stderr, L"Cannot read image - %s\n", specifiedPath);
+				return 0;
+			}
+
+			pEnumSource = &imageSource;
+			bPathIsImage = TRUE;
+		}
+	}
+
+	/* a count covers every entry, even those /CAP would leave out */
+	if (bCount)
+		entryCap = 0;
+
+	/* paths are read by other tools, which have no use for a line counting the entries left out */
+	if (bPaths)
+	{
+		if (outputFormat != OUTPUT_TREE)
+		{
+			fwprintf(stderr, L"Invalid switch - /P writes no JSON\n");
+			return 0;
+		}
+
+		entryCap = 0;
+	}
+
+	/* only files on disk have contents to be hashed, and a hash has to cover every entry */
+	if (bHashTree)
+	{
+		if (bHashContents && pEnumSource != &diskSource)
+		{
+			fwprintf(stderr, L"Invalid switch - /HASHTREE:C needs a folder on disk\n");
+			return 0;
+		}
+
+		entryCap = 0;
+	}
+
+	/* the time limit counts from here, Ctrl+C is handled from here on too */
+	LimitInit(maxEntries, timeout);
+
+	/* sets up UTF-8 output, both for the console and for redirection */
+	OutputInit(outputQueueSize);
+
+	/* display banner, JSON output carries the same information in its root object */
+	if (pEnumSource == &synthSource)
+	{
+		/* a generated tree has no volume, nor a current directory: it is always listed from its root */
+		wcscpy_s(dwName, MAX_PATH, L"SYNTH");
+		dwSerial = SynthSerial();
+		strSourceRoot = SYNTH_ROOT;
+	}
+	else if (pEnumSource == &imageSource)
+	{
+		/* so is an image, but its volume has a label and serial number of its own */
+		wcscpy_s(dwName, MAX_PATH, ImageLabel());
+		dwSerial = ImageSerial();
+		strSourceRoot = IMAGE_ROOT;
+	}
+	else
+	{
+		GetVolumeInformation(NULL, dwName, MAX_PATH, &dwSerial, NULL, NULL, NULL, 0);
+	}
+
+	/* the banner and the listed folder head a drawn tree, /P writes the paths alone */
+	bHeader = outputFormat == OUTPUT_TREE && !bPaths;
+
+	if (bHeader)
+	{
+		OutputPrintf(L"Folder PATH listing for volume %s", dwName);
+		OutputNewLine();
+		OutputPrintf(L"Volume serial number is %X-%X", dwSerial >> 16, dwSerial & 0xffff);
+		OutputNewLine();
+	}
+
+	if (strSourceRoot != NULL)
+	{
+		if (bHeader)
+		{
+			/* an image named as the path is shown by that path, as a folder would be */
+			if (bPathIsImage)
+			{
+				CharUpper(specifiedPath);
+				OutputWriteString(specifiedPath);
+			}
+			else if (strLocate != NULL)
+			{
+				OutputWriteString(IndexRoot());
+			}
+			else
+			{
+				OutputWriteString(strSourceRoot);
+			}
 
-	if (bSetPath == TRUE) /* if a path is specified, display absolute path */
+			OutputNewLine();
+		}
+	}
+	else if (bSetPath == TRUE) /* if a path is specified, display absolute path */
 	{
 		CharUpper(specifiedPath);
 
-		wprintf(L"%s\n", specifiedPath);
+		if (bHeader)
+		{
+			OutputWriteString(specifiedPath);
+			OutputNewLine();
+		}
 
 		/* if we fail here, assume we had no subfolders and exit */
 		if (SetCurrentDirectory(specifiedPath) == FALSE)
 		{
 			strPath = wcschr(specifiedPath, L'\\');
+			OutputFlush();
 			fwprintf(stderr, L"Invalid path - %s\n", strPath);
 			fwprintf(stderr, L"No subfolders exist\n\n");
 
 			return 0;
 		}
 	}
-	else /* if no path is specified, display drive letter and relative path */
+	else if (bHeader) /* if no path is specified, display drive letter and relative path */
 	{
-		wprintf(L"%c:.\n", (_getdrive() + 'A' - 1));
+		OutputPrintf(L"%c:.", (_getdrive() + 'A' - 1));
+		OutputNewLine();
 	}
 
 	/* get the current directory */
-	sz = GetCurrentDirectory(0, NULL);
-	strPath = (wchar_t*)malloc(sizeof(wchar_t) * sz);
-	GetCurrentDirectory(sz, strPath);
+	sz = (strSourceRoot != NULL) ? (DWORD)wcslen(strSourceRoot) + 1 : GetCurrentDirectory(0, NULL);
+	strPath = (wchar_t*)StatsMalloc(sizeof(wchar_t) * sz);
+
+	if (strSourceRoot != NULL)
+		wcscpy_s(strPath, sz, strSourceRoot);
+	else
+		GetCurrentDirectory(sz, strPath);
+
+	if (outputFormat == OUTPUT_JSON)
+	{
+		OutputWriteString("{\"volume\":");
+		JsonWriteString(dwName);
+		StringCchPrintfA(serial, _countof(serial), ",\"serial\":\"%04X-%04X\",\"path\":", dwSerial >> 16, dwSerial & 0xffff);
+		OutputWriteString(serial);
+		JsonWriteString(strPath);
+		/* a count is written as members of the root object */
+		if (bHashTree)
+			OutputWriteString(",\"folders\":[");
+		else if (!bCount)
+			OutputWriteString(",\"contents\":[");
+	}
 
 	/* get the sub directories within this current folder */
-	GetDirectoryStructure(strPath, 1, L"          ");
+	if (bHashTree)
+	{
+		BYTE digest[HASH_SIZE];
+		wchar_t hex[HASH_HEX + 1];
+
+		HashDirectoryStructure(strPath, wcslen(strPath), NULL, digest);
+
+		/* the listed folder comes last, in JSON as a member of the root object */
+		if (outputFormat == OUTPUT_JSON)
+		{
+			HashFormat(digest, hex);
+			OutputWriteString("],\"hash\":");
+			JsonWriteString(hex);
+		}
+		else
+		{
+			HashWriteFolder(L"", digest);
+		}
+	}
+	else if (strIndexFile[0] != L'\0' && strLocate == NULL)
+	{
+		ULONGLONG folders = 0;
+		ULONGLONG files = 0;
+
+		IndexInit(strPath);
+		IndexDirectoryStructure(strPath, 0, NULL, &folders, &files);
+
+		if (IndexWrite(strIndexFile, dwName, dwSerial))
+		{
+			OutputPrintf(L"%llu folders and %llu files indexed", folders, files);
+			OutputNewLine();
+		}
+		else
+		{
+			fwprintf(stderr, L"Cannot write index - %s\n", strIndexFile);
+		}
+	}
+	else if (bCount)
+	{
+		ULONGLONG folders = 0;
+		ULONGLONG files = 0;
+		ULONGLONG bytes = 0;
+		char count[128];
+
+		/* files are only counted, only the folders are kept to be descended into */
+		bKeepFiles = FALSE;
+		CountDirectoryStructure(strPath, NULL, &folders, &files, &bytes);
+
+		if (outputFormat == OUTPUT_TREE)
+		{
+			OutputPrintf(L"%llu folders, %llu files, %llu bytes", folders, files, bytes);
+			OutputNewLine();
+		}
+		else
+		{
+			StringCchPrintfA(count, _countof(count), "%s\"folders\":%llu,\"files\":%llu,\"bytes\":%llu%s",
+				(outputFormat == OUTPUT_JSON) ? "," : "{\"type\":\"count\",", folders, files, bytes,
+				(outputFormat == OUTPUT_JSON) ? "" : "}");
+			OutputWriteString(count);
+
+			if (outputFormat == OUTPUT_NDJSON)
+				OutputNewLine();
+		}
+	}
+	else if (bPaths)
+	{
+		wchar_t* str = (wchar_t*)StatsMalloc(STR_MAX * sizeof(wchar_t));
+
+		if (str == NULL)
+			exit(-1);
+
+		wcscpy_s(str, STR_MAX, strPath);
+		pathShownLen = wcslen(str);
+		PathDirectoryStructure(str, pathShownLen, NULL);
+		free(str);
+	}
+	else if (bPrune || bFold)
+	{
+		PRUNE_NODE* root = PruneRoot(strPath);
+		BYTE signature[HASH_SIZE];
+		ULONGLONG lines = 0;
+
+		if (outputFormat != OUTPUT_TREE)
+		{
+			wcscpy_s(prunePath, STR_MAX, strPath);
+			pruneJsonFolders[0].pathLen = wcslen(prunePath);
+			PruneInit(PruneRenderJson, FALSE, bFold);
+		}
+		else if (bUseAscii)
+			PruneInit(PruneRenderTree<TRUE>, TRUE, bFold);
+		else
+			PruneInit(PruneRenderTree<FALSE>, TRUE, bFold);
+
+		PruneDirectoryStructure(root, NULL, signature, &lines);
+		PruneFinish(root);
+		FoldFree();
+	}
+	else
+	{
+		GetDirectoryStructure(strPath, 1, L"", NULL);
+	}
+
+	/* say so if a limit or Ctrl+C cut the listing short */
+	LimitDescribe(truncated, _countof(truncated));
+
+	if (outputFormat == OUTPUT_JSON)
+	{
+		if (!bHashTree && !bCount)
+			OutputWrite("]", 1);
+
+		if (truncated[0] != L'\0')
+		{
+			OutputWriteString(",\"truncated\":");
+			JsonWriteString(truncated);
+		}
+
+		OutputWrite("}", 1);
+		OutputNewLine();
+	}
+	else if (truncated[0] != L'\0' && bPaths)
+	{
+		/* a line among the paths would be taken for one */
+		OutputFlush();
+		fwprintf(stderr, L"... listing truncated, %s\n", truncated);
+	}
+	else if (truncated[0] != L'\0')
+	{
+		if (outputFormat == OUTPUT_NDJSON)
+		{
+			OutputWriteString("{\"type\":\"truncated\",\"reason\":");
+			JsonWriteString(truncated);
+			OutputWrite("}", 1);
+		}
+		else
+		{
+			OutputPrintf(L"... listing truncated, %s", truncated);
+		}
+
+		OutputNewLine();
+	}
+
+	OutputFlush();
 
 	/* if we didn't find any sub directories, state so */
-	if (HasSubFolder(strPath) == FALSE)
+	if (truncated[0] == L'\0' && HasSubFolder(strPath) == FALSE)
 		fwprintf(stderr, L"No subfolders exist\n\n");
 
+	if (pEnumSource == &imageSource)
+		ImageFree();
+
 	free(strPath);
 
+	StatsReport(bStatsJson);
+	TraceWrite();
+
 	return 0;
 }
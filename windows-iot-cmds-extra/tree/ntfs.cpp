@@ -0,0 +1,943 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     NTFS volumes inside images for tree.com's /IMAGE option
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include <windows.h>
+
+#include "image.h"
+#include "stats.h"
+#include "trace.h"
+
+/* file records the volume keeps its own metadata in, none of them is listed */
+#define NTFS_RESERVED	24
+#define NTFS_VOLUME	3
+#define NTFS_ROOT	5
+#define NTFS_UPCASE	10
+
+/* attribute types */
+#define NTFS_STANDARD_INFORMATION	0x10
+#define NTFS_FILE_NAME			0x30
+#define NTFS_VOLUME_NAME		0x60
+#define NTFS_DATA			0x80
+#define NTFS_END			0xFFFFFFFF
+
+/* file record flags */
+#define NTFS_IN_USE	0x1
+#define NTFS_DIRECTORY	0x2
+
+/* the name space of a file name only 8.3 aware systems see */
+#define NTFS_DOS_NAME	2
+
+/* update sequence numbers protect the last two bytes of every 512 */
+#define NTFS_FIXUP_STRIDE	512
+
+/* bytes of the MFT read ahead of the scan at a time */
+#define NTFS_CHUNK	(4 * 1024 * 1024)
+
+/* record numbers are 48 bits wide, the upper 16 bits of a reference are a sequence number */
+#define NTFS_RECORD(ref) ((ref) & 0xFFFFFFFFFFFFULL)
+
+#define NTFS_ATTRIBUTES (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | \
+	FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_TEMPORARY | FILE_ATTRIBUTE_SPARSE_FILE | \
+	FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_COMPRESSED | FILE_ATTRIBUTE_OFFLINE | \
+	FILE_ATTRIBUTE_NOT_CONTENT_INDEXED | FILE_ATTRIBUTE_ENCRYPTED)
+
+/* clusters of a non resident attribute, lcn is NTFS_SPARSE for a hole */
+typedef struct _NTFS_RUN
+{
+	ULONGLONG vcn;
+	ULONGLONG lcn;
+	ULONGLONG length;
+} NTFS_RUN;
+
+#define NTFS_SPARSE ((ULONGLONG)-1)
+
+/* a file record, by record number */
+typedef struct _NTFS_NODE
+{
+	FILETIME ftCreationTime;
+	FILETIME ftLastWriteTime;
+	FILETIME ftLastAccessTime;
+	ULONGLONG size;
+	DWORD attributes;	/* 0 if the record is not in use */
+	ULONG firstLink;	/* of the folder's entries in ntfsLinks, they end at the next record's */
+} NTFS_NODE;
+
+/* a name of a file in a folder, files with hard links have several */
+typedef struct _NTFS_LINK
+{
+	ULONG record;
+	ULONG parent;
+	ULONG name;		/* offset in ntfsNames */
+	BYTE nameLen;
+} NTFS_LINK;
+
+/* an open enumeration, the range of ntfsLinks left to be returned */
+typedef struct _NTFS_CURSOR
+{
+	ULONG next;
+	ULONG end;
+} NTFS_CURSOR;
+
+/* layout of the mounted volume, set once by NtfsMount */
+static const BYTE* ntfsBase = NULL;
+static ULONGLONG ntfsSize = 0;
+static ULONG ntfsClusterSize = 0;
+static ULONGLONG ntfsClusters = 0;
+static ULONG ntfsRecordSize = 0;
+
+/*
+ * the directory tree, built from a single pass over the MFT: ntfsNodes
+ * holds every record, ntfsLinks every name grouped by folder and sorted
+ * the way NTFS sorts its indexes, and ntfsNames the characters of them all
+ */
+static NTFS_NODE* ntfsNodes = NULL;
+static ULONG ntfsRecords = 0;
+static NTFS_LINK* ntfsLinks = NULL;
+static ULONG ntfsLinkCount = 0;
+static ULONG ntfsLinkSlots = 0;
+static wchar_t* ntfsNames = NULL;
+static ULONG ntfsNamesLen = 0;
+static ULONG ntfsNamesSlots = 0;
+
+/* upper case of every UTF-16 unit, from the volume's $UpCase, NULL if it couldn't be read */
+static WORD* ntfsUpcase = NULL;
+
+/**
+* @name: NtfsFixup
+*
+* @return
+* false if the record was torn by an interrupted write
+*
+* puts back the last two bytes of every 512, which were replaced by the
+* update sequence number when the record was written
+*/
+static BOOL NtfsFixup(BYTE* record)
+{
+	UINT usaOffset = ImageWord(record + 4);
+	UINT usaCount = ImageWord(record + 6);
+	UINT i = 0;
+
+	if (usaCount != ntfsRecordSize / NTFS_FIXUP_STRIDE + 1 || usaOffset + 2 * usaCount > ntfsRecordSize)
+		return FALSE;
+
+	for (i = 1; i < usaCount; ++i)
+	{
+		BYTE* end = record + i * NTFS_FIXUP_STRIDE - 2;
+
+		if (memcmp(end, record + usaOffset, 2) != 0)
+			return FALSE;
+
+		memcpy(end, record + usaOffset + 2 * i, 2);
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: NtfsAttribute
+*
+* @param offset
+* of the attribute before the one wanted, 0 for the first one
+*
+* @return
+* offset of the next attribute of record, 0 if there are no more
+*/
+static ULONG NtfsAttribute(const BYTE* record, ULONG offset)
+{
+	ULONG used = ImageDword(record + 24);
+
+	if (used > ntfsRecordSize)
+		used = ntfsRecordSize;
+
+	offset = (offset == 0) ? ImageWord(record + 20) : offset + ImageDword(record + offset + 4);
+
+	/* every attribute needs room for its header, and must stay inside the record */
+	if (offset + 16 > used || ImageDword(record + offset) == NTFS_END ||
+		ImageDword(record + offset + 4) < 16 || ImageDword(record + offset + 4) > used - offset)
+		return 0;
+
+	return offset;
+}
+
+/**
+* @name: NtfsValue
+*
+* @param valueLen
+* receives the length of the value
+*
+* @return
+* the value of a resident attribute, NULL if attr is not resident
+*/
+static const BYTE* NtfsValue(const BYTE* attr, ULONG* valueLen)
+{
+	ULONG len = ImageDword(attr + 4);
+	ULONG offset = 0;
+
+	if (attr[8] != 0 || len < 24)
+		return NULL;
+
+	offset = ImageWord(attr + 20);
+	*valueLen = ImageDword(attr + 16);
+
+	if (offset > len || *valueLen > len - offset)
+		return NULL;
+
+	return attr + offset;
+}
+
+/**
+* @name: NtfsFind
+*
+* @return
+* offset of the first unnamed attribute of type in record, 0 if there is none
+*/
+static ULONG NtfsFind(const BYTE* record, DWORD type)
+{
+	ULONG offset = 0;
+
+	while ((offset = NtfsAttribute(record, offset)) != 0)
+	{
+		if (ImageDword(record + offset) == type && record[offset + 9] == 0)
+			return offset;
+	}
+
+	return 0;
+}
+
+/**
+* @name: NtfsRuns
+*
+* @param count
+* receives the number of runs
+*
+* @return
+* the clusters of the non resident attribute attr, to be freed by the
+* caller, or NULL if attr is resident or its mapping pairs are damaged
+*/
+static NTFS_RUN* NtfsRuns(const BYTE* attr, UINT* count)
+{
+	ULONG len = ImageDword(attr + 4);
+	ULONG offset = 0;
+	ULONGLONG vcn = 0;
+	LONGLONG lcn = 0;
+	NTFS_RUN* runs = NULL;
+	UINT slots = 0;
+
+	*count = 0;
+
+	if (attr[8] != 1 || len < 64)
+		return NULL;
+
+	vcn = ImageQword(attr + 16);
+	offset = ImageWord(attr + 32);
+
+	/* every run is a header byte giving the size of its length and of its offset, then both */
+	while (offset < len && attr[offset] != 0)
+	{
+		UINT lengthSize = attr[offset] & 0x0F;
+		UINT lcnSize = attr[offset] >> 4;
+		ULONGLONG length = 0;
+		LONGLONG delta = 0;
+		UINT i = 0;
+
+		if (lengthSize == 0 || lengthSize > 8 || lcnSize > 8 || offset + 1 + lengthSize + lcnSize > len)
+			break;
+
+		for (i = 0; i < lengthSize; ++i)
+			length |= (ULONGLONG)attr[offset + 1 + i] << (8 * i);
+
+		/* the offset from the previous run is signed */
+		for (i = 0; i < lcnSize; ++i)
+			delta |= (LONGLONG)attr[offset + 1 + lengthSize + i] << (8 * i);
+
+		if (lcnSize > 0 && lcnSize < 8 && (attr[offset + lengthSize + lcnSize] & 0x80))
+			delta -= (LONGLONG)1 << (8 * lcnSize);
+
+		lcn += delta;
+
+		if (lcnSize > 0 && (lcn < 0 || (ULONGLONG)lcn > ntfsClusters || length > ntfsClusters - lcn))
+			break;
+
+		if (*count == slots)
+		{
+			slots = slots ? 2 * slots : 8;
+			runs = (NTFS_RUN*)StatsRealloc(runs, slots * sizeof(NTFS_RUN));
+
+			if (runs == NULL)
+				exit(-1);
+		}
+
+		runs[*count].vcn = vcn;
+		runs[*count].lcn = (lcnSize == 0) ? NTFS_SPARSE : (ULONGLONG)lcn;
+		runs[*count].length = length;
+		++*count;
+
+		vcn += length;
+		offset += 1 + lengthSize + lcnSize;
+	}
+
+	if (offset >= len || attr[offset] != 0)
+	{
+		free(runs);
+		*count = 0;
+		return NULL;
+	}
+
+	return runs;
+}
+
+/**
+* @name: NtfsRead
+*
+* @param hint
+* run to start looking at, updated to the run the read ended in
+*
+* @return
+* false if part of the len bytes from pos on lie outside runs or the image
+*
+* copies the len bytes at pos of the attribute with the clusters runs to buf
+*/
+static BOOL NtfsRead(const NTFS_RUN* runs, UINT count, UINT* hint, ULONGLONG pos, BYTE* buf, ULONG len)
+{
+	UINT i = *hint;
+
+	while (len > 0)
+	{
+		ULONGLONG vcn = pos / ntfsClusterSize;
+		ULONGLONG offset = 0;
+		ULONGLONG n = 0;
+
+		if (i >= count || vcn < runs[i].vcn)
+			i = 0;
+
+		while (i < count && vcn >= runs[i].vcn + runs[i].length)
+			++i;
+
+		if (i == count || vcn < runs[i].vcn)
+			return FALSE;
+
+		offset = pos - runs[i].vcn * ntfsClusterSize;
+		n = runs[i].length * ntfsClusterSize - offset;
+
+		if (n > len)
+			n = len;
+
+		if (runs[i].lcn == NTFS_SPARSE)
+		{
+			ZeroMemory(buf, (SIZE_T)n);
+		}
+		else
+		{
+			offset += runs[i].lcn * ntfsClusterSize;
+
+			if (offset + n > ntfsSize)
+				return FALSE;
+
+			memcpy(buf, ntfsBase + offset, (SIZE_T)n);
+		}
+
+		buf += n;
+		pos += n;
+		len -= (ULONG)n;
+	}
+
+	*hint = i;
+	return TRUE;
+}
+
+/**
+* @name: NtfsPrefetch
+*
+* @return
+* void
+*
+* asks for the len bytes from pos on of the attribute with the clusters
+* runs to be read in, so that the scan finds them in memory. They are read
+* in a few large requests rather than a page at a time as they are touched
+*/
+static VOID NtfsPrefetch(const NTFS_RUN* runs, UINT count, ULONGLONG pos, ULONGLONG len)
+{
+	WIN32_MEMORY_RANGE_ENTRY ranges[16];
+	ULONG n = 0;
+	UINT i = 0;
+
+	for (i = 0; i < count && n < _countof(ranges); ++i)
+	{
+		ULONGLONG start = runs[i].vcn * ntfsClusterSize;
+		ULONGLONG end = start + runs[i].length * ntfsClusterSize;
+		ULONGLONG offset = 0;
+
+		if (end <= pos || start >= pos + len || runs[i].lcn == NTFS_SPARSE)
+			continue;
+
+		if (start < pos)
+			start = pos;
+
+		if (end > pos + len)
+			end = pos + len;
+
+		offset = runs[i].lcn * ntfsClusterSize + (start - runs[i].vcn * ntfsClusterSize);
+
+		if (offset >= ntfsSize)
+			continue;
+
+		if (end - start > ntfsSize - offset)
+			end = start + ntfsSize - offset;
+
+		ranges[n].VirtualAddress = (PVOID)(ntfsBase + offset);
+		ranges[n].NumberOfBytes = (SIZE_T)(end - start);
+		++n;
+	}
+
+	if (n > 0)
+		PrefetchVirtualMemory(GetCurrentProcess(), n, ranges, 0);
+}
+
+/**
+* @name: NtfsAddLink
+*
+* @return
+* void
+*
+* adds the name of record in folder parent, the links are grouped by
+* folder once the whole MFT has been read, see NtfsIndex
+*/
+static VOID NtfsAddLink(ULONG record, ULONGLONG parent, const BYTE* name, UINT nameLen)
+{
+	UINT i = 0;
+
+	/* the metadata files, and the root, which is its own parent */
+	if (record < NTFS_RESERVED || parent >= ntfsRecords || nameLen == 0)
+		return;
+
+	if (ntfsLinkCount == ntfsLinkSlots)
+	{
+		ntfsLinkSlots = ntfsLinkSlots ? 2 * ntfsLinkSlots : 4096;
+		ntfsLinks = (NTFS_LINK*)StatsRealloc(ntfsLinks, ntfsLinkSlots * sizeof(NTFS_LINK));
+
+		if (ntfsLinks == NULL)
+			exit(-1);
+	}
+
+	if (ntfsNamesLen + nameLen > ntfsNamesSlots)
+	{
+		ntfsNamesSlots = ntfsNamesSlots ? 2 * ntfsNamesSlots : 65536;
+		ntfsNames = (wchar_t*)StatsRealloc(ntfsNames, ntfsNamesSlots * sizeof(wchar_t));
+
+		if (ntfsNames == NULL)
+			exit(-1);
+	}
+
+	for (i = 0; i < nameLen; ++i)
+		ntfsNames[ntfsNamesLen + i] = (wchar_t)ImageWord(name + 2 * i);
+
+	ntfsLinks[ntfsLinkCount].record = record;
+	ntfsLinks[ntfsLinkCount].parent = (ULONG)parent;
+	ntfsLinks[ntfsLinkCount].name = ntfsNamesLen;
+	ntfsLinks[ntfsLinkCount].nameLen = (BYTE)nameLen;
+	++ntfsLinkCount;
+	ntfsNamesLen += nameLen;
+}
+
+/**
+* @name: NtfsRecord
+*
+* @param number
+* of record, which has been fixed up already
+*
+* @return
+* void
+*
+* takes the names, times, attributes and size of a file from its record.
+* An extension record, which holds the attributes that didn't fit in the
+* record of the file itself, only adds what it holds to that file
+*/
+static VOID NtfsRecord(const BYTE* record, ULONG number)
+{
+	ULONGLONG base = NTFS_RECORD(ImageQword(record + 32));
+	ULONG owner = (base != 0) ? (ULONG)base : number;
+	NTFS_NODE* node = NULL;
+	ULONGLONG nameSize = 0;
+	ULONGLONG dataSize = 0;
+	BOOL bData = FALSE;
+	DWORD attributes = 0;
+	ULONG offset = 0;
+
+	if (base >= ntfsRecords)
+		return;
+
+	node = &ntfsNodes[owner];
+
+	while ((offset = NtfsAttribute(record, offset)) != 0)
+	{
+		const BYTE* attr = record + offset;
+		const BYTE* value = NULL;
+		ULONG valueLen = 0;
+
+		switch (ImageDword(attr))
+		{
+		case NTFS_STANDARD_INFORMATION:
+			if (base == 0 && (value = NtfsValue(attr, &valueLen)) != NULL && valueLen >= 36)
+			{
+				memcpy(&node->ftCreationTime, value, sizeof(FILETIME));
+				memcpy(&node->ftLastWriteTime, value + 8, sizeof(FILETIME));
+				memcpy(&node->ftLastAccessTime, value + 24, sizeof(FILETIME));
+				attributes = ImageDword(value + 32) & NTFS_ATTRIBUTES;
+			}
+			break;
+
+		case NTFS_FILE_NAME:
+			/* a file with a long name has a short one as well, which Windows never lists */
+			if ((value = NtfsValue(attr, &valueLen)) != NULL && valueLen >= 66 &&
+				66 + 2 * (ULONG)value[64] <= valueLen && value[65] != NTFS_DOS_NAME)
+			{
+				NtfsAddLink(owner, NTFS_RECORD(ImageQword(value)), value + 66, value[64]);
+				nameSize = ImageQword(value + 48);
+			}
+			break;
+
+		case NTFS_DATA:
+			/* the size of a file is that of its unnamed stream, as kept in its first extent */
+			if (attr[9] != 0)
+				break;
+
+			if ((value = NtfsValue(attr, &valueLen)) != NULL)
+			{
+				dataSize = valueLen;
+				bData = TRUE;
+			}
+			else if (attr[8] == 1 && ImageDword(attr + 4) >= 56 && ImageQword(attr + 16) == 0)
+			{
+				dataSize = ImageQword(attr + 48);
+				bData = TRUE;
+			}
+			break;
+		}
+	}
+
+	if (base != 0)
+	{
+		if (bData)
+			node->size = dataSize;
+
+		return;
+	}
+
+	if (ImageWord(record + 22) & NTFS_DIRECTORY)
+	{
+		attributes |= FILE_ATTRIBUTE_DIRECTORY;
+		node->size = 0;
+	}
+	else if (bData)
+	{
+		node->size = dataSize;
+	}
+	else if (node->size == 0)
+	{
+		/* the stream is in an extension record, the copy in the name is good enough until it turns up */
+		node->size = nameSize;
+	}
+
+	node->attributes = (attributes != 0) ? attributes : FILE_ATTRIBUTE_NORMAL;
+}
+
+/**
+* @name: NtfsCompareLinks
+*
+* @return
+* how the names of a and b compare in a folder index: upper cased with
+* the volume's own table first, then as they are, so names differing only
+* in case still come in a fixed order
+*/
+static int NtfsCompareLinks(const void* a, const void* b)
+{
+	const NTFS_LINK* linkA = (const NTFS_LINK*)a;
+	const NTFS_LINK* linkB = (const NTFS_LINK*)b;
+	const wchar_t* nameA = ntfsNames + linkA->name;
+	const wchar_t* nameB = ntfsNames + linkB->name;
+	UINT len = (linkA->nameLen < linkB->nameLen) ? linkA->nameLen : linkB->nameLen;
+	UINT i = 0;
+
+	for (i = 0; i < len; ++i)
+	{
+		wchar_t upperA = ntfsUpcase ? (wchar_t)ntfsUpcase[(WORD)nameA[i]] : (wchar_t)towupper(nameA[i]);
+		wchar_t upperB = ntfsUpcase ? (wchar_t)ntfsUpcase[(WORD)nameB[i]] : (wchar_t)towupper(nameB[i]);
+
+		if (upperA != upperB)
+			return (upperA < upperB) ? -1 : 1;
+	}
+
+	if (linkA->nameLen != linkB->nameLen)
+		return (linkA->nameLen < linkB->nameLen) ? -1 : 1;
+
+	for (i = 0; i < len; ++i)
+	{
+		if (nameA[i] != nameB[i])
+			return (nameA[i] < nameB[i]) ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/**
+* @name: NtfsIndex
+*
+* @return
+* void
+*
+* groups the links by folder, dropping those of records no longer in use
+* and of parents that aren't folders, and sorts every folder's entries
+*/
+static VOID NtfsIndex(VOID)
+{
+	NTFS_LINK* links = NULL;
+	ULONG count = 0;
+	ULONG start = 0;
+	ULONG i = 0;
+
+	/* count the entries of every folder, then turn the counts into where each folder starts */
+	for (i = 0; i < ntfsLinkCount; ++i)
+	{
+		const NTFS_LINK* link = &ntfsLinks[i];
+
+		if (ntfsNodes[link->record].attributes != 0 &&
+			(ntfsNodes[link->parent].attributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			++ntfsNodes[link->parent].firstLink;
+			++count;
+		}
+	}
+
+	for (i = 0; i <= ntfsRecords; ++i)
+	{
+		ULONG n = ntfsNodes[i].firstLink;
+
+		ntfsNodes[i].firstLink = start;
+		start += n;
+	}
+
+	links = (NTFS_LINK*)StatsMalloc((count ? count : 1) * sizeof(NTFS_LINK));
+
+	if (links == NULL)
+		exit(-1);
+
+	/* every folder's start moves on as its entries are placed, ending up at the next folder's */
+	for (i = 0; i < ntfsLinkCount; ++i)
+	{
+		const NTFS_LINK* link = &ntfsLinks[i];
+
+		if (ntfsNodes[link->record].attributes != 0 &&
+			(ntfsNodes[link->parent].attributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			links[ntfsNodes[link->parent].firstLink++] = *link;
+		}
+	}
+
+	for (i = ntfsRecords; i > 0; --i)
+		ntfsNodes[i].firstLink = ntfsNodes[i - 1].firstLink;
+
+	ntfsNodes[0].firstLink = 0;
+
+	free(ntfsLinks);
+	ntfsLinks = links;
+	ntfsLinkCount = count;
+	ntfsLinkSlots = count;
+
+	for (i = 0; i < ntfsRecords; ++i)
+	{
+		ULONG n = ntfsNodes[i + 1].firstLink - ntfsNodes[i].firstLink;
+
+		if (n > 1)
+			qsort(ntfsLinks + ntfsNodes[i].firstLink, n, sizeof(NTFS_LINK), NtfsCompareLinks);
+	}
+}
+
+/**
+* @name: NtfsLoad
+*
+* @param number
+* of the record wanted
+*
+* @param record
+* receives the record, ntfsRecordSize bytes
+*
+* @return
+* false if the record is not in use or can't be read
+*/
+static BOOL NtfsLoad(const NTFS_RUN* runs, UINT count, ULONG number, BYTE* record)
+{
+	UINT hint = 0;
+
+	return NtfsRead(runs, count, &hint, (ULONGLONG)number * ntfsRecordSize, record, ntfsRecordSize) &&
+		memcmp(record, "FILE", 4) == 0 && (ImageWord(record + 22) & NTFS_IN_USE) && NtfsFixup(record);
+}
+
+/**
+* @name: NtfsLoadUpcase
+*
+* @return
+* void
+*
+* reads the table names are upper cased with when they are sorted, which
+* the volume keeps as it was when it was formatted, so that folders are
+* listed in the order Windows would list them on that volume
+*/
+static VOID NtfsLoadUpcase(const NTFS_RUN* mftRuns, UINT mftCount, BYTE* record)
+{
+	NTFS_RUN* runs = NULL;
+	UINT count = 0;
+	UINT hint = 0;
+	ULONG offset = 0;
+
+	if (!NtfsLoad(mftRuns, mftCount, NTFS_UPCASE, record) || (offset = NtfsFind(record, NTFS_DATA)) == 0 ||
+		(runs = NtfsRuns(record + offset, &count)) == NULL)
+		return;
+
+	ntfsUpcase = (WORD*)StatsMalloc(65536 * sizeof(WORD));
+
+	if (ntfsUpcase == NULL)
+		exit(-1);
+
+	if (ImageQword(record + offset + 48) < 65536 * sizeof(WORD) ||
+		!NtfsRead(runs, count, &hint, 0, (BYTE*)ntfsUpcase, 65536 * sizeof(WORD)))
+	{
+		free(ntfsUpcase);
+		ntfsUpcase = NULL;
+	}
+
+	free(runs);
+}
+
+/**
+* @name: NtfsMount
+*
+* recognises NTFS volumes, see IMAGE_FS
+*
+* the whole directory tree is read here, in a single pass over the MFT in
+* the order it lies on the volume: a listing is then a walk through memory
+* instead of a search of every folder's index, a page at a time
+*/
+static BOOL NtfsMount(const BYTE* base, ULONGLONG size, wchar_t* label, size_t labelLen, DWORD* serial, IMAGE_DIR* root)
+{
+	ULONGLONG span = TraceBegin();
+	NTFS_RUN* runs = NULL;
+	BYTE* record = NULL;
+	ULONGLONG mftSize = 0;
+	ULONG bytesPerSector = 0;
+	ULONG sectorsPerCluster = 0;
+	ULONG offset = 0;
+	ULONG value = 0;
+	UINT count = 0;
+	UINT hint = 0;
+	ULONG i = 0;
+	const BYTE* name = NULL;
+
+	if (size < 512 || memcmp(base + 3, "NTFS    ", 8) != 0 || base[510] != 0x55 || base[511] != 0xAA)
+		return FALSE;
+
+	bytesPerSector = ImageWord(base + 11);
+	sectorsPerCluster = base[13];
+
+	/* large clusters are given as a negative power of two */
+	if (sectorsPerCluster > 0x80)
+		sectorsPerCluster = (sectorsPerCluster < 0xF0) ? 0 : 1UL << (256 - sectorsPerCluster);
+
+	if (bytesPerSector < 512 || bytesPerSector > 4096 || (bytesPerSector & (bytesPerSector - 1)) ||
+		sectorsPerCluster == 0 || (sectorsPerCluster & (sectorsPerCluster - 1)) ||
+		(ULONGLONG)bytesPerSector * sectorsPerCluster > 0x200000)
+		return FALSE;
+
+	ntfsBase = base;
+	ntfsSize = size;
+	ntfsClusterSize = bytesPerSector * sectorsPerCluster;
+	ntfsClusters = size / ntfsClusterSize;
+
+	/* so is the size of a file record, if it is smaller than a cluster */
+	value = base[64];
+	ntfsRecordSize = (value > 0x80) ? ((value >= 0xF4) ? 1UL << (256 - value) : 0) : value * ntfsClusterSize;
+
+	if (ntfsRecordSize < 1024 || ntfsRecordSize > 4096 || (ntfsRecordSize & (ntfsRecordSize - 1)))
+		return FALSE;
+
+	*serial = ImageDword(base + 72);
+	label[0] = L'\0';
+
+	record = (BYTE*)StatsMalloc(ntfsRecordSize);
+
+	if (record == NULL)
+		exit(-1);
+
+	/* the MFT describes itself in its first record, which is always where the boot sector says */
+	if (ImageQword(base + 48) >= ntfsClusters ||
+		ImageQword(base + 48) * ntfsClusterSize + ntfsRecordSize > size)
+	{
+		free(record);
+		return FALSE;
+	}
+
+	memcpy(record, base + ImageQword(base + 48) * ntfsClusterSize, ntfsRecordSize);
+
+	if (memcmp(record, "FILE", 4) != 0 || !NtfsFixup(record) || (offset = NtfsFind(record, NTFS_DATA)) == 0 ||
+		(runs = NtfsRuns(record + offset, &count)) == NULL)
+	{
+		free(record);
+		return FALSE;
+	}
+
+	mftSize = ImageQword(record + offset + 48);
+	/* a damaged size must not cost more memory than the image could hold records */
+	if (mftSize > size)
+		mftSize = size;
+
+	ntfsRecords = (mftSize / ntfsRecordSize < 0xFFFFFFFF) ? (ULONG)(mftSize / ntfsRecordSize) : 0xFFFFFFFE;
+
+	if (ntfsRecords <= NTFS_ROOT)
+	{
+		free(runs);
+		free(record);
+		return FALSE;
+	}
+
+	/* one more, where the last folder's entries end */
+	ntfsNodes = (NTFS_NODE*)StatsCalloc((SIZE_T)ntfsRecords + 1, sizeof(NTFS_NODE));
+
+	if (ntfsNodes == NULL)
+		exit(-1);
+
+	for (i = 0; i < ntfsRecords; ++i)
+	{
+		ULONGLONG pos = (ULONGLONG)i * ntfsRecordSize;
+
+		/* keep the next chunk coming in while this one is worked through */
+		if ((pos & (NTFS_CHUNK - 1)) == 0)
+		{
+			if (i == 0)
+				NtfsPrefetch(runs, count, 0, NTFS_CHUNK);
+
+			NtfsPrefetch(runs, count, pos + NTFS_CHUNK, NTFS_CHUNK);
+		}
+
+		if (!NtfsRead(runs, count, &hint, pos, record, ntfsRecordSize))
+			break;
+
+		if (memcmp(record, "FILE", 4) == 0 && (ImageWord(record + 22) & NTFS_IN_USE) && NtfsFixup(record))
+			NtfsRecord(record, i);
+	}
+
+	TraceEnd("image", "mft_scan", span, NULL, "records", i);
+	span = TraceBegin();
+
+	if (!(ntfsNodes[NTFS_ROOT].attributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		free(ntfsNodes);
+		free(ntfsLinks);
+		free(ntfsNames);
+		ntfsNodes = NULL;
+		ntfsLinks = NULL;
+		ntfsNames = NULL;
+		ntfsLinkCount = ntfsLinkSlots = 0;
+		ntfsNamesLen = ntfsNamesSlots = 0;
+		free(runs);
+		free(record);
+		return FALSE;
+	}
+
+	NtfsLoadUpcase(runs, count, record);
+	NtfsIndex();
+	TraceEnd("image", "mft_index", span, NULL, "entries", ntfsLinkCount);
+
+	/* the label is an attribute of $Volume */
+	if (NtfsLoad(runs, count, NTFS_VOLUME, record) && (offset = NtfsFind(record, NTFS_VOLUME_NAME)) != 0 &&
+		(name = NtfsValue(record + offset, &value)) != NULL)
+	{
+		for (i = 0; i < value / 2 && i < labelLen - 1; ++i)
+			label[i] = (wchar_t)ImageWord(name + 2 * i);
+
+		label[i] = L'\0';
+	}
+
+	free(runs);
+	free(record);
+
+	ZeroMemory(root, sizeof(*root));
+	root->first = NTFS_ROOT;
+	return TRUE;
+}
+
+/**
+* @name: NtfsDirOpen
+*
+* starts enumerating a folder, see IMAGE_FS
+*/
+static VOID* NtfsDirOpen(const IMAGE_DIR* dir)
+{
+	NTFS_CURSOR* cursor = (NTFS_CURSOR*)StatsMalloc(sizeof(NTFS_CURSOR));
+
+	if (cursor == NULL)
+		exit(-1);
+
+	cursor->next = 0;
+	cursor->end = 0;
+
+	if (dir->first < ntfsRecords)
+	{
+		cursor->next = ntfsNodes[dir->first].firstLink;
+		cursor->end = ntfsNodes[dir->first + 1].firstLink;
+	}
+
+	return cursor;
+}
+
+/**
+* @name: NtfsDirNext
+*
+* returns the next entry of a folder, see IMAGE_FS
+*/
+static BOOL NtfsDirNext(VOID* pCursor, WIN32_FIND_DATA* data, IMAGE_DIR* dir)
+{
+	NTFS_CURSOR* cursor = (NTFS_CURSOR*)pCursor;
+	const NTFS_LINK* link = NULL;
+	const NTFS_NODE* node = NULL;
+
+	if (cursor->next >= cursor->end)
+		return FALSE;
+
+	link = &ntfsLinks[cursor->next++];
+	node = &ntfsNodes[link->record];
+
+	ZeroMemory(data, sizeof(*data));
+	data->dwFileAttributes = node->attributes;
+	data->ftCreationTime = node->ftCreationTime;
+	data->ftLastWriteTime = node->ftLastWriteTime;
+	data->ftLastAccessTime = node->ftLastAccessTime;
+	data->nFileSizeHigh = (DWORD)(node->size >> 32);
+	data->nFileSizeLow = (DWORD)node->size;
+	memcpy(data->cFileName, ntfsNames + link->name, link->nameLen * sizeof(wchar_t));
+	data->cFileName[link->nameLen] = L'\0';
+
+	if (node->attributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		ZeroMemory(dir, sizeof(*dir));
+		dir->first = link->record;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: NtfsDirClose
+*
+* ends an enumeration, see IMAGE_FS
+*/
+static VOID NtfsDirClose(VOID* cursor)
+{
+	free(cursor);
+}
+
+const IMAGE_FS ntfsFs = { NtfsMount, NtfsDirOpen, NtfsDirNext, NtfsDirClose };
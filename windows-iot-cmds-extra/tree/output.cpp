@@ -0,0 +1,466 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Buffered stdout writer used by tree.com
+*/
+
+#include <io.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <strsafe.h>
+
+#include "output.h"
+#include "stats.h"
+#include "trace.h"
+#include "utf8.h"
+
+/* size in bytes of the buffer collecting output before it is written */
+#define OUTPUT_BUF_MAX (64 * 1024)
+
+/* UTF-16 code units transcoded at a time, so a single step always fits the buffer */
+#define OUTPUT_STEP (OUTPUT_BUF_MAX / 3)
+
+/* console output is kept as UTF-16, this many code units at a time */
+#define OUTPUT_BUF_MAX_W (OUTPUT_BUF_MAX / sizeof(wchar_t))
+
+/* code units per WriteConsoleW call, older consoles fail on much larger writes. The tests set a smaller one */
+#ifndef CONSOLE_WRITE_MAX
+#define CONSOLE_WRITE_MAX (16 * 1024)
+#endif
+
+/* handle output is written to, either a console or a file or pipe */
+static HANDLE hOutput = INVALID_HANDLE_VALUE;
+
+/* if this flag is true, stdout is a console and output is written to it as UTF-16 */
+static BOOL bConsole = FALSE;
+
+/* if this flag is true, writing failed (e.g. the reading end of a pipe went away) */
+static BOOL bBroken = FALSE;
+
+/* a block of output waiting to be written */
+typedef struct _OUTPUT_CHUNK
+{
+	char* data;	/* OUTPUT_BUF_MAX bytes */
+	size_t len;	/* bytes, or UTF-16 code units when writing to a console */
+} OUTPUT_CHUNK;
+
+/*
+ * ring of chunks shared with the writer thread: the traversal fills chunk
+ * chunkHead, the writer thread writes chunks chunkTail up to chunkHead
+ */
+static OUTPUT_CHUNK* arrChunk = NULL;
+static UINT chunkCount = 0;
+static ULONGLONG chunkHead = 0;
+static ULONGLONG chunkTail = 0;
+static SRWLOCK chunkLock = SRWLOCK_INIT;
+static CONDITION_VARIABLE chunkFilled = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE chunkDrained = CONDITION_VARIABLE_INIT;
+
+/* NULL if output is written synchronously */
+static HANDLE hWriter = NULL;
+
+/* the chunk being filled, viewed as bytes or as UTF-16 */
+static char* outBuf = NULL;
+static wchar_t* outBufW = NULL;
+static size_t outLen = 0;
+
+/**
+* @name: WriteChunk
+*
+* @param chunk
+* block of output to be written to stdout
+*
+* @return
+* void
+*/
+static VOID WriteChunk(OUTPUT_CHUNK* chunk)
+{
+	ULONGLONG span = TraceBegin();
+	size_t done = 0;
+
+	while (!bBroken && done < chunk->len)
+	{
+		ULONGLONG start = StatsBegin();
+		DWORD written = 0;
+
+		if (bConsole)
+		{
+			/* the console takes UTF-16 as is, sparing a round trip through UTF-8 */
+			DWORD n = (DWORD)min(chunk->len - done, CONSOLE_WRITE_MAX);
+			const wchar_t* text = (const wchar_t*)chunk->data + done;
+
+			/* a surrogate pair split between two calls would show as two replacement characters */
+			if (n > 1 && done + n < chunk->len && (text[n - 1] & 0xFC00) == 0xD800)
+				--n;
+
+			if (!WriteConsoleW(hOutput, text, n, &written, NULL))
+				bBroken = TRUE;
+		}
+		else
+		{
+			if (!WriteFile(hOutput, chunk->data + done, (DWORD)(chunk->len - done), &written, NULL))
+				bBroken = TRUE;
+		}
+
+		StatsEnd(STAT_OUTPUT_WRITE, start);
+		StatsCount(STAT_OUTPUT_BYTES, bConsole ? written * sizeof(wchar_t) : written);
+		done += written;
+	}
+
+	TraceEnd("output", "write", span, NULL, "bytes", bConsole ? done * sizeof(wchar_t) : done);
+}
+
+/**
+* @name: WriterThread
+*
+* @return
+* never returns, the thread ends with the process
+*
+* writes chunks as the traversal hands them over, so enumerating never
+* waits on a slow console or pipe until the whole ring is full
+*/
+static DWORD WINAPI WriterThread(LPVOID param)
+{
+	UNREFERENCED_PARAMETER(param);
+
+	TraceThreadName("writer");
+
+	for (;;)
+	{
+		OUTPUT_CHUNK* chunk = NULL;
+
+		AcquireSRWLockExclusive(&chunkLock);
+		while (chunkTail == chunkHead)
+			SleepConditionVariableSRW(&chunkFilled, &chunkLock, INFINITE, 0);
+
+		chunk = &arrChunk[chunkTail % chunkCount];
+		ReleaseSRWLockExclusive(&chunkLock);
+
+		WriteChunk(chunk);
+
+		AcquireSRWLockExclusive(&chunkLock);
+		++chunkTail;
+		WakeConditionVariable(&chunkDrained);
+		ReleaseSRWLockExclusive(&chunkLock);
+	}
+}
+
+/**
+* @name: SelectChunk
+*
+* @return
+* void
+*
+* makes chunk chunkHead the one OutputWrite fills
+*/
+static VOID SelectChunk(VOID)
+{
+	outBuf = arrChunk[chunkHead % chunkCount].data;
+	outBufW = (wchar_t*)outBuf;
+	outLen = 0;
+}
+
+/**
+* @name: SubmitChunk
+*
+* @return
+* void
+*
+* hands the chunk being filled to the writer thread, blocking while all
+* chunks are still waiting to be written, or writes it right away if
+* there is no writer thread
+*/
+static VOID SubmitChunk(VOID)
+{
+	ULONGLONG start = 0;
+	ULONGLONG span = 0;
+
+	if (outLen == 0)
+		return;
+
+	arrChunk[chunkHead % chunkCount].len = outLen;
+	start = StatsBegin();
+	span = TraceBegin();
+
+	if (hWriter == NULL)
+	{
+		WriteChunk(&arrChunk[0]);
+		StatsEnd(STAT_OUTPUT_WAIT, start);
+		TraceEnd("output", "submit", span, NULL, NULL, 0);
+		outLen = 0;
+		return;
+	}
+
+	AcquireSRWLockExclusive(&chunkLock);
+	++chunkHead;
+	WakeConditionVariable(&chunkFilled);
+
+	while (chunkHead - chunkTail == chunkCount)
+		SleepConditionVariableSRW(&chunkDrained, &chunkLock, INFINITE, 0);
+
+	ReleaseSRWLockExclusive(&chunkLock);
+	StatsEnd(STAT_OUTPUT_WAIT, start);
+	TraceEnd("output", "submit", span, NULL, NULL, 0);
+
+	SelectChunk();
+}
+
+/**
+* @name: OutputInit
+*
+* @param queueSize
+* bytes of output that may wait for the writer thread before the traversal
+* is held up, 0 writes synchronously
+*
+* @return
+* void
+*
+* must be called before anything is written to stdout. Redirected output is
+* transcoded to UTF-8 here and written with WriteFile, while a console gets
+* UTF-16 straight from WriteConsoleW
+*/
+VOID OutputInit(size_t queueSize)
+{
+	HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD mode = 0;
+	UINT i = 0;
+
+	/* NUL is a character device too, but only a real console has a console mode */
+	bConsole = GetFileType(hStdout) == FILE_TYPE_CHAR && GetConsoleMode(hStdout, &mode);
+	hOutput = hStdout;
+
+	if (!bConsole)
+		_setmode(_fileno(stdout), _O_BINARY);
+
+	/* double buffering is the least that lets the traversal run ahead */
+	chunkCount = (UINT)(queueSize / OUTPUT_BUF_MAX);
+	if (queueSize > 0 && chunkCount < 2)
+		chunkCount = 2;
+	else if (chunkCount == 0)
+		chunkCount = 1;
+
+	arrChunk = (OUTPUT_CHUNK*)StatsCalloc(chunkCount, sizeof(OUTPUT_CHUNK));
+	if (arrChunk == NULL)
+		exit(-1);
+
+	for (i = 0; i < chunkCount; ++i)
+	{
+		arrChunk[i].data = (char*)StatsMalloc(OUTPUT_BUF_MAX);
+		if (arrChunk[i].data == NULL)
+			exit(-1);
+	}
+
+	SelectChunk();
+
+	if (chunkCount > 1)
+	{
+		hWriter = CreateThread(NULL, 0, WriterThread, NULL, 0, NULL);
+
+		/* without a thread, fall back to writing from a single chunk */
+		if (hWriter == NULL)
+			chunkCount = 1;
+	}
+
+	atexit(OutputFlush);
+}
+
+/**
+* @name: OutputFlush
+*
+* @return
+* void
+*
+* writes out everything collected so far and waits until it has been written
+*/
+VOID OutputFlush(VOID)
+{
+	ULONGLONG start = 0;
+	ULONGLONG span = TraceBegin();
+
+	SubmitChunk();
+
+	if (hWriter == NULL)
+	{
+		TraceEnd("output", "flush", span, NULL, NULL, 0);
+		return;
+	}
+
+	start = StatsBegin();
+
+	AcquireSRWLockExclusive(&chunkLock);
+	while (chunkTail != chunkHead)
+		SleepConditionVariableSRW(&chunkDrained, &chunkLock, INFINITE, 0);
+	ReleaseSRWLockExclusive(&chunkLock);
+
+	StatsEnd(STAT_OUTPUT_WAIT, start);
+	TraceEnd("output", "flush", span, NULL, NULL, 0);
+}
+
+/*
+ * what OutputWrite needs to know about the text it is handed: UTF-16 as
+ * wchar_t, or UTF-8 as char. Everything else about writing is shared
+ */
+template <typename CHAR>
+struct OutputText;
+
+template <>
+struct OutputText<wchar_t>
+{
+	/* code units per step when transcoding for a file or pipe */
+	static const size_t fileStep = OUTPUT_STEP;
+
+	/* TRUE if str[n] is the low half of a surrogate pair, which must not be split off */
+	static BOOL Continues(const wchar_t* str, size_t n) { return (str[n] & 0xFC00) == 0xDC00; }
+
+	static size_t Length(const wchar_t* str) { return wcslen(str); }
+
+	static size_t MaxUtf8(size_t n) { return UTF8_MAX_BYTES(n); }
+
+	static size_t ToUtf8(char* dst, const wchar_t* str, size_t n) { return Utf16ToUtf8(dst, str, n); }
+
+	static size_t ToUtf16(wchar_t* dst, const wchar_t* str, size_t n)
+	{
+		memcpy(dst, str, n * sizeof(wchar_t));
+		return n;
+	}
+};
+
+template <>
+struct OutputText<char>
+{
+	static const size_t fileStep = OUTPUT_BUF_MAX;
+
+	/* TRUE if str[n] is a continuation byte of a multi byte sequence */
+	static BOOL Continues(const char* str, size_t n) { return (str[n] & 0xC0) == 0x80; }
+
+	static size_t Length(const char* str) { return strlen(str); }
+
+	static size_t MaxUtf8(size_t n) { return n; }
+
+	/* redirected output gets the bytes exactly as they are, including invalid sequences */
+	static size_t ToUtf8(char* dst, const char* str, size_t n)
+	{
+		memcpy(dst, str, n);
+		return n;
+	}
+
+	/* the console only takes UTF-16, which is never longer than the UTF-8 input */
+	static size_t ToUtf16(wchar_t* dst, const char* str, size_t n)
+	{
+		return MultiByteToWideChar(CP_UTF8, 0, str, (int)n, dst, (int)n);
+	}
+};
+
+/**
+* @name: OutputWrite
+*
+* @param str
+* text to be written, UTF-16 if CHAR is wchar_t and UTF-8 if it is char,
+* need not be NUL terminated
+*
+* @param len
+* number of code units in str
+*
+* @return
+* void
+*
+* a console gets UTF-16, anything else UTF-8. Text already in the encoding
+* stdout takes is copied without transcoding
+*/
+template <typename CHAR>
+VOID OutputWrite(const CHAR* str, size_t len)
+{
+	while (len > 0)
+	{
+		size_t n = len;
+
+		if (bConsole)
+		{
+			if (n > OUTPUT_BUF_MAX_W)
+				n = OUTPUT_BUF_MAX_W;
+		}
+		else if (n > OutputText<CHAR>::fileStep)
+		{
+			n = OutputText<CHAR>::fileStep;
+		}
+
+		/* never split a character between two steps */
+		while (n < len && n > 1 && OutputText<CHAR>::Continues(str, n))
+			--n;
+
+		if (bConsole)
+		{
+			if (outLen + n > OUTPUT_BUF_MAX_W)
+				SubmitChunk();
+
+			outLen += OutputText<CHAR>::ToUtf16(outBufW + outLen, str, n);
+		}
+		else
+		{
+			if (outLen + OutputText<CHAR>::MaxUtf8(n) > OUTPUT_BUF_MAX)
+				SubmitChunk();
+
+			outLen += OutputText<CHAR>::ToUtf8(outBuf + outLen, str, n);
+		}
+
+		str += n;
+		len -= n;
+	}
+}
+
+/**
+* @name: OutputWriteString
+*
+* @param str
+* NUL terminated text to be written, UTF-16 or UTF-8 as for OutputWrite
+*
+* @return
+* void
+*/
+template <typename CHAR>
+VOID OutputWriteString(const CHAR* str)
+{
+	OutputWrite(str, OutputText<CHAR>::Length(str));
+}
+
+template VOID OutputWrite<wchar_t>(const wchar_t* str, size_t len);
+template VOID OutputWrite<char>(const char* str, size_t len);
+template VOID OutputWriteString<wchar_t>(const wchar_t* str);
+template VOID OutputWriteString<char>(const char* str);
+
+/**
+* @name: OutputNewLine
+*
+* @return
+* void
+*
+* ends the current line with CR LF, as the CRT's text mode used to
+*/
+VOID OutputNewLine(VOID)
+{
+	OutputWrite("\r\n", 2);
+}
+
+/**
+* @name: OutputPrintf
+*
+* @param format
+* printf style format string, must not contain line breaks (use OutputNewLine)
+*
+* @return
+* void
+*/
+VOID OutputPrintf(const wchar_t* format, ...)
+{
+	wchar_t str[1024];
+	va_list args;
+
+	va_start(args, format);
+	StringCchVPrintf(str, _countof(str), format, args);
+	va_end(args);
+
+	OutputWriteString(str);
+}
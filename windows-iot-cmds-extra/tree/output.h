@@ -0,0 +1,22 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Buffered stdout writer used by tree.com
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* largest /BUF, in KB */
+#define OUTPUT_QUEUE_KB_MAX (1024 * 1024)
+
+VOID OutputInit(size_t queueSize);
+
+/* instantiated for wchar_t (UTF-16) and char (UTF-8) */
+template <typename CHAR> VOID OutputWrite(const CHAR* str, size_t len);
+template <typename CHAR> VOID OutputWriteString(const CHAR* str);
+
+VOID OutputNewLine(VOID);
+VOID OutputPrintf(const wchar_t* format, ...);
+VOID OutputFlush(VOID);
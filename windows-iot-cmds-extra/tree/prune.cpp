@@ -0,0 +1,985 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Deferred output behind tree.com's /PRUNE and /FOLD options
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <windows.h>
+
+#include "output.h"
+#include "prune.h"
+#include "stats.h"
+#include "trace.h"
+
+/* bytes of records per block of the queue */
+#define PRUNE_BLOCK_SIZE (64 * 1024)
+
+/* bytes of records kept in memory, older blocks are moved to a temporary file */
+#ifndef PRUNE_MEMORY_MAX
+#define PRUNE_MEMORY_MAX (32 * 1024 * 1024)
+#endif
+
+/*
+ * bytes of records held back for /FOLD alone. A folder whose records grow
+ * beyond this is written out as it is, so /FOLD never needs the spill file
+ */
+#define PRUNE_FOLD_MAX (PRUNE_MEMORY_MAX / 2)
+
+/* a block of the record queue, records never straddle two blocks */
+typedef struct _PRUNE_BLOCK
+{
+	struct _PRUNE_BLOCK* next;
+	struct _PRUNE_BLOCK* prev;
+	ULONGLONG start;	/* queue position of data[0] */
+	size_t used;
+	size_t read;		/* records before this offset have been written */
+	BYTE* data;		/* PRUNE_BLOCK_SIZE bytes, NULL while spilled */
+	LONGLONG spillPos;	/* offset of the records in the spill file while spilled */
+} PRUNE_BLOCK;
+
+/*
+ * queue of records in traversal order. Records are written from the head as
+ * soon as the decisions they depend on are known, the traversal appends at
+ * the tail, and a folder found to hold nothing is cut from the tail again
+ */
+static PRUNE_BLOCK* pruneHead = NULL;
+static PRUNE_BLOCK* pruneTail = NULL;
+
+/* blocks whose records are in memory */
+static UINT pruneResident = 0;
+
+/*
+ * last block moved to the spill file. Blocks are spilled oldest first, but
+ * never the head, which is being written, nor the tail, which is appended
+ * to and cut back. So the spilled blocks always follow the head, up to this one
+ */
+static PRUNE_BLOCK* pruneSpillLast = NULL;
+
+/* temporary file holding spilled blocks, created when first needed */
+static HANDLE hPruneSpill = INVALID_HANDLE_VALUE;
+
+/* blocks in the spill file, and the bytes it holds. It is reused from the start once empty */
+static UINT pruneSpilled = 0;
+static LONGLONG pruneSpillEnd = 0;
+
+/* if this flag is true, no spill file could be written and all blocks stay in memory */
+static BOOL bPruneNoSpill = FALSE;
+
+static PRUNE_RENDER pruneRender = NULL;
+
+/* if this flag is true, records wait for connectors too, not just for visibility */
+static BOOL bPruneConnectors = FALSE;
+
+/* if this flag is true, records wait until no folder around them may still be folded */
+static BOOL bPruneFold = FALSE;
+
+/* the folder being read, the deepest one opened and not yet closed */
+static PRUNE_NODE* pruneCurrent = NULL;
+
+/* number given to the next folder opened */
+static ULONGLONG pruneSeq = 0;
+
+/*
+ * hasVisibleSub of the folders whose entries were written last, by depth,
+ * for the records after an entry once its node has been freed
+ */
+static PRUNE_STATE* pruneSubState = NULL;
+static UINT pruneSubStateSlots = 0;
+
+/**
+* @name: PruneInit
+*
+* @param render
+* called for every record that is to be written, in traversal order
+*
+* @param bConnectors
+* true if records also depend on which sub folder is the last visible one
+* and on whether a folder has visible sub folders, as tree output does
+*
+* @param bFold
+* true if the contents of a folder may be replaced by PruneFold until it is closed
+*
+* @return
+* void
+*/
+VOID PruneInit(PRUNE_RENDER render, BOOL bConnectors, BOOL bFold)
+{
+	pruneRender = render;
+	bPruneConnectors = bConnectors;
+	bPruneFold = bFold;
+}
+
+/**
+* @name: PruneAllocBlock
+*
+* @return
+* an empty block appended to the queue
+*/
+static PRUNE_BLOCK* PruneAllocBlock(VOID)
+{
+	PRUNE_BLOCK* block = (PRUNE_BLOCK*)StatsMalloc(sizeof(PRUNE_BLOCK));
+
+	if (block == NULL)
+		exit(-1);
+
+	block->data = (BYTE*)StatsMalloc(PRUNE_BLOCK_SIZE);
+	if (block->data == NULL)
+		exit(-1);
+
+	++pruneResident;
+	block->spillPos = 0;
+	block->next = NULL;
+	block->prev = pruneTail;
+	block->start = (pruneTail != NULL) ? pruneTail->start + PRUNE_BLOCK_SIZE : 0;
+	block->used = 0;
+	block->read = 0;
+
+	if (pruneTail != NULL)
+		pruneTail->next = block;
+	else
+		pruneHead = block;
+
+	pruneTail = block;
+	return block;
+}
+
+/**
+* @name: PruneFreeBlock
+*
+* @return
+* void
+*
+* releases a block that has been unlinked from the queue
+*/
+static VOID PruneFreeBlock(PRUNE_BLOCK* block)
+{
+	if (block == pruneSpillLast)
+		pruneSpillLast = NULL;
+
+	if (block->data != NULL)
+		--pruneResident;
+	else if (--pruneSpilled == 0)
+		pruneSpillEnd = 0;
+
+	free(block->data);
+	free(block);
+}
+
+/**
+* @name: PruneSpillOpen
+*
+* @return
+* true if the spill file is open
+*
+* the file is deleted by the system as soon as it is closed, including
+* when tree is ended by a second Ctrl+C
+*/
+static BOOL PruneSpillOpen(VOID)
+{
+	wchar_t strDir[MAX_PATH];
+	wchar_t strFile[MAX_PATH];
+
+	if (hPruneSpill != INVALID_HANDLE_VALUE)
+		return TRUE;
+
+	if (GetTempPath(MAX_PATH, strDir) == 0 || GetTempFileName(strDir, L"tre", 0, strFile) == 0)
+		return FALSE;
+
+	hPruneSpill = CreateFile(strFile, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+
+	if (hPruneSpill == INVALID_HANDLE_VALUE)
+	{
+		DeleteFile(strFile);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: PruneSpill
+*
+* @return
+* true if the records of block were moved to the spill file and its memory released
+*/
+static BOOL PruneSpill(PRUNE_BLOCK* block)
+{
+	ULONGLONG span = TraceBegin();
+	LARGE_INTEGER pos;
+	DWORD written = 0;
+
+	if (!PruneSpillOpen())
+	{
+		OutputFlush();
+		fwprintf(stderr, L"Cannot create temporary file, held back output stays in memory\n");
+		return FALSE;
+	}
+
+	pos.QuadPart = pruneSpillEnd;
+
+	if (!SetFilePointerEx(hPruneSpill, pos, NULL, FILE_BEGIN) ||
+		!WriteFile(hPruneSpill, block->data, (DWORD)block->used, &written, NULL) ||
+		written != block->used)
+	{
+		OutputFlush();
+		fwprintf(stderr, L"Cannot write temporary file, held back output stays in memory\n");
+		return FALSE;
+	}
+
+	block->spillPos = pruneSpillEnd;
+	pruneSpillEnd += block->used;
+	++pruneSpilled;
+
+	free(block->data);
+	block->data = NULL;
+	--pruneResident;
+
+	TraceEnd("prune", "spill", span, NULL, "bytes", block->used);
+	return TRUE;
+}
+
+/**
+* @name: PruneLoad
+*
+* @return
+* void
+*
+* reads the records of a spilled block back into memory
+*/
+static VOID PruneLoad(PRUNE_BLOCK* block)
+{
+	ULONGLONG span = TraceBegin();
+	LARGE_INTEGER pos;
+	DWORD read = 0;
+
+	block->data = (BYTE*)StatsMalloc(PRUNE_BLOCK_SIZE);
+	if (block->data == NULL)
+		exit(-1);
+
+	pos.QuadPart = block->spillPos;
+
+	/* without its records the listing can't go on */
+	if (!SetFilePointerEx(hPruneSpill, pos, NULL, FILE_BEGIN) ||
+		!ReadFile(hPruneSpill, block->data, (DWORD)block->used, &read, NULL) ||
+		read != block->used)
+	{
+		OutputFlush();
+		fwprintf(stderr, L"Cannot read temporary file\n");
+		exit(-1);
+	}
+
+	++pruneResident;
+
+	if (--pruneSpilled == 0)
+		pruneSpillEnd = 0;
+
+	TraceEnd("prune", "load", span, NULL, "bytes", block->used);
+}
+
+/**
+* @name: PruneSpillNext
+*
+* @return
+* true if one more block was spilled
+*/
+static BOOL PruneSpillNext(VOID)
+{
+	PRUNE_BLOCK* block = (pruneSpillLast != NULL) ? pruneSpillLast->next : pruneHead->next;
+
+	if (bPruneNoSpill || block == NULL || block == pruneTail)
+		return FALSE;
+
+	if (!PruneSpill(block))
+	{
+		bPruneNoSpill = TRUE;
+		return FALSE;
+	}
+
+	pruneSpillLast = block;
+	return TRUE;
+}
+
+/**
+* @name: PruneFindNode
+*
+* @param seq
+* number of a folder, see PRUNE_NODE
+*
+* @return
+* its node, or NULL if it has been settled and freed
+*
+* a folder still undecided is either open, and so on the way down to the
+* folder being read, or the last visible sub folder of one that is
+*/
+static PRUNE_NODE* PruneFindNode(ULONGLONG seq, UINT depth)
+{
+	PRUNE_NODE* x = NULL;
+
+	for (x = pruneCurrent; x != NULL && x->depth + 1 >= depth; x = x->parent)
+	{
+		if (x->depth == depth && x->seq == seq)
+			return x;
+
+		if (x->depth + 1 == depth && x->lastVisible != NULL && x->lastVisible->seq == seq)
+			return x->lastVisible;
+	}
+
+	return NULL;
+}
+
+/**
+* @name: PruneSettled
+*
+* @param seq
+* number of a folder, see PRUNE_NODE
+*
+* @return
+* true if neither the folder at depth nor any folder above it may still be folded
+*
+* a closed folder is decided. An open one was opened before the folder if
+* it is one of its parents, since nothing opened after it has been closed
+*/
+static BOOL PruneSettled(ULONGLONG seq, UINT depth)
+{
+	const PRUNE_NODE* x = NULL;
+
+	for (x = pruneCurrent; x != NULL; x = x->parent)
+	{
+		if (x->depth <= depth && x->seq <= seq && x->folded == PRUNE_UNKNOWN)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* @name: PruneReady
+*
+* @return
+* true if everything record depends on is known, in which case its last
+* and hasVisibleSub are filled in from the node of its folder if there
+* is still one
+*/
+static BOOL PruneReady(PRUNE_RECORD* record)
+{
+	const PRUNE_NODE* node = PruneFindNode(record->seq, record->depth);
+	PRUNE_STATE hasVisibleSub = PRUNE_UNKNOWN;
+
+	/* the entry of a folder is kept when it is folded, its contents are not */
+	if (bPruneFold && !PruneSettled(record->seq, record->kind == PRUNE_OPEN ? record->depth - 1 : record->depth))
+		return FALSE;
+
+	switch (record->kind)
+	{
+	case PRUNE_OPEN:
+		/* without a node, the decisions were written into the record by PrunePatch */
+		if (node != NULL)
+		{
+			if (node->visible != PRUNE_YES || (bPruneConnectors && node->last == PRUNE_UNKNOWN))
+				return FALSE;
+
+			record->last = node->last;
+			record->hasVisibleSub = node->hasVisibleSub;
+		}
+
+		pruneSubState[record->depth] = record->hasVisibleSub;
+		return TRUE;
+
+	case PRUNE_FILE:
+	case PRUNE_MORE:
+	case PRUNE_BLANK:
+	case PRUNE_SAME:
+		/* with connectors, the entry of a folder is only written once its node is settled */
+		hasVisibleSub = (node != NULL) ? node->hasVisibleSub : pruneSubState[record->depth];
+
+		if (bPruneConnectors && hasVisibleSub == PRUNE_UNKNOWN)
+			return FALSE;
+
+		record->hasVisibleSub = hasVisibleSub;
+		return TRUE;
+
+	default:
+		return TRUE;
+	}
+}
+
+/**
+* @name: PruneFreeNode
+*
+* @return
+* void
+*/
+static VOID PruneFreeNode(PRUNE_NODE* node)
+{
+	free(node->strPath);
+	free(node);
+}
+
+/**
+* @name: PrunePatch
+*
+* @return
+* void
+*
+* writes the decisions about node into its PRUNE_OPEN record, in the spill
+* file if that is where the record is
+*/
+static VOID PrunePatch(const PRUNE_NODE* node)
+{
+	PRUNE_BLOCK* block = pruneTail;
+	size_t offset = 0;
+	PRUNE_STATE states[2];
+	LARGE_INTEGER pos;
+	DWORD written = 0;
+
+	while (block->start > node->recordPos)
+		block = block->prev;
+
+	offset = (size_t)(node->recordPos - block->start);
+
+	if (block->data != NULL)
+	{
+		PRUNE_RECORD* record = (PRUNE_RECORD*)(block->data + offset);
+
+		record->last = node->last;
+		record->hasVisibleSub = node->hasVisibleSub;
+		return;
+	}
+
+	states[0] = node->last;
+	states[1] = node->hasVisibleSub;
+	pos.QuadPart = block->spillPos + offset + offsetof(PRUNE_RECORD, last);
+
+	/* the record would be written with decisions missing */
+	if (!SetFilePointerEx(hPruneSpill, pos, NULL, FILE_BEGIN) ||
+		!WriteFile(hPruneSpill, states, sizeof(states), &written, NULL) ||
+		written != sizeof(states))
+	{
+		OutputFlush();
+		fwprintf(stderr, L"Cannot write temporary file\n");
+		exit(-1);
+	}
+}
+
+/**
+* @name: PruneSettle
+*
+* @param node
+* a closed folder whose last decision, whether it is the last visible
+* sub folder of its parent, has just been made
+*
+* @return
+* void
+*
+* moves the decisions about node into its record and frees it
+*/
+static VOID PruneSettle(PRUNE_NODE* node)
+{
+	if (node->parent->lastVisible == node)
+		node->parent->lastVisible = NULL;
+
+	/* a record already written needs them no more */
+	if (node->recordPos >= pruneHead->start + pruneHead->read)
+		PrunePatch(node);
+
+	PruneFreeNode(node);
+}
+
+/**
+* @name: PruneFlush
+*
+* @return
+* void
+*
+* writes records from the head of the queue until one has to wait
+*/
+static VOID PruneFlush(VOID)
+{
+	while (pruneHead != NULL)
+	{
+		PRUNE_BLOCK* block = pruneHead;
+		PRUNE_RECORD* record = NULL;
+
+		if (block->read == block->used)
+		{
+			/* the tail block stays, the traversal appends to it */
+			if (block == pruneTail)
+				break;
+
+			pruneHead = block->next;
+			pruneHead->prev = NULL;
+			PruneFreeBlock(block);
+			continue;
+		}
+
+		if (block->data == NULL)
+			PruneLoad(block);
+
+		record = (PRUNE_RECORD*)(block->data + block->read);
+
+		if (!PruneReady(record))
+			break;
+
+		pruneRender(record);
+		block->read += record->size;
+	}
+}
+
+/**
+* @name: PruneAppend
+*
+* @param name
+* NUL terminated, copied into the record
+*
+* @return
+* the new record at the tail of the queue, its position in pos
+*/
+static PRUNE_RECORD* PruneAppend(PRUNE_KIND kind, PRUNE_NODE* node, const wchar_t* name, ULONGLONG* pos)
+{
+	size_t nameLen = (name != NULL) ? wcslen(name) : 0;
+	size_t size = offsetof(PRUNE_RECORD, name) + (nameLen + 1) * sizeof(wchar_t);
+	PRUNE_RECORD* record = NULL;
+
+	/* keep every record aligned for its 64 bit members */
+	size = (size + 7) & ~(size_t)7;
+
+	if (pruneTail == NULL || pruneTail->used + size > PRUNE_BLOCK_SIZE)
+		PruneAllocBlock();
+
+	record = (PRUNE_RECORD*)(pruneTail->data + pruneTail->used);
+	ZeroMemory(record, offsetof(PRUNE_RECORD, name));
+	record->size = (UINT)size;
+	record->kind = kind;
+	record->seq = node->seq;
+	record->depth = node->depth;
+	memcpy(record->name, name != NULL ? name : L"", (nameLen + 1) * sizeof(wchar_t));
+
+	if (pos != NULL)
+		*pos = pruneTail->start + pruneTail->used;
+
+	pruneTail->used += size;
+	return record;
+}
+
+/**
+* @name: PruneHeld
+*
+* @return
+* bytes of records in the queue that have not been written yet
+*/
+static ULONGLONG PruneHeld(VOID)
+{
+	if (pruneHead == NULL)
+		return 0;
+
+	return (pruneTail->start + pruneTail->used) - (pruneHead->start + pruneHead->read);
+}
+
+/**
+* @name: PruneGiveUpFold
+*
+* @return
+* true if a folder was found that may no longer be folded
+*
+* the outermost folder still open that may be folded holds back everything
+* below it. It is decided not to be, so that its records can be written
+*/
+static BOOL PruneGiveUpFold(VOID)
+{
+	PRUNE_NODE* outer = NULL;
+	PRUNE_NODE* x = NULL;
+
+	for (x = pruneCurrent; x != NULL; x = x->parent)
+	{
+		if (x->folded == PRUNE_UNKNOWN)
+			outer = x;
+	}
+
+	if (outer == NULL)
+		return FALSE;
+
+	outer->folded = PRUNE_NO;
+	return TRUE;
+}
+
+/**
+* @name: PruneCommit
+*
+* @return
+* void
+*
+* called after each change, writes what can be written and moves what
+* is still held back beyond PRUNE_MEMORY_MAX to the spill file
+*/
+static VOID PruneCommit(VOID)
+{
+	PruneFlush();
+
+	while (bPruneFold && PruneHeld() > PRUNE_FOLD_MAX && PruneGiveUpFold())
+		PruneFlush();
+
+	while (pruneResident > PRUNE_MEMORY_MAX / PRUNE_BLOCK_SIZE && PruneSpillNext())
+		;
+}
+
+/**
+* @name: PruneTruncate
+*
+* @param pos
+* position of the first record to be dropped
+*
+* @return
+* void
+*
+* drops the records of a folder found to hold nothing, or of the contents
+* of a folded one, which are the last ones in the queue since the traversal
+* is depth first. Their nodes have all been freed already. The block they
+* start in becomes the tail again, so it is read back if it was spilled,
+* the blocks after it are released without being read
+*/
+static VOID PruneTruncate(ULONGLONG pos)
+{
+	PRUNE_BLOCK* first = pruneTail;
+	PRUNE_BLOCK* block = NULL;
+	BOOL bSpilled = FALSE;
+
+	while (first->start > pos)
+		first = first->prev;
+
+	bSpilled = (first->data == NULL);
+
+	for (block = first->next; block != NULL; )
+	{
+		PRUNE_BLOCK* next = block->next;
+
+		PruneFreeBlock(block);
+		block = next;
+	}
+
+	if (bSpilled)
+		PruneLoad(first);
+
+	pruneTail = first;
+	first->next = NULL;
+	first->used = (size_t)(pos - first->start);
+
+	/* the spilled blocks now end right before the new tail */
+	if (bSpilled)
+		pruneSpillLast = (first->prev != NULL && first->prev->data == NULL) ? first->prev : NULL;
+}
+
+/**
+* @name: PruneNewNode
+*
+* @return
+* a node with nothing decided about it
+*/
+static PRUNE_NODE* PruneNewNode(PRUNE_NODE* parent, const wchar_t* strPath)
+{
+	PRUNE_NODE* node = (PRUNE_NODE*)StatsCalloc(1, sizeof(PRUNE_NODE));
+
+	if (node == NULL)
+		exit(-1);
+
+	node->parent = parent;
+	node->seq = pruneSeq++;
+	node->depth = (parent != NULL) ? parent->depth + 1 : 0;
+
+	if (node->depth >= pruneSubStateSlots)
+	{
+		UINT slots = (pruneSubStateSlots > 0) ? 2 * pruneSubStateSlots : 64;
+		PRUNE_STATE* states = (PRUNE_STATE*)StatsRealloc(pruneSubState, slots * sizeof(PRUNE_STATE));
+
+		if (states == NULL)
+			exit(-1);
+
+		pruneSubState = states;
+		pruneSubStateSlots = slots;
+	}
+
+	if (strPath != NULL)
+	{
+		size_t len = wcslen(strPath) + 1;
+
+		node->strPath = (wchar_t*)StatsMalloc(len * sizeof(wchar_t));
+		if (node->strPath == NULL)
+			exit(-1);
+
+		memcpy(node->strPath, strPath, len * sizeof(wchar_t));
+	}
+
+	return node;
+}
+
+/**
+* @name: PruneRoot
+*
+* @param strPath
+* the listed folder
+*
+* @return
+* its node, always visible and never written itself
+*/
+PRUNE_NODE* PruneRoot(const wchar_t* strPath)
+{
+	PRUNE_NODE* root = PruneNewNode(NULL, strPath);
+
+	root->visible = PRUNE_YES;
+	root->last = PRUNE_YES;
+	root->folded = PRUNE_NO;
+
+	pruneCurrent = root;
+	return root;
+}
+
+/**
+* @name: PruneOpen
+*
+* @param parent
+* folder the new one is a sub folder of
+*
+* @param entry
+* find data of the new folder
+*
+* @param strPath
+* full path of the new folder, or NULL if it won't be descended into
+*
+* @param bSummary
+* true if entry stands for the count sub folders of parent beyond /CAP
+*
+* @return
+* node of the new folder, to be passed to PruneClose once it has been read
+*/
+PRUNE_NODE* PruneOpen(PRUNE_NODE* parent, const WIN32_FIND_DATA* entry,
+	const wchar_t* strPath, BOOL bSummary, ULONGLONG count)
+{
+	PRUNE_NODE* node = PruneNewNode(parent, strPath);
+	PRUNE_RECORD* record = PruneAppend(PRUNE_OPEN, node, entry->cFileName, &node->recordPos);
+
+	record->bSummary = bSummary;
+	record->attributes = entry->dwFileAttributes;
+	record->ftLastWrite = entry->ftLastWriteTime;
+	record->count = count;
+	node->contentPos = node->recordPos + record->size;
+
+	pruneCurrent = node;
+
+	PruneCommit();
+	return node;
+}
+
+/**
+* @name: PruneShow
+*
+* @return
+* void
+*
+* node has something to show, so it and all its ancestors are visible. A
+* folder becoming visible also decides that the sub folder of its parent
+* visible before it is not the last one, which settles that one
+*/
+VOID PruneShow(PRUNE_NODE* node)
+{
+	PRUNE_NODE* x = NULL;
+
+	for (x = node; x != NULL && x->visible != PRUNE_YES; x = x->parent)
+	{
+		PRUNE_NODE* parent = x->parent;
+
+		x->visible = PRUNE_YES;
+
+		if (parent == NULL)
+			continue;
+
+		parent->hasVisibleSub = PRUNE_YES;
+
+		if (parent->lastVisible != NULL)
+		{
+			parent->lastVisible->last = PRUNE_NO;
+			PruneSettle(parent->lastVisible);
+		}
+
+		parent->lastVisible = x;
+	}
+
+	PruneCommit();
+}
+
+/**
+* @name: PruneFile
+*
+* @param entry
+* a file of node, which makes node visible
+*
+* @return
+* void
+*/
+VOID PruneFile(PRUNE_NODE* node, const WIN32_FIND_DATA* entry)
+{
+	PRUNE_RECORD* record = PruneAppend(PRUNE_FILE, node, entry->cFileName, NULL);
+
+	record->attributes = entry->dwFileAttributes;
+	record->ftLastWrite = entry->ftLastWriteTime;
+	record->fileSize = ((ULONGLONG)entry->nFileSizeHigh << 32) | entry->nFileSizeLow;
+
+	PruneShow(node);
+}
+
+/**
+* @name: PruneMore
+*
+* @param strText
+* line drawn in place of the files of node beyond /CAP
+*
+* @return
+* void
+*/
+VOID PruneMore(PRUNE_NODE* node, const wchar_t* strText, ULONGLONG count, ULONGLONG bytes)
+{
+	PRUNE_RECORD* record = PruneAppend(PRUNE_MORE, node, strText, NULL);
+
+	record->count = count;
+	record->fileSize = bytes;
+
+	PruneShow(node);
+}
+
+/**
+* @name: PruneBlank
+*
+* @return
+* void
+*
+* ends the files of node with a blank line, as tree output does
+*/
+VOID PruneBlank(PRUNE_NODE* node)
+{
+	PruneAppend(PRUNE_BLANK, node, NULL, NULL);
+	PruneCommit();
+}
+
+/**
+* @name: PruneEndFolders
+*
+* @return
+* void
+*
+* all sub folders of node have been read, so its last visible one is known
+*/
+VOID PruneEndFolders(PRUNE_NODE* node)
+{
+	if (node->lastVisible != NULL)
+	{
+		node->lastVisible->last = PRUNE_YES;
+		PruneSettle(node->lastVisible);
+	}
+
+	if (node->hasVisibleSub == PRUNE_UNKNOWN)
+		node->hasVisibleSub = PRUNE_NO;
+
+	PruneCommit();
+}
+
+/**
+* @name: PruneFold
+*
+* @param strSame
+* path of a folder listing the same as node, which has been written or is
+* held back ahead of node. Copied into the record
+*
+* @return
+* true if the contents of node were replaced by a line referring to
+* strSame, false if they have been decided to be written as they are
+*
+* to be called once everything below node has been read, before PruneClose
+*/
+BOOL PruneFold(PRUNE_NODE* node, const wchar_t* strSame)
+{
+	if (node->folded != PRUNE_UNKNOWN)
+		return FALSE;
+
+	/* nothing below node can have been written while it might be folded, its sub folders are settled */
+	PruneTruncate(node->contentPos);
+
+	node->hasVisibleSub = PRUNE_NO;
+	node->folded = PRUNE_YES;
+
+	PruneAppend(PRUNE_SAME, node, strSame, NULL);
+	PruneCommit();
+	return TRUE;
+}
+
+/**
+* @name: PruneClose
+*
+* @return
+* void
+*
+* node and everything below it has been read. If nothing in it turned
+* out to be visible, its records are dropped and node is freed. Else it is
+* kept until PruneShow or PruneEndFolders settle it, but without its path
+*/
+VOID PruneClose(PRUNE_NODE* node)
+{
+	pruneCurrent = node->parent;
+
+	if (node->folded == PRUNE_UNKNOWN)
+		node->folded = PRUNE_NO;
+
+	if (node->visible != PRUNE_YES)
+	{
+		PruneTruncate(node->recordPos);
+		PruneFreeNode(node);
+		return;
+	}
+
+	free(node->strPath);
+	node->strPath = NULL;
+
+	PruneAppend(PRUNE_CLOSE, node, NULL, NULL);
+	PruneCommit();
+}
+
+/**
+* @name: PruneFinish
+*
+* @param root
+* node returned by PruneRoot, freed here
+*
+* @return
+* void
+*
+* once the traversal is over every decision is known, so all that is left is written
+*/
+VOID PruneFinish(PRUNE_NODE* root)
+{
+	PruneFlush();
+
+	while (pruneHead != NULL)
+	{
+		PRUNE_BLOCK* block = pruneHead;
+
+		pruneHead = block->next;
+		PruneFreeBlock(block);
+	}
+
+	pruneTail = NULL;
+
+	if (hPruneSpill != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(hPruneSpill);
+		hPruneSpill = INVALID_HANDLE_VALUE;
+	}
+
+	PruneFreeNode(root);
+	pruneCurrent = NULL;
+
+	free(pruneSubState);
+	pruneSubState = NULL;
+	pruneSubStateSlots = 0;
+}
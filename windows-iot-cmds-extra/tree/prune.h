@@ -0,0 +1,84 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Deferred output behind tree.com's /PRUNE and /FOLD options
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* a decision about a folder that may only be known once more of the tree has been read */
+typedef enum _PRUNE_STATE
+{
+	PRUNE_UNKNOWN,
+	PRUNE_YES,
+	PRUNE_NO
+} PRUNE_STATE;
+
+/*
+ * a folder some decision about is still to be made. Once all are, they are
+ * written into its PRUNE_OPEN record and the node is freed, so only the open
+ * folders and the last visible sub folder of each are ever kept in memory
+ */
+typedef struct _PRUNE_NODE
+{
+	struct _PRUNE_NODE* parent;
+	struct _PRUNE_NODE* lastVisible;	/* last sub folder found to be visible so far, until it is settled */
+	wchar_t* strPath;			/* NULL if the folder is not descended into, or once it is closed */
+	ULONGLONG seq;				/* number of the folder, in the order they are opened */
+	UINT depth;				/* 0 for the listed folder itself */
+	PRUNE_STATE visible;			/* has a matching file below it */
+	PRUNE_STATE last;			/* is the last visible sub folder of parent */
+	PRUNE_STATE hasVisibleSub;		/* has a visible sub folder */
+	PRUNE_STATE folded;			/* its contents are replaced by a reference, with /FOLD */
+	ULONGLONG recordPos;			/* position of its PRUNE_OPEN record */
+	ULONGLONG contentPos;			/* position of the first record after it */
+} PRUNE_NODE;
+
+typedef enum _PRUNE_KIND
+{
+	PRUNE_OPEN,	/* the entry of node itself */
+	PRUNE_CLOSE,	/* end of node, after everything below it */
+	PRUNE_FILE,	/* a file in node */
+	PRUNE_MORE,	/* summary of the files in node beyond /CAP */
+	PRUNE_BLANK,	/* blank line closing the files of node */
+	PRUNE_SAME	/* path of an earlier folder listing the same as node, in place of its contents */
+} PRUNE_KIND;
+
+/*
+ * output held back until the decisions it depends on are known, which they
+ * are by the time it is handed to the renderer. last and hasVisibleSub are
+ * next to each other, see PrunePatch
+ */
+typedef struct _PRUNE_RECORD
+{
+	UINT size;			/* bytes, including the name and padding */
+	PRUNE_KIND kind;
+	ULONGLONG seq;			/* folder the record belongs to, see PRUNE_NODE */
+	UINT depth;			/* of that folder */
+	BOOL bSummary;			/* the folder stands for the sub folders of its parent beyond /CAP */
+	PRUNE_STATE last;		/* the folder is the last visible sub folder of its parent */
+	PRUNE_STATE hasVisibleSub;	/* the folder has a visible sub folder */
+	DWORD attributes;
+	FILETIME ftLastWrite;
+	ULONGLONG fileSize;	/* bytes, or for PRUNE_MORE the total of the files left out */
+	ULONGLONG count;	/* for PRUNE_MORE and summaries, the entries left out */
+	wchar_t name[1];
+} PRUNE_RECORD;
+
+/* writes a record whose decisions are known, see PruneInit */
+typedef VOID (*PRUNE_RENDER)(const PRUNE_RECORD* record);
+
+VOID PruneInit(PRUNE_RENDER render, BOOL bConnectors, BOOL bFold);
+PRUNE_NODE* PruneRoot(const wchar_t* strPath);
+PRUNE_NODE* PruneOpen(PRUNE_NODE* parent, const WIN32_FIND_DATA* entry,
+	const wchar_t* strPath, BOOL bSummary, ULONGLONG count);
+VOID PruneShow(PRUNE_NODE* node);
+VOID PruneFile(PRUNE_NODE* node, const WIN32_FIND_DATA* entry);
+VOID PruneMore(PRUNE_NODE* node, const wchar_t* strText, ULONGLONG count, ULONGLONG bytes);
+VOID PruneBlank(PRUNE_NODE* node);
+VOID PruneEndFolders(PRUNE_NODE* node);
+BOOL PruneFold(PRUNE_NODE* node, const wchar_t* strSame);
+VOID PruneClose(PRUNE_NODE* node);
+VOID PruneFinish(PRUNE_NODE* root);
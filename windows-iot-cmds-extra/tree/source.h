@@ -0,0 +1,28 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Directory enumeration sources tree.com can list
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/*
+ * where folders and files are enumerated from, with the semantics of the
+ * Win32 calls of the same name: FindFirst takes a "path\*.*" or "path\*."
+ * pattern and returns INVALID_HANDLE_VALUE if the folder cannot be listed.
+ * Every source must allow several threads to enumerate at once
+ */
+typedef struct _ENUM_SOURCE
+{
+	HANDLE (WINAPI* FindFirst)(LPCWSTR strPattern, LPWIN32_FIND_DATAW pFindData);
+	BOOL (WINAPI* FindNext)(HANDLE hFind, LPWIN32_FIND_DATAW pFindData);
+	BOOL (WINAPI* FindClose)(HANDLE hFind);
+} ENUM_SOURCE;
+
+/* the real file system */
+extern const ENUM_SOURCE diskSource;
+
+/* source the traversal enumerates, diskSource unless another was selected */
+extern const ENUM_SOURCE* pEnumSource;
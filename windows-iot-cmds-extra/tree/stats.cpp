@@ -0,0 +1,188 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Counters and timers behind tree.com's --stats option
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+#include <psapi.h>
+
+#include "stats.h"
+
+BOOL bStats = FALSE;
+
+__declspec(thread) STATS_THREAD* pThreadStats = NULL;
+
+/* every thread that counted something, only ever added to */
+static STATS_THREAD* volatile pStatsList = NULL;
+
+static LARGE_INTEGER statsStart;
+static LARGE_INTEGER statsFrequency;
+
+static const wchar_t* statNames[STAT_MAX] =
+{
+	L"directory opens",
+	L"enumeration calls",
+	L"HasSubFolder calls",
+	L"entries seen",
+	L"heap allocations",
+	L"output bytes",
+	L"output writes",
+	L"blocked on output"
+};
+
+/* member names used by the JSON report */
+static const wchar_t* statKeys[STAT_MAX] =
+{
+	L"dir_open",
+	L"dir_enum",
+	L"has_subfolder",
+	L"entries",
+	L"alloc",
+	L"output_bytes",
+	L"output_write",
+	L"output_wait"
+};
+
+/* only these have a meaningful cumulative time */
+static const BOOL statTimed[STAT_MAX] = { TRUE, TRUE, TRUE, FALSE, FALSE, FALSE, TRUE, TRUE };
+
+/**
+* @name: StatsRegisterThread
+*
+* @return
+* counters of the calling thread, created on its first event
+*/
+STATS_THREAD* StatsRegisterThread(VOID)
+{
+	/* the one allocation not counted, StatsCalloc would come back here for the counters */
+	STATS_THREAD* stats = (STATS_THREAD*)calloc(1, sizeof(STATS_THREAD));
+	STATS_THREAD* head = NULL;
+
+	if (stats == NULL)
+		exit(-1);
+
+	stats->threadId = GetCurrentThreadId();
+
+	do
+	{
+		head = pStatsList;
+		stats->next = head;
+	} while (InterlockedCompareExchangePointer((PVOID volatile*)&pStatsList, stats, head) != head);
+
+	pThreadStats = stats;
+	return stats;
+}
+
+/**
+* @name: StatsInit
+*
+* @return
+* void
+*
+* turns collection on and starts the wall clock
+*/
+VOID StatsInit(VOID)
+{
+	QueryPerformanceFrequency(&statsFrequency);
+	QueryPerformanceCounter(&statsStart);
+	bStats = TRUE;
+}
+
+/**
+* @name: TicksToMs
+*
+* @return
+* ticks converted to milliseconds
+*/
+static double TicksToMs(ULONGLONG ticks)
+{
+	return (double)ticks * 1000.0 / (double)statsFrequency.QuadPart;
+}
+
+/**
+* @name: StatsReport
+*
+* @param bJson
+* if true, a single JSON object is written instead of a table
+*
+* @return
+* void
+*
+* sums the counters of all threads and writes them to stderr, so the
+* report never mixes with the listing on stdout. Must only be called once
+* output has been flushed and the other threads are idle
+*/
+VOID StatsReport(BOOL bJson)
+{
+	ULONGLONG count[STAT_MAX] = { 0 };
+	ULONGLONG ticks[STAT_MAX] = { 0 };
+	STATS_THREAD* stats = NULL;
+	PROCESS_MEMORY_COUNTERS memory;
+	LARGE_INTEGER now;
+	double elapsed = 0;
+	double rate = 0;
+	ULONGLONG calls = 0;
+	UINT threads = 0;
+	UINT i = 0;
+
+	if (!bStats)
+		return;
+
+	QueryPerformanceCounter(&now);
+	elapsed = TicksToMs(now.QuadPart - statsStart.QuadPart);
+
+	ZeroMemory(&memory, sizeof(memory));
+	GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+	for (stats = pStatsList; stats != NULL; stats = stats->next)
+	{
+		for (i = 0; i < STAT_MAX; ++i)
+		{
+			count[i] += stats->count[i];
+			ticks[i] += stats->ticks[i];
+		}
+		++threads;
+	}
+
+	/* every directory and output call is one trip into the kernel */
+	calls = count[STAT_DIR_OPEN] + count[STAT_DIR_ENUM] + count[STAT_OUTPUT_WRITE];
+
+	if (elapsed > 0)
+		rate = (double)count[STAT_ENTRIES] * 1000.0 / elapsed;
+
+	if (bJson)
+	{
+		fwprintf(stderr, L"{\"elapsed_ms\":%.3f,\"threads\":%u,\"entries_per_sec\":%.0f,"
+			L"\"peak_working_set\":%llu,\"system_calls\":%llu",
+			elapsed, threads, rate, (ULONGLONG)memory.PeakWorkingSetSize, calls);
+
+		for (i = 0; i < STAT_MAX; ++i)
+		{
+			fwprintf(stderr, L",\"%s\":%llu", statKeys[i], count[i]);
+
+			if (statTimed[i])
+				fwprintf(stderr, L",\"%s_ms\":%.3f", statKeys[i], TicksToMs(ticks[i]));
+		}
+
+		fwprintf(stderr, L"}\n");
+		return;
+	}
+
+	fwprintf(stderr, L"\n%-22s %14s %12s\n", L"", L"count", L"time (ms)");
+
+	for (i = 0; i < STAT_MAX; ++i)
+	{
+		if (statTimed[i])
+			fwprintf(stderr, L"%-22s %14llu %12.3f\n", statNames[i], count[i], TicksToMs(ticks[i]));
+		else
+			fwprintf(stderr, L"%-22s %14llu\n", statNames[i], count[i]);
+	}
+
+	fwprintf(stderr, L"%-22s %14llu\n", L"system calls", calls);
+	fwprintf(stderr, L"%-22s %14.0f\n", L"entries per second", rate);
+	fwprintf(stderr, L"%-22s %14llu\n", L"peak working set (KB)", (ULONGLONG)memory.PeakWorkingSetSize / 1024);
+	fwprintf(stderr, L"%-22s %14u %12.3f\n", L"threads, elapsed", threads, elapsed);
+}
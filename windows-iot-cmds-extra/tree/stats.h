@@ -0,0 +1,167 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Counters and timers behind tree.com's --stats option
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include <windows.h>
+
+/* what is being counted, each with a number of events and their cumulative time */
+typedef enum _STAT_ID
+{
+	STAT_DIR_OPEN,		/* FindFirstFile calls */
+	STAT_DIR_ENUM,		/* FindNextFile calls */
+	STAT_HAS_SUBFOLDER,	/* HasSubFolder calls, including their own opens and enumeration */
+	STAT_ENTRIES,		/* files and folders returned by enumeration */
+	STAT_ALLOC,		/* heap allocations and reallocations */
+	STAT_OUTPUT_BYTES,	/* bytes handed to WriteFile or WriteConsoleW */
+	STAT_OUTPUT_WRITE,	/* WriteFile and WriteConsoleW calls */
+	STAT_OUTPUT_WAIT,	/* time the traversal spent blocked on output */
+	STAT_MAX
+} STAT_ID;
+
+/* one set of counters per thread, so counting never needs a lock or an interlocked operation */
+typedef struct _STATS_THREAD
+{
+	ULONGLONG count[STAT_MAX];
+	ULONGLONG ticks[STAT_MAX];
+	DWORD threadId;
+	struct _STATS_THREAD* next;
+} STATS_THREAD;
+
+/* if this flag is true, counters are collected and reported at exit */
+extern BOOL bStats;
+
+extern __declspec(thread) STATS_THREAD* pThreadStats;
+
+STATS_THREAD* StatsRegisterThread(VOID);
+VOID StatsInit(VOID);
+VOID StatsReport(BOOL bJson);
+
+/**
+* @name: StatsBegin
+*
+* @return
+* timestamp to be passed to StatsEnd, or 0 if statistics are off
+*/
+static __forceinline ULONGLONG StatsBegin(VOID)
+{
+	LARGE_INTEGER now;
+
+	if (!bStats)
+		return 0;
+
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+/**
+* @name: StatsEnd
+*
+* @param id
+* counter the timed event belongs to
+*
+* @param start
+* value returned by StatsBegin when the event started
+*
+* @return
+* void
+*/
+static __forceinline VOID StatsEnd(STAT_ID id, ULONGLONG start)
+{
+	STATS_THREAD* stats = pThreadStats;
+	LARGE_INTEGER now;
+
+	if (!bStats)
+		return;
+
+	QueryPerformanceCounter(&now);
+
+	if (stats == NULL)
+		stats = StatsRegisterThread();
+
+	stats->count[id] += 1;
+	stats->ticks[id] += now.QuadPart - start;
+}
+
+/**
+* @name: StatsCount
+*
+* @param id
+* counter to be increased
+*
+* @param n
+* number of events, or bytes for STAT_OUTPUT_BYTES
+*
+* @return
+* void
+*/
+static __forceinline VOID StatsCount(STAT_ID id, ULONGLONG n)
+{
+	STATS_THREAD* stats = pThreadStats;
+
+	if (!bStats)
+		return;
+
+	if (stats == NULL)
+		stats = StatsRegisterThread();
+
+	stats->count[id] += n;
+}
+
+/**
+* @name: StatsMalloc
+*
+* @param size
+* bytes to allocate
+*
+* @return
+* the allocated block as malloc returns it
+*
+* every heap allocation goes through StatsMalloc, StatsCalloc or StatsRealloc
+* so STAT_ALLOC counts all of them
+*/
+static __forceinline VOID* StatsMalloc(size_t size)
+{
+	StatsCount(STAT_ALLOC, 1);
+	return malloc(size);
+}
+
+/**
+* @name: StatsCalloc
+*
+* @param count
+* number of elements
+*
+* @param size
+* bytes per element
+*
+* @return
+* the zeroed block as calloc returns it
+*/
+static __forceinline VOID* StatsCalloc(size_t count, size_t size)
+{
+	StatsCount(STAT_ALLOC, 1);
+	return calloc(count, size);
+}
+
+/**
+* @name: StatsRealloc
+*
+* @param ptr
+* block to resize, or NULL
+*
+* @param size
+* new size in bytes
+*
+* @return
+* the resized block as realloc returns it
+*/
+static __forceinline VOID* StatsRealloc(VOID* ptr, size_t size)
+{
+	StatsCount(STAT_ALLOC, 1);
+	return realloc(ptr, size);
+}
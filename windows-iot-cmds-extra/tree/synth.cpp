@@ -0,0 +1,319 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Synthetic in-memory directory trees for tree.com's /SYNTH option
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "stats.h"
+#include "synth.h"
+
+/* shape of the generated tree, set once by SynthInit */
+static UINT synthFanout = 0;		/* sub folders of every folder above the deepest level */
+static UINT synthDepth = 0;		/* levels of sub folders below the root */
+static UINT synthFiles = 0;		/* files in every folder */
+static UINT synthNameLen = 12;		/* average name length, in characters */
+static UINT synthUnicode = 0;		/* percentage of characters outside ASCII */
+static UINT synthLatency = 0;		/* microseconds every folder takes to open */
+static ULONGLONG synthSeed = 1;
+
+/* characters names are made of, besides the non ASCII ones */
+static const wchar_t synthChars[] = L"abcdefghijklmnopqrstuvwxyz0123456789_-";
+
+/* file extensions, folders never get one */
+static const wchar_t* synthExt[] = { L".txt", L".dat", L".log", L".cpp", L".png", L".xml" };
+
+/* an open enumeration, everything else is derived from the folder's path */
+typedef struct _SYNTH_FIND
+{
+	ULONGLONG hash;		/* identifies the folder, names and sizes are derived from it */
+	UINT folders;		/* sub folders to be returned */
+	UINT count;		/* entries to be returned, including . and .. */
+	UINT next;		/* entry FindNext returns */
+	BOOL bFoldersOnly;	/* "*." pattern, only names without an extension match */
+} SYNTH_FIND;
+
+/**
+* @name: SynthMix
+*
+* @return
+* x scrambled, so that neighbouring inputs give unrelated outputs
+*/
+static ULONGLONG SynthMix(ULONGLONG x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/**
+* @name: SynthNumber
+*
+* @param str
+* points at the number, moved past it and past a following comma
+*
+* @param value
+* left unchanged if str holds no number
+*
+* @return
+* false if str holds something other than a number
+*/
+static BOOL SynthNumber(const wchar_t** str, UINT* value)
+{
+	wchar_t* end = NULL;
+	ULONG n = 0;
+
+	if (**str == L'\0')
+		return TRUE;
+
+	n = wcstoul(*str, &end, 10);
+
+	if (end == *str || (*end != L',' && *end != L'\0'))
+		return FALSE;
+
+	*value = (UINT)n;
+	*str = (*end == L',') ? end + 1 : end;
+	return TRUE;
+}
+
+/**
+* @name: SynthInit
+*
+* @param strSpec
+* fanout,depth,files[,namelen[,unicode[,latency[,seed]]]]
+*
+* @return
+* false if strSpec is malformed
+*
+* the tree is never held in memory: every folder's entries are generated
+* from its path when it is opened, so trees of any size cost nothing but
+* the time to enumerate them, and the same spec always gives the same tree
+*/
+BOOL SynthInit(const wchar_t* strSpec)
+{
+	UINT seed = 1;
+
+	if (!SynthNumber(&strSpec, &synthFanout) ||
+		!SynthNumber(&strSpec, &synthDepth) ||
+		!SynthNumber(&strSpec, &synthFiles) ||
+		!SynthNumber(&strSpec, &synthNameLen) ||
+		!SynthNumber(&strSpec, &synthUnicode) ||
+		!SynthNumber(&strSpec, &synthLatency) ||
+		!SynthNumber(&strSpec, &seed) ||
+		*strSpec != L'\0')
+	{
+		return FALSE;
+	}
+
+	if (synthNameLen == 0)
+		synthNameLen = 1;
+
+	/* leave room for the extension within MAX_PATH */
+	if (synthNameLen > (MAX_PATH - 8) / 2)
+		synthNameLen = (MAX_PATH - 8) / 2;
+
+	if (synthUnicode > 100)
+		synthUnicode = 100;
+
+	synthSeed = seed;
+	return TRUE;
+}
+
+/**
+* @name: SynthSerial
+*
+* @return
+* volume serial number shown for the synthetic tree
+*/
+DWORD SynthSerial(VOID)
+{
+	return (DWORD)SynthMix(synthSeed);
+}
+
+/**
+* @name: SynthDelay
+*
+* @return
+* void
+*
+* waits synthLatency microseconds, sleeping for whole milliseconds and
+* spinning on the rest, since Sleep cannot wait any shorter
+*/
+static VOID SynthDelay(VOID)
+{
+	LARGE_INTEGER now;
+	LARGE_INTEGER end;
+	LARGE_INTEGER frequency;
+
+	if (synthLatency == 0)
+		return;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&end);
+	end.QuadPart += synthLatency * frequency.QuadPart / 1000000;
+
+	if (synthLatency >= 1000)
+		Sleep(synthLatency / 1000);
+
+	do
+	{
+		QueryPerformanceCounter(&now);
+	} while (now.QuadPart < end.QuadPart);
+}
+
+/**
+* @name: SynthFill
+*
+* @param find
+* enumeration the entry belongs to
+*
+* @param index
+* entry to be generated, 0 and 1 being . and ..
+*
+* @param pFindData
+* receives the entry
+*
+* @return
+* void
+*/
+static VOID SynthFill(const SYNTH_FIND* find, UINT index, LPWIN32_FIND_DATAW pFindData)
+{
+	ULONGLONG h = SynthMix(find->hash + index);
+	ULONGLONG time = 0;
+	UINT len = 0;
+	UINT i = 0;
+
+	ZeroMemory(pFindData, sizeof(*pFindData));
+
+	if (index < 2)
+	{
+		pFindData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		wcscpy_s(pFindData->cFileName, MAX_PATH, index == 0 ? L"." : L"..");
+		return;
+	}
+
+	/* lengths are spread evenly around the average */
+	len = 1 + (UINT)(h % (2 * synthNameLen - 1));
+
+	for (i = 0; i < len; ++i)
+	{
+		h = SynthMix(h);
+
+		/* CJK ideographs, all in the basic plane so no surrogates are needed */
+		if ((h >> 32) % 100 < synthUnicode)
+			pFindData->cFileName[i] = (wchar_t)(0x4E00 + h % 0x5000);
+		else
+			pFindData->cFileName[i] = synthChars[h % (_countof(synthChars) - 1)];
+	}
+
+	pFindData->cFileName[len] = L'\0';
+
+	/* 2016-01-01 plus up to about three years */
+	time = 130960800000000000ULL + (h >> 8) % (3ULL * 365 * 24 * 3600 * 10000000);
+	pFindData->ftCreationTime.dwLowDateTime = (DWORD)time;
+	pFindData->ftCreationTime.dwHighDateTime = (DWORD)(time >> 32);
+	pFindData->ftLastWriteTime = pFindData->ftCreationTime;
+	pFindData->ftLastAccessTime = pFindData->ftCreationTime;
+
+	if (index - 2 < find->folders)
+	{
+		pFindData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		return;
+	}
+
+	pFindData->dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+	pFindData->nFileSizeLow = (DWORD)(SynthMix(h) % (1 << ((h >> 40) % 24 + 1)));
+	wcscat_s(pFindData->cFileName, MAX_PATH, synthExt[(h >> 56) % _countof(synthExt)]);
+}
+
+/**
+* @name: SynthFindFirst
+*
+* FindFirstFile for synthetic trees, see ENUM_SOURCE
+*/
+static HANDLE WINAPI SynthFindFirst(LPCWSTR strPattern, LPWIN32_FIND_DATAW pFindData)
+{
+	const size_t rootLen = _countof(SYNTH_ROOT) - 1;
+	const wchar_t* end = wcsrchr(strPattern, L'\\');
+	const wchar_t* c = NULL;
+	SYNTH_FIND* find = NULL;
+	ULONGLONG hash = synthSeed;
+	UINT depth = 0;
+	BOOL bExtension = FALSE;
+
+	if (end == NULL || _wcsnicmp(strPattern, SYNTH_ROOT, rootLen) != 0 ||
+		(strPattern + rootLen != end && strPattern[rootLen] != L'\\'))
+	{
+		SetLastError(ERROR_PATH_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	/* every folder is identified by its path below the root */
+	for (c = strPattern + rootLen; c < end; ++c)
+	{
+		if (*c == L'\\')
+			++depth;
+		else if (*c == L'.')
+			bExtension = TRUE;
+
+		hash = SynthMix(hash ^ *c);
+	}
+
+	/* only folders above the deepest level exist, and they never have an extension */
+	if (depth > synthDepth || bExtension)
+	{
+		SetLastError(ERROR_PATH_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	SynthDelay();
+
+	find = (SYNTH_FIND*)StatsMalloc(sizeof(SYNTH_FIND));
+	if (find == NULL)
+		exit(-1);
+
+	find->hash = hash;
+	find->folders = (depth < synthDepth) ? synthFanout : 0;
+	find->bFoldersOnly = wcscmp(end, L"\\*.") == 0;
+	find->count = 2 + find->folders + (find->bFoldersOnly ? 0 : synthFiles);
+	find->next = 1;
+
+	SynthFill(find, 0, pFindData);
+	return (HANDLE)find;
+}
+
+/**
+* @name: SynthFindNext
+*
+* FindNextFile for synthetic trees, see ENUM_SOURCE
+*/
+static BOOL WINAPI SynthFindNext(HANDLE hFind, LPWIN32_FIND_DATAW pFindData)
+{
+	SYNTH_FIND* find = (SYNTH_FIND*)hFind;
+
+	if (find->next == find->count)
+	{
+		SetLastError(ERROR_NO_MORE_FILES);
+		return FALSE;
+	}
+
+	SynthFill(find, find->next++, pFindData);
+	return TRUE;
+}
+
+/**
+* @name: SynthFindClose
+*
+* FindClose for synthetic trees, see ENUM_SOURCE
+*/
+static BOOL WINAPI SynthFindClose(HANDLE hFind)
+{
+	free(hFind);
+	return TRUE;
+}
+
+const ENUM_SOURCE synthSource = { SynthFindFirst, SynthFindNext, SynthFindClose };
@@ -0,0 +1,19 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Synthetic in-memory directory trees for tree.com's /SYNTH option
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include "source.h"
+
+/* path of the root folder of a synthetic tree */
+#define SYNTH_ROOT L"SYNTH:"
+
+extern const ENUM_SOURCE synthSource;
+
+BOOL SynthInit(const wchar_t* strSpec);
+DWORD SynthSerial(VOID);
@@ -0,0 +1,331 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Runs the benchmarks and writes their results as JSON lines
+#
+#   python3 bench.py [--build DIR] [--against REV]... [--out FILE] [--repeat N] [SCENARIO...]
+#
+# Each scenario runs tree from the build folder and yields one result per
+# variant, the fastest of --repeat runs. --against REV also builds tree as of
+# git revision REV, against the same posix/ layer, and runs every scenario
+# with it too; each result names the revision it came from, and a comparison
+# with the first REV goes to stderr. Folders to list are generated by gen/mktree.py, on tmpfs
+# where there is one, and kept for later runs.
+
+import argparse
+import io
+import json
+import os
+import pty
+import re
+import shutil
+import subprocess
+import sys
+import tarfile
+import tempfile
+import threading
+import time
+import tty
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, 'gen'))
+
+import mkarchive  # noqa: E402
+import mktree  # noqa: E402
+
+SCENARIOS = {}
+
+
+def scenario(func):
+    """Registers a scenario under its function's name, in definition order."""
+    SCENARIOS[func.__name__] = func
+    return func
+
+
+def scratch():
+    """Folder the generated trees are kept in."""
+    base = '/dev/shm' if os.access('/dev/shm', os.W_OK) else tempfile.gettempdir()
+    return os.path.join(base, 'tree-bench')
+
+
+def folder(**params):
+    """Returns (cwd, name) of the tree mktree builds from params, building it on first use.
+    tree.com takes anything starting with '/' for a switch, so it is given name from cwd."""
+    root = os.path.join(scratch(), '-'.join('%s%s' % item for item in sorted(params.items())))
+    if not os.path.exists(os.path.join(root, '.done')):
+        shutil.rmtree(root, ignore_errors=True)
+        os.makedirs(root)
+        mktree.make(os.path.join(root, 't'), **params)
+        open(os.path.join(root, '.done'), 'w').close()
+    return root, 't'
+
+
+def archives(entries):
+    """Returns the folder holding large.zip and large.tar.gz of entries entries, built on first use."""
+    root = os.path.join(scratch(), 'archives-%d' % entries)
+    if not os.path.exists(os.path.join(root, '.done')):
+        shutil.rmtree(root, ignore_errors=True)
+        mkarchive.large(root, entries, 1)
+        open(os.path.join(root, '.done'), 'w').close()
+    return root
+
+
+class Run:
+    """One run of a program: wall and CPU seconds, what it wrote and --stats:json. Its peak
+    RSS comes from --stats, as ru_maxrss would include this process's from before exec."""
+
+    def __init__(self, argv, cwd, env=None, stdout=None):
+        out = tempfile.TemporaryFile(dir=scratch())
+        err = tempfile.TemporaryFile()
+        start = time.perf_counter()
+        proc = subprocess.Popen(argv, cwd=cwd, env=env, stdout=stdout or out, stderr=err)
+        _, status, usage = os.wait4(proc.pid, 0)
+        self.wall = time.perf_counter() - start
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        if proc.returncode != 0:
+            err.seek(0)
+            raise RuntimeError('%s exited with %d: %s' % (' '.join(argv), proc.returncode, err.read().decode()))
+        self.cpu = usage.ru_utime + usage.ru_stime
+        self.bytes = 0
+        self.lines = 0
+        out.seek(0)
+        for block in iter(lambda: out.read(1 << 20), b''):
+            self.bytes += len(block)
+            self.lines += block.count(b'\n')
+        err.seek(0)
+        tail = err.read().strip().rsplit(b'\n', 1)[-1]
+        self.stats = json.loads(tail) if tail.startswith(b'{') else {}
+
+
+class Target:
+    """A tree binary, and the revision it was built from. The build folder's own
+    tree is the working tree's, named by git describe."""
+
+    def __init__(self, build, rev, repeat):
+        self.build = build
+        self.current = rev is None
+        self.rev = rev or subprocess.run(['git', 'describe', '--always', '--dirty'], cwd=HERE,
+                                         stdout=subprocess.PIPE, check=True).stdout.decode().strip()
+        self.repeat = repeat
+        self.tree = os.path.join(build, 'tree')
+        self.usage = None
+
+    def run(self, args, cwd, env=None, stdout=None):
+        """Runs tree with args repeat times and keeps the fastest run, by wall time."""
+        runs = [Run([self.tree] + args, cwd, env, stdout) for _ in range(self.repeat)]
+        return min(runs, key=lambda r: r.wall)
+
+    def supports(self, switch):
+        """True if this build of tree takes switch. Older revisions ignore switches they do
+        not know, so this looks for it in their usage text."""
+        if self.usage is None:
+            self.usage = subprocess.run([self.tree, '/?'], stdout=subprocess.PIPE,
+                                        stderr=subprocess.STDOUT).stdout.decode()
+        return re.search(r'[\[ ]%s\b' % re.escape(switch.split(':')[0]), self.usage) is not None
+
+def rate(count, seconds):
+    return round(count / seconds) if seconds > 0 else None
+
+
+@scenario
+def utf8(target):
+    """The transcoder microbenchmark, per name and per output step (only for the build folder)."""
+    bench = os.path.join(target.build, 'utf8_bench')
+    if not target.current or not os.path.exists(bench):
+        return
+    for line in subprocess.run([bench], stdout=subprocess.PIPE, check=True).stdout.decode().splitlines():
+        yield json.loads(line)
+
+
+@scenario
+def render(target):
+    """Lines per second of each line renderer: either glyph set, with and without files."""
+    folders = folder(fanout=8, depth=5, files=0)
+    files = folder(fanout=8, depth=4, files=20)
+    for variant, switches, (cwd, name) in (('folders', [], folders), ('folders-ascii', ['/A'], folders),
+                                           ('files', ['/F'], files), ('files-ascii', ['/F', '/A'], files)):
+        r = target.run([name] + switches, cwd)
+        yield {'bench': 'render', 'variant': variant, 'lines': r.lines, 'wall_ms': round(r.wall * 1000, 2),
+               'lines_per_s': rate(r.lines, r.wall)}
+
+
+@scenario
+def lines(target):
+    """CPU time per line when lines are long: deep prefixes and long names, so assembling
+    each line costs more than finding its entry."""
+    cwd, name = folder(fanout=2, depth=12, files=8, name_len=48)
+    for variant, switches in (('files', ['/F']), ('files-ascii', ['/F', '/A'])):
+        r = target.run([name] + switches, cwd)
+        yield {'bench': 'lines', 'variant': variant, 'lines': r.lines, 'bytes': r.bytes,
+               'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+               'cpu_ns_per_line': round(r.cpu * 1e9 / r.lines, 1)}
+
+
+@scenario
+def modes(target):
+    """Every output mode over one tree with a fifth of its names non ASCII: entries per second,
+    peak RSS and, where --stats is there to count them, system calls."""
+    cwd, name = folder(fanout=6, depth=4, files=40, name_len=16, name_dist='lognormal', unicode=20)
+    stats = ['--stats:json'] if target.supports('--stats:json') else []
+    for variant, switches in (('folders', []), ('files', ['/F']), ('ascii', ['/F', '/A']),
+                              ('json', ['/F', '/JSON']), ('ndjson', ['/F', '/NDJSON']),
+                              ('paths', ['/F', '/P']), ('count', ['/F', '/C'])):
+        if not all(target.supports(switch) for switch in switches):
+            continue
+        r = target.run([name] + switches + stats, cwd)
+        entries = r.stats.get('entries', r.lines)
+        result = {'bench': 'modes', 'variant': variant, 'entries': entries, 'bytes': r.bytes,
+                  'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+                  'entries_per_s': rate(entries, r.wall)}
+        for key, field in (('peak_working_set', 'peak_rss'), ('system_calls', 'system_calls')):
+            if key in r.stats:
+                result[field] = r.stats[key]
+        yield result
+
+
+@scenario
+def count(target):
+    """/C against the listing it counts, over one tree of 200k entries: /C writes one line
+    where /F writes one per entry, so what is left is the cost of reading the folders."""
+    if not target.supports('/C'):
+        return
+    cwd, name = folder(fanout=8, depth=4, files=40)
+    stats = ['--stats:json'] if target.supports('--stats:json') else []
+    for variant, switches in (('list', ['/F']), ('count', ['/F', '/C']),
+                              ('list-folders', []), ('count-folders', ['/C'])):
+        r = target.run([name] + switches + stats, cwd)
+        entries = r.stats.get('entries', r.lines)
+        result = {'bench': 'count', 'variant': variant, 'entries': entries, 'bytes': r.bytes,
+                  'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+                  'entries_per_s': rate(entries, r.wall)}
+        for key, field in (('peak_working_set', 'peak_rss'), ('system_calls', 'system_calls')):
+            if key in r.stats:
+                result[field] = r.stats[key]
+        yield result
+
+
+@scenario
+def prefetch(target):
+    """A /SYNTH tree taking 2 ms to open each folder, as an SD card or network share might,
+    read with a growing window of sibling folders read ahead."""
+    if not target.supports('/SYNTH') or not target.supports('/PREFETCH'):
+        return
+    spec = '/SYNTH:5,3,20,12,10,2000,1'
+    for ahead in (0, 1, 4, 16):
+        r = target.run([spec, '/F', '/PREFETCH:%d' % ahead], scratch())
+        yield {'bench': 'prefetch', 'variant': 'ahead-%d' % ahead, 'lines': r.lines,
+               'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+               'lines_per_s': rate(r.lines, r.wall)}
+
+
+@scenario
+def console(target):
+    """A 100k line listing written to a terminal, through the console path and, with
+    TREE_CONSOLE=0, through the UTF-8 file path. On Windows the console path is batched
+    WriteConsoleW calls; here each batch is one write(2) to a pty, so this measures the
+    batching, not the console host."""
+    cwd, name = folder(fanout=8, depth=4, files=20)
+    for variant, force in (('console', None), ('file', '0')):
+        env = dict(os.environ)
+        env.pop('TREE_CONSOLE', None)
+        if force is not None:
+            env['TREE_CONSOLE'] = force
+        with Terminal() as term:
+            r = target.run([name, '/F'], cwd, env, term.slave)
+        yield {'bench': 'console', 'variant': variant, 'lines': term.lines // target.repeat,
+               'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+               'lines_per_s': rate(term.lines // target.repeat, r.wall)}
+
+
+@scenario
+def archive(target):
+    """A 500000 entry ZIP and TAR.GZ listed without extracting them: the whole archive is
+    read and every folder's entries sorted before the first line is written."""
+    if not target.supports('/IMAGE') or 'ZIP' not in target.usage:
+        return
+    cwd = archives(500000)
+    stats = ['--stats:json'] if target.supports('--stats:json') else []
+    for variant in ('large.zip', 'large.tar.gz'):
+        r = target.run([variant, '/F'] + stats, cwd)
+        result = {'bench': 'archive', 'variant': variant, 'lines': r.lines,
+                  'wall_ms': round(r.wall * 1000, 2), 'cpu_ms': round(r.cpu * 1000, 2),
+                  'lines_per_s': rate(r.lines, r.wall)}
+        if 'peak_working_set' in r.stats:
+            result['peak_rss'] = r.stats['peak_working_set']
+        yield result
+
+
+def revision(rev, build):
+    """Builds tree as of git revision rev with this posix layer, returns its build folder.
+    The sources are extracted once; make brings the build up to date with the layer."""
+    dest = os.path.join(build, 'rev', rev)
+    src = os.path.join(dest, 'src')
+    if not os.path.exists(os.path.join(src, '.done')):
+        top = subprocess.run(['git', 'rev-parse', '--show-toplevel'], cwd=HERE,
+                             stdout=subprocess.PIPE, check=True).stdout.decode().strip()
+        prefix = os.path.relpath(os.path.dirname(HERE), top).replace(os.sep, '/')
+        archive = subprocess.run(['git', 'archive', '--format=tar', '%s:%s' % (rev, prefix)], cwd=top,
+                                 stdout=subprocess.PIPE, check=True).stdout
+        shutil.rmtree(src, ignore_errors=True)
+        os.makedirs(src)
+        with tarfile.open(fileobj=io.BytesIO(archive)) as tar:
+            tar.extractall(src)
+        open(os.path.join(src, '.done'), 'w').close()
+    subprocess.run(['make', '-s', 'SRC=' + src, 'BUILD=' + dest, os.path.join(dest, 'tree')], cwd=HERE, check=True)
+    return dest
+
+
+# the measurements compare prints, lower is better for each
+COMPARED = ('wall_ms', 'cpu_ns_per_line')
+
+
+def compare(results, rev):
+    """Writes each result's measurements next to those of rev to stderr."""
+    base = {(r['bench'], r['variant']): r for r in results if r['rev'] == rev}
+    for r in results:
+        other = base.get((r['bench'], r['variant']))
+        if r['rev'] == rev or other is None:
+            continue
+        for key in COMPARED:
+            if key not in r or not other.get(key):
+                continue
+            change = (r[key] - other[key]) / other[key] * 100
+            print('%-10s %-16s %-15s %-12s %10.2f  %-12s %10.2f  %+6.1f%%' % (
+                r['bench'], r['variant'], key, r['rev'], r[key], rev, other[key], change), file=sys.stderr)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Runs the benchmarks.')
+    p.add_argument('--build', default=os.path.join(HERE, 'build'), help='build folder holding tree')
+    p.add_argument('--against', metavar='REV', action='append', default=[], help='git revision to compare with')
+    p.add_argument('--out', help='file the results are written to, default BUILD/bench.json')
+    p.add_argument('--repeat', type=int, default=5, help='runs of each variant, the fastest counts')
+    p.add_argument('scenarios', nargs='*', metavar='SCENARIO', help=', '.join(SCENARIOS))
+    args = p.parse_args()
+
+    names = args.scenarios or list(SCENARIOS)
+    for name in names:
+        if name not in SCENARIOS:
+            p.error('no scenario %s' % name)
+
+    os.makedirs(scratch(), exist_ok=True)
+    targets = [Target(os.path.abspath(args.build), None, args.repeat)]
+    for rev in args.against:
+        targets.append(Target(revision(rev, os.path.abspath(args.build)), rev, args.repeat))
+
+    results = []
+    with open(args.out or os.path.join(args.build, 'bench.json'), 'w') as out:
+        for name in names:
+            for target in targets:
+                for result in SCENARIOS[name](target):
+                    result['rev'] = target.rev
+                    results.append(result)
+                    line = json.dumps(result, ensure_ascii=False)
+                    print(line)
+                    out.write(line + '\n')
+
+    if args.against:
+        compare(results, args.against[0])
+
+
+if __name__ == '__main__':
+    main()
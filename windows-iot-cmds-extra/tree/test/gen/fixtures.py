@@ -0,0 +1,99 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Builds the folders the golden tests list, with fixed sizes and times
+#
+#   python3 gen/fixtures.py OUT
+
+import os
+import shutil
+import sys
+
+import mkarchive
+import mkimage
+import mkntfs
+
+# 2021-06-15 13:45:30 UTC, every entry gets this modification time unless it says otherwise
+MTIME = 1623764730
+
+
+def build(root, tree, mtime=MTIME):
+    """Creates tree under root: a dict value is a folder, an int a file of that many bytes,
+    a (size, mtime) tuple a file with a time of its own."""
+    os.makedirs(root, exist_ok=True)
+    for name, value in tree.items():
+        path = os.path.join(root, name)
+        if isinstance(value, dict):
+            build(path, value, mtime)
+            continue
+        size, when = value if isinstance(value, tuple) else (value, mtime)
+        with open(path, 'wb') as f:
+            f.write(bytes((i * 7 + len(name)) & 0xFF for i in range(size)))
+        os.utime(path, (when, when))
+    os.utime(root, (mtime, mtime))
+
+
+# names from every UTF-8 length class, including one outside the BMP and a combining sequence
+UNICODE = {
+    'ASCII.txt': 10,
+    'café.txt': 11,
+    'naïve résumé.doc': 12,
+    'combining é.txt': 13,
+    'emoji \U0001F600.txt': 14,
+    'Русский.txt': 15,
+    '日本語フォルダ': {
+        '中文.txt': 16,
+        '한국어': {'데이터.bin': 17},
+    },
+    'Ελληνικά': {},
+    'zzz': {'deep': {'deeper': {'bottom.txt': 1}}},
+}
+
+# enough lines for several of the writer's 64 KB chunks
+MANY = {'folder %02d' % i: {'file %03d with a longer name.txt' % j: (i + j) % 7 for j in range(60)}
+        for i in range(80)}
+
+# files a second, a minute, a day and years apart around MTIME, for /NEWER and /OLDER
+DATED = {
+    'early.txt': (1, 1577836800),
+    'minute before.txt': (2, MTIME - 60),
+    'exact.txt': (3, MTIME),
+    'second after.txt': (4, MTIME + 1),
+    'day after.txt': (5, MTIME + 86400),
+    'leap day.txt': (6, 1709164800),
+}
+
+# built both as a folder and, by mkimage.py and mkntfs.py, as file system images in images/,
+# and by mkarchive.py as archives
+IMAGED = {
+    'README.TXT': 1234,
+    'long file name.txt': 77,
+    'Ünïcode 文件.txt': 5,
+    'emoji \U0001F600.txt': 6,
+    'EMPTYF': 0,
+    'Docs': dict({'Document number %02d with a long name.txt' % i: i * 100 for i in range(40)},
+                 Deep={'Deeper': {'bottom.bin': 1}, 'NOTE.TXT': 3}),
+    'Empty': {},
+    'Mixed.Case.Dir': {'a.b.c': 1, 'noext': 2, 'SUB': {'x': 1}},
+}
+
+FIXTURES = {
+    'unicode': UNICODE,
+    'many': MANY,
+    'dated': DATED,
+    'imaged': IMAGED,
+}
+
+
+def main():
+    out = sys.argv[1]
+    if os.path.exists(out):
+        shutil.rmtree(out)
+    for name, tree in FIXTURES.items():
+        build(os.path.join(out, name), tree)
+    mkimage.build(os.path.join(out, 'images'), IMAGED)
+    mkntfs.build(os.path.join(out, 'images'), IMAGED)
+    mkarchive.build(os.path.join(out, 'images'), IMAGED)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,157 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Builds ZIP, TAR and TAR.GZ archives for the golden tests and benchmarks
+#
+#   python3 gen/mkarchive.py OUT
+#   python3 gen/mkarchive.py OUT --entries N [--seed N]
+#
+# The first form writes the IMAGED tree of fixtures.py into OUT as
+# imaged.zip, imaged.tar in each of the ustar, GNU and pax formats and
+# imaged.tar.gz, every entry stored at MTIME, and as pax-unterminated.tar,
+# whose pax size record lacks its newline. Entries are stored in an order
+# of their own, folders only implied by the paths of some of the files in
+# them, so the listing has to be put together rather than read off.
+#
+# The second form writes large.zip and large.tar.gz holding N entries,
+# files and folders with random names seeded with seed, for
+# bench.py. The files are empty, so even 500000 entries take a few tens
+# of MB.
+
+import argparse
+import io
+import os
+import random
+import sys
+import tarfile
+import time
+import zipfile
+
+# every entry gets this modification time, as in fixtures.py
+MTIME = 1623764730
+
+ALPHABET = 'abcdefghijklmnopqrstuvwxyz0123456789_-'
+
+
+def flatten(tree, prefix=''):
+    """(path, size) of every entry below tree, size None for a folder."""
+    for name, value in tree.items():
+        path = prefix + name
+        if isinstance(value, dict):
+            yield path, None
+            yield from flatten(value, path + '/')
+        else:
+            yield path, value[0] if isinstance(value, tuple) else value
+
+
+def shuffled(entries, seed):
+    """entries in a fixed random order, leaving out half the folders that hold something,
+    which the archive then only implies."""
+    rng = random.Random(seed)
+    entries = list(entries)
+    parents = {path.rsplit('/', 1)[0] for path, _ in entries if '/' in path}
+    entries = [e for e in entries if e[1] is not None or e[0] not in parents or rng.random() < 0.5]
+    rng.shuffle(entries)
+    return entries
+
+
+def write_zip(path, entries):
+    when = time.gmtime(MTIME)[:6]
+    with zipfile.ZipFile(path, 'w', zipfile.ZIP_STORED, allowZip64=True) as z:
+        for name, size in entries:
+            if size is None:
+                info = zipfile.ZipInfo(name + '/', when)
+                info.external_attr = (0o40755 << 16) | 0x10
+                z.writestr(info, b'')
+            else:
+                info = zipfile.ZipInfo(name, when)
+                info.external_attr = 0o100644 << 16
+                z.writestr(info, bytes(size))
+
+
+def write_tar(path, entries, fmt, mode='w'):
+    with tarfile.open(path, mode, format=fmt) as t:
+        for name, size in entries:
+            info = tarfile.TarInfo(name)
+            info.mtime = MTIME
+            if size is None:
+                info.type = tarfile.DIRTYPE
+                t.addfile(info)
+            else:
+                info.size = size
+                t.addfile(info, io.BytesIO(bytes(size)))
+
+
+def ustar_header(name, size, kind=b'0'):
+    """A ustar header block with its checksum filled in."""
+    h = bytearray(512)
+    h[0:len(name)] = name
+    h[100:108] = b'0000644\0'
+    h[108:116] = h[116:124] = b'0000000\0'
+    h[124:136] = b'%011o\0' % size
+    h[136:148] = b'%011o\0' % MTIME
+    h[148:156] = b' ' * 8
+    h[156:157] = kind
+    h[257:263] = b'ustar\0'
+    h[263:265] = b'00'
+    h[148:156] = b'%06o\0 ' % sum(h)
+    return bytes(h)
+
+
+def pax_unterminated(path):
+    """a.txt of 5 bytes, whose pax size record "9 size=55" has no newline: the length covers
+    the record up to its last digit, which is taken for the newline, so the size is 5. Reading
+    on to the end of the digits would give 55, and past the end of the header if it was last."""
+    record = b'9 size=55'
+    blocks = [ustar_header(b'PaxHeaders/a.txt', len(record), b'x'), record.ljust(512, b'\0'),
+              ustar_header(b'a.txt', 5), b'hello'.ljust(512, b'\0'),
+              ustar_header(b'b.txt', 2), b'hi'.ljust(512, b'\0'), bytes(1024)]
+    with open(path, 'wb') as f:
+        f.write(b''.join(blocks))
+
+
+def build(out, tree):
+    os.makedirs(out, exist_ok=True)
+    entries = shuffled(flatten(tree), 1)
+    write_zip(os.path.join(out, 'imaged.zip'), entries)
+    write_tar(os.path.join(out, 'imaged.tar'), entries, tarfile.USTAR_FORMAT)
+    write_tar(os.path.join(out, 'imaged-gnu.tar'), entries, tarfile.GNU_FORMAT)
+    write_tar(os.path.join(out, 'imaged-pax.tar'), entries, tarfile.PAX_FORMAT)
+    write_tar(os.path.join(out, 'imaged.tar.gz'), entries, tarfile.PAX_FORMAT, 'w:gz')
+    pax_unterminated(os.path.join(out, 'pax-unterminated.tar'))
+
+
+def large(out, count, seed):
+    """count entries, a tenth of them folders, each file or folder in a folder made before it."""
+    rng = random.Random(seed)
+    folders = ['']
+    entries = []
+    for i in range(count):
+        parent = rng.choice(folders)
+        name = (parent + '/' if parent else '') + ''.join(rng.choice(ALPHABET) for _ in range(rng.randint(4, 20)))
+        name += '.%d' % i
+        if rng.random() < 0.1:
+            folders.append(name)
+            entries.append((name, None))
+        else:
+            entries.append((name, 0))
+    os.makedirs(out, exist_ok=True)
+    write_zip(os.path.join(out, 'large.zip'), entries)
+    write_tar(os.path.join(out, 'large.tar.gz'), entries, tarfile.PAX_FORMAT, 'w:gz')
+
+
+def main():
+    p = argparse.ArgumentParser(description='Builds archives for the golden tests and benchmarks.')
+    p.add_argument('out', help='folder to write the archives into')
+    p.add_argument('--entries', type=int, help='build large archives of this many entries instead')
+    p.add_argument('--seed', type=int, default=1, help='seed of the names in the large archives')
+    args = p.parse_args()
+    if args.entries:
+        large(args.out, args.entries, args.seed)
+    else:
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        import fixtures
+        build(args.out, fixtures.IMAGED)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,420 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Builds FAT12, FAT16, FAT32 and exFAT images for the golden tests
+#
+#   python3 gen/mkimage.py OUT
+#
+# Writes the IMAGED tree of fixtures.py as fat12.img, fat16.img, fat32.img
+# and exfat.img into OUT, and mbr.img holding the FAT16 volume in its second
+# slot and the exFAT one in its fourth. gpt.img holds the same two volumes
+# as the first and third entries of a GPT, and gpt-*.img are 4 KB disks
+# whose GPT is damaged or hostile, see gpt_hostile. mkfs.fat and mkfs.exfat would need
+# root to fill an image, so the structures are laid out here instead: entries
+# in the order tree.com's POSIX layer sorts a folder, so an image lists the
+# same as the folder built from the same tree, every entry written at MTIME,
+# names that don't fit 8.3 given long name entries, a deleted entry in every
+# folder and the chains of folders and files spread over every other cluster.
+# Images are written sparse, the FAT32 one needs 65525 clusters to be one.
+
+import os
+import struct
+import sys
+
+# 2021-06-15 13:45:30, as fixtures.MTIME
+DATE = ((2021 - 1980) << 9) | (6 << 5) | 15
+TIME = (13 << 11) | (45 << 5) | (30 // 2)
+
+SERIAL = 0x1234ABCD
+LABEL = 'IMAGED'
+
+
+def order(tree):
+    """The entries of a folder as the POSIX layer returns them, compared upper cased."""
+    return sorted(tree.items(), key=lambda item: [ord(c.upper()) if len(c.upper()) == 1 else ord(c) for c in item[0]])
+
+
+def needs_long_name(name):
+    try:
+        name.encode('ascii')
+    except UnicodeEncodeError:
+        return True
+    base, _, ext = name.partition('.')
+    return (name != name.upper() or '.' in ext or ' ' in name or not base or
+            len(base) > 8 or len(ext) > 3)
+
+
+def short_name(name, used):
+    """The 11 bytes of the 8.3 name, with a ~N tail where a long name goes along."""
+    if not needs_long_name(name):
+        base, _, ext = name.partition('.')
+        return (base.ljust(8) + ext.ljust(3)).encode()
+    base, _, ext = name.rpartition('.') if '.' in name else (name, '', '')
+    clean = lambda s: ''.join(c for c in s.upper() if c.isascii() and c.isalnum()) or 'X'
+    base, ext = clean(base), clean(ext)[:3] if ext else ''
+    for i in range(1, 1000):
+        tail = '~%d' % i
+        short = (base[:8 - len(tail)] + tail).ljust(8) + ext.ljust(3)
+        if short not in used:
+            used.add(short)
+            return short.encode()
+    raise ValueError('too many names like ' + name)
+
+
+def checksum(short):
+    s = 0
+    for c in short:
+        s = (((s & 1) << 7) + (s >> 1) + c) & 0xFF
+    return s
+
+
+def fat_entries(name, attr, cluster, size, used):
+    """The long name entries of name, if it needs them, followed by its short entry."""
+    out = []
+    short = short_name(name, used)
+    if needs_long_name(name):
+        units = name.encode('utf-16-le')
+        chars = [units[i:i + 2] for i in range(0, len(units), 2)] + [b'\0\0']
+        while len(chars) % 13:
+            chars.append(b'\xff\xff')
+        parts = [chars[i:i + 13] for i in range(0, len(chars), 13)]
+        for n in range(len(parts), 0, -1):
+            part = parts[n - 1]
+            e = bytearray(32)
+            e[0] = n | (0x40 if n == len(parts) else 0)
+            e[1:11] = b''.join(part[0:5])
+            e[11] = 0x0F
+            e[13] = checksum(short)
+            e[14:26] = b''.join(part[5:11])
+            e[28:32] = b''.join(part[11:13])
+            out.append(bytes(e))
+    out.append(struct.pack('<11sBBBHHHHHHHI', short, attr, 0, 0, TIME, DATE, DATE,
+                           cluster >> 16, TIME, DATE, cluster & 0xFFFF, size))
+    return out
+
+
+def dot_entry(name, cluster):
+    return struct.pack('<11sBBBHHHHHHHI', name.ljust(11).encode(), 0x10, 0, 0, TIME, DATE, DATE,
+                       cluster >> 16, TIME, DATE, cluster & 0xFFFF, 0)
+
+
+def deleted_entry(used):
+    e = bytearray(fat_entries('DELETED.TXT', 0x20, 0, 5, used)[-1])
+    e[0] = 0xE5
+    return bytes(e)
+
+
+class Fat:
+    """A FAT12, FAT16 or FAT32 volume of 512 byte sectors and clusters."""
+
+    def __init__(self, bits, sectors, root_entries=512):
+        self.bits = bits
+        self.reserved = 32 if bits == 32 else 1
+        self.root_entries = 0 if bits == 32 else root_entries
+        self.sectors = sectors
+        root_sectors = (self.root_entries * 32 + 511) // 512
+        self.fat_sectors = ((sectors + 2) * bits // 8 + 511) // 512 + 1
+        self.root_off = (self.reserved + 2 * self.fat_sectors) * 512
+        self.heap = self.root_off + root_sectors * 512
+        self.clusters = sectors - self.reserved - 2 * self.fat_sectors - root_sectors
+        self.fat = [0] * (self.clusters + 2)
+        self.fat[0] = 0x0FFFFFF8
+        self.fat[1] = 0x0FFFFFFF
+        self.img = bytearray(sectors * 512)
+        self.next = 2
+        assert (self.clusters < 4085) == (bits == 12) and (4085 <= self.clusters < 65525) == (bits == 16), self.clusters
+
+    def alloc(self, n):
+        chain = list(range(self.next, self.next + 2 * n, 2))
+        self.next += 2 * n
+        for a, b in zip(chain, chain[1:]):
+            self.fat[a] = b
+        self.fat[chain[-1]] = 0x0FFFFFFF
+        return chain
+
+    def write_chain(self, chain, data):
+        data = data.ljust(len(chain) * 512, b'\0')
+        assert len(data) == len(chain) * 512
+        for i, c in enumerate(chain):
+            off = self.heap + (c - 2) * 512
+            self.img[off:off + 512] = data[i * 512:(i + 1) * 512]
+
+    def folder(self, tree, me, parent):
+        """The entries of a folder, and the sub folders still to be written with their chains."""
+        used = set()
+        if me is None:
+            entries = [struct.pack('<11sB20s', LABEL.ljust(11).encode(), 0x08, b'')]
+        else:
+            entries = [dot_entry('.', me), dot_entry('..', parent)]
+        entries.append(deleted_entry(used))
+        subs = []
+        for name, value in order(tree):
+            if isinstance(value, dict):
+                size = sum(32 * (2 + len(n) // 13) for n in value) + 3 * 32
+                chain = self.alloc(size // 512 + 1)
+                entries += fat_entries(name, 0x10, chain[0], 0, used)
+                subs.append((value, chain))
+            else:
+                size = value[0] if isinstance(value, tuple) else value
+                chain = self.alloc((size + 511) // 512) if size else [0]
+                entries += fat_entries(name, 0x20, chain[0], size, used)
+        return b''.join(entries), subs
+
+    def build(self, tree):
+        if self.bits == 32:
+            root = self.alloc(3)
+            data, subs = self.folder(tree, None, 0)
+            self.write_chain(root, data)
+        else:
+            root = [0]
+            data, subs = self.folder(tree, None, 0)
+            assert len(data) <= self.root_entries * 32
+            self.img[self.root_off:self.root_off + len(data)] = data
+        # .. of a folder in the root is cluster 0, also on FAT32
+        todo = [(t, chain, 0) for t, chain in subs]
+        while todo:
+            t, chain, parent = todo.pop()
+            data, subs = self.folder(t, chain[0], parent)
+            self.write_chain(chain, data)
+            todo += [(t2, chain2, chain[0]) for t2, chain2 in subs]
+        table = bytearray(self.fat_sectors * 512)
+        for i, v in enumerate(self.fat):
+            if self.bits == 32:
+                struct.pack_into('<I', table, i * 4, v)
+            elif self.bits == 16:
+                struct.pack_into('<H', table, i * 2, v & 0xFFFF)
+            else:
+                v &= 0xFFF
+                o = i + i // 2
+                if i & 1:
+                    table[o] = (table[o] & 0x0F) | ((v & 0xF) << 4)
+                    table[o + 1] = v >> 4
+                else:
+                    table[o] = v & 0xFF
+                    table[o + 1] = (table[o + 1] & 0xF0) | (v >> 8)
+        for k in range(2):
+            o = (self.reserved + k * self.fat_sectors) * 512
+            self.img[o:o + len(table)] = table
+        b = self.img
+        b[0:3] = b'\xEB\x3C\x90'
+        b[3:11] = b'MSWIN4.1'
+        struct.pack_into('<HBHBHHBHHHII', b, 11, 512, 1, self.reserved, 2, self.root_entries,
+                         self.sectors if self.sectors < 65536 else 0, 0xF8,
+                         0 if self.bits == 32 else self.fat_sectors, 63, 255, 0,
+                         self.sectors if self.sectors >= 65536 else 0)
+        if self.bits == 32:
+            struct.pack_into('<IHHI', b, 36, self.fat_sectors, 0, 0, root[0])
+            ext = 0x40
+        else:
+            ext = 0x24
+        b[ext + 2] = 0x29
+        struct.pack_into('<I', b, ext + 3, SERIAL)
+        b[ext + 7:ext + 18] = b'NO NAME    '
+        b[510:512] = b'\x55\xAA'
+        return bytes(b)
+
+
+class Exfat:
+    """An exFAT volume of 4 KB clusters, folders alternately contiguous and chained in the FAT."""
+
+    SHIFT = 3
+
+    def __init__(self, clusters=1024):
+        self.cluster = 512 << self.SHIFT
+        self.fat_off = 24
+        self.fat_len = (clusters * 4 + 511) // 512
+        self.heap_sec = 64 + self.fat_len
+        self.clusters = clusters
+        self.img = bytearray(self.heap_sec * 512 + clusters * self.cluster)
+        self.fat = [0] * (clusters + 2)
+        self.fat[0] = 0xFFFFFFF8
+        self.fat[1] = 0xFFFFFFFF
+        self.next = 2
+
+    def alloc(self, n, contiguous):
+        step = 1 if contiguous else 2
+        chain = list(range(self.next, self.next + step * n, step))
+        self.next += step * n + 1
+        if not contiguous:
+            for a, b in zip(chain, chain[1:]):
+                self.fat[a] = b
+            self.fat[chain[-1]] = 0xFFFFFFFF
+        return chain
+
+    def write_chain(self, chain, data):
+        data = data.ljust(len(chain) * self.cluster, b'\0')
+        assert len(data) == len(chain) * self.cluster
+        for i, c in enumerate(chain):
+            off = self.heap_sec * 512 + (c - 2) * self.cluster
+            self.img[off:off + self.cluster] = data[i * self.cluster:(i + 1) * self.cluster]
+
+    def entries(self, name, attr, first, length, contiguous):
+        """The file, stream extension and name entries of one file or folder, times in UTC."""
+        units = name.encode('utf-16-le')
+        names = (len(units) // 2 + 14) // 15
+        stamp = (DATE << 16) | TIME
+        f = bytearray(32)
+        f[0] = 0x85
+        f[1] = 1 + names
+        struct.pack_into('<H', f, 4, attr)
+        struct.pack_into('<III', f, 8, stamp, stamp, stamp)
+        f[22] = f[23] = f[24] = 0x80
+        s = bytearray(32)
+        s[0] = 0xC0
+        s[1] = 0x01 | (0x02 if contiguous else 0)
+        s[3] = len(units) // 2
+        struct.pack_into('<Q', s, 8, length)
+        struct.pack_into('<I', s, 20, first)
+        struct.pack_into('<Q', s, 24, length)
+        out = [bytes(f), bytes(s)]
+        for i in range(names):
+            n = bytearray(32)
+            n[0] = 0xC1
+            chunk = units[i * 30:(i + 1) * 30]
+            n[2:2 + len(chunk)] = chunk
+            out.append(bytes(n))
+        return out
+
+    def folder(self, tree, is_root):
+        entries = []
+        if is_root:
+            label = LABEL.encode('utf-16-le')
+            e = bytearray(32)
+            e[0] = 0x83
+            e[1] = len(LABEL)
+            e[2:2 + len(label)] = label
+            entries.append(bytes(e))
+        for e in self.entries('gone.txt', 0x20, 0, 0, True):
+            entries.append(bytes([e[0] & 0x7F]) + e[1:])
+        subs = []
+        for k, (name, value) in enumerate(order(tree)):
+            if isinstance(value, dict):
+                n = sum(32 * (3 + len(x) // 15) for x in value) // self.cluster + 1
+                contiguous = k % 2 == 0
+                chain = self.alloc(n, contiguous)
+                entries += self.entries(name, 0x10, chain[0], n * self.cluster, contiguous)
+                subs.append((value, chain))
+            else:
+                size = value[0] if isinstance(value, tuple) else value
+                first = self.alloc((size + self.cluster - 1) // self.cluster, True)[0] if size else 0
+                entries += self.entries(name, 0x20, first, size, True)
+        return b''.join(entries), subs
+
+    def build(self, tree):
+        root = self.alloc(2, False)
+        todo = [(tree, root, True)]
+        while todo:
+            t, chain, is_root = todo.pop()
+            data, subs = self.folder(t, is_root)
+            self.write_chain(chain, data)
+            todo += [(t2, chain2, False) for t2, chain2 in subs]
+        table = b''.join(struct.pack('<I', v) for v in self.fat)
+        self.img[self.fat_off * 512:self.fat_off * 512 + len(table)] = table
+        b = self.img
+        b[0:3] = b'\xEB\x76\x90'
+        b[3:11] = b'EXFAT   '
+        struct.pack_into('<QQIIIIIIHHBBBB', b, 64, 0, len(b) // 512, self.fat_off, self.fat_len, self.heap_sec,
+                         self.clusters, root[0], SERIAL, 0x100, 0, 9, self.SHIFT, 1, 0x80)
+        b[510:512] = b'\x55\xAA'
+        return bytes(b)
+
+
+def mbr(volumes):
+    """A disk with a volume in each of the given slots, as {slot: (data, type)}, 1 MB apart."""
+    parts = []
+    start = 2048
+    for slot, (data, kind) in sorted(volumes.items()):
+        parts.append((slot, start, data, kind))
+        start += (len(data) // 512 + 2047) // 2048 * 2048
+    img = bytearray(start * 512)
+    for slot, first, data, kind in parts:
+        img[first * 512:first * 512 + len(data)] = data
+        struct.pack_into('<B3sB3sII', img, 446 + 16 * slot, 0, b'\0\0\0', kind, b'\0\0\0', first, len(data) // 512)
+    img[510:512] = b'\x55\xAA'
+    return bytes(img)
+
+
+def gpt_header(table, entries, entry_size):
+    """A protective MBR and a GPT header whose entries are at LBA table, without checksums,
+    which tree.com doesn't check."""
+    img = bytearray(1024)
+    struct.pack_into('<B3sB3sII', img, 446, 0, b'\0\0\0', 0xEE, b'\0\0\0', 1, 0xFFFFFFFF)
+    img[510:512] = b'\x55\xAA'
+    img[512:520] = b'EFI PART'
+    struct.pack_into('<IIIIQQQQ16sQII', img, 520, 0x10000, 92, 0, 0, 1, 0, 34, 0, b'\x11' * 16,
+                     table, entries, entry_size)
+    return img
+
+
+def gpt_entry(first, last):
+    return struct.pack('<16s16sQQ', b'\xa2' * 16, b'\x33' * 16, first, last).ljust(128, b'\0')
+
+
+def gpt(volumes):
+    """A disk with a volume in each of the given entries, as {index: data}, 1 MB apart."""
+    table = bytearray(128 * 128)
+    start = 2048
+    parts = []
+    for index, data in sorted(volumes.items()):
+        sectors = len(data) // 512
+        table[index * 128:(index + 1) * 128] = gpt_entry(start, start + sectors - 1)
+        parts.append((start, data))
+        start += (sectors + 2047) // 2048 * 2048
+    img = bytearray(start * 512)
+    img[0:1024] = gpt_header(2, 128, 128)
+    img[1024:1024 + len(table)] = table
+    for first, data in parts:
+        img[first * 512:first * 512 + len(data)] = data
+    return bytes(img)
+
+
+def gpt_hostile():
+    """4 KB disks whose GPT must be refused without reading outside them, as {name: data}:
+    an entry LBA whose byte offset wraps around, entries of sizes that are not a multiple of
+    8 or larger than a sector, a partition starting past the end of the disk and one ending
+    past it, and more entries than fit."""
+    def disk(table, entries, entry_size, entry=b''):
+        img = bytearray(4096)
+        img[0:1024] = gpt_header(table, entries, entry_size)
+        img[1024:1024 + len(entry)] = entry
+        return bytes(img)
+    return {
+        'wrap': disk(0x007FFFFFFFFFFFFF, 1, 0x200),
+        'lba': disk(9, 1, 128, gpt_entry(2, 3)),
+        'odd': disk(2, 4, 130, gpt_entry(2, 3)),
+        'big': disk(2, 1, 1024, gpt_entry(2, 3)),
+        'start': disk(2, 1, 128, gpt_entry(1 << 40, (1 << 40) + 7)),
+        'end': disk(2, 1, 128, gpt_entry(3, 1 << 40)),
+        'many': disk(2, 0xFFFFFFFF, 128),
+    }
+
+
+def write(path, data):
+    """Writes data leaving the 4 KB pages that are all zero as holes."""
+    zero = bytes(4096)
+    with open(path, 'wb') as f:
+        for off in range(0, len(data), 4096):
+            page = data[off:off + 4096]
+            if page != zero[:len(page)]:
+                f.seek(off)
+                f.write(page)
+        f.truncate(len(data))
+
+
+def build(out, tree):
+    os.makedirs(out, exist_ok=True)
+    fat16 = Fat(16, 4400).build(tree)
+    exfat = Exfat().build(tree)
+    write(os.path.join(out, 'fat12.img'), Fat(12, 2880, 224).build(tree))
+    write(os.path.join(out, 'fat16.img'), fat16)
+    write(os.path.join(out, 'fat32.img'), Fat(32, 66700).build(tree))
+    write(os.path.join(out, 'exfat.img'), exfat)
+    write(os.path.join(out, 'mbr.img'), mbr({1: (fat16, 0x06), 3: (exfat, 0x07)}))
+    write(os.path.join(out, 'gpt.img'), gpt({0: fat16, 2: exfat}))
+    for name, data in gpt_hostile().items():
+        write(os.path.join(out, 'gpt-%s.img' % name), data)
+
+
+if __name__ == '__main__':
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import fixtures
+    build(sys.argv[1], fixtures.IMAGED)
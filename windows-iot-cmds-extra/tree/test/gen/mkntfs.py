@@ -0,0 +1,271 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Builds NTFS images for the golden tests
+#
+#   python3 gen/mkntfs.py OUT
+#
+# Writes the IMAGED tree of fixtures.py as ntfs.img into OUT, and ntfs-links.img
+# holding what only NTFS has: a file with hard links in two folders, one whose
+# data is in an extension record, a record no longer in use, names differing
+# only in case in the POSIX name space, 8.3 names alongside long ones, a
+# sparse 10 GB file and a $UpCase of its own. In both the MFT is cut into
+# fragments placed on the volume back to front, so its runs go backwards.
+#
+# mkntfs and ntfs-3g would need root and FUSE to fill an image, and where
+# they run they lay the MFT out in one piece, so the records are written
+# here instead. Only what tree.com reads is filled in: the boot sector, the
+# MFT, $Volume's name, $UpCase and the records of the listed files. There
+# are no folder indexes, no $Bitmap and no $LogFile, so chkdsk would object.
+
+import os
+import random
+import struct
+import sys
+
+from mkimage import needs_long_name, short_name, write
+
+# 2021-06-15 13:45:30 UTC as a FILETIME, as fixtures.MTIME
+FILETIME = 116444736000000000 + 1623764730 * 10 ** 7
+
+SERIAL = 0x1122334455667788
+LABEL = 'IMAGED'
+
+ROOT = 5
+
+# name spaces of $FILE_NAME
+POSIX, WIN32, DOS, WIN32_AND_DOS = 0, 1, 2, 3
+
+
+def upcase_table():
+    """The upper case of every UTF-16 unit, as Windows fills $UpCase."""
+    table = []
+    for c in range(65536):
+        upper = chr(c).upper() if not 0xD800 <= c < 0xE000 else chr(c)
+        table.append(ord(upper) if len(upper) == 1 and ord(upper) < 65536 else c)
+    return table
+
+
+def pad8(data):
+    return data + b'\0' * (-len(data) % 8)
+
+
+def resident(kind, value, ident, name=''):
+    units = name.encode('utf-16-le')
+    header = 24 + len(units)
+    header += -header % 8
+    body = pad8(value)
+    return (struct.pack('<IIBBHHHIHBB', kind, header + len(body), 0, len(name), 24, 0, ident, len(value), header, 0, 0)
+            + units).ljust(header, b'\0') + body
+
+
+def mapping_pairs(runs):
+    """The run list of (lcn, length) pairs, lcn None for a hole, offsets relative to the run before."""
+    out = b''
+    prev = 0
+    for lcn, length in runs:
+        size = length.to_bytes((length.bit_length() + 8) // 8, 'little')
+        if lcn is None:
+            out += bytes([len(size)]) + size
+            continue
+        delta = lcn - prev
+        prev = lcn
+        n = 1
+        while not -(1 << (8 * n - 1)) <= delta < 1 << (8 * n - 1):
+            n += 1
+        out += bytes([(n << 4) | len(size)]) + size + (delta & ((1 << (8 * n)) - 1)).to_bytes(n, 'little')
+    return out + b'\0'
+
+
+def nonresident(kind, runs, size, ident, cluster):
+    pairs = pad8(mapping_pairs(runs))
+    clusters = sum(length for _, length in runs)
+    return struct.pack('<IIBBHHHQQHHIQQQ', kind, 64 + len(pairs), 1, 0, 64, 0, ident, 0, clusters - 1, 64, 0, 0,
+                       clusters * cluster, size, size) + pairs
+
+
+def standard_information(attributes):
+    return resident(0x10, struct.pack('<QQQQI', FILETIME, FILETIME, FILETIME, FILETIME, attributes).ljust(72, b'\0'), 0)
+
+
+def file_name(parent, name, space, size, flags=0):
+    units = name.encode('utf-16-le')
+    value = struct.pack('<QQQQQQQIIBB', parent | (1 << 48), FILETIME, FILETIME, FILETIME, FILETIME,
+                        size, size, flags, 0, len(units) // 2, space) + units
+    return resident(0x30, value, 1)
+
+
+class Ntfs:
+    """An NTFS volume of 4 KB clusters and 1 KB file records."""
+
+    CLUSTER = 4096
+    RECORD = 1024
+
+    def __init__(self, seed=1):
+        self.rng = random.Random(seed)
+        self.records = {}
+        self.files = []
+        self.next = 64
+
+    def add(self, parent, name, size=None, attributes=0x20, space=None):
+        """A file, or a folder if size is None, named in parent. Returns its record number."""
+        number = self.next
+        self.next += 1
+        if space is None:
+            space = WIN32 if needs_long_name(name) else WIN32_AND_DOS
+        names = [(parent, name, space)]
+        if space == WIN32:
+            short = short_name(name, set()).decode()
+            names.append((parent, (short[:8].rstrip() + '.' + short[8:]).rstrip('. '), DOS))
+        self.files.append(dict(number=number, names=names, size=size, attributes=attributes if size is not None else 0))
+        return number
+
+    def add_tree(self, parent, tree):
+        for name, value in tree.items():
+            if isinstance(value, dict):
+                self.add_tree(self.add(parent, name), value)
+            else:
+                self.add(parent, name, value[0] if isinstance(value, tuple) else value)
+
+    def record(self, number, attributes, flags=1, base=0):
+        b = bytearray(self.RECORD)
+        b[0:4] = b'FILE'
+        usa = self.RECORD // 512 + 1
+        struct.pack_into('<HHQHHHHIIQHHI', b, 4, 0x30, usa, 0, 1, 1, 0x38, flags, 0, self.RECORD,
+                         base | ((1 << 48) if base else 0), 0, 0, number)
+        off = 0x38
+        for a in attributes:
+            b[off:off + len(a)] = a
+            off += len(a)
+        b[off:off + 4] = b'\xff\xff\xff\xff'
+        off += 8
+        struct.pack_into('<I', b, 24, off)
+        assert off <= self.RECORD, (number, off)
+        # the last two bytes of every 512 go into the update sequence array
+        b[0x30:0x32] = b'\x07\x00'
+        for i in range(1, usa):
+            p = i * 512 - 2
+            b[0x30 + 2 * i:0x32 + 2 * i] = b[p:p + 2]
+            b[p:p + 2] = b'\x07\x00'
+        self.records[number] = bytes(b)
+
+    def build(self, fragments=4):
+        cs = self.CLUSTER
+        count = self.next + 8
+        mft_bytes = count * self.RECORD
+        mft_clusters = (mft_bytes + cs - 1) // cs
+        upcase = b''.join(struct.pack('<H', u) for u in upcase_table())
+        upcase_lcn = 16
+        upcase_clusters = len(upcase) // cs
+        # fragments of the MFT at random cuts, laid out back to front with gaps between them
+        cuts = sorted(self.rng.sample(range(1, mft_clusters), min(fragments, mft_clusters) - 1))
+        lengths = [b - a for a, b in zip([0] + cuts, cuts + [mft_clusters])]
+        first = upcase_lcn + upcase_clusters + 5
+        pos = first + mft_clusters + 3 * len(lengths)
+        mft_runs = []
+        for length in lengths:
+            pos -= length + 3
+            mft_runs.append((pos, length))
+        data_lcn = first + mft_clusters + 3 * len(lengths) + 2
+        data = {}
+        clusters = data_lcn
+        for f in self.files:
+            if f['size'] and f['size'] > 64 and not f.get('sparse'):
+                n = (f['size'] + cs - 1) // cs
+                data[f['number']] = [(clusters, n)]
+                clusters += n + 1
+        clusters += 16
+
+        self.record(0, [standard_information(6), file_name(ROOT, '$MFT', WIN32_AND_DOS, mft_bytes),
+                        nonresident(0x80, mft_runs, mft_bytes, 2, cs)])
+        self.record(1, [standard_information(6), file_name(ROOT, '$MFTMirr', WIN32_AND_DOS, 4096)])
+        self.record(3, [standard_information(6), file_name(ROOT, '$Volume', WIN32_AND_DOS, 0),
+                        resident(0x60, LABEL.encode('utf-16-le'), 3)])
+        self.record(ROOT, [standard_information(6), file_name(ROOT, '.', WIN32_AND_DOS, 0)], flags=3)
+        self.record(10, [standard_information(6), file_name(ROOT, '$UpCase', WIN32_AND_DOS, len(upcase)),
+                         nonresident(0x80, [(upcase_lcn, upcase_clusters)], len(upcase), 2, cs)])
+        self.record(11, [standard_information(6), file_name(ROOT, '$Extend', WIN32_AND_DOS, 0)], flags=3)
+        self.record(24, [standard_information(6), file_name(11, '$Quota', WIN32_AND_DOS, 0)])
+
+        extension = count - 2
+        for f in self.files:
+            folder = f['size'] is None
+            size = f['size'] or 0
+            attributes = [standard_information(f['attributes'])]
+            # the copy of the size in a name of a file whose data is elsewhere is left at 0, as Windows may
+            attributes += [file_name(parent, name, space, 0 if f.get('extension') else size)
+                           for parent, name, space in f['names']]
+            if f.get('extension'):
+                self.record(extension, [nonresident(0x80, data[f['number']], size, 4, cs)], base=f['number'])
+            elif f.get('sparse'):
+                attributes.append(nonresident(0x80, [(None, (size + cs - 1) // cs)], size, 4, cs))
+            elif not folder and f['number'] in data:
+                attributes.append(nonresident(0x80, data[f['number']], size, 4, cs))
+            elif not folder:
+                attributes.append(resident(0x80, bytes(size), 4))
+            self.record(f['number'], attributes, flags=(0 if f.get('deleted') else 1) | (2 if folder else 0))
+
+        img = bytearray(clusters * cs)
+        b = img
+        b[0:3] = b'\xEB\x52\x90'
+        b[3:11] = b'NTFS    '
+        struct.pack_into('<HB', b, 11, 512, cs // 512)
+        b[21] = 0xF8
+        struct.pack_into('<Q', b, 40, clusters * (cs // 512) - 1)
+        struct.pack_into('<Q', b, 48, mft_runs[0][0])
+        struct.pack_into('<Q', b, 56, 2)
+        b[64] = 256 - (self.RECORD.bit_length() - 1)
+        b[68] = 1
+        struct.pack_into('<Q', b, 72, SERIAL)
+        b[510:512] = b'\x55\xAA'
+        img[upcase_lcn * cs:upcase_lcn * cs + len(upcase)] = upcase
+        mft = bytearray(mft_clusters * cs)
+        for number, record in self.records.items():
+            mft[number * self.RECORD:(number + 1) * self.RECORD] = record
+        vcn = 0
+        for lcn, length in mft_runs:
+            img[lcn * cs:(lcn + length) * cs] = mft[vcn * cs:(vcn + length) * cs]
+            vcn += length
+        return bytes(img)
+
+
+def links():
+    """What only NTFS has, see the top of this file."""
+    v = Ntfs()
+    docs = v.add(ROOT, 'Documents')
+    v.add(ROOT, 'readme.txt', 1234)
+    v.add(ROOT, 'A long file name.txt', 77)
+    v.add(ROOT, 'Ünïcode 文件.txt', 5)
+    for name in ('zeta', 'Alpha', 'beta', '_under', 'éclair', 'Éclair2'):
+        v.add(ROOT, name, 4)
+    v.add(ROOT, 'big.bin', 10 << 30)
+    v.files[-1]['sparse'] = True
+    v.add(ROOT, 'hidden.sys', 9, attributes=0x26)
+    case = v.add(ROOT, 'CaseDir')
+    for i, name in enumerate(('abc', 'ABC', 'Abc')):
+        v.add(case, name, i + 1, space=POSIX)
+    empty = v.add(ROOT, 'Empty')
+    deep = docs
+    for d in range(4):
+        deep = v.add(deep, 'level%d' % d)
+        v.add(deep, 'file%d.dat' % d, d * 1000)
+    v.add(docs, 'linked.txt', 55)
+    v.files[-1]['names'].append((empty, 'also linked.txt', WIN32_AND_DOS))
+    v.add(docs, 'extended.bin', 424242)
+    v.files[-1]['extension'] = True
+    v.add(docs, 'deleted.txt', 5)
+    v.files[-1]['deleted'] = True
+    return v.build()
+
+
+def build(out, tree):
+    os.makedirs(out, exist_ok=True)
+    v = Ntfs()
+    v.add_tree(ROOT, tree)
+    write(os.path.join(out, 'ntfs.img'), v.build())
+    write(os.path.join(out, 'ntfs-links.img'), links())
+
+
+if __name__ == '__main__':
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import fixtures
+    build(sys.argv[1], fixtures.IMAGED)
@@ -0,0 +1,96 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Builds reproducible folder trees for the benchmarks
+#
+#   python3 gen/mktree.py OUT --fanout N --depth N --files N [--name-len N]
+#       [--name-dist fixed|uniform|lognormal] [--unicode PERCENT] [--seed N]
+#
+# Every folder down to depth holds fanout sub folders and files files. Names
+# are name-len characters long on average, spread as name-dist says, and
+# unicode percent of them mix in non ASCII characters, some outside the BMP.
+# Names and file sizes come from a generator seeded with seed, so the same
+# arguments always give the same tree. Files are sparse, so a large tree
+# costs inodes but hardly any space; bench.py builds its trees on tmpfs.
+
+import argparse
+import math
+import os
+import random
+import shutil
+
+# every entry gets this modification time, as in fixtures.py
+MTIME = 1623764730
+
+ALPHABET = 'abcdefghijklmnopqrstuvwxyz0123456789_-'
+
+# what non ASCII names mix in: Latin with diacritics, Cyrillic, Greek, CJK, Hangul and two outside the BMP
+UNICODE = 'éèàüöçñøåß' 'абвгдежзиклмнопрст' 'αβγδεζηθλμπσω' '日本語中文字漢' '한국어데이터' '\U0001F600\U0001F4C1'
+
+# longest name in characters, which keeps even an all CJK name within 255 bytes of UTF-8
+NAME_MAX = 80
+
+
+def name(rng, args):
+    """A name of args.name_len characters on average."""
+    mean = args.name_len
+    if args.name_dist == 'fixed':
+        length = mean
+    elif args.name_dist == 'lognormal':
+        length = int(rng.lognormvariate(math.log(mean), 0.5))
+    else:
+        length = int(rng.uniform(0.5, 1.5) * mean)
+    length = max(1, min(NAME_MAX, length))
+    if args.unicode > 0 and rng.random() * 100 < args.unicode:
+        return ''.join(rng.choice(UNICODE) if rng.random() < 0.5 else rng.choice(ALPHABET) for _ in range(length))
+    return ''.join(rng.choice(ALPHABET) for _ in range(length))
+
+
+def build(root, args, rng, depth):
+    """Creates the files of root and, above depth, its sub folders."""
+    os.mkdir(root)
+    names = set()
+    for i in range(args.files + (args.fanout if depth < args.depth else 0)):
+        stem = name(rng, args)
+        while stem in names:
+            stem += rng.choice(ALPHABET)
+        names.add(stem)
+        if i < args.files:
+            path = os.path.join(root, stem + '.dat')
+            with open(path, 'wb') as f:
+                f.truncate(rng.randrange(1 << 20))
+            os.utime(path, (MTIME, MTIME))
+        else:
+            build(os.path.join(root, stem), args, rng, depth + 1)
+    os.utime(root, (MTIME, MTIME))
+
+
+def parser():
+    p = argparse.ArgumentParser(description='Builds a reproducible folder tree.')
+    p.add_argument('out', help='folder to create, replaced if it exists')
+    p.add_argument('--fanout', type=int, required=True, help='sub folders of each folder above depth')
+    p.add_argument('--depth', type=int, required=True, help='levels of folders below out')
+    p.add_argument('--files', type=int, required=True, help='files in each folder')
+    p.add_argument('--name-len', type=int, default=12, help='average name length in characters')
+    p.add_argument('--name-dist', choices=('fixed', 'uniform', 'lognormal'), default='uniform',
+                   help='spread of name lengths: all alike, 0.5 to 1.5 times the average, or a long tail')
+    p.add_argument('--unicode', type=float, default=0, help='percentage of names with non ASCII characters')
+    p.add_argument('--seed', type=int, default=1, help='seed of the names and sizes')
+    return p
+
+
+def make(out, **kwargs):
+    """Builds a tree as the command line would, for bench.py."""
+    argv = [out]
+    for key, value in kwargs.items():
+        argv += ['--' + key.replace('_', '-'), str(value)]
+    generate(parser().parse_args(argv))
+
+
+def generate(args):
+    if os.path.exists(args.out):
+        shutil.rmtree(args.out)
+    build(args.out, args, random.Random(args.seed), 0)
+
+
+if __name__ == '__main__':
+    generate(parser().parse_args())
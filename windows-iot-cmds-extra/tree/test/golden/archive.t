@@ -0,0 +1,43 @@
+gen/mkarchive.py stores the imaged folder as ZIP, as TAR in the ustar, GNU
+and pax formats and as TAR.GZ, entries out of order and some folders only
+implied by the paths below them. Each lists the same as the folder.
+
+  $ tree imaged /F /JSON | sed 's/.*"contents"://' > $T/folder
+  $ for a in imaged.zip imaged.tar imaged-gnu.tar imaged-pax.tar imaged.tar.gz; do tree images/$a /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder && echo $a; done
+  imaged.zip
+  imaged.tar
+  imaged-gnu.tar
+  imaged-pax.tar
+  imaged.tar.gz
+  $ tree images/imaged.tar.gz /F | tail -n +4 | head -12
+  │   emoji 😀.txt
+  │   EMPTYF
+  │   long file name.txt
+  │   README.TXT
+  │   Ünïcode 文件.txt
+  │    
+  ├───Docs
+  │   │   Document number 00 with a long name.txt
+  │   │   Document number 01 with a long name.txt
+  │   │   Document number 02 with a long name.txt
+  │   │   Document number 03 with a long name.txt
+  │   │   Document number 04 with a long name.txt
+
+A pax record is read up to its length, even when it doesn't end in a
+newline: the size of a.txt is 5, not the 55 its record's digits run on to.
+
+  $ tree images/pax-unterminated.tar /F /C 2>&1 | tail -n +4
+  0 folders, 2 files, 7 bytes
+  No subfolders exist
+  
+
+A TAR cut short lists the entries before the cut. A ZIP cut short has lost
+its central directory, and is refused like a TAR.GZ whose first blocks of
+entries can't be inflated.
+
+  $ head -c 40000 images/imaged.tar > $T/cut.tar && cd $T && tree cut.tar /F /C 2>&1 | tail -n +4
+  4 folders, 20 files, 25216 bytes
+  $ head -c 600 images/imaged.tar.gz > $T/cut.tar.gz && cd $T && tree cut.tar.gz /F /C 2>&1
+  Cannot read image - $T\cut.tar.gz
+  $ head -c 40000 images/imaged.zip > $T/cut.zip && cd $T && tree cut.zip /F /C 2>&1
+  Cannot read image - $T\cut.zip
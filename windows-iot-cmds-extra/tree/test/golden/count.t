@@ -0,0 +1,46 @@
+/C writes one line counting the folders below the folder, the files /F would
+list and the bytes in them, instead of listing them, with or without /F.
+
+  $ tree imaged /C | tail -n +4
+  6 folders, 50 files, 79330 bytes
+  $ tree imaged /F /C | tail -n +4
+  6 folders, 50 files, 79330 bytes
+  $ tree unicode /F /C | tail -n +4
+  6 folders, 9 files, 109 bytes
+  $ tree many /F /C | tail -n +4
+  80 folders, 4800 files, 14394 bytes
+
+The counts are those of the listing /C stands in for.
+
+  $ tree many /F /P | wc -l
+  4880
+  $ tree imaged /F /JSON | grep -o '"type":"file"' | wc -l
+  50
+
+The filters count only the files they let through, and /CAP, which only
+shortens the listing, leaves the count alone.
+
+  $ tree imaged /F /C /SIZE:+3500 | tail -n +4
+  6 folders, 4 files, 15000 bytes
+  $ tree imaged /F /C /FIND:number | tail -n +4
+  6 folders, 40 files, 78000 bytes
+  $ tree many /F /C /CAP:10 | tail -n +4
+  80 folders, 4800 files, 14394 bytes
+  $ tree dated /F /C /NEWER:2021-06-15T13:45:30 | tail -n +4
+  No subfolders exist
+  
+  0 folders, 4 files, 18 bytes
+
+With /JSON and /NDJSON the count is written as fields.
+
+  $ tree imaged /F /C /JSON | sed 's/.*"folders"/"folders"/'
+  "folders":6,"files":50,"bytes":79330}
+  $ tree imaged /F /C /NDJSON | tail -n 1
+  {"type":"count","folders":6,"files":50,"bytes":79330}
+
+Images and archives are counted the same way as folders.
+
+  $ tree images/fat32.img /F /C | tail -n +4
+  6 folders, 50 files, 79330 bytes
+  $ tree images/imaged.zip /F /C | tail -n +4
+  6 folders, 50 files, 79330 bytes
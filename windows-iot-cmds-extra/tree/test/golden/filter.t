@@ -0,0 +1,87 @@
+/NEWER and /OLDER take YYYY-MM-DD, YYYY-MM-DDTHH:MM or YYYY-MM-DDTHH:MM:SS in
+UTC. exact.txt was written at 2021-06-15T13:45:30.
+
+  $ tree dated /F /NEWER:2021-06-15T13:45:30 | tail -n +4
+  No subfolders exist
+  
+       day after.txt
+       exact.txt
+       leap day.txt
+       second after.txt
+        
+  $ tree dated /F /OLDER:2021-06-15T13:45:30 | tail -n +4
+  No subfolders exist
+  
+       early.txt
+       minute before.txt
+        
+  $ tree dated /F /NEWER:2021-06-15T13:45 | tail -n +4
+  No subfolders exist
+  
+       day after.txt
+       exact.txt
+       leap day.txt
+       second after.txt
+        
+  $ tree dated /F /NEWER:2021-06-16 | tail -n +4
+  No subfolders exist
+  
+       day after.txt
+       leap day.txt
+        
+  $ tree dated /F /NEWER:2024-02-29 | tail -n +4
+  No subfolders exist
+  
+       leap day.txt
+        
+
+Anything after the time, a form cut short or a field out of range is
+rejected rather than read as far as it goes.
+
+  $ tree dated /F /NEWER:2021-06-15x
+  Invalid switch - /NEWER:2021-06-15x
+  $ tree dated /F /NEWER:2021-06-15T13:45:30Z
+  Invalid switch - /NEWER:2021-06-15T13:45:30Z
+  $ tree dated /F /NEWER:2021-06-15T
+  Invalid switch - /NEWER:2021-06-15T
+  $ tree dated /F /NEWER:2021-06-15T13
+  Invalid switch - /NEWER:2021-06-15T13
+  $ tree dated /F /NEWER:2021-06-15T13:45:
+  Invalid switch - /NEWER:2021-06-15T13:45:
+  $ tree dated /F /NEWER:2021-13-01
+  Invalid switch - /NEWER:2021-13-01
+  $ tree dated /F /NEWER:2021-00-10
+  Invalid switch - /NEWER:2021-00-10
+  $ tree dated /F /NEWER:2021-06-00
+  Invalid switch - /NEWER:2021-06-00
+  $ tree dated /F /NEWER:2021-06-15T24:00
+  Invalid switch - /NEWER:2021-06-15T24:00
+  $ tree dated /F /NEWER:2021-06-15T13:60
+  Invalid switch - /NEWER:2021-06-15T13:60
+  $ tree dated /F /OLDER:2021-06-15T13:45:60
+  Invalid switch - /OLDER:2021-06-15T13:45:60
+  $ tree dated /F /OLDER:2023-02-29
+  Invalid switch - /OLDER:2023-02-29
+  $ tree dated /F /OLDER:1600-12-31
+  Invalid switch - /OLDER:1600-12-31
+
+/SIZE takes a size from 0 up to below 2^64 bytes once scaled by its unit;
+anything else is refused rather than converted to some size.
+
+  $ tree dated /F /SIZE:1e19 | tail -n +4
+  No subfolders exist
+  
+  $ tree dated /F /SIZE:inf
+  Invalid switch - /SIZE:inf
+  $ tree dated /F /SIZE:-nan
+  Invalid switch - /SIZE:-nan
+  $ tree dated /F /SIZE:1e30
+  Invalid switch - /SIZE:1e30
+  $ tree dated /F /SIZE:17179869184G
+  Invalid switch - /SIZE:17179869184G
+  $ tree dated /F /SIZE:+-5
+  Invalid switch - /SIZE:+-5
+  $ tree dated /F /SIZE:--5
+  Invalid switch - /SIZE:--5
+  $ tree dated /F /SIZE:5X
+  Invalid switch - /SIZE:5X
@@ -0,0 +1,66 @@
+/FIND lists the files and folders whose names hold the text, ignoring case,
+and the folders leading to them. A folder found is listed without what is
+in it.
+
+  $ tree imaged /F /FIND:readme | tail -n +4
+       README.TXT
+        
+  $ tree imaged /F /FIND:DEEP | tail -n +4
+  └───Docs
+      └───Deep
+          └───Deeper
+  $ tree imaged /F /FIND:文件 | tail -n +4
+       Ünïcode 文件.txt
+        
+  $ tree unicode /F /FIND:한국 | tail -n +4
+  └───日本語フォルダ
+      └───한국어
+  $ tree imaged /F /FIND:zzz | tail -n +4
+
+Text holding * or ? is a pattern the whole name has to match.
+
+  $ tree imaged /F /FIND:*.bin | tail -n +4
+  └───Docs
+      └───Deep
+          └───Deeper
+                   bottom.bin
+                    
+  $ tree imaged /F /FIND:?.B?C | tail -n +4
+  └───Mixed.Case.Dir
+           a.b.c
+            
+  $ tree imaged /F /FIND:*number?1* | tail -n +4
+  └───Docs
+           Document number 10 with a long name.txt
+           Document number 11 with a long name.txt
+           Document number 12 with a long name.txt
+           Document number 13 with a long name.txt
+           Document number 14 with a long name.txt
+           Document number 15 with a long name.txt
+           Document number 16 with a long name.txt
+           Document number 17 with a long name.txt
+           Document number 18 with a long name.txt
+           Document number 19 with a long name.txt
+            
+  $ tree imaged /F /FIND:*.txt* | grep -ci txt
+  45
+
+Without /F only folders are listed, so only the folders found and those
+leading to them.
+
+  $ tree imaged /FIND:case | tail -n +4
+  └───Mixed.Case.Dir
+
+/FIND combines with the other filters, and a second /FIND is refused.
+
+  $ tree imaged /F /FIND:number /SIZE:+3500 | tail -n +4
+  └───Docs
+           Document number 36 with a long name.txt
+           Document number 37 with a long name.txt
+           Document number 38 with a long name.txt
+           Document number 39 with a long name.txt
+            
+  $ tree many /F /FIND:"file 059" | grep -c "file 059"
+  80
+  $ tree imaged /F /FIND:a /FIND:b 2>&1 | head -1
+  Invalid switch - /FIND:b
@@ -0,0 +1,176 @@
+gen/mkimage.py lays out the imaged folder as FAT12, FAT16, FAT32 and exFAT
+volumes. Each lists the same as the folder, names, sizes and times alike.
+
+  $ tree imaged /F /JSON | sed 's/.*"contents"://' > $T/folder
+  $ for fs in fat12 fat16 fat32 exfat; do tree images/$fs.img /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder && echo $fs; done
+  fat12
+  fat16
+  fat32
+  exfat
+  $ tree images/fat32.img /F | tail -n +4
+  │   emoji 😀.txt
+  │   EMPTYF
+  │   long file name.txt
+  │   README.TXT
+  │   Ünïcode 文件.txt
+  │    
+  ├───Docs
+  │   │   Document number 00 with a long name.txt
+  │   │   Document number 01 with a long name.txt
+  │   │   Document number 02 with a long name.txt
+  │   │   Document number 03 with a long name.txt
+  │   │   Document number 04 with a long name.txt
+  │   │   Document number 05 with a long name.txt
+  │   │   Document number 06 with a long name.txt
+  │   │   Document number 07 with a long name.txt
+  │   │   Document number 08 with a long name.txt
+  │   │   Document number 09 with a long name.txt
+  │   │   Document number 10 with a long name.txt
+  │   │   Document number 11 with a long name.txt
+  │   │   Document number 12 with a long name.txt
+  │   │   Document number 13 with a long name.txt
+  │   │   Document number 14 with a long name.txt
+  │   │   Document number 15 with a long name.txt
+  │   │   Document number 16 with a long name.txt
+  │   │   Document number 17 with a long name.txt
+  │   │   Document number 18 with a long name.txt
+  │   │   Document number 19 with a long name.txt
+  │   │   Document number 20 with a long name.txt
+  │   │   Document number 21 with a long name.txt
+  │   │   Document number 22 with a long name.txt
+  │   │   Document number 23 with a long name.txt
+  │   │   Document number 24 with a long name.txt
+  │   │   Document number 25 with a long name.txt
+  │   │   Document number 26 with a long name.txt
+  │   │   Document number 27 with a long name.txt
+  │   │   Document number 28 with a long name.txt
+  │   │   Document number 29 with a long name.txt
+  │   │   Document number 30 with a long name.txt
+  │   │   Document number 31 with a long name.txt
+  │   │   Document number 32 with a long name.txt
+  │   │   Document number 33 with a long name.txt
+  │   │   Document number 34 with a long name.txt
+  │   │   Document number 35 with a long name.txt
+  │   │   Document number 36 with a long name.txt
+  │   │   Document number 37 with a long name.txt
+  │   │   Document number 38 with a long name.txt
+  │   │   Document number 39 with a long name.txt
+  │   │    
+  │   └───Deep
+  │       │   NOTE.TXT
+  │       │    
+  │       └───Deeper
+  │                bottom.bin
+  │                 
+  ├───Empty
+  └───Mixed.Case.Dir
+      │   a.b.c
+      │   noext
+      │    
+      └───SUB
+               x
+                
+  $ tree images/fat12.img | head -2
+  Folder PATH listing for volume IMAGED
+  Volume serial number is 1234-ABCD
+  $ tree images/exfat.img | head -2
+  Folder PATH listing for volume IMAGED
+  Volume serial number is 1234-ABCD
+
+mbr.img holds the FAT16 volume in slot 2 and the exFAT one in slot 4.
+/IMAGE:file,N picks a slot, without one the first volume found is listed.
+
+  $ tree images/mbr.img /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree /IMAGE:images/mbr.img,2 /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree /IMAGE:images/mbr.img,4 /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree /IMAGE:images/mbr.img,1
+  Cannot read image - images/mbr.img,1
+  $ tree /IMAGE:images/mbr.img,5
+  Cannot read image - images/mbr.img,5
+
+gpt.img holds the same volumes as the first and third entries of a GPT.
+
+  $ tree images/gpt.img /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree /IMAGE:images/gpt.img,3 /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree /IMAGE:images/gpt.img,2
+  Cannot read image - images/gpt.img,2
+  $ tree /IMAGE:images/gpt.img,129
+  Cannot read image - images/gpt.img,129
+
+A GPT whose entries lie at an LBA whose offset wraps around or past the end
+of the disk, entries of an odd size or larger than a sector, partitions
+starting or ending past the disk, or more entries than fit is refused
+without reading outside the image.
+
+  $ for g in wrap lba odd big start end many; do tree /IMAGE:images/gpt-$g.img; done
+  Cannot read image - images/gpt-wrap.img
+  Cannot read image - images/gpt-lba.img
+  Cannot read image - images/gpt-odd.img
+  Cannot read image - images/gpt-big.img
+  Cannot read image - images/gpt-start.img
+  Cannot read image - images/gpt-end.img
+  Cannot read image - images/gpt-many.img
+
+A damaged image lists what can be read of it. Cut short, the folders past
+the end are empty; a cluster chained to itself ends its folder.
+
+  $ head -c 40960 images/fat16.img > $T/cut.img && cd $T && tree cut.img /F | tail -n +4
+  │   emoji 😀.txt
+  │   EMPTYF
+  │   long file name.txt
+  │   README.TXT
+  │   Ünïcode 文件.txt
+  │    
+  ├───Docs
+  │   │   Document number 00 with a long name.txt
+  │   │   Document number 01 with a long name.txt
+  │   │   Document number 02 with a long name.txt
+  │   │   Document number 03 with a long name.txt
+  │   │   Document number 04 with a long name.txt
+  │   │   Document number 05 with a long name.txt
+  │   │   Document number 06 with a long name.txt
+  │   │   Document number 07 with a long name.txt
+  │   │   Document number 08 with a long name.txt
+  │   │   Document number 09 with a long name.txt
+  │   │   Document number 10 with a long name.txt
+  │   │   Document number 11 with a long name.txt
+  │   │   Document number 12 with a long name.txt
+  │   │   Document number 13 with a long name.txt
+  │   │   Document number 14 with a long name.txt
+  │   │    
+  │   └───Deep
+  ├───Empty
+  └───Mixed.Case.Dir
+  $ head -c 100000 images/exfat.img > $T/cut.img && cd $T && tree cut.img /F | wc -l
+  58
+  $ cp images/fat16.img $T/loop.img && printf '\002\000' | dd of=$T/loop.img bs=1 seek=516 conv=notrunc status=none
+  $ cd $T && tree loop.img /F | tail -n +4
+  │   emoji 😀.txt
+  │   EMPTYF
+  │   long file name.txt
+  │   README.TXT
+  │   Ünïcode 文件.txt
+  │    
+  ├───Docs
+  │   │   Document number 00 with a long name.txt
+  │   │   Document number 01 with a long name.txt
+  │   │    
+  │   └───Deep
+  │       │   NOTE.TXT
+  │       │    
+  │       └───Deeper
+  │                bottom.bin
+  │                 
+  ├───Empty
+  └───Mixed.Case.Dir
+      │   a.b.c
+      │   noext
+      │    
+      └───SUB
+               x
+                
+
+An image name too long for a path is refused rather than cut short.
+
+  $ tree /IMAGE:$(printf 'x%.0s' $(seq 300)).img 2>&1 | cut -c 1-40
+  Cannot read image - xxxxxxxxxxxxxxxxxxxx
@@ -0,0 +1,73 @@
+/INDEX writes the names below a folder to a file instead of listing them.
+Listed as a path, the index shows the folder as it was when indexed.
+
+  $ tree imaged /INDEX:$T/imaged.idx | tail -n +4
+  6 folders and 50 files indexed
+  $ tree imaged /F /JSON | sed 's/.*"contents"://' > $T/folder
+  $ cd $T && tree imaged.idx /F /JSON | sed 's/.*"contents"://' | cmp - folder
+
+The many folder puts thousands of names behind the same trigrams, so their
+postings are grown many times over from their first few bytes.
+
+  $ tree many /INDEX:$T/many.idx | tail -n +4
+  80 folders and 4800 files indexed
+  $ tree many /F /JSON | sed 's/.*"contents"://' > $T/folder
+  $ cd $T && tree many.idx /F /JSON | sed 's/.*"contents"://' | cmp - folder
+
+/LOCATE lists the entries whose names hold the text, ignoring case, along
+with the folders leading to them.
+
+  $ tree /INDEX:$T/imaged.idx /LOCATE:readme | tail -n +4
+  No subfolders exist
+  
+       README.TXT
+        
+  $ tree /INDEX:$T/imaged.idx /LOCATE:deep | tail -n +4
+  └───Docs
+      └───Deep
+          └───Deeper
+  $ tree /INDEX:$T/imaged.idx /LOCATE:文件 | tail -n +4
+  No subfolders exist
+  
+       Ünïcode 文件.txt
+        
+  $ tree /INDEX:$T/imaged.idx /LOCATE:zzz | tail -n +4
+  No subfolders exist
+  
+
+Text shorter than a trigram, and patterns holding * or ?, which must match
+the whole name.
+
+  $ tree /INDEX:$T/imaged.idx /LOCATE:NO | tail -n +4
+  ├───Docs
+  │   └───Deep
+  │            NOTE.TXT
+  │             
+  └───Mixed.Case.Dir
+           noext
+            
+  $ tree /INDEX:$T/imaged.idx /LOCATE:*.bin | tail -n +4
+  └───Docs
+      └───Deep
+          └───Deeper
+                   bottom.bin
+                    
+  $ tree /INDEX:$T/imaged.idx /LOCATE:?.B?C | tail -n +4
+  No subfolders exist
+  
+  └───Mixed.Case.Dir
+           a.b.c
+            
+  $ tree /INDEX:$T/many.idx /LOCATE:"FILE 059" | grep -c "file 059"
+  80
+  $ tree /INDEX:$T/many.idx /LOCATE:"folder 12" | tail -n +4 | head -3
+  └───folder 12
+
+/LOCATE only reads an index, and an index holds no JSON.
+
+  $ tree imaged /INDEX:$T/imaged.idx /LOCATE:x 2>&1
+  Invalid switch - /LOCATE needs /INDEX:file and nothing else to list
+  $ tree /INDEX:$T/missing.idx /LOCATE:x 2>&1 | sed 's/ - .*/ - missing/'
+  Cannot read index - missing
+  $ tree imaged /INDEX:$T/x.idx /JSON 2>&1
+  Invalid switch - /INDEX writes no JSON
@@ -0,0 +1,97 @@
+gen/mkntfs.py lays out the imaged folder as an NTFS volume, which lists the
+same as the folder.
+
+  $ tree imaged /F /JSON | sed 's/.*"contents"://' > $T/folder
+  $ tree images/ntfs.img /F /JSON | sed 's/.*"contents"://' | cmp - $T/folder
+  $ tree images/ntfs.img | head -2
+  Folder PATH listing for volume IMAGED
+  Volume serial number is 5566-7788
+
+ntfs-links.img holds what only NTFS has. Names are sorted with the volume's
+$UpCase, names differing only in case by their code units, 8.3 names and
+the record no longer in use are left out, and the file with two links is
+listed in both folders.
+
+  $ tree images/ntfs-links.img /F | tail -n +4
+  │   A long file name.txt
+  │   Alpha
+  │   beta
+  │   big.bin
+  │   hidden.sys
+  │   readme.txt
+  │   zeta
+  │   _under
+  │   éclair
+  │   Éclair2
+  │   Ünïcode 文件.txt
+  │    
+  ├───CaseDir
+  │        ABC
+  │        Abc
+  │        abc
+  │         
+  ├───Documents
+  │   │   extended.bin
+  │   │   linked.txt
+  │   │    
+  │   └───level0
+  │       │   file0.dat
+  │       │    
+  │       └───level1
+  │           │   file1.dat
+  │           │    
+  │           └───level2
+  │               │   file2.dat
+  │               │    
+  │               └───level3
+  │                        file3.dat
+  │                         
+  └───Empty
+           also linked.txt
+            
+  $ tree images/ntfs-links.img /C | tail -n +4
+  7 folders, 21 files, 10737849947 bytes
+  $ tree images/ntfs-links.img /F /ATTR:H | tail -n +4
+  │   hidden.sys
+  │    
+  ├───CaseDir
+  ├───Documents
+  │   └───level0
+  │       └───level1
+  │           └───level2
+  │               └───level3
+  └───Empty
+  $ tree images/ntfs-links.img /F /SIZE:+1G | tail -n +4
+  │   big.bin
+  │    
+  ├───CaseDir
+  ├───Documents
+  │   └───level0
+  │       └───level1
+  │           └───level2
+  │               └───level3
+  └───Empty
+  $ tree images/ntfs-links.img /F /FIND:extended | tail -n +4
+  └───Documents
+           extended.bin
+            
+
+A record torn by an interrupted write is skipped, the rest of the volume
+still lists. An image cut short inside the MFT, whose first fragment lies
+last on this volume, or before it, can't be read at all.
+
+  $ python3 -c "import sys; d = bytearray(open(sys.argv[1], 'rb').read()); r = d.find('readme.txt'.encode('utf-16-le')) & ~1023; d[r + 510] ^= 0xFF; open(sys.argv[2], 'wb').write(d)" images/ntfs-links.img $T/torn.img
+  $ cd $T && tree torn.img /F | tail -n +4 | head -8
+  │   A long file name.txt
+  │   Alpha
+  │   beta
+  │   big.bin
+  │   hidden.sys
+  │   zeta
+  │   _under
+  │   éclair
+  $ python3 -c "import sys; d = open(sys.argv[1], 'rb').read(); open(sys.argv[2], 'wb').write(d[:d.find('level2'.encode('utf-16-le')) & ~1023])" images/ntfs-links.img $T/cut.img
+  $ cd $T && tree cut.img /F | tail -n +4
+  Cannot read image - $T\cut.img
+  $ head -c 65536 images/ntfs-links.img > $T/cut.img && cd $T && tree cut.img /F | tail -n +4
+  Cannot read image - $T\cut.img
@@ -0,0 +1,22 @@
+The writer's UTF-16 (wchar_t) and UTF-8 (char) instantiations produce the
+same bytes, written synchronously or through the writer thread, to a file or
+to a console. The corpus has lines long enough to cross every step and chunk
+boundary, with surrogate pairs and multi byte sequences straddling them.
+Its first line puts a pair across the end of the first console write, which
+the tests make smaller than a chunk.
+
+  $ outwrite narrow > $T/narrow
+  $ iconv -f UTF-8 -t UTF-8 $T/narrow > /dev/null && wc -c < $T/narrow
+  636667
+  $ outwrite wide | cmp - $T/narrow
+  $ outwrite wide 1000000 | cmp - $T/narrow
+  $ outwrite narrow 1000000 | cmp - $T/narrow
+  $ TREE_CONSOLE=1 outwrite wide | cmp - $T/narrow
+  $ TREE_CONSOLE=1 outwrite narrow | cmp - $T/narrow
+  $ TREE_CONSOLE=1 outwrite narrow 1000000 | cmp - $T/narrow
+
+The JSON writer sends its keys and numbers as char and the names as wchar_t;
+mixing the two in one line changes nothing for a console.
+
+  $ tree unicode /F /JSON > $T/json
+  $ TREE_CONSOLE=1 tree unicode /F /JSON | cmp - $T/json
@@ -0,0 +1,91 @@
+/P writes the full path of each folder, and with /F of each file, one per
+line: the files of a folder first, then each sub folder followed by what is
+below it.
+
+  $ tree imaged /P
+  $FIX\imaged\Docs
+  $FIX\imaged\Docs\Deep
+  $FIX\imaged\Docs\Deep\Deeper
+  $FIX\imaged\Empty
+  $FIX\imaged\Mixed.Case.Dir
+  $FIX\imaged\Mixed.Case.Dir\SUB
+  $ tree unicode /P /F
+  $FIX\unicode\ASCII.txt
+  $FIX\unicode\café.txt
+  $FIX\unicode\combining é.txt
+  $FIX\unicode\emoji 😀.txt
+  $FIX\unicode\naïve résumé.doc
+  $FIX\unicode\Русский.txt
+  $FIX\unicode\zzz
+  $FIX\unicode\zzz\deep
+  $FIX\unicode\zzz\deep\deeper
+  $FIX\unicode\zzz\deep\deeper\bottom.txt
+  $FIX\unicode\Ελληνικά
+  $FIX\unicode\日本語フォルダ
+  $FIX\unicode\日本語フォルダ\中文.txt
+  $FIX\unicode\日本語フォルダ\한국어
+  $FIX\unicode\日本語フォルダ\한국어\데이터.bin
+  $ tree many /P /F | wc -l
+  4880
+  $ tree many /P /F /PREFETCH:8 | cmp - <(tree many /P /F /PREFETCH:0)
+
+/P0 ends each path with a NUL character instead of a new line, for xargs -0.
+
+  $ tree unicode /P0 /F | tr '\0' '\n' | cmp - <(tree unicode /P /F | tr -d '\r')
+  $ tree unicode /P0 | tr -cd '\0' | wc -c
+  6
+
+/FIND writes only the files and folders it finds, as their paths already
+name the folders leading to them.
+
+  $ tree imaged /P /F /FIND:deep
+  $FIX\imaged\Docs\Deep
+  $FIX\imaged\Docs\Deep\Deeper
+  $ tree imaged /P /F /FIND:*.bin
+  $FIX\imaged\Docs\Deep\Deeper\bottom.bin
+
+/PRUNE writes the files that pass the filters and the folders holding one
+somewhere below them, each folder before what is below it. Without /F the
+folders are still chosen by the files they hold.
+
+  $ tree imaged /P /F /PRUNE /SIZE:1
+  $FIX\imaged\Docs
+  $FIX\imaged\Docs\Deep
+  $FIX\imaged\Docs\Deep\Deeper
+  $FIX\imaged\Docs\Deep\Deeper\bottom.bin
+  $FIX\imaged\Mixed.Case.Dir
+  $FIX\imaged\Mixed.Case.Dir\a.b.c
+  $FIX\imaged\Mixed.Case.Dir\SUB
+  $FIX\imaged\Mixed.Case.Dir\SUB\x
+  $ tree imaged /P /PRUNE /SIZE:1
+  $FIX\imaged\Docs
+  $FIX\imaged\Docs\Deep
+  $FIX\imaged\Docs\Deep\Deeper
+  $FIX\imaged\Mixed.Case.Dir
+  $FIX\imaged\Mixed.Case.Dir\SUB
+  $ tree imaged /P /F /PRUNE /SIZE:+3500
+  $FIX\imaged\Docs
+  $FIX\imaged\Docs\Document number 36 with a long name.txt
+  $FIX\imaged\Docs\Document number 37 with a long name.txt
+  $FIX\imaged\Docs\Document number 38 with a long name.txt
+  $FIX\imaged\Docs\Document number 39 with a long name.txt
+  $ tree many /P /F /PRUNE /SIZE:6 | wc -l
+  764
+
+/MAX stops after that many paths, with the sibling folders read ahead
+waited on and released.
+
+  $ tree many /P /F /MAX:5 /PREFETCH:8 2>&1
+  $FIX\many\folder 00
+  $FIX\many\folder 00\file 000 with a longer name.txt
+  $FIX\many\folder 00\file 001 with a longer name.txt
+  $FIX\many\folder 00\file 002 with a longer name.txt
+  $FIX\many\folder 00\file 003 with a longer name.txt
+  ... listing truncated, limit of 5 entries reached
+  $ tree imaged /P /F /PRUNE /SIZE:1 /MAX:3 2>&1
+  $FIX\imaged\Docs
+  $FIX\imaged\Docs\Deep
+  $FIX\imaged\Docs\Deep\Deeper
+  ... listing truncated, limit of 3 entries reached
+  $ tree imaged /P /JSON 2>&1
+  Invalid switch - /P writes no JSON
@@ -0,0 +1,10 @@
+Reading sibling folders ahead keeps the output order, also when opening a
+folder takes a while and read-aheads finish out of order.
+
+  $ tree /SYNTH:4,3,3,8,20,1000,5 /F /PREFETCH:0 > $T/serial
+  $ wc -l < $T/serial
+  427
+  $ tree /SYNTH:4,3,3,8,20,1000,5 /F /PREFETCH:1 | cmp - $T/serial
+  $ tree /SYNTH:4,3,3,8,20,1000,5 /F /PREFETCH:16 | cmp - $T/serial
+  $ tree many /F /PREFETCH:0 > $T/disk
+  $ tree many /F /PREFETCH:8 | cmp - $T/disk
@@ -0,0 +1,25 @@
+/PRUNE leaves out folders with no file that passes the filters. Their held
+back entries are dropped again, which must not disturb the ones kept.
+
+  $ tree unicode /F /PRUNE /SIZE:+15 | tail -n +4
+  └───日本語フォルダ
+      │   中文.txt
+      │    
+      └───한국어
+               데이터.bin
+                
+  $ tree many /F /PRUNE /SIZE:6 | wc -l
+  847
+  $ tree many /F /PRUNE /SIZE:6 /FOLD | wc -l
+  296
+
+The test build keeps four blocks of held back records in memory. A folder
+whose last sub folder is only known at its end holds everything below it,
+so here most of it is spilled to a temporary file and read back, while the
+empty folders after it are dropped. Nothing is lost or reordered.
+
+  $ cd $T && mkdir -p spill/a/p/{0001..2000} spill/a/q/{0001..1000} spill/b && for d in spill/a/p/* spill/b; do touch $d/f; done
+  $ cd $T && tree spill /F /PRUNE --trace:trace.json > pruned && echo spill $(grep -c '"name":"spill"' trace.json) load $(grep -c '"name":"load"' trace.json)
+  spill 6 load 6
+  $ cd $T && rm -r spill/a/q && tree spill /F | cmp - pruned && wc -l < pruned
+  6008
@@ -0,0 +1,127 @@
+Trees listed through the source interface render alike whichever source they
+come from. A seeded synthetic tree, half of whose names are CJK, is the same
+on every run:
+
+  $ tree /SYNTH:2,2,3,10,50,0,7 /F
+  Folder PATH listing for volume SYNTH
+  Volume serial number is 5932-DD7
+  SYNTH:
+  │   knj躖棽_匴桑q2cqr佃4st鍂u.txt
+  │   銫1zmd鋻谤芯t7fo.log
+  │   塔.log
+  │    
+  ├───炎7sl-8w赑尬
+  │   │   歡哔-魉du塬h盈7.dat
+  │   │   1灁喜虷蛌巭掲2闷w3飪苓z8sq贽.xml
+  │   │   hz矁笭鶝骵n荭d7荪9媒.log
+  │   │    
+  │   ├───恝攄付钷d游5鵅u廬
+  │   │        凕瀬tq薭慖vi俺n褦瞴7塟0d7蝘.xml
+  │   │        4d峗呸l閒范2鰊筿ze.cpp
+  │   │        议yg_k鷡最p381桺1-8瀷礳.png
+  │   │         
+  │   └───貏乚v
+  │            胜t嫶f溂歱g鬊s襗繚隬wi图jij.xml
+  │            鲝梧权l瘩綁縭戎d驋疚罡詯肅.log
+  │            b藳鱖叱羧磎z7獒哒8l1r镽5-.xml
+  │             
+  └───-tj_y萦嚡g粹t_迀j-摄b4b
+      │   z妛鑣腥-e7寧湆貧b螎3z.log
+      │   茐k妸儒wiz.xml
+      │   b鉖动q犟g.cpp
+      │    
+      ├───廸3却櫛匹l胍j妩jf0f蘷玣哀a鐤
+      │        菞抱珤礯惈su1zz7禧絿.cpp
+      │        r譠縘c威藘90唨w秽_簌隸艵n园.txt
+      │        _駞of主-m鶼e瓽蝅qf扒f9霗.cpp
+      │         
+      └───9灩z躋w罥1t罿lg
+               v.log
+               _26r泚n0d鐽寎杴滴ee69fl3.xml
+               k涳ir獶ci7.png
+                
+
+/A swaps the connectors for ASCII and leaves the names alone.
+
+  $ tree /SYNTH:2,2,3,10,50,0,7 /F /A
+  Folder PATH listing for volume SYNTH
+  Volume serial number is 5932-DD7
+  SYNTH:
+  |   knj躖棽_匴桑q2cqr佃4st鍂u.txt
+  |   銫1zmd鋻谤芯t7fo.log
+  |   塔.log
+  |    
+  +---炎7sl-8w赑尬
+  |   |   歡哔-魉du塬h盈7.dat
+  |   |   1灁喜虷蛌巭掲2闷w3飪苓z8sq贽.xml
+  |   |   hz矁笭鶝骵n荭d7荪9媒.log
+  |   |    
+  |   +---恝攄付钷d游5鵅u廬
+  |   |        凕瀬tq薭慖vi俺n褦瞴7塟0d7蝘.xml
+  |   |        4d峗呸l閒范2鰊筿ze.cpp
+  |   |        议yg_k鷡最p381桺1-8瀷礳.png
+  |   |         
+  |   \---貏乚v
+  |            胜t嫶f溂歱g鬊s襗繚隬wi图jij.xml
+  |            鲝梧权l瘩綁縭戎d驋疚罡詯肅.log
+  |            b藳鱖叱羧磎z7獒哒8l1r镽5-.xml
+  |             
+  \----tj_y萦嚡g粹t_迀j-摄b4b
+      |   z妛鑣腥-e7寧湆貧b螎3z.log
+      |   茐k妸儒wiz.xml
+      |   b鉖动q犟g.cpp
+      |    
+      +---廸3却櫛匹l胍j妩jf0f蘷玣哀a鐤
+      |        菞抱珤礯惈su1zz7禧絿.cpp
+      |        r譠縘c威藘90唨w秽_簌隸艵n园.txt
+      |        _駞of主-m鶼e瓽蝅qf扒f9霗.cpp
+      |         
+      \---9灩z躋w罥1t罿lg
+               v.log
+               _26r泚n0d鐽寎杴滴ee69fl3.xml
+               k涳ir獶ci7.png
+                
+
+Names reach the JSON writers intact.
+
+  $ tree /SYNTH:2,1,2,10,50,0,7 /F /NDJSON
+  {"type":"file","name":"knj躖棽_匴桑q2cqr佃4st鍂u.txt","depth":1,"parent":"SYNTH:","size":118,"modified":"2018-07-14T00:57:01Z"}
+  {"type":"file","name":"銫1zmd鋻谤芯t7fo.log","depth":1,"parent":"SYNTH:","size":8417,"modified":"2018-04-15T16:21:56Z"}
+  {"type":"directory","name":"炎7sl-8w赑尬","depth":1,"parent":"SYNTH:","modified":"2017-07-07T01:10:20Z"}
+  {"type":"file","name":"恝攄付钷d游5鵅u廬.png","depth":2,"parent":"SYNTH:\\炎7sl-8w赑尬","size":13047839,"modified":"2016-10-11T22:26:25Z"}
+  {"type":"file","name":"貏乚v.dat","depth":2,"parent":"SYNTH:\\炎7sl-8w赑尬","size":11515,"modified":"2017-09-15T17:48:45Z"}
+  {"type":"directory","name":"-tj_y萦嚡g粹t_迀j-摄b4b","depth":1,"parent":"SYNTH:","modified":"2016-12-08T19:28:45Z"}
+  {"type":"file","name":"廸3却櫛匹l胍j妩jf0f蘷玣哀a鐤.png","depth":2,"parent":"SYNTH:\\-tj_y萦嚡g粹t_迀j-摄b4b","size":30942,"modified":"2018-11-01T19:29:44Z"}
+  {"type":"file","name":"9灩z躋w罥1t罿lg.xml","depth":2,"parent":"SYNTH:\\-tj_y萦嚡g粹t_迀j-摄b4b","size":878,"modified":"2018-09-15T15:11:36Z"}
+
+The disk source with /A, names from every UTF-8 length class included:
+
+  $ tree unicode /F /A
+  Folder PATH listing for volume POSIX
+  Volume serial number is 1234-ABCD
+  $FIX\unicode
+  |   ASCII.txt
+  |   café.txt
+  |   combining é.txt
+  |   emoji 😀.txt
+  |   naïve résumé.doc
+  |   Русский.txt
+  |    
+  +---zzz
+  |   \---deep
+  |       \---deeper
+  |                bottom.txt
+  |                 
+  +---Ελληνικά
+  \---日本語フォルダ
+      |   中文.txt
+      |    
+      \---한국어
+               데이터.bin
+                
+
+No box drawing character is left with /A:
+
+  $ tree unicode /F /A | grep -c '[│├└─]'
+  0
+  [1]
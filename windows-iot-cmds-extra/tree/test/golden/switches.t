@@ -0,0 +1,55 @@
+/MAX, /CAP, /TIMEOUT, /PREFETCH and /BUF take decimal numbers and nothing
+else. An empty, signed, partly numeric or out of range value is refused
+rather than read as 0, which would mean no limit or no wait.
+
+  $ tree many /F /MAX:3 2>&1 | tail -n +4
+  ├───folder 00
+  │        file 000 with a longer name.txt
+  │        file 001 with a longer name.txt
+  ... listing truncated, limit of 3 entries reached
+  $ tree many /F /MAX:abc
+  Invalid switch - /MAX:abc
+  $ tree many /F /MAX:
+  Invalid switch - /MAX:
+  $ tree many /F /MAX:-1
+  Invalid switch - /MAX:-1
+  $ tree many /F /MAX:18446744073709551616
+  Invalid switch - /MAX:18446744073709551616
+  $ tree many /F /MAX:18446744073709551615 | wc -l
+  4963
+  $ tree many /CAP:2 | tail -n +4
+  ├───folder 00
+  ├───folder 01
+  └───... 78 more folders
+  $ tree many /CAP:2x
+  Invalid switch - /CAP:2x
+  $ tree many /CAP:4294967296
+  Invalid switch - /CAP:4294967296
+  $ tree many /TIMEOUT:x
+  Invalid switch - /TIMEOUT:x
+  $ tree many /TIMEOUT:4294967295
+  Invalid switch - /TIMEOUT:4294967295
+  $ tree many /TIMEOUT:60000 | wc -l
+  83
+  $ tree many /PREFETCH:1025
+  Invalid switch - /PREFETCH:1025
+  $ tree many /PREFETCH:+4
+  Invalid switch - /PREFETCH:+4
+  $ tree many /PREFETCH:1024 | wc -l
+  83
+  $ tree many /BUF:1k
+  Invalid switch - /BUF:1k
+  $ tree many /BUF:0 | wc -l
+  83
+
+The single letter switches are that letter alone. A bare /CAP is not /C,
+and a switch tree doesn't know is refused.
+
+  $ tree many /CAP
+  Invalid switch - /CAP
+  $ tree many /Fx
+  Invalid switch - /Fx
+  $ tree many /X
+  Invalid switch - /X
+  $ tree many /
+  Invalid switch - /
@@ -0,0 +1,50 @@
+Redirected output is UTF-8 with CR LF line ends, names from every UTF-8
+length class included; the one outside the BMP reaches the transcoder as a
+surrogate pair.
+
+  $ tree unicode /F
+  Folder PATH listing for volume POSIX
+  Volume serial number is 1234-ABCD
+  $FIX\unicode
+  │   ASCII.txt
+  │   café.txt
+  │   combining é.txt
+  │   emoji 😀.txt
+  │   naïve résumé.doc
+  │   Русский.txt
+  │    
+  ├───zzz
+  │   └───deep
+  │       └───deeper
+  │                bottom.txt
+  │                 
+  ├───Ελληνικά
+  └───日本語フォルダ
+      │   中文.txt
+      │    
+      └───한국어
+               데이터.bin
+                
+  $ tree unicode /F /A | grep emoji | od -An -c
+     |               e   m   o   j   i     360 237 230 200   .   t
+     x   t  \r  \n
+  $ tree unicode /F | iconv -f UTF-8 -t UTF-8 > /dev/null && echo valid
+  valid
+
+A name that isn't valid UTF-8 reaches tree as unpaired surrogates, as one
+that isn't valid Unicode does on Windows, and is opened again by them. Text
+output writes U+FFFD in their place, JSON keeps them as escapes.
+
+  $ cd $T && mkdir -p "bad/$(printf 'caf\351')/sub" && touch "bad/$(printf 'caf\351')/sub/x" "bad/$(printf 'r\351sum\351.txt')"
+  $ cd $T && tree bad /F | tail -n +4
+  │   r�sum�.txt
+  │    
+  └───caf�
+      └───sub
+               x
+                
+  $ cd $T && tree bad /F /NDJSON | grep -o '"name":"[^"]*"'
+  "name":"r\udce9sum\udce9.txt"
+  "name":"caf\udce9"
+  "name":"sub"
+  "name":"x"
@@ -0,0 +1,20 @@
+Output written through the writer thread is byte for byte what the
+synchronous path writes, whatever the queue size, also when a slow reader
+makes the traversal wait for the writer.
+
+  $ tree many /F /BUF:0 > $T/sync
+  $ wc -l < $T/sync
+  4963
+  $ tree many /F | cmp - $T/sync
+  $ tree many /F /BUF:64 | cmp - $T/sync
+  $ tree many /F /BUF:200 | cmp - $T/sync
+  $ tree many /F /BUF:64 | (sleep 0.3; cat) | cmp - $T/sync
+  $ TREE_CONSOLE=1 tree many /F /BUF:64 | cmp - $T/sync
+  $ TREE_CONSOLE=1 tree many /F /BUF:0 | cmp - $T/sync
+
+The same holds for the JSON writers, which mix narrow and wide writes.
+
+  $ tree many /F /NDJSON /BUF:0 > $T/ndjson
+  $ tree many /F /NDJSON /BUF:64 | (sleep 0.3; cat) | cmp - $T/ndjson
+  $ tree many /F /JSON /BUF:0 > $T/json
+  $ tree many /F /JSON /BUF:64 | cmp - $T/json
@@ -0,0 +1,264 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Writes a fixed corpus through the output writer, for comparing its UTF-16 and UTF-8 paths
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "../output.h"
+
+/* code units in each of the long lines, enough to cross every step and chunk boundary twice */
+#define LONG_LINE (70 * 1024)
+
+/* a piece of the corpus as UTF-16, and the same text as UTF-8 */
+typedef struct _PIECE
+{
+	wchar_t* wide;
+	size_t wideLen;
+	char* narrow;
+	size_t narrowLen;
+} PIECE;
+
+static PIECE* arrPiece = NULL;
+static UINT pieceCount = 0;
+static UINT pieceMax = 0;
+
+/**
+* @name: AddPiece
+*
+* @param str
+* UTF-16 text, taken over by the corpus
+*
+* @param len
+* number of code units in str
+*
+* @return
+* void
+*/
+static VOID AddPiece(wchar_t* str, size_t len)
+{
+	PIECE* piece = NULL;
+	int n = 0;
+
+	if (pieceCount == pieceMax)
+	{
+		pieceMax = pieceMax ? pieceMax * 2 : 64;
+		arrPiece = (PIECE*)realloc(arrPiece, pieceMax * sizeof(PIECE));
+		if (arrPiece == NULL)
+			exit(-1);
+	}
+
+	piece = &arrPiece[pieceCount++];
+	piece->wide = str;
+	piece->wideLen = len;
+
+	n = WideCharToMultiByte(CP_UTF8, 0, str, (int)len, NULL, 0, NULL, NULL);
+	piece->narrow = (char*)malloc(n + 1);
+	if (piece->narrow == NULL)
+		exit(-1);
+
+	piece->narrowLen = WideCharToMultiByte(CP_UTF8, 0, str, (int)len, piece->narrow, n, NULL, NULL);
+	piece->narrow[piece->narrowLen] = '\0';
+}
+
+/**
+* @name: AddString
+*
+* @param str
+* NUL terminated UTF-16 text
+*
+* @return
+* void
+*/
+static VOID AddString(const wchar_t* str)
+{
+	size_t len = wcslen(str);
+	wchar_t* copy = (wchar_t*)malloc((len + 1) * sizeof(wchar_t));
+
+	if (copy == NULL)
+		exit(-1);
+
+	memcpy(copy, str, (len + 1) * sizeof(wchar_t));
+	AddPiece(copy, len);
+}
+
+/**
+* @name: AddLongLine
+*
+* @param unit
+* text repeated to fill the line, a whole number of characters
+*
+* @param every
+* if non zero, a surrogate pair is put in after this many repetitions
+*
+* @return
+* void
+*
+* the pairs land on different offsets relative to the step sizes, so
+* some of them straddle a boundary the writer has to step around
+*/
+static VOID AddLongLine(const wchar_t* unit, UINT every)
+{
+	wchar_t* str = (wchar_t*)malloc((LONG_LINE + 8) * sizeof(wchar_t));
+	size_t unitLen = wcslen(unit);
+	size_t len = 0;
+	UINT count = 0;
+
+	if (str == NULL)
+		exit(-1);
+
+	while (len + unitLen + 2 <= LONG_LINE)
+	{
+		memcpy(str + len, unit, unitLen * sizeof(wchar_t));
+		len += unitLen;
+
+		if (every != 0 && ++count % every == 0)
+		{
+			/* U+1F600 */
+			str[len++] = 0xD83D;
+			str[len++] = 0xDE00;
+		}
+	}
+
+	str[len] = L'\0';
+	AddPiece(str, len);
+}
+
+/**
+* @name: AddStraddle
+*
+* @param before
+* code units put ahead of the surrogate pair
+*
+* @return
+* void
+*
+* as the first piece, the pair straddles the end of the first console
+* write, which must not split it
+*/
+static VOID AddStraddle(size_t before)
+{
+	wchar_t* str = (wchar_t*)malloc((before + 3) * sizeof(wchar_t));
+	size_t i = 0;
+
+	if (str == NULL)
+		exit(-1);
+
+	for (i = 0; i < before; ++i)
+		str[i] = L'x';
+
+	/* U+1F600 */
+	str[before] = 0xD83D;
+	str[before + 1] = 0xDE00;
+	str[before + 2] = L'\0';
+	AddPiece(str, before + 2);
+}
+
+/**
+* @name: BuildCorpus
+*
+* @return
+* void
+*/
+static VOID BuildCorpus(VOID)
+{
+	static const wchar_t emoji[] = { L'e', L'm', L'o', L'j', L'i', L' ', 0xD83D, 0xDE00, L'.', L't', L'x', L't', 0 };
+
+	AddStraddle(CONSOLE_WRITE_MAX - 1);
+	AddString(L"Folder PATH listing");
+	AddString(L"│   ├───café.txt");
+	AddString(L"└───日本語フォルダ");
+	AddString(L"naïve résumé.doc");
+	AddString(L"combining é.txt");
+	AddString(emoji);
+	AddString(L"Русский Ελληνικά 한국어");
+	AddString(L"");
+
+	AddLongLine(L"a", 7);
+	AddLongLine(L"é", 5);
+	AddLongLine(L"中", 3);
+	AddLongLine(L"|   ", 0);
+	AddLongLine(L"", 1);
+}
+
+/**
+* @name: wmain
+*
+* @param argv
+* argv[1] is wide or narrow, the OutputWrite instantiation to use. argv[2],
+* if given, is the queue size for OutputInit
+*
+* @return
+* 0, or 1 on a usage error
+*
+* writes each piece of the corpus followed by a line break. Every third
+* piece goes through OutputWriteString, the others are cut into calls of
+* varying length that never split a character
+*/
+int wmain(int argc, wchar_t* argv[])
+{
+	BOOL bNarrow = FALSE;
+	UINT i = 0;
+
+	if (argc < 2 || (wcscmp(argv[1], L"wide") != 0 && wcscmp(argv[1], L"narrow") != 0))
+	{
+		fwprintf(stderr, L"usage: outwrite wide|narrow [queue bytes]\n");
+		return 1;
+	}
+
+	bNarrow = wcscmp(argv[1], L"narrow") == 0;
+	BuildCorpus();
+	OutputInit(argc > 2 ? (size_t)wcstoul(argv[2], NULL, 10) : 0);
+
+	for (i = 0; i < pieceCount; ++i)
+	{
+		const PIECE* piece = &arrPiece[i];
+		size_t done = 0;
+		size_t cut = 1 + i * 997;
+
+		if (i % 3 == 0)
+		{
+			if (bNarrow)
+				OutputWriteString(piece->narrow);
+			else
+				OutputWriteString(piece->wide);
+
+			OutputNewLine();
+			continue;
+		}
+
+		while (done < (bNarrow ? piece->narrowLen : piece->wideLen))
+		{
+			size_t n = 0;
+
+			if (bNarrow)
+			{
+				n = min(cut, piece->narrowLen - done);
+				while (done + n < piece->narrowLen && (piece->narrow[done + n] & 0xC0) == 0x80)
+					++n;
+
+				OutputWrite(piece->narrow + done, n);
+			}
+			else
+			{
+				n = min(cut, piece->wideLen - done);
+				if (done + n < piece->wideLen && (piece->wide[done + n] & 0xFC00) == 0xDC00)
+					++n;
+
+				OutputWrite(piece->wide + done, n);
+			}
+
+			done += n;
+			cut = cut * 3 % 40009 + 1;
+		}
+
+		OutputNewLine();
+	}
+
+	OutputFlush();
+	return 0;
+}
@@ -0,0 +1,41 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Microsoft CRT extensions tree.com uses, force-included into every file of the harness build
+*/
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#define _TRUNCATE ((size_t)-1)
+#define STRUNCATE 80
+
+int wcscpy_s(wchar_t* dst, size_t size, const wchar_t* src);
+int wcscat_s(wchar_t* dst, size_t size, const wchar_t* src);
+int wcsncpy_s(wchar_t* dst, size_t size, const wchar_t* src, size_t count);
+int _wcsicmp(const wchar_t* a, const wchar_t* b);
+int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t count);
+wchar_t* _wfullpath(wchar_t* dst, const wchar_t* path, size_t size);
+int _wfopen_s(FILE** pFile, const wchar_t* path, const wchar_t* mode);
+int _getdrive(void);
+
+#define _wcstoui64 wcstoull
+#define _strtoui64 strtoull
+#define _strtoi64 strtoll
+
+/*
+ * the wide printf family follows MSVC: %s and %c take wide arguments, %hs
+ * and %S narrow ones. Formatting goes through PosixFormat, and stdio only
+ * ever sees UTF-8 so narrow and wide writes to one stream can be mixed
+ */
+int PosixFormat(wchar_t* dst, size_t size, const wchar_t* format, va_list args);
+int PosixFwprintf(FILE* file, const wchar_t* format, ...);
+int PosixSwprintf(wchar_t* dst, size_t size, const wchar_t* format, ...);
+#define fwprintf PosixFwprintf
+#define swprintf_s PosixSwprintf
+#define swscanf_s swscanf
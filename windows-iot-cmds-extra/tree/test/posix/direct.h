@@ -0,0 +1,9 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     direct.h for the harness build
+*/
+
+#pragma once
+
+int _getdrive(void);
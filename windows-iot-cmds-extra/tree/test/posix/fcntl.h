@@ -0,0 +1,14 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     fcntl.h for the harness build
+*/
+
+#pragma once
+
+#include_next <fcntl.h>
+
+#define _O_TEXT 0x4000
+#define _O_BINARY 0x8000
+#define _O_U16TEXT 0x20000
+#define _O_U8TEXT 0x40000
@@ -0,0 +1,30 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     intrin.h for the harness build, only utf8.cpp's x86 path needs it
+*/
+
+#pragma once
+
+#include <immintrin.h>
+
+/* GCC's cpuid.h has a __cpuid macro of its own, so these are spelled out */
+static inline void __cpuidex(int info[4], int leaf, int subleaf)
+{
+	__asm__ __volatile__("cpuid" : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3]) : "a"(leaf), "c"(subleaf));
+}
+
+static inline void __cpuid(int info[4], int leaf)
+{
+	__cpuidex(info, leaf, 0);
+}
+
+/* GCC only provides _xgetbv with -mxsave */
+static inline unsigned long long PosixXgetbv(unsigned int index)
+{
+	unsigned int eax, edx;
+
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((unsigned long long)edx << 32) | eax;
+}
+#define _xgetbv PosixXgetbv
@@ -0,0 +1,12 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     io.h for the harness build, file descriptors are always binary
+*/
+
+#pragma once
+
+#include <stdio.h>
+
+#define _fileno fileno
+#define _setmode(fd, mode) ((void)(fd), (mode))
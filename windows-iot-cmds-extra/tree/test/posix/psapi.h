@@ -0,0 +1,9 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     psapi.h for the harness build, GetProcessMemoryInfo is declared in windows.h
+*/
+
+#pragma once
+
+#include <windows.h>
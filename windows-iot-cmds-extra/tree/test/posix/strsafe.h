@@ -0,0 +1,18 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     strsafe.h for the harness build, see win32.cpp
+*/
+
+#pragma once
+
+#include <stdarg.h>
+#include <windows.h>
+
+HRESULT StringCchCopy(LPWSTR dst, size_t size, LPCWSTR src);
+HRESULT StringCchCopyN(LPWSTR dst, size_t size, LPCWSTR src, size_t count);
+HRESULT StringCchCat(LPWSTR dst, size_t size, LPCWSTR src);
+HRESULT StringCchLength(LPCWSTR str, size_t max, size_t* pLen);
+HRESULT StringCchVPrintf(LPWSTR dst, size_t size, LPCWSTR format, va_list args);
+HRESULT StringCchPrintf(LPWSTR dst, size_t size, LPCWSTR format, ...);
+HRESULT StringCchPrintfA(char* dst, size_t size, const char* format, ...);
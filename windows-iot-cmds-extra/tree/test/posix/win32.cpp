@@ -0,0 +1,1603 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     The part of the Win32 API and CRT tree.com uses, implemented over POSIX for the test harness
+*/
+
+/*
+ * This is not a port: it is just enough Windows for tree.com's own sources
+ * to build and run unchanged on Linux, so their output can be compared with
+ * golden files and their speed measured. Names are handed to tree.com as
+ * UTF-16, surrogate pairs included, whatever the size of wchar_t, and paths
+ * with backslashes; file systems see UTF-8 with forward slashes.
+ */
+
+#define NOMINMAX
+#include <windows.h>
+#include <strsafe.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <locale.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* 100ns intervals between 1601-01-01 and 1970-01-01 */
+#define EPOCH_DIFFERENCE 116444736000000000ULL
+
+/* highest number of threads the thread pool grows to */
+#define POOL_THREADS_MAX 64
+
+static __thread DWORD lastError = ERROR_SUCCESS;
+
+DWORD GetLastError(VOID)
+{
+	return lastError;
+}
+
+VOID SetLastError(DWORD error)
+{
+	lastError = error;
+}
+
+/* errno as the Win32 error the same failure reports on Windows */
+static DWORD ErrnoToError(int err)
+{
+	switch (err)
+	{
+	case ENOENT:
+		return ERROR_FILE_NOT_FOUND;
+	case ENOTDIR:
+		return ERROR_PATH_NOT_FOUND;
+	case EACCES:
+	case EPERM:
+		return ERROR_ACCESS_DENIED;
+	case ENOMEM:
+		return ERROR_NOT_ENOUGH_MEMORY;
+	default:
+		return ERROR_ACCESS_DENIED;
+	}
+}
+
+/*
+ * UTF-8 and UTF-16
+ */
+
+/*
+ * appends the UTF-16 form of UTF-8 bytes, with U+FFFD for each maximal
+ * invalid subpart as Windows does. With bName, each byte of such a part
+ * becomes the unpaired surrogate U+DC80 to U+DCFF instead, as a file name
+ * that isn't valid Unicode is on Windows, so that AppendUtf8 gives back
+ * the same bytes and the file can be opened again
+ */
+static void AppendUtf16(std::wstring& out, const char* str, size_t len, bool bName = false)
+{
+	const unsigned char* s = (const unsigned char*)str;
+	size_t i = 0;
+
+	while (i < len)
+	{
+		size_t start = i;
+		unsigned c = s[i];
+		unsigned need = 0;
+		unsigned lo = 0x80;
+		unsigned hi = 0xBF;
+		unsigned cp = 0;
+
+		if (c < 0x80)
+		{
+			out += (wchar_t)c;
+			++i;
+			continue;
+		}
+
+		if (c >= 0xC2 && c <= 0xDF)
+		{
+			need = 1;
+			cp = c & 0x1F;
+		}
+		else if (c >= 0xE0 && c <= 0xEF)
+		{
+			need = 2;
+			cp = c & 0x0F;
+			lo = (c == 0xE0) ? 0xA0 : 0x80;
+			hi = (c == 0xED) ? 0x9F : 0xBF;
+		}
+		else if (c >= 0xF0 && c <= 0xF4)
+		{
+			need = 3;
+			cp = c & 0x07;
+			lo = (c == 0xF0) ? 0x90 : 0x80;
+			hi = (c == 0xF4) ? 0x8F : 0xBF;
+		}
+		else
+		{
+			out += bName ? (wchar_t)(0xDC00 + c) : (wchar_t)0xFFFD;
+			++i;
+			continue;
+		}
+
+		++i;
+		while (need > 0)
+		{
+			if (i >= len || s[i] < lo || s[i] > hi)
+				break;
+
+			cp = (cp << 6) | (s[i] & 0x3F);
+			lo = 0x80;
+			hi = 0xBF;
+			++i;
+			--need;
+		}
+
+		if (need > 0 && bName)
+		{
+			for (; start < i; ++start)
+				out += (wchar_t)(0xDC00 + s[start]);
+		}
+		else if (need > 0)
+			out += (wchar_t)0xFFFD;
+		else if (cp >= 0x10000)
+		{
+			out += (wchar_t)(0xD800 + ((cp - 0x10000) >> 10));
+			out += (wchar_t)(0xDC00 + ((cp - 0x10000) & 0x3FF));
+		}
+		else
+			out += (wchar_t)cp;
+	}
+}
+
+/* a name or path from the system, see AppendUtf16 */
+static std::wstring Widen(const char* str)
+{
+	std::wstring out;
+
+	AppendUtf16(out, str, strlen(str), true);
+	return out;
+}
+
+/*
+ * appends the UTF-8 form of UTF-16 code units, with U+FFFD for unpaired
+ * surrogates. With bName, U+DC80 to U+DCFF are the bytes AppendUtf16 found
+ * outside of valid UTF-8 and are written as those bytes again
+ */
+static void AppendUtf8(std::string& out, const wchar_t* str, size_t len, bool bName = false)
+{
+	size_t i = 0;
+
+	while (i < len)
+	{
+		unsigned c = (unsigned)str[i++];
+
+		if (c >= 0xD800 && c <= 0xDBFF && i < len && (unsigned)str[i] >= 0xDC00 && (unsigned)str[i] <= 0xDFFF)
+			c = 0x10000 + ((c - 0xD800) << 10) + ((unsigned)str[i++] - 0xDC00);
+		else if (bName && c >= 0xDC80 && c <= 0xDCFF)
+		{
+			out += (char)(c - 0xDC00);
+			continue;
+		}
+		else if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+			c = 0xFFFD;
+
+		if (c < 0x80)
+			out += (char)c;
+		else if (c < 0x800)
+		{
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			out += (char)(0xE0 | (c >> 12));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (c >> 18));
+			out += (char)(0x80 | ((c >> 12) & 0x3F));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+}
+
+/* a name or path for the system, see AppendUtf8 */
+static std::string Narrow(const wchar_t* str)
+{
+	std::string out;
+
+	AppendUtf8(out, str, wcslen(str), true);
+	return out;
+}
+
+/* a Win32 path as a POSIX one, backslashes become slashes */
+static std::string PosixPath(const wchar_t* str)
+{
+	std::string out = Narrow(str);
+
+	std::replace(out.begin(), out.end(), '\\', '/');
+	return out;
+}
+
+/* a POSIX path as tree.com expects one, with backslashes */
+static std::wstring Win32Path(const char* str)
+{
+	std::wstring out = Widen(str);
+
+	std::replace(out.begin(), out.end(), L'/', L'\\');
+	return out;
+}
+
+int MultiByteToWideChar(UINT codePage, DWORD flags, const char* src, int srcLen, LPWSTR dst, int dstLen)
+{
+	std::wstring out;
+
+	(void)codePage;
+	(void)flags;
+
+	AppendUtf16(out, src, (srcLen < 0) ? strlen(src) + 1 : (size_t)srcLen);
+
+	if (dstLen == 0)
+		return (int)out.size();
+
+	if (out.size() > (size_t)dstLen)
+	{
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return 0;
+	}
+
+	wmemcpy(dst, out.data(), out.size());
+	return (int)out.size();
+}
+
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR src, int srcLen, char* dst, int dstLen,
+	const char* defaultChar, BOOL* pUsedDefault)
+{
+	std::string out;
+
+	(void)codePage;
+	(void)flags;
+	(void)defaultChar;
+
+	if (pUsedDefault != NULL)
+		*pUsedDefault = FALSE;
+
+	AppendUtf8(out, src, (srcLen < 0) ? wcslen(src) + 1 : (size_t)srcLen);
+
+	if (dstLen == 0)
+		return (int)out.size();
+
+	if (out.size() > (size_t)dstLen)
+	{
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return 0;
+	}
+
+	memcpy(dst, out.data(), out.size());
+	return (int)out.size();
+}
+
+/*
+ * time
+ */
+
+static FILETIME ToFileTime(const struct timespec& ts)
+{
+	ULONGLONG t = (ULONGLONG)ts.tv_sec * 10000000ULL + (ULONGLONG)ts.tv_nsec / 100 + EPOCH_DIFFERENCE;
+	FILETIME ft;
+
+	ft.dwLowDateTime = (DWORD)t;
+	ft.dwHighDateTime = (DWORD)(t >> 32);
+	return ft;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* pCount)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pCount->QuadPart = (LONGLONG)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+VOID Sleep(DWORD ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+BOOL FileTimeToSystemTime(const FILETIME* ft, SYSTEMTIME* st)
+{
+	ULONGLONG t = ((ULONGLONG)ft->dwHighDateTime << 32) | ft->dwLowDateTime;
+	time_t secs = (time_t)(t / 10000000ULL) - (time_t)(EPOCH_DIFFERENCE / 10000000ULL);
+	struct tm tm;
+
+	if (gmtime_r(&secs, &tm) == NULL)
+		return FALSE;
+
+	st->wYear = (WORD)(tm.tm_year + 1900);
+	st->wMonth = (WORD)(tm.tm_mon + 1);
+	st->wDayOfWeek = (WORD)tm.tm_wday;
+	st->wDay = (WORD)tm.tm_mday;
+	st->wHour = (WORD)tm.tm_hour;
+	st->wMinute = (WORD)tm.tm_min;
+	st->wSecond = (WORD)tm.tm_sec;
+	st->wMilliseconds = (WORD)((t / 10000ULL) % 1000);
+	return TRUE;
+}
+
+BOOL SystemTimeToFileTime(const SYSTEMTIME* st, FILETIME* ft)
+{
+	static const int days[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	struct timespec ts;
+	struct tm tm;
+
+	/* Windows rejects what does not name a real instant, rather than normalising it */
+	if (st->wYear < 1601 || st->wYear > 30827 || st->wMonth < 1 || st->wMonth > 12 ||
+		st->wDay < 1 || st->wDay > days[st->wMonth - 1] || st->wHour > 23 || st->wMinute > 59 ||
+		st->wSecond > 59 || st->wMilliseconds > 999)
+		return FALSE;
+
+	if (st->wMonth == 2 && st->wDay == 29 && !((st->wYear % 4 == 0 && st->wYear % 100 != 0) || st->wYear % 400 == 0))
+		return FALSE;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = st->wYear - 1900;
+	tm.tm_mon = st->wMonth - 1;
+	tm.tm_mday = st->wDay;
+	tm.tm_hour = st->wHour;
+	tm.tm_min = st->wMinute;
+	tm.tm_sec = st->wSecond;
+
+	ts.tv_sec = timegm(&tm);
+	ts.tv_nsec = st->wMilliseconds * 1000000L;
+
+	/* before 1970 timespec goes negative, so do the arithmetic in signed 100ns units */
+	LONGLONG t = (LONGLONG)ts.tv_sec * 10000000LL + ts.tv_nsec / 100 + (LONGLONG)EPOCH_DIFFERENCE;
+	ft->dwLowDateTime = (DWORD)t;
+	ft->dwHighDateTime = (DWORD)((ULONGLONG)t >> 32);
+	return TRUE;
+}
+
+BOOL DosDateTimeToFileTime(WORD date, WORD time, FILETIME* ft)
+{
+	SYSTEMTIME st;
+
+	memset(&st, 0, sizeof(st));
+	st.wYear = (WORD)(1980 + (date >> 9));
+	st.wMonth = (WORD)((date >> 5) & 0x0F);
+	st.wDay = (WORD)(date & 0x1F);
+	st.wHour = (WORD)(time >> 11);
+	st.wMinute = (WORD)((time >> 5) & 0x3F);
+	st.wSecond = (WORD)((time & 0x1F) * 2);
+	return SystemTimeToFileTime(&st, ft);
+}
+
+/* the harness runs with TZ=UTC, so local time is UTC */
+BOOL LocalFileTimeToFileTime(const FILETIME* local, FILETIME* ft)
+{
+	*ft = *local;
+	return TRUE;
+}
+
+/*
+ * directories
+ */
+
+/* an open FindFirstFile search: the whole directory, read and sorted up front */
+typedef struct _POSIX_FIND
+{
+	std::string dir;
+	std::vector<std::string> names;
+	size_t next;
+} POSIX_FIND;
+
+/* NTFS hands out names in upper-cased ordinal order, doing the same keeps listings reproducible */
+static bool NameLess(const std::wstring& a, const std::wstring& b)
+{
+	size_t n = std::min(a.size(), b.size());
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		wint_t x = towupper(a[i]);
+		wint_t y = towupper(b[i]);
+
+		if (x != y)
+			return x < y;
+	}
+
+	return a.size() < b.size();
+}
+
+/* Windows' own quirks: *.* matches every name, dot or not, and a trailing dot only names without one */
+static bool WildcardMatch(const std::string& pattern, const char* name)
+{
+	if (pattern == "*" || pattern == "*.*")
+		return true;
+
+	if (pattern.size() > 1 && pattern.back() == '.')
+	{
+		if (strchr(name, '.') != NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0)
+			return false;
+
+		return fnmatch(pattern.substr(0, pattern.size() - 1).c_str(), name, FNM_CASEFOLD) == 0;
+	}
+
+	return fnmatch(pattern.c_str(), name, FNM_CASEFOLD) == 0;
+}
+
+static BOOL FillFindData(const POSIX_FIND* find, const std::string& name, WIN32_FIND_DATAW* pFindData)
+{
+	std::string path = find->dir + "/" + name;
+	std::wstring wide = Widen(name.c_str());
+	struct stat st;
+	ULONGLONG size = 0;
+
+	memset(pFindData, 0, sizeof(*pFindData));
+
+	if (lstat(path.c_str(), &st) != 0)
+		return FALSE;
+
+	if (S_ISDIR(st.st_mode))
+		pFindData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+	else if (S_ISLNK(st.st_mode))
+		pFindData->dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_REPARSE_POINT;
+	else
+		pFindData->dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+
+	if (name[0] == '.' && name != "." && name != "..")
+		pFindData->dwFileAttributes |= FILE_ATTRIBUTE_HIDDEN;
+
+	if (!(st.st_mode & S_IWUSR))
+		pFindData->dwFileAttributes |= FILE_ATTRIBUTE_READONLY;
+
+	if (!S_ISDIR(st.st_mode))
+		size = (ULONGLONG)st.st_size;
+
+	pFindData->nFileSizeHigh = (DWORD)(size >> 32);
+	pFindData->nFileSizeLow = (DWORD)size;
+	pFindData->ftLastWriteTime = ToFileTime(st.st_mtim);
+	pFindData->ftLastAccessTime = ToFileTime(st.st_atim);
+	pFindData->ftCreationTime = pFindData->ftLastWriteTime;
+
+	/* a name too long for MAX_PATH does not exist as far as FindFirstFile goes */
+	wcsncpy(pFindData->cFileName, wide.c_str(), MAX_PATH - 1);
+	return TRUE;
+}
+
+HANDLE FindFirstFileW(LPCWSTR strPattern, WIN32_FIND_DATAW* pFindData)
+{
+	std::string pattern = PosixPath(strPattern);
+	size_t slash = pattern.rfind('/');
+	std::vector<std::wstring> wide;
+	POSIX_FIND* find = new POSIX_FIND;
+	struct dirent* entry = NULL;
+	DIR* dir = NULL;
+
+	find->dir = (slash == std::string::npos) ? "." : (slash == 0) ? "/" : pattern.substr(0, slash);
+	find->next = 0;
+	pattern = (slash == std::string::npos) ? pattern : pattern.substr(slash + 1);
+
+	dir = opendir(find->dir.c_str());
+	if (dir == NULL)
+	{
+		SetLastError(errno == ENOENT ? ERROR_PATH_NOT_FOUND : ErrnoToError(errno));
+		delete find;
+		return INVALID_HANDLE_VALUE;
+	}
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (WildcardMatch(pattern, entry->d_name))
+			find->names.push_back(entry->d_name);
+	}
+
+	closedir(dir);
+
+	std::sort(find->names.begin(), find->names.end(), [](const std::string& a, const std::string& b)
+	{
+		return NameLess(Widen(a.c_str()), Widen(b.c_str()));
+	});
+
+	if (!FindNextFileW(find, pFindData))
+	{
+		delete find;
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return find;
+}
+
+BOOL FindNextFileW(HANDLE hFind, WIN32_FIND_DATAW* pFindData)
+{
+	POSIX_FIND* find = (POSIX_FIND*)hFind;
+
+	/* entries removed since the directory was read are skipped */
+	while (find->next < find->names.size())
+	{
+		if (FillFindData(find, find->names[find->next++], pFindData))
+			return TRUE;
+	}
+
+	SetLastError(ERROR_NO_MORE_FILES);
+	return FALSE;
+}
+
+BOOL FindClose(HANDLE hFind)
+{
+	delete (POSIX_FIND*)hFind;
+	return TRUE;
+}
+
+DWORD GetFileAttributes(LPCWSTR strPath)
+{
+	struct stat st;
+
+	if (stat(PosixPath(strPath).c_str(), &st) != 0)
+	{
+		SetLastError(ErrnoToError(errno));
+		return INVALID_FILE_ATTRIBUTES;
+	}
+
+	return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+}
+
+BOOL SetCurrentDirectory(LPCWSTR strPath)
+{
+	if (chdir(PosixPath(strPath).c_str()) != 0)
+	{
+		SetLastError(ErrnoToError(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+DWORD GetCurrentDirectory(DWORD size, LPWSTR strPath)
+{
+	char buf[4096];
+	std::wstring wide;
+
+	if (getcwd(buf, sizeof(buf)) == NULL)
+		return 0;
+
+	wide = Win32Path(buf);
+	if (size < wide.size() + 1)
+		return (DWORD)wide.size() + 1;
+
+	wmemcpy(strPath, wide.c_str(), wide.size() + 1);
+	return (DWORD)wide.size();
+}
+
+/* every folder is on one volume with a fixed label and serial number, which golden output relies on */
+BOOL GetVolumeInformation(LPCWSTR strRoot, LPWSTR strName, DWORD nameSize, LPDWORD pSerial,
+	LPDWORD pMaxComponent, LPDWORD pFlags, LPWSTR strFileSystem, DWORD fileSystemSize)
+{
+	(void)strRoot;
+	(void)pMaxComponent;
+	(void)pFlags;
+	(void)strFileSystem;
+	(void)fileSystemSize;
+
+	if (strName != NULL)
+		StringCchCopy(strName, nameSize, L"POSIX");
+
+	if (pSerial != NULL)
+		*pSerial = 0x1234ABCD;
+
+	return TRUE;
+}
+
+DWORD GetTempPath(DWORD size, LPWSTR strPath)
+{
+	const char* dir = getenv("TMPDIR");
+	std::wstring wide = Win32Path((dir != NULL && dir[0] != '\0') ? dir : "/tmp");
+
+	if (wide.back() != L'\\')
+		wide += L'\\';
+
+	if (size < wide.size() + 1)
+		return (DWORD)wide.size() + 1;
+
+	wmemcpy(strPath, wide.c_str(), wide.size() + 1);
+	return (DWORD)wide.size();
+}
+
+/* with unique 0 the file is created, as on Windows */
+UINT GetTempFileName(LPCWSTR strDir, LPCWSTR strPrefix, UINT unique, LPWSTR strFile)
+{
+	UINT n = (unique != 0) ? unique : ((UINT)getpid() ^ (UINT)time(NULL)) & 0xFFFF;
+
+	for (UINT tries = 0; tries < 0x10000; ++tries, n = (n + 1) & 0xFFFF)
+	{
+		int fd = -1;
+
+		if (n == 0)
+			continue;
+
+		if (FAILED(StringCchPrintf(strFile, MAX_PATH, L"%s%.3s%X.tmp", strDir, strPrefix, n)))
+			return 0;
+
+		if (unique != 0)
+			return unique;
+
+		fd = open(PosixPath(strFile).c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+		if (fd >= 0)
+		{
+			close(fd);
+			return n;
+		}
+
+		if (errno != EEXIST)
+			break;
+	}
+
+	SetLastError(ErrnoToError(errno));
+	return 0;
+}
+
+BOOL DeleteFile(LPCWSTR strPath)
+{
+	if (unlink(PosixPath(strPath).c_str()) != 0)
+	{
+		SetLastError(ErrnoToError(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* paths are case sensitive here, so upper-casing one would name another file */
+LPWSTR CharUpper(LPWSTR str)
+{
+	return str;
+}
+
+/*
+ * files and mappings: a file HANDLE is its descriptor, anything else is an object
+ */
+
+typedef enum _POSIX_OBJECT_TYPE
+{
+	OBJECT_MAPPING,
+	OBJECT_THREAD
+} POSIX_OBJECT_TYPE;
+
+typedef struct _POSIX_OBJECT
+{
+	POSIX_OBJECT_TYPE type;
+	int fd;
+	pthread_t thread;
+	LPTHREAD_START_ROUTINE start;
+	LPVOID param;
+} POSIX_OBJECT;
+
+/* descriptors are small numbers, objects live on the heap well above them */
+static bool IsDescriptor(HANDLE h)
+{
+	return (uintptr_t)h < 0x10000;
+}
+
+static int Descriptor(HANDLE h)
+{
+	return (int)(intptr_t)h;
+}
+
+HANDLE CreateFile(LPCWSTR strPath, DWORD access, DWORD share, LPVOID security, DWORD disposition, DWORD flags, HANDLE hTemplate)
+{
+	std::string path = PosixPath(strPath);
+	int mode = O_RDONLY;
+	int fd = -1;
+
+	(void)share;
+	(void)security;
+	(void)hTemplate;
+
+	if ((access & GENERIC_READ) && (access & GENERIC_WRITE))
+		mode = O_RDWR;
+	else if (access & GENERIC_WRITE)
+		mode = O_WRONLY;
+
+	if (disposition == CREATE_ALWAYS)
+		mode |= O_CREAT | O_TRUNC;
+	else if (disposition == CREATE_NEW)
+		mode |= O_CREAT | O_EXCL;
+
+	fd = open(path.c_str(), mode | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		SetLastError(ErrnoToError(errno));
+		return INVALID_HANDLE_VALUE;
+	}
+
+	/* unlinked right away, the file still lives until the descriptor is closed */
+	if (flags & FILE_FLAG_DELETE_ON_CLOSE)
+		unlink(path.c_str());
+
+	return (HANDLE)(intptr_t)fd;
+}
+
+BOOL ReadFile(HANDLE hFile, LPVOID buf, DWORD len, LPDWORD pRead, LPVOID overlapped)
+{
+	ssize_t n = 0;
+
+	(void)overlapped;
+
+	do
+		n = read(Descriptor(hFile), buf, len);
+	while (n < 0 && errno == EINTR);
+
+	if (n < 0)
+	{
+		SetLastError(ErrnoToError(errno));
+		return FALSE;
+	}
+
+	*pRead = (DWORD)n;
+	return TRUE;
+}
+
+/* like WriteFile on a blocking handle, returns only once everything is written or writing failed */
+BOOL WriteFile(HANDLE hFile, LPCVOID buf, DWORD len, LPDWORD pWritten, LPVOID overlapped)
+{
+	DWORD done = 0;
+
+	(void)overlapped;
+
+	while (done < len)
+	{
+		ssize_t n = write(Descriptor(hFile), (const char*)buf + done, len - done);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+		{
+			SetLastError(ErrnoToError(errno));
+			*pWritten = done;
+			return FALSE;
+		}
+
+		done += (DWORD)n;
+	}
+
+	*pWritten = done;
+	return TRUE;
+}
+
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pSize)
+{
+	struct stat st;
+
+	if (fstat(Descriptor(hFile), &st) != 0)
+		return FALSE;
+
+	pSize->QuadPart = st.st_size;
+	return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER* pPos, DWORD method)
+{
+	off_t pos = lseek(Descriptor(hFile), distance.QuadPart,
+		(method == FILE_BEGIN) ? SEEK_SET : (method == FILE_CURRENT) ? SEEK_CUR : SEEK_END);
+
+	if (pos < 0)
+		return FALSE;
+
+	if (pPos != NULL)
+		pPos->QuadPart = pos;
+
+	return TRUE;
+}
+
+BOOL CloseHandle(HANDLE h)
+{
+	POSIX_OBJECT* object = (POSIX_OBJECT*)h;
+
+	if (IsDescriptor(h))
+		return close(Descriptor(h)) == 0;
+
+	/* a thread keeps running without its handle, as on Windows */
+	if (object->type == OBJECT_MAPPING)
+		close(object->fd);
+
+	delete object;
+	return TRUE;
+}
+
+HANDLE CreateFileMapping(HANDLE hFile, LPVOID security, DWORD protect, DWORD sizeHigh, DWORD sizeLow, LPCWSTR strName)
+{
+	POSIX_OBJECT* object = NULL;
+	struct stat st;
+
+	(void)security;
+	(void)protect;
+	(void)sizeHigh;
+	(void)sizeLow;
+	(void)strName;
+
+	/* Windows cannot map an empty file either */
+	if (fstat(Descriptor(hFile), &st) != 0 || st.st_size == 0)
+		return NULL;
+
+	object = new POSIX_OBJECT();
+	object->type = OBJECT_MAPPING;
+	object->fd = dup(Descriptor(hFile));
+	return object;
+}
+
+/* views by address, so UnmapViewOfFile knows their length */
+static std::vector<std::pair<const void*, size_t> > views;
+static pthread_mutex_t viewLock = PTHREAD_MUTEX_INITIALIZER;
+
+LPVOID MapViewOfFile(HANDLE hMapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T len)
+{
+	POSIX_OBJECT* object = (POSIX_OBJECT*)hMapping;
+	off_t offset = (off_t)(((ULONGLONG)offsetHigh << 32) | offsetLow);
+	void* view = NULL;
+	struct stat st;
+
+	(void)access;
+
+	if (len == 0)
+	{
+		if (fstat(object->fd, &st) != 0 || st.st_size <= offset)
+			return NULL;
+
+		len = (SIZE_T)(st.st_size - offset);
+	}
+
+	view = mmap(NULL, len, PROT_READ, MAP_PRIVATE, object->fd, offset);
+	if (view == MAP_FAILED)
+		return NULL;
+
+	pthread_mutex_lock(&viewLock);
+	views.push_back(std::make_pair((const void*)view, (size_t)len));
+	pthread_mutex_unlock(&viewLock);
+	return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID view)
+{
+	BOOL ret = FALSE;
+
+	pthread_mutex_lock(&viewLock);
+	for (size_t i = 0; i < views.size(); ++i)
+	{
+		if (views[i].first == view)
+		{
+			munmap((void*)view, views[i].second);
+			views.erase(views.begin() + i);
+			ret = TRUE;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&viewLock);
+	return ret;
+}
+
+BOOL PrefetchVirtualMemory(HANDLE hProcess, ULONG_PTR count, WIN32_MEMORY_RANGE_ENTRY* ranges, ULONG flags)
+{
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+	(void)hProcess;
+	(void)flags;
+
+	for (ULONG_PTR i = 0; i < count; ++i)
+	{
+		uintptr_t start = (uintptr_t)ranges[i].VirtualAddress & ~(page - 1);
+
+		madvise((void*)start, (uintptr_t)ranges[i].VirtualAddress + ranges[i].NumberOfBytes - start, MADV_WILLNEED);
+	}
+
+	return TRUE;
+}
+
+/*
+ * console
+ */
+
+HANDLE GetStdHandle(DWORD id)
+{
+	return (HANDLE)(intptr_t)((id == STD_OUTPUT_HANDLE) ? STDOUT_FILENO : (id == STD_ERROR_HANDLE) ? STDERR_FILENO : STDIN_FILENO);
+}
+
+/*
+ * a terminal on stdout is the console. TREE_CONSOLE=1 makes any stdout one,
+ * so tests can reach the console path through a pipe, and TREE_CONSOLE=0
+ * makes a terminal a plain file, so the two paths can be timed on one tty
+ */
+static bool IsConsole(HANDLE h)
+{
+	const char* force = getenv("TREE_CONSOLE");
+
+	if (Descriptor(h) != STDOUT_FILENO)
+		return false;
+
+	if (force != NULL && *force != '\0')
+		return strcmp(force, "0") != 0;
+
+	return isatty(STDOUT_FILENO) != 0;
+}
+
+DWORD GetFileType(HANDLE hFile)
+{
+	struct stat st;
+
+	if (IsConsole(hFile))
+		return FILE_TYPE_CHAR;
+
+	if (fstat(Descriptor(hFile), &st) != 0)
+		return 0;
+
+	if (S_ISCHR(st.st_mode))
+		return FILE_TYPE_CHAR;
+
+	if (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))
+		return FILE_TYPE_PIPE;
+
+	return FILE_TYPE_DISK;
+}
+
+BOOL GetConsoleMode(HANDLE hConsole, LPDWORD pMode)
+{
+	*pMode = 0;
+	return IsConsole(hConsole);
+}
+
+/*
+ * each batch becomes a single write(2) to the terminal, as WriteConsoleW is a
+ * single call to the console host. Each call is converted on its own, so a
+ * surrogate pair split between two calls comes out as two U+FFFD, as it
+ * does on a console
+ */
+BOOL WriteConsoleW(HANDLE hConsole, const VOID* buf, DWORD len, LPDWORD pWritten, LPVOID reserved)
+{
+	std::string out;
+	DWORD written = 0;
+
+	(void)reserved;
+
+	AppendUtf8(out, (const wchar_t*)buf, len);
+
+	if (!WriteFile(hConsole, out.data(), (DWORD)out.size(), &written, NULL))
+		return FALSE;
+
+	*pWritten = len;
+	return TRUE;
+}
+
+static PHANDLER_ROUTINE ctrlHandler = NULL;
+
+static void CtrlSignal(int sig)
+{
+	(void)sig;
+
+	if (ctrlHandler == NULL || !ctrlHandler(CTRL_C_EVENT))
+		_exit(0xC000013A & 0xFF);
+}
+
+BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE handler, BOOL add)
+{
+	ctrlHandler = add ? handler : NULL;
+	signal(SIGINT, CtrlSignal);
+	return TRUE;
+}
+
+/*
+ * threads and synchronisation
+ */
+
+static void* ThreadStart(void* param)
+{
+	POSIX_OBJECT* object = (POSIX_OBJECT*)param;
+
+	object->start(object->param);
+	return NULL;
+}
+
+HANDLE CreateThread(LPVOID security, SIZE_T stackSize, LPTHREAD_START_ROUTINE start, LPVOID param, DWORD flags, LPDWORD pId)
+{
+	POSIX_OBJECT* object = new POSIX_OBJECT();
+
+	(void)security;
+	(void)stackSize;
+	(void)flags;
+	(void)pId;
+
+	object->type = OBJECT_THREAD;
+	object->start = start;
+	object->param = param;
+
+	if (pthread_create(&object->thread, NULL, ThreadStart, object) != 0)
+	{
+		delete object;
+		return NULL;
+	}
+
+	pthread_detach(object->thread);
+	return object;
+}
+
+/* the thread pool: callbacks queued for a set of workers that grows while all of them are busy */
+typedef struct _POOL_WORK
+{
+	PTP_SIMPLE_CALLBACK callback;
+	PVOID context;
+} POOL_WORK;
+
+static std::vector<POOL_WORK> poolQueue;
+static size_t poolHead = 0;
+static UINT poolThreads = 0;
+static UINT poolIdle = 0;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWork = PTHREAD_COND_INITIALIZER;
+
+static void* PoolWorker(void* param)
+{
+	(void)param;
+
+	pthread_mutex_lock(&poolLock);
+
+	for (;;)
+	{
+		POOL_WORK work;
+
+		while (poolHead == poolQueue.size())
+		{
+			++poolIdle;
+			pthread_cond_wait(&poolWork, &poolLock);
+			--poolIdle;
+		}
+
+		work = poolQueue[poolHead++];
+		if (poolHead == poolQueue.size())
+		{
+			poolQueue.clear();
+			poolHead = 0;
+		}
+
+		pthread_mutex_unlock(&poolLock);
+		work.callback(NULL, work.context);
+		pthread_mutex_lock(&poolLock);
+	}
+
+	return NULL;
+}
+
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK callback, PVOID context, LPVOID environment)
+{
+	POOL_WORK work;
+
+	(void)environment;
+
+	work.callback = callback;
+	work.context = context;
+
+	pthread_mutex_lock(&poolLock);
+	poolQueue.push_back(work);
+
+	if (poolIdle < poolQueue.size() - poolHead && poolThreads < POOL_THREADS_MAX)
+	{
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, PoolWorker, NULL) == 0)
+		{
+			pthread_detach(thread);
+			++poolThreads;
+		}
+	}
+
+	pthread_cond_signal(&poolWork);
+	pthread_mutex_unlock(&poolLock);
+	return poolThreads > 0;
+}
+
+DWORD GetCurrentThreadId(VOID)
+{
+	return (DWORD)syscall(SYS_gettid);
+}
+
+DWORD GetCurrentProcessId(VOID)
+{
+	return (DWORD)getpid();
+}
+
+HANDLE GetCurrentProcess(VOID)
+{
+	return (HANDLE)(LONG_PTR)-1;
+}
+
+/* statically initialised locks and condition variables are created by whichever thread gets there first */
+template <typename T, int (*INIT)(T*)>
+static T* LazyObject(void** pImpl)
+{
+	T* object = (T*)__atomic_load_n(pImpl, __ATOMIC_ACQUIRE);
+	void* expected = NULL;
+
+	if (object != NULL)
+		return object;
+
+	object = new T;
+	INIT(object);
+
+	if (!__atomic_compare_exchange_n(pImpl, &expected, (void*)object, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		delete object;
+		object = (T*)expected;
+	}
+
+	return object;
+}
+
+static int InitMutex(pthread_mutex_t* mutex)
+{
+	return pthread_mutex_init(mutex, NULL);
+}
+
+static int InitCond(pthread_cond_t* cond)
+{
+	return pthread_cond_init(cond, NULL);
+}
+
+static pthread_mutex_t* Mutex(SRWLOCK* lock)
+{
+	return LazyObject<pthread_mutex_t, InitMutex>(&lock->impl);
+}
+
+static pthread_cond_t* Cond(CONDITION_VARIABLE* cond)
+{
+	return LazyObject<pthread_cond_t, InitCond>(&cond->impl);
+}
+
+VOID AcquireSRWLockExclusive(SRWLOCK* lock)
+{
+	pthread_mutex_lock(Mutex(lock));
+}
+
+VOID ReleaseSRWLockExclusive(SRWLOCK* lock)
+{
+	pthread_mutex_unlock(Mutex(lock));
+}
+
+BOOL SleepConditionVariableSRW(CONDITION_VARIABLE* cond, SRWLOCK* lock, DWORD ms, ULONG flags)
+{
+	struct timespec ts;
+
+	(void)flags;
+
+	if (ms == INFINITE)
+		return pthread_cond_wait(Cond(cond), Mutex(lock)) == 0;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L)
+	{
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	return pthread_cond_timedwait(Cond(cond), Mutex(lock), &ts) == 0;
+}
+
+VOID WakeConditionVariable(CONDITION_VARIABLE* cond)
+{
+	pthread_cond_signal(Cond(cond));
+}
+
+VOID WakeAllConditionVariable(CONDITION_VARIABLE* cond)
+{
+	pthread_cond_broadcast(Cond(cond));
+}
+
+/*
+ * process
+ */
+
+BOOL GetProcessMemoryInfo(HANDLE hProcess, PROCESS_MEMORY_COUNTERS* pCounters, DWORD size)
+{
+	struct rusage usage;
+	char line[128];
+	unsigned long kb = 0;
+	FILE* status = NULL;
+
+	(void)hProcess;
+
+	memset(pCounters, 0, size);
+	pCounters->cb = size;
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		pCounters->PageFaultCount = (DWORD)(usage.ru_minflt + usage.ru_majflt);
+
+	/*
+	 * ru_maxrss carries over the peak of whatever process exec replaced,
+	 * such as the python running a benchmark, so take the peak of this
+	 * address space from VmHWM instead
+	 */
+	status = fopen("/proc/self/status", "r");
+	if (status != NULL)
+	{
+		while (fgets(line, sizeof(line), status) != NULL)
+		{
+			if (sscanf(line, "VmHWM: %lu kB", &kb) == 1)
+				pCounters->PeakWorkingSetSize = (SIZE_T)kb * 1024;
+			else if (sscanf(line, "VmRSS: %lu kB", &kb) == 1)
+				pCounters->WorkingSetSize = (SIZE_T)kb * 1024;
+		}
+
+		fclose(status);
+	}
+
+	return TRUE;
+}
+
+/*
+ * strsafe
+ */
+
+/* MSVC's wide format as glibc's: %s and %c are wide, %hs, %S and %hc narrow, %I64 is %ll */
+static std::wstring TranslateFormat(const wchar_t* format)
+{
+	std::wstring out;
+
+	for (const wchar_t* p = format; *p != L'\0'; ++p)
+	{
+		bool narrow = false;
+		bool wide = false;
+
+		out += *p;
+		if (*p != L'%')
+			continue;
+
+		++p;
+		while (*p != L'\0' && wcschr(L"-+ #0123456789.*", *p) != NULL)
+			out += *p++;
+
+		for (;;)
+		{
+			if (wcsncmp(p, L"I64", 3) == 0)
+			{
+				out += L"ll";
+				p += 3;
+			}
+			else if (wcsncmp(p, L"I32", 3) == 0)
+				p += 3;
+			else if (*p == L'I')
+			{
+				out += L'z';
+				++p;
+			}
+			else if (*p == L'h' && (p[1] == L's' || p[1] == L'c'))
+			{
+				narrow = true;
+				++p;
+			}
+			else if (*p == L'l' && (p[1] == L's' || p[1] == L'c'))
+			{
+				wide = true;
+				++p;
+			}
+			else if (*p == L'h' || *p == L'l' || *p == L'z' || *p == L'j' || *p == L't' || *p == L'L')
+				out += *p++;
+			else
+				break;
+		}
+
+		if (*p == L'\0')
+			break;
+
+		if (*p == L'S' || *p == L'C')
+			out += (wchar_t)towlower(*p);
+		else if (*p == L's' || *p == L'c')
+		{
+			if (!narrow || wide)
+				out += L'l';
+			out += *p;
+		}
+		else
+			out += *p;
+	}
+
+	return out;
+}
+
+int PosixFormat(wchar_t* dst, size_t size, const wchar_t* format, va_list args)
+{
+	std::wstring translated = TranslateFormat(format);
+
+	return vswprintf(dst, size, translated.c_str(), args);
+}
+
+static std::wstring FormatString(const wchar_t* format, va_list args)
+{
+	std::vector<wchar_t> buf(256);
+
+	for (;;)
+	{
+		va_list copy;
+		int n = 0;
+
+		va_copy(copy, args);
+		n = PosixFormat(buf.data(), buf.size(), format, copy);
+		va_end(copy);
+
+		if (n >= 0)
+			return std::wstring(buf.data(), (size_t)n);
+
+		/* glibc cannot tell a short buffer from an encoding error, give up eventually */
+		if (buf.size() >= (1 << 24))
+			return std::wstring();
+
+		buf.resize(buf.size() * 4);
+	}
+}
+
+int PosixFwprintf(FILE* file, const wchar_t* format, ...)
+{
+	std::wstring text;
+	std::string out;
+	va_list args;
+
+	va_start(args, format);
+	text = FormatString(format, args);
+	va_end(args);
+
+	AppendUtf8(out, text.data(), text.size());
+	fwrite(out.data(), 1, out.size(), file);
+	return (int)text.size();
+}
+
+int PosixSwprintf(wchar_t* dst, size_t size, const wchar_t* format, ...)
+{
+	va_list args;
+	int n = 0;
+
+	va_start(args, format);
+	n = PosixFormat(dst, size, format, args);
+	va_end(args);
+
+	if (n < 0 && size > 0)
+		dst[0] = L'\0';
+
+	return n;
+}
+
+HRESULT StringCchCopy(LPWSTR dst, size_t size, LPCWSTR src)
+{
+	return StringCchCopyN(dst, size, src, (size_t)-1);
+}
+
+HRESULT StringCchCopyN(LPWSTR dst, size_t size, LPCWSTR src, size_t count)
+{
+	size_t i = 0;
+
+	if (size == 0)
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+
+	for (; i < count && src[i] != L'\0'; ++i)
+	{
+		if (i + 1 == size)
+		{
+			dst[i] = L'\0';
+			return STRSAFE_E_INSUFFICIENT_BUFFER;
+		}
+
+		dst[i] = src[i];
+	}
+
+	dst[i] = L'\0';
+	return S_OK;
+}
+
+HRESULT StringCchCat(LPWSTR dst, size_t size, LPCWSTR src)
+{
+	size_t len = 0;
+
+	if (FAILED(StringCchLength(dst, size, &len)))
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+
+	return StringCchCopy(dst + len, size - len, src);
+}
+
+HRESULT StringCchLength(LPCWSTR str, size_t max, size_t* pLen)
+{
+	size_t len = wcsnlen(str, max);
+
+	if (len == max)
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+
+	if (pLen != NULL)
+		*pLen = len;
+
+	return S_OK;
+}
+
+HRESULT StringCchVPrintf(LPWSTR dst, size_t size, LPCWSTR format, va_list args)
+{
+	std::wstring text = FormatString(format, args);
+
+	return StringCchCopyN(dst, size, text.c_str(), text.size());
+}
+
+HRESULT StringCchPrintf(LPWSTR dst, size_t size, LPCWSTR format, ...)
+{
+	va_list args;
+	HRESULT hr = S_OK;
+
+	va_start(args, format);
+	hr = StringCchVPrintf(dst, size, format, args);
+	va_end(args);
+	return hr;
+}
+
+HRESULT StringCchPrintfA(char* dst, size_t size, const char* format, ...)
+{
+	va_list args;
+	int n = 0;
+
+	va_start(args, format);
+	n = vsnprintf(dst, size, format, args);
+	va_end(args);
+
+	return (n < 0 || (size_t)n >= size) ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+/*
+ * CRT
+ */
+
+/* the secure CRT functions end the process on a short buffer, which is what a test wants to see */
+static void InvalidParameter(const char* function)
+{
+	fprintf(stderr, "%s: buffer too small\n", function);
+	abort();
+}
+
+int wcscpy_s(wchar_t* dst, size_t size, const wchar_t* src)
+{
+	if (FAILED(StringCchCopy(dst, size, src)))
+		InvalidParameter("wcscpy_s");
+
+	return 0;
+}
+
+int wcscat_s(wchar_t* dst, size_t size, const wchar_t* src)
+{
+	if (FAILED(StringCchCat(dst, size, src)))
+		InvalidParameter("wcscat_s");
+
+	return 0;
+}
+
+int wcsncpy_s(wchar_t* dst, size_t size, const wchar_t* src, size_t count)
+{
+	HRESULT hr = StringCchCopyN(dst, size, src, (count == _TRUNCATE) ? (size_t)-1 : count);
+
+	if (FAILED(hr) && count != _TRUNCATE)
+		InvalidParameter("wcsncpy_s");
+
+	return FAILED(hr) ? STRUNCATE : 0;
+}
+
+int _wcsicmp(const wchar_t* a, const wchar_t* b)
+{
+	return wcscasecmp(a, b);
+}
+
+int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t count)
+{
+	return wcsncasecmp(a, b, count);
+}
+
+/* made absolute and normalised without looking at the file system, as on Windows */
+wchar_t* _wfullpath(wchar_t* dst, const wchar_t* path, size_t size)
+{
+	std::string full = PosixPath(path);
+	std::vector<std::string> parts;
+	std::string out;
+	size_t start = 0;
+	std::wstring wide;
+
+	if (full.empty() || full[0] != '/')
+	{
+		char cwd[4096];
+
+		if (getcwd(cwd, sizeof(cwd)) == NULL)
+			return NULL;
+
+		full = std::string(cwd) + "/" + full;
+	}
+
+	while (start <= full.size())
+	{
+		size_t end = full.find('/', start);
+		std::string part = full.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+
+		if (part == "..")
+		{
+			if (!parts.empty())
+				parts.pop_back();
+		}
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+
+		if (end == std::string::npos)
+			break;
+
+		start = end + 1;
+	}
+
+	for (size_t i = 0; i < parts.size(); ++i)
+		out += "/" + parts[i];
+
+	wide = Win32Path(out.empty() ? "/" : out.c_str());
+	if (FAILED(StringCchCopy(dst, size, wide.c_str())))
+		return NULL;
+
+	return dst;
+}
+
+int _wfopen_s(FILE** pFile, const wchar_t* path, const wchar_t* mode)
+{
+	*pFile = fopen(PosixPath(path).c_str(), Narrow(mode).c_str());
+	return (*pFile != NULL) ? 0 : errno;
+}
+
+/* every path is on drive C: */
+int _getdrive(void)
+{
+	return 3;
+}
+
+/*
+ * entry point
+ */
+
+extern int wmain(int argc, wchar_t** argv);
+
+int main(int argc, char** argv)
+{
+	std::vector<std::wstring> args;
+	std::vector<wchar_t*> argvW;
+
+	/* towupper and friends need to know about more than ASCII, like the Windows CRT */
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	/* a reader going away is an error from WriteFile, not a signal */
+	signal(SIGPIPE, SIG_IGN);
+
+	for (int i = 0; i < argc; ++i)
+		args.push_back(Widen(argv[i]));
+
+	for (int i = 0; i < argc; ++i)
+		argvW.push_back(&args[i][0]);
+
+	argvW.push_back(NULL);
+	return wmain(argc, argvW.data());
+}
@@ -0,0 +1,277 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     The part of the Win32 API tree.com uses, implemented over POSIX for the test harness
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+/* calling conventions and storage classes */
+#define WINAPI
+#define CALLBACK
+#define __forceinline inline __attribute__((always_inline))
+#define __declspec(x) POSIX_DECLSPEC_##x
+#define POSIX_DECLSPEC_thread __thread
+#define POSIX_DECLSPEC_noinline __attribute__((noinline))
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+
+#define VOID void
+#define TRUE 1
+#define FALSE 0
+
+typedef int BOOL;
+typedef unsigned char BYTE, UCHAR;
+typedef unsigned short WORD, USHORT;
+typedef short SHORT;
+typedef unsigned int DWORD, UINT, ULONG;
+typedef int LONG, INT;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef uintptr_t ULONG_PTR, SIZE_T;
+typedef intptr_t LONG_PTR;
+typedef long HRESULT;
+typedef void* HANDLE;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef DWORD* LPDWORD;
+typedef wchar_t WCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+
+#define LOWORD(x) ((WORD)((x) & 0xFFFF))
+#define HIWORD(x) ((WORD)(((x) >> 16) & 0xFFFF))
+#define MAXDWORD 0xFFFFFFFF
+#define MAXUINT ((UINT)~0u)
+#define MAXULONGLONG ((ULONGLONG)~0ull)
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+
+#ifndef __cplusplus
+#error the test harness builds tree.com as C++
+#endif
+
+#if !defined(NOMINMAX) && !defined(min)
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define S_OK ((HRESULT)0)
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+#define SUCCEEDED(hr) ((HRESULT)(hr) >= 0)
+#define FAILED(hr) ((HRESULT)(hr) < 0)
+
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_PATH_NOT_FOUND 3
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_NO_MORE_FILES 18
+
+#define FILE_ATTRIBUTE_READONLY 0x1
+#define FILE_ATTRIBUTE_HIDDEN 0x2
+#define FILE_ATTRIBUTE_SYSTEM 0x4
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_ARCHIVE 0x20
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_ATTRIBUTE_TEMPORARY 0x100
+#define FILE_ATTRIBUTE_SPARSE_FILE 0x200
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x400
+#define FILE_ATTRIBUTE_COMPRESSED 0x800
+#define FILE_ATTRIBUTE_OFFLINE 0x1000
+#define FILE_ATTRIBUTE_NOT_CONTENT_INDEXED 0x2000
+#define FILE_ATTRIBUTE_ENCRYPTED 0x4000
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_FLAG_BACKUP_SEMANTICS 0x02000000
+#define FILE_FLAG_DELETE_ON_CLOSE 0x04000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define PAGE_READONLY 0x2
+#define FILE_MAP_READ 0x4
+
+#define STD_OUTPUT_HANDLE ((DWORD)-11)
+#define STD_ERROR_HANDLE ((DWORD)-12)
+#define FILE_TYPE_DISK 0x1
+#define FILE_TYPE_CHAR 0x2
+#define FILE_TYPE_PIPE 0x3
+#define CTRL_C_EVENT 0
+#define CTRL_BREAK_EVENT 1
+#define CP_UTF8 65001
+
+typedef struct _FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct _SYSTEMTIME
+{
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+} SYSTEMTIME;
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef union _ULARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		DWORD HighPart;
+	};
+	ULONGLONG QuadPart;
+} ULARGE_INTEGER;
+
+typedef struct _WIN32_FIND_DATAW
+{
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+	DWORD dwReserved0;
+	DWORD dwReserved1;
+	WCHAR cFileName[MAX_PATH];
+	WCHAR cAlternateFileName[14];
+} WIN32_FIND_DATAW, WIN32_FIND_DATA, *LPWIN32_FIND_DATAW, *LPWIN32_FIND_DATA;
+
+typedef struct _PROCESS_MEMORY_COUNTERS
+{
+	DWORD cb;
+	DWORD PageFaultCount;
+	SIZE_T PeakWorkingSetSize;
+	SIZE_T WorkingSetSize;
+	SIZE_T QuotaPeakPagedPoolUsage;
+	SIZE_T QuotaPagedPoolUsage;
+	SIZE_T QuotaPeakNonPagedPoolUsage;
+	SIZE_T QuotaNonPagedPoolUsage;
+	SIZE_T PagefileUsage;
+	SIZE_T PeakPagefileUsage;
+} PROCESS_MEMORY_COUNTERS;
+
+typedef struct _WIN32_MEMORY_RANGE_ENTRY
+{
+	PVOID VirtualAddress;
+	SIZE_T NumberOfBytes;
+} WIN32_MEMORY_RANGE_ENTRY;
+
+/* a pthread mutex or condition variable, created on first use like the statically initialised Win32 ones */
+typedef struct _SRWLOCK
+{
+	void* impl;
+} SRWLOCK, CONDITION_VARIABLE;
+#define SRWLOCK_INIT { NULL }
+#define CONDITION_VARIABLE_INIT { NULL }
+
+typedef struct _TP_CALLBACK_INSTANCE* PTP_CALLBACK_INSTANCE;
+typedef VOID (CALLBACK* PTP_SIMPLE_CALLBACK)(PTP_CALLBACK_INSTANCE, PVOID);
+typedef DWORD (WINAPI* LPTHREAD_START_ROUTINE)(LPVOID);
+typedef BOOL (WINAPI* PHANDLER_ROUTINE)(DWORD);
+
+/* errors */
+DWORD GetLastError(VOID);
+VOID SetLastError(DWORD error);
+
+/* memory */
+#define ZeroMemory(dst, len) memset((dst), 0, (len))
+#define CopyMemory(dst, src, len) memcpy((dst), (src), (len))
+#define MoveMemory(dst, src, len) memmove((dst), (src), (len))
+BOOL PrefetchVirtualMemory(HANDLE hProcess, ULONG_PTR count, WIN32_MEMORY_RANGE_ENTRY* ranges, ULONG flags);
+
+/* directories, names are UTF-16 with either kind of slash */
+HANDLE FindFirstFileW(LPCWSTR strPattern, WIN32_FIND_DATAW* pFindData);
+BOOL FindNextFileW(HANDLE hFind, WIN32_FIND_DATAW* pFindData);
+BOOL FindClose(HANDLE hFind);
+#define FindFirstFile FindFirstFileW
+#define FindNextFile FindNextFileW
+DWORD GetFileAttributes(LPCWSTR strPath);
+BOOL SetCurrentDirectory(LPCWSTR strPath);
+DWORD GetCurrentDirectory(DWORD size, LPWSTR strPath);
+BOOL GetVolumeInformation(LPCWSTR strRoot, LPWSTR strName, DWORD nameSize, LPDWORD pSerial,
+	LPDWORD pMaxComponent, LPDWORD pFlags, LPWSTR strFileSystem, DWORD fileSystemSize);
+DWORD GetTempPath(DWORD size, LPWSTR strPath);
+UINT GetTempFileName(LPCWSTR strDir, LPCWSTR strPrefix, UINT unique, LPWSTR strFile);
+BOOL DeleteFile(LPCWSTR strPath);
+LPWSTR CharUpper(LPWSTR str);
+
+/* files and mappings, a HANDLE is a file descriptor */
+HANDLE CreateFile(LPCWSTR strPath, DWORD access, DWORD share, LPVOID security, DWORD disposition, DWORD flags, HANDLE hTemplate);
+BOOL ReadFile(HANDLE hFile, LPVOID buf, DWORD len, LPDWORD pRead, LPVOID overlapped);
+BOOL WriteFile(HANDLE hFile, LPCVOID buf, DWORD len, LPDWORD pWritten, LPVOID overlapped);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pSize);
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER* pPos, DWORD method);
+BOOL CloseHandle(HANDLE h);
+HANDLE CreateFileMapping(HANDLE hFile, LPVOID security, DWORD protect, DWORD sizeHigh, DWORD sizeLow, LPCWSTR strName);
+LPVOID MapViewOfFile(HANDLE hMapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T len);
+BOOL UnmapViewOfFile(LPCVOID view);
+
+/* console, stdout counts as one when TREE_CONSOLE is set */
+HANDLE GetStdHandle(DWORD id);
+DWORD GetFileType(HANDLE hFile);
+BOOL GetConsoleMode(HANDLE hConsole, LPDWORD pMode);
+BOOL WriteConsoleW(HANDLE hConsole, const VOID* buf, DWORD len, LPDWORD pWritten, LPVOID reserved);
+BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE handler, BOOL add);
+int MultiByteToWideChar(UINT codePage, DWORD flags, const char* src, int srcLen, LPWSTR dst, int dstLen);
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR src, int srcLen, char* dst, int dstLen,
+	const char* defaultChar, BOOL* pUsedDefault);
+
+/* time */
+BOOL QueryPerformanceCounter(LARGE_INTEGER* pCount);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency);
+VOID Sleep(DWORD ms);
+BOOL FileTimeToSystemTime(const FILETIME* ft, SYSTEMTIME* st);
+BOOL SystemTimeToFileTime(const SYSTEMTIME* st, FILETIME* ft);
+BOOL DosDateTimeToFileTime(WORD date, WORD time, FILETIME* ft);
+BOOL LocalFileTimeToFileTime(const FILETIME* local, FILETIME* ft);
+
+/* threads and synchronisation */
+HANDLE CreateThread(LPVOID security, SIZE_T stackSize, LPTHREAD_START_ROUTINE start, LPVOID param, DWORD flags, LPDWORD pId);
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK callback, PVOID context, LPVOID environment);
+DWORD GetCurrentThreadId(VOID);
+DWORD GetCurrentProcessId(VOID);
+HANDLE GetCurrentProcess(VOID);
+VOID AcquireSRWLockExclusive(SRWLOCK* lock);
+VOID ReleaseSRWLockExclusive(SRWLOCK* lock);
+#define AcquireSRWLockShared AcquireSRWLockExclusive
+#define ReleaseSRWLockShared ReleaseSRWLockExclusive
+BOOL SleepConditionVariableSRW(CONDITION_VARIABLE* cond, SRWLOCK* lock, DWORD ms, ULONG flags);
+VOID WakeConditionVariable(CONDITION_VARIABLE* cond);
+VOID WakeAllConditionVariable(CONDITION_VARIABLE* cond);
+#define InterlockedCompareExchangePointer(dst, value, comparand) __sync_val_compare_and_swap((dst), (comparand), (value))
+
+/* process */
+BOOL GetProcessMemoryInfo(HANDLE hProcess, PROCESS_MEMORY_COUNTERS* pCounters, DWORD size);
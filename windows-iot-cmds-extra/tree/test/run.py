@@ -0,0 +1,131 @@
+# PROJECT:     Windows IoT extra commands
+# LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+# PURPOSE:     Runs the golden output tests
+#
+#   python3 run.py [--build DIR] [--update] FILE_OR_FOLDER...
+#
+# A test file is prose with indented commands and their expected output, as
+# in cram. A line "  $ command" is run with bash from the fixtures folder,
+# with the build folder first on PATH, $FIX naming the fixtures, $T a scratch
+# folder of the test file and TZ=UTC. The lines indented by two spaces that
+# follow it are its stdout and stderr together; CR LF is shown as LF, bytes
+# that are not printable UTF-8 are escaped and the line marked "(esc)", and a
+# non-zero exit status is shown as "[status]". --update writes what the
+# commands printed back into the files.
+
+import argparse
+import difflib
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+INDENT = '  '
+COMMAND = '  $ '
+
+
+def render(data, fix, scratch):
+    """Turns raw output into the lines a test file holds."""
+    data = data.replace(b'\r\n', b'\n')
+    # tree.com shows paths with backslashes
+    for path, name in ((scratch, b'$T'), (fix, b'$FIX')):
+        data = data.replace(os.fsencode(path), name).replace(os.fsencode(path.replace('/', '\\')), name)
+    if data and not data.endswith(b'\n'):
+        data += b' (no-eol)\n'
+    lines = []
+    for raw in data.split(b'\n')[:-1]:
+        try:
+            text = raw.decode('utf-8')
+            if any(c < ' ' and c != '\t' for c in text) or '\x7f' in text:
+                raise ValueError
+        except ValueError:
+            text = ''.join(chr(b) if 0x20 <= b < 0x7F and b != 0x5C else '\\\\' if b == 0x5C else '\\x%02x' % b
+                           for b in raw) + ' (esc)'
+        lines.append(text)
+    return lines
+
+
+def parse(path):
+    """Splits a test file into prose and (command, expected output) pairs."""
+    with open(path, encoding='utf-8') as f:
+        lines = f.read().split('\n')
+    if lines and lines[-1] == '':
+        lines.pop()
+    blocks = []
+    i = 0
+    while i < len(lines):
+        line = lines[i]
+        i += 1
+        if not line.startswith(COMMAND):
+            blocks.append(line)
+            continue
+        expected = []
+        while i < len(lines) and lines[i].startswith(INDENT) and not lines[i].startswith(COMMAND):
+            expected.append(lines[i][len(INDENT):])
+            i += 1
+        blocks.append((line[len(COMMAND):], expected))
+    return blocks
+
+
+def run_file(path, build, fix, update):
+    blocks = parse(path)
+    scratch = tempfile.mkdtemp(prefix='tree-test-')
+    env = dict(os.environ, PATH=os.path.abspath(build) + os.pathsep + os.environ['PATH'],
+               FIX=fix, T=scratch, TMPDIR=scratch, TZ='UTC', LC_ALL='C.UTF-8',
+               TESTDIR=os.path.dirname(os.path.abspath(__file__)))
+    env.pop('TREE_CONSOLE', None)
+    out = []
+    failed = 0
+    try:
+        for block in blocks:
+            if isinstance(block, str):
+                out.append(block)
+                continue
+            command, expected = block
+            proc = subprocess.run(['bash', '-c', command], cwd=fix, env=env,
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+            actual = render(proc.stdout, fix, scratch)
+            if proc.returncode != 0:
+                actual.append('[%d]' % proc.returncode)
+            out.append(COMMAND + command)
+            out += [INDENT + line for line in actual]
+            if actual != expected:
+                failed += 1
+                sys.stdout.write('FAIL %s: $ %s\n' % (path, command))
+                for line in difflib.unified_diff(expected, actual, 'expected', 'actual', lineterm='', n=2):
+                    sys.stdout.write('  ' + line + '\n')
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+    if update and failed:
+        with open(path, 'w', encoding='utf-8') as f:
+            f.write('\n'.join(out) + '\n')
+    return sum(1 for b in blocks if not isinstance(b, str)), failed
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--build', default='build')
+    parser.add_argument('--update', action='store_true')
+    parser.add_argument('paths', nargs='+')
+    args = parser.parse_args()
+
+    fix = os.path.abspath(os.path.join(args.build, 'fixtures'))
+    files = []
+    for path in args.paths:
+        if os.path.isdir(path):
+            files += sorted(os.path.join(path, name) for name in os.listdir(path) if name.endswith('.t'))
+        else:
+            files.append(path)
+
+    total = failed = 0
+    for path in files:
+        n, f = run_file(path, args.build, fix, args.update)
+        total += n
+        failed += f
+    print('%d commands in %d files, %d failed' % (total, len(files), failed))
+    return 1 if failed and not args.update else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,89 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Tests for the --trace file writer
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "../trace.h"
+#include "unit.h"
+
+/* longest run of ASCII put before the surrogate pair, past the writer's 256 unit buffer */
+#define TRACE_TEST_RUN 300
+
+/**
+* @name: CountBytes
+*
+* @return
+* number of times needle occurs in data
+*/
+static UINT CountBytes(const char* data, size_t len, const char* needle)
+{
+	size_t needleLen = strlen(needle);
+	UINT count = 0;
+
+	for (size_t i = 0; i + needleLen <= len; ++i)
+	{
+		if (memcmp(data + i, needle, needleLen) == 0)
+			++count;
+	}
+
+	return count;
+}
+
+/*
+ * paths with a surrogate pair at every offset around the point where the
+ * path string is flushed come out as the one 4 byte sequence, never as
+ * two U+FFFD
+ */
+TEST(TraceSurrogateAcrossFlush)
+{
+	wchar_t strDir[MAX_PATH];
+	wchar_t strFile[MAX_PATH];
+	wchar_t path[TRACE_TEST_RUN + 4];
+	UINT spans = 0;
+	FILE* f = NULL;
+	char* data = NULL;
+	long len = 0;
+
+	GetTempPath(MAX_PATH, strDir);
+	CHECK(GetTempFileName(strDir, L"trc", 0, strFile) != 0);
+	CHECK(TraceInit(strFile));
+
+	for (UINT run = 240; run <= TRACE_TEST_RUN; ++run)
+	{
+		for (UINT i = 0; i < run; ++i)
+			path[i] = (i % 50 == 7) ? L'"' : L'a';
+
+		/* U+1F600 */
+		path[run] = 0xD83D;
+		path[run + 1] = 0xDE00;
+		path[run + 2] = L'\0';
+
+		TraceSpan("test", "span", TraceBegin(), path, NULL, 0);
+		++spans;
+	}
+
+	TraceWrite();
+
+	CHECK(_wfopen_s(&f, strFile, L"rb") == 0);
+	if (f == NULL)
+		return;
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = (char*)malloc(len);
+	CHECK(data != NULL && fread(data, 1, len, f) == (size_t)len);
+	fclose(f);
+	DeleteFile(strFile);
+
+	CHECK(CountBytes(data, len, "\xF0\x9F\x98\x80") == spans);
+	CHECK(CountBytes(data, len, "\xEF\xBF\xBD") == 0);
+
+	free(data);
+}
@@ -0,0 +1,98 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Minimal unit test runner for tree.com's modules
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unit.h"
+
+static UNIT_TEST* pTests = NULL;
+static UNIT_TEST* pCurrent = NULL;
+static UINT failures = 0;
+
+/**
+* @name: UnitRegister
+*
+* @param test
+* test to be run, kept in name order
+*
+* @return
+* TRUE, so registration can initialise a static
+*/
+BOOL UnitRegister(UNIT_TEST* test)
+{
+	UNIT_TEST** link = &pTests;
+
+	while (*link != NULL && strcmp((*link)->name, test->name) < 0)
+		link = &(*link)->next;
+
+	test->next = *link;
+	*link = test;
+	return TRUE;
+}
+
+/**
+* @name: UnitFail
+*
+* @return
+* void
+*/
+VOID UnitFail(const char* expr, const char* file, int line)
+{
+	printf("%s:%d: %s: CHECK(%s) failed\n", file, line, pCurrent->name, expr);
+	++failures;
+}
+
+/**
+* @name: UnitRun
+*
+* @param filter
+* if not NULL, only tests whose name contains it are run
+*
+* @return
+* process exit code, 0 if every check passed
+*/
+static int UnitRun(const char* filter)
+{
+	UINT run = 0;
+	UINT failed = 0;
+
+	for (pCurrent = pTests; pCurrent != NULL; pCurrent = pCurrent->next)
+	{
+		UINT before = failures;
+
+		if (filter != NULL && strstr(pCurrent->name, filter) == NULL)
+			continue;
+
+		pCurrent->func();
+		++run;
+
+		if (failures != before)
+			++failed;
+	}
+
+	printf("%u tests, %u failed\n", run, failed);
+	return failed == 0 ? 0 : 1;
+}
+
+#ifdef UNIT_MAIN
+/* built on its own, without the Win32 layer and its wmain entry point */
+int main(int argc, char** argv)
+{
+	return UnitRun(argc > 1 ? argv[1] : NULL);
+}
+#else
+int wmain(int argc, wchar_t** argv)
+{
+	char filter[MAX_PATH];
+
+	if (argc < 2)
+		return UnitRun(NULL);
+
+	WideCharToMultiByte(CP_UTF8, 0, argv[1], -1, filter, sizeof(filter), NULL, NULL);
+	return UnitRun(filter);
+}
+#endif
@@ -0,0 +1,36 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Minimal unit test runner for tree.com's modules
+*/
+
+#pragma once
+
+#include <windows.h>
+
+typedef VOID (*UNIT_FUNC)(VOID);
+
+/* a test, registered by a static constructor so adding one never touches a list */
+typedef struct _UNIT_TEST
+{
+	const char* name;
+	UNIT_FUNC func;
+	struct _UNIT_TEST* next;
+} UNIT_TEST;
+
+BOOL UnitRegister(UNIT_TEST* test);
+VOID UnitFail(const char* expr, const char* file, int line);
+
+#define TEST(name) \
+	static VOID name(VOID); \
+	static UNIT_TEST name##Test = { #name, name, NULL }; \
+	static BOOL name##Registered = UnitRegister(&name##Test); \
+	static VOID name(VOID)
+
+/* records a failure and carries on, so one run reports every broken check */
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+			UnitFail(#expr, __FILE__, __LINE__); \
+	} while (0)
@@ -0,0 +1,179 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Microbenchmark of the UTF-16 to UTF-8 transcoder on ASCII, mixed and CJK names
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../utf8.h"
+
+/*
+ * built with -fshort-wchar, linking utf8.cpp twice: once with the vector
+ * paths and once, renamed to Utf16ToUtf8Scalar, with the scalar loop alone
+ */
+size_t Utf16ToUtf8Scalar(char* dst, const wchar_t* src, size_t len);
+
+/* names per set, about the size of a large folder tree */
+#define BENCH_NAMES 200000
+
+/* code units per call in bulk mode, the output writer's OUTPUT_STEP */
+#define BENCH_STEP ((64 * 1024) / 3)
+
+/* each measurement repeats the whole set for at least this long */
+#define BENCH_MIN_NS 300000000LL
+
+typedef size_t (*TRANSCODE)(char* dst, const wchar_t* src, size_t len);
+
+/* the names of one set, back to back, with where each one starts */
+typedef struct _NAME_SET
+{
+	const char* name;
+	wchar_t* units;
+	size_t* start;
+	size_t total;
+} NAME_SET;
+
+static UINT seed = 1;
+
+static UINT Random(UINT n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % n;
+}
+
+static wchar_t AsciiChar(VOID)
+{
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-. ";
+
+	return (wchar_t)chars[Random(sizeof(chars) - 1)];
+}
+
+/**
+* @name: MakeSet
+*
+* @param nonAscii
+* percentage of names holding non-ASCII text
+*
+* @param cjk
+* percentage of those whose non-ASCII text is CJK rather than accented Latin or Cyrillic
+*/
+static VOID MakeSet(NAME_SET* set, const char* name, UINT nonAscii, UINT cjk)
+{
+	static const wchar_t exts[][5] = { L".txt", L".log", L".dll", L".jpg", L".cpp" };
+	size_t cap = (size_t)BENCH_NAMES * 48;
+	size_t o = 0;
+
+	set->name = name;
+	set->units = (wchar_t*)malloc(cap * sizeof(wchar_t));
+	set->start = (size_t*)malloc((BENCH_NAMES + 1) * sizeof(size_t));
+	if (set->units == NULL || set->start == NULL)
+		exit(-1);
+
+	seed = 1;
+
+	for (UINT i = 0; i < BENCH_NAMES; ++i)
+	{
+		UINT len = 4 + Random(28);
+		BOOL special = Random(100) < nonAscii;
+		BOOL wide = Random(100) < cjk;
+
+		set->start[i] = o;
+
+		for (UINT j = 0; j < len; ++j)
+		{
+			if (special && wide && Random(10) < 8)
+				set->units[o++] = (wchar_t)(0x4E00 + Random(0x5000));
+			else if (special && !wide && Random(10) < 3)
+				set->units[o++] = (wchar_t)(Random(2) ? 0xC0 + Random(0x40) : 0x410 + Random(0x40));
+			else
+				set->units[o++] = AsciiChar();
+		}
+
+		memcpy(set->units + o, exts[Random(5)], 4 * sizeof(wchar_t));
+		o += 4;
+	}
+
+	set->start[BENCH_NAMES] = o;
+	set->total = o;
+}
+
+static long long Now(VOID)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+* @name: Measure
+*
+* @param bulk
+* if true, the set is transcoded in blocks the size of an output step rather than a name at a time
+*
+* @return
+* void
+*
+* writes one JSON result line
+*/
+static VOID Measure(const NAME_SET* set, const char* variant, TRANSCODE transcode, BOOL bulk, char* buf)
+{
+	long long start = Now();
+	long long elapsed = 0;
+	unsigned long long bytes = 0;
+	UINT passes = 0;
+
+	do
+	{
+		size_t o = 0;
+
+		if (bulk)
+		{
+			for (size_t i = 0; i < set->total; i += BENCH_STEP)
+				o += transcode(buf + o, set->units + i, (set->total - i < BENCH_STEP) ? set->total - i : BENCH_STEP);
+		}
+		else
+		{
+			for (UINT i = 0; i < BENCH_NAMES; ++i)
+				o += transcode(buf + o, set->units + set->start[i], set->start[i + 1] - set->start[i]);
+		}
+
+		bytes += o;
+		++passes;
+		elapsed = Now() - start;
+	} while (elapsed < BENCH_MIN_NS);
+
+	printf("{\"bench\":\"utf8\",\"set\":\"%s\",\"calls\":\"%s\",\"variant\":\"%s\",\"ns_per_name\":%.2f,"
+		"\"input_mb_per_s\":%.1f,\"output_bytes\":%llu}\n",
+		set->name, bulk ? "bulk" : "name", variant, (double)elapsed / ((double)passes * BENCH_NAMES),
+		(double)set->total * sizeof(wchar_t) * passes * 1000.0 / (double)elapsed,
+		bytes / passes);
+}
+
+int main(VOID)
+{
+	NAME_SET sets[3];
+	char* buf = NULL;
+
+	MakeSet(&sets[0], "ascii", 0, 0);
+	MakeSet(&sets[1], "mixed", 25, 30);
+	MakeSet(&sets[2], "cjk", 90, 100);
+
+	for (UINT i = 0; i < 3; ++i)
+	{
+		buf = (char*)realloc(buf, UTF8_MAX_BYTES(sets[i].total));
+		if (buf == NULL)
+			exit(-1);
+
+		Measure(&sets[i], "scalar", Utf16ToUtf8Scalar, FALSE, buf);
+		Measure(&sets[i], "vector", Utf16ToUtf8, FALSE, buf);
+		Measure(&sets[i], "scalar", Utf16ToUtf8Scalar, TRUE, buf);
+		Measure(&sets[i], "vector", Utf16ToUtf8, TRUE, buf);
+	}
+
+	return 0;
+}
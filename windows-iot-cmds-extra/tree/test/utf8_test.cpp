@@ -0,0 +1,169 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Tests for the UTF-16 to UTF-8 transcoder
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utf8.h"
+#include "unit.h"
+
+/* also built with -fshort-wchar, where wchar_t is UTF-16 as on Windows, to reach the vector paths */
+
+/**
+* @name: Reference
+*
+* straightforward encoder the transcoder is checked against
+*
+* @return
+* number of bytes written to dst
+*/
+static size_t Reference(char* dst, const wchar_t* src, size_t len)
+{
+	size_t o = 0;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		UINT c = (UINT)src[i] & 0xFFFF;
+
+		if (c >= 0xD800 && c <= 0xDBFF && i + 1 < len && ((UINT)src[i + 1] & 0xFC00) == 0xDC00)
+			c = 0x10000 + ((c - 0xD800) << 10) + (((UINT)src[++i] & 0xFFFF) - 0xDC00);
+		else if (c >= 0xD800 && c <= 0xDFFF)
+			c = 0xFFFD;
+
+		if (c < 0x80)
+			dst[o++] = (char)c;
+		else if (c < 0x800)
+		{
+			dst[o++] = (char)(0xC0 | (c >> 6));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			dst[o++] = (char)(0xE0 | (c >> 12));
+			dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			dst[o++] = (char)(0xF0 | (c >> 18));
+			dst[o++] = (char)(0x80 | ((c >> 12) & 0x3F));
+			dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	return o;
+}
+
+/**
+* @name: Matches
+*
+* @return
+* true if the transcoder and the reference agree on src
+*/
+static BOOL Matches(const wchar_t* src, size_t len)
+{
+	char* expected = (char*)malloc(UTF8_MAX_BYTES(len) + 1);
+	char* actual = (char*)malloc(UTF8_MAX_BYTES(len) + 64);
+	size_t n = Reference(expected, src, len);
+	size_t m = 0;
+	BOOL ret = FALSE;
+
+	/* anything written past the returned length would show up here */
+	memset(actual, 0x5A, UTF8_MAX_BYTES(len) + 64);
+	m = Utf16ToUtf8(actual, src, len);
+
+	ret = n == m && memcmp(expected, actual, n) == 0 && m <= UTF8_MAX_BYTES(len) &&
+		(UCHAR)actual[UTF8_MAX_BYTES(len)] == 0x5A;
+
+	free(expected);
+	free(actual);
+	return ret;
+}
+
+TEST(Utf8Ascii)
+{
+	wchar_t str[300];
+
+	for (size_t i = 0; i < 300; ++i)
+		str[i] = (wchar_t)(L' ' + i % 95);
+
+	/* every length around the 16 and 32 unit blocks, at every alignment */
+	for (size_t start = 0; start < 8; ++start)
+	{
+		for (size_t len = 0; start + len <= 300; ++len)
+			CHECK(Matches(str + start, len));
+	}
+}
+
+TEST(Utf8NonAsciiInBlock)
+{
+	static const wchar_t chars[] = { 0x7F, 0x80, 0xFF, 0x100, 0x7FF, 0x800, 0x4E2D, 0xFFFD, 0xFFFF };
+	wchar_t str[96];
+
+	/* a single non-ASCII unit at each position must stop the block it falls in */
+	for (size_t c = 0; c < _countof(chars); ++c)
+	{
+		for (size_t pos = 0; pos < 96; ++pos)
+		{
+			for (size_t i = 0; i < 96; ++i)
+				str[i] = (wchar_t)(L'a' + i % 26);
+
+			str[pos] = chars[c];
+			CHECK(Matches(str, 96));
+		}
+	}
+}
+
+TEST(Utf8Surrogates)
+{
+	static const wchar_t pair[] = { 0xD83D, 0xDE00 };
+	static const wchar_t highOnly[] = { L'a', 0xD83D, L'b' };
+	static const wchar_t lowOnly[] = { L'a', 0xDE00, L'b' };
+	static const wchar_t reversed[] = { 0xDE00, 0xD83D };
+	static const wchar_t highAtEnd[] = { L'a', 0xD83D };
+	char out[16];
+
+	CHECK(Utf16ToUtf8(out, pair, 2) == 4 && memcmp(out, "\xF0\x9F\x98\x80", 4) == 0);
+	CHECK(Utf16ToUtf8(out, highOnly, 3) == 5 && memcmp(out, "a\xEF\xBF\xBD" "b", 5) == 0);
+	CHECK(Utf16ToUtf8(out, lowOnly, 3) == 5 && memcmp(out, "a\xEF\xBF\xBD" "b", 5) == 0);
+	CHECK(Utf16ToUtf8(out, reversed, 2) == 6 && memcmp(out, "\xEF\xBF\xBD\xEF\xBF\xBD", 6) == 0);
+
+	/* the low half lying beyond len is not looked at */
+	CHECK(Utf16ToUtf8(out, pair, 1) == 3 && memcmp(out, "\xEF\xBF\xBD", 3) == 0);
+	CHECK(Utf16ToUtf8(out, highAtEnd, 2) == 4);
+}
+
+TEST(Utf8Random)
+{
+	static const UINT ranges[][2] = { { 0x20, 0x7F }, { 0x80, 0x800 }, { 0x800, 0xD800 }, { 0xD800, 0xE000 }, { 0xE000, 0x10000 } };
+	wchar_t str[200];
+	UINT seed = 12345;
+
+	for (UINT round = 0; round < 20000; ++round)
+	{
+		size_t len = 0;
+
+		seed = seed * 1103515245 + 12345;
+		len = (seed >> 16) % 200;
+
+		/* mostly ASCII with the occasional other unit, like real names */
+		for (size_t i = 0; i < len; ++i)
+		{
+			UINT r = 0;
+
+			seed = seed * 1103515245 + 12345;
+			r = (seed >> 8) & 0xFFFF;
+
+			if (r % 8 != 0)
+				str[i] = (wchar_t)(0x20 + r % 95);
+			else
+				str[i] = (wchar_t)(ranges[r % 5][0] + (r >> 3) % (ranges[r % 5][1] - ranges[r % 5][0]));
+		}
+
+		CHECK(Matches(str, len));
+	}
+}
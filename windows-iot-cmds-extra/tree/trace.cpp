@@ -0,0 +1,328 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Chrome trace event export behind tree.com's --trace option
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "stats.h"
+#include "trace.h"
+#include "utf8.h"
+
+/* events and path characters allocated at a time by each thread */
+#define TRACE_BLOCK_EVENTS 4096
+#define TRACE_BLOCK_CHARS (64 * 1024)
+
+/* one complete ("X") event */
+typedef struct _TRACE_EVENT
+{
+	const char* cat;
+	const char* name;
+	const char* countName;
+	const wchar_t* path;
+	ULONGLONG start;
+	ULONGLONG end;
+	ULONGLONG count;
+} TRACE_EVENT;
+
+typedef struct _TRACE_BLOCK
+{
+	struct _TRACE_BLOCK* next;
+	UINT used;
+	TRACE_EVENT events[TRACE_BLOCK_EVENTS];
+} TRACE_BLOCK;
+
+typedef struct _TRACE_CHARS
+{
+	struct _TRACE_CHARS* next;
+	size_t used;
+	wchar_t chars[TRACE_BLOCK_CHARS];
+} TRACE_CHARS;
+
+/* events of one thread, only ever touched by that thread until TraceWrite */
+typedef struct _TRACE_THREAD
+{
+	DWORD threadId;
+	const char* name;
+	TRACE_BLOCK* first;
+	TRACE_BLOCK* last;
+	TRACE_CHARS* chars;
+	struct _TRACE_THREAD* next;
+} TRACE_THREAD;
+
+BOOL bTrace = FALSE;
+
+static __declspec(thread) TRACE_THREAD* pThreadTrace = NULL;
+
+/* every thread that recorded something, only ever added to */
+static TRACE_THREAD* volatile pTraceList = NULL;
+
+static FILE* fTrace = NULL;
+static LARGE_INTEGER traceStart;
+static LARGE_INTEGER traceFrequency;
+
+/**
+* @name: TraceInit
+*
+* @param strFile
+* trace file to be created
+*
+* @return
+* true if the file could be created and tracing is on
+*/
+BOOL TraceInit(const wchar_t* strFile)
+{
+	if (_wfopen_s(&fTrace, strFile, L"wb") != 0 || fTrace == NULL)
+		return FALSE;
+
+	QueryPerformanceFrequency(&traceFrequency);
+	QueryPerformanceCounter(&traceStart);
+	bTrace = TRUE;
+	return TRUE;
+}
+
+/**
+* @name: TraceThread
+*
+* @return
+* events of the calling thread, registered on its first use
+*/
+static TRACE_THREAD* TraceThread(VOID)
+{
+	TRACE_THREAD* trace = pThreadTrace;
+	TRACE_THREAD* head = NULL;
+
+	if (trace != NULL)
+		return trace;
+
+	trace = (TRACE_THREAD*)StatsCalloc(1, sizeof(TRACE_THREAD));
+	if (trace == NULL)
+		exit(-1);
+
+	trace->threadId = GetCurrentThreadId();
+
+	do
+	{
+		head = pTraceList;
+		trace->next = head;
+	} while (InterlockedCompareExchangePointer((PVOID volatile*)&pTraceList, trace, head) != head);
+
+	pThreadTrace = trace;
+	return trace;
+}
+
+/**
+* @name: TraceThreadName
+*
+* @param name
+* name of the calling thread's track, must be a string literal
+*
+* @return
+* void
+*/
+VOID TraceThreadName(const char* name)
+{
+	if (bTrace)
+		TraceThread()->name = name;
+}
+
+/**
+* @name: TraceCopyPath
+*
+* @return
+* copy of path kept until the trace is written
+*/
+static const wchar_t* TraceCopyPath(TRACE_THREAD* trace, const wchar_t* path)
+{
+	size_t len = wcslen(path) + 1;
+	wchar_t* copy = NULL;
+
+	/* paths are far shorter than a block, STR_MAX at most */
+	if (trace->chars == NULL || trace->chars->used + len > TRACE_BLOCK_CHARS)
+	{
+		TRACE_CHARS* chars = (TRACE_CHARS*)StatsMalloc(sizeof(TRACE_CHARS));
+
+		if (chars == NULL || len > TRACE_BLOCK_CHARS)
+			exit(-1);
+
+		chars->used = 0;
+		chars->next = trace->chars;
+		trace->chars = chars;
+	}
+
+	copy = trace->chars->chars + trace->chars->used;
+	memcpy(copy, path, len * sizeof(wchar_t));
+	trace->chars->used += len;
+	return copy;
+}
+
+/**
+* @name: TraceSpan
+*
+* records a span that started at start and ends now, see TraceEnd
+*/
+VOID TraceSpan(const char* cat, const char* name, ULONGLONG start,
+	const wchar_t* path, const char* countName, ULONGLONG count)
+{
+	TRACE_THREAD* trace = TraceThread();
+	TRACE_EVENT* event = NULL;
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+
+	if (trace->last == NULL || trace->last->used == TRACE_BLOCK_EVENTS)
+	{
+		TRACE_BLOCK* block = (TRACE_BLOCK*)StatsMalloc(sizeof(TRACE_BLOCK));
+
+		if (block == NULL)
+			exit(-1);
+
+		block->next = NULL;
+		block->used = 0;
+
+		if (trace->last == NULL)
+			trace->first = block;
+		else
+			trace->last->next = block;
+
+		trace->last = block;
+	}
+
+	event = &trace->last->events[trace->last->used++];
+	event->cat = cat;
+	event->name = name;
+	event->start = start;
+	event->end = now.QuadPart;
+	event->path = (path != NULL) ? TraceCopyPath(trace, path) : NULL;
+	event->countName = countName;
+	event->count = count;
+}
+
+/**
+* @name: TraceWriteString
+*
+* writes str as a quoted JSON string in UTF-8
+*/
+static VOID TraceWriteString(const wchar_t* str)
+{
+	wchar_t buf[256 + 8];
+	char utf8[UTF8_MAX_BYTES(256 + 8)];
+	size_t n = 0;
+
+	fputc('"', fTrace);
+
+	for (;; ++str)
+	{
+		if (*str == L'\0' || n >= 256)
+		{
+			/* a high surrogate ending the buffer waits for its low half rather than become U+FFFD */
+			size_t held = (*str != L'\0' && (buf[n - 1] & 0xFC00) == 0xD800) ? 1 : 0;
+
+			fwrite(utf8, 1, Utf16ToUtf8(utf8, buf, n - held), fTrace);
+
+			if (held)
+				buf[0] = buf[n - 1];
+
+			n = held;
+
+			if (*str == L'\0')
+				break;
+		}
+
+		if (*str == L'"' || *str == L'\\')
+		{
+			buf[n++] = L'\\';
+			buf[n++] = *str;
+		}
+		else if (*str < 0x20)
+		{
+			n += swprintf_s(&buf[n], 7, L"\\u%04x", (UINT)*str);
+		}
+		else
+		{
+			buf[n++] = *str;
+		}
+	}
+
+	fputc('"', fTrace);
+}
+
+/**
+* @name: TicksToUs
+*
+* @return
+* ticks since tracing started, in microseconds
+*/
+static double TicksToUs(ULONGLONG ticks)
+{
+	return (double)(LONGLONG)(ticks - traceStart.QuadPart) * 1000000.0 / (double)traceFrequency.QuadPart;
+}
+
+/**
+* @name: TraceWrite
+*
+* @return
+* void
+*
+* writes all recorded spans in the Chrome trace event format, loadable in
+* chrome://tracing and Perfetto. Must only be called once the other threads
+* are idle
+*/
+VOID TraceWrite(VOID)
+{
+	TRACE_THREAD* trace = NULL;
+	BOOL first = TRUE;
+
+	if (!bTrace)
+		return;
+
+	bTrace = FALSE;
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", fTrace);
+
+	for (trace = pTraceList; trace != NULL; trace = trace->next)
+	{
+		TRACE_BLOCK* block = NULL;
+
+		if (trace->name != NULL)
+		{
+			fprintf(fTrace, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",", GetCurrentProcessId(), trace->threadId, trace->name);
+			first = FALSE;
+		}
+
+		for (block = trace->first; block != NULL; block = block->next)
+		{
+			UINT i = 0;
+
+			for (i = 0; i < block->used; ++i)
+			{
+				const TRACE_EVENT* event = &block->events[i];
+				double ts = TicksToUs(event->start);
+
+				fprintf(fTrace, "%s\n{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+					first ? "" : ",", event->cat, event->name, GetCurrentProcessId(), trace->threadId,
+					ts, TicksToUs(event->end) - ts);
+				first = FALSE;
+
+				if (event->path != NULL)
+				{
+					fputs("\"path\":", fTrace);
+					TraceWriteString(event->path);
+				}
+
+				if (event->countName != NULL)
+					fprintf(fTrace, "%s\"%s\":%llu", event->path != NULL ? "," : "", event->countName, event->count);
+
+				fputs("}}", fTrace);
+			}
+		}
+	}
+
+	fputs("\n]}\n", fTrace);
+	fclose(fTrace);
+	fTrace = NULL;
+}
@@ -0,0 +1,66 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     Chrome trace event export behind tree.com's --trace option
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* if this flag is true, spans are recorded and written to the trace file at exit */
+extern BOOL bTrace;
+
+BOOL TraceInit(const wchar_t* strFile);
+VOID TraceThreadName(const char* name);
+VOID TraceSpan(const char* cat, const char* name, ULONGLONG start,
+	const wchar_t* path, const char* countName, ULONGLONG count);
+VOID TraceWrite(VOID);
+
+/**
+* @name: TraceBegin
+*
+* @return
+* timestamp to be passed to TraceEnd, or 0 if tracing is off
+*/
+static __forceinline ULONGLONG TraceBegin(VOID)
+{
+	LARGE_INTEGER now;
+
+	if (!bTrace)
+		return 0;
+
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+/**
+* @name: TraceEnd
+*
+* @param cat
+* category of the span, must be a string literal
+*
+* @param name
+* name of the span, must be a string literal
+*
+* @param start
+* value returned by TraceBegin when the span started
+*
+* @param path
+* optional path shown with the span, copied
+*
+* @param countName
+* optional name of count, must be a string literal
+*
+* @param count
+* shown with the span if countName is not NULL
+*
+* @return
+* void
+*/
+static __forceinline VOID TraceEnd(const char* cat, const char* name, ULONGLONG start,
+	const wchar_t* path, const char* countName, ULONGLONG count)
+{
+	if (bTrace)
+		TraceSpan(cat, name, start, path, countName, count);
+}
@@ -0,0 +1,216 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     UTF-16 to UTF-8 transcoding for the tree.com output path
+*/
+
+#include <windows.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_SSE2
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(_M_ARM) || defined(_M_ARM64)
+#define UTF8_NEON
+#include <arm_neon.h>
+#endif
+
+#include "utf8.h"
+
+/* code units the scalar path converts before trying the vector path again */
+#define SCALAR_RUN 16
+
+#ifdef UTF8_SSE2
+/* AVX2 support is probed once, -1 until then */
+static int iHasAvx2 = -1;
+
+/**
+* @name: HasAvx2
+*
+* @return
+* true if both the processor and the operating system support AVX2
+*/
+static BOOL HasAvx2(VOID)
+{
+	if (iHasAvx2 < 0)
+	{
+		int info[4];
+		BOOL ret = FALSE;
+
+		__cpuid(info, 0);
+		if (info[0] >= 7)
+		{
+			__cpuid(info, 1);
+
+			/* OSXSAVE and AVX, then make sure the OS saves the YMM registers */
+			if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6)
+			{
+				__cpuidex(info, 7, 0);
+				ret = (info[1] & (1 << 5)) != 0;
+			}
+		}
+
+		iHasAvx2 = ret;
+	}
+
+	return iHasAvx2;
+}
+
+/**
+* @name: AsciiRunAvx2
+*
+* copies 32 code unit blocks for as long as they are entirely ASCII
+*
+* @return
+* number of code units consumed, which is also the number of bytes written
+*/
+static size_t AsciiRunAvx2(char* dst, const wchar_t* src, size_t len)
+{
+	const __m256i mask = _mm256_set1_epi16((short)0xFF80);
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask))
+			break;
+
+		/* packus works per 128 bit lane, so the quadwords have to be put back in order */
+		_mm256_storeu_si256((__m256i*)(dst + i),
+			_mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+	}
+
+	return i;
+}
+#endif
+
+/**
+* @name: AsciiRun
+*
+* copies 16 code unit blocks for as long as they are entirely ASCII
+*
+* @return
+* number of code units consumed, which is also the number of bytes written
+*/
+static size_t AsciiRun(char* dst, const wchar_t* src, size_t len)
+{
+	size_t i = 0;
+
+#if defined(UTF8_SSE2)
+	const __m128i mask = _mm_set1_epi16((short)0xFF80);
+	const __m128i zero = _mm_setzero_si128();
+
+	if (len >= 64 && HasAvx2())
+		i = AsciiRunAvx2(dst, src, len);
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+		__m128i hi = _mm_and_si128(_mm_or_si128(a, b), mask);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, zero)) != 0xFFFF)
+			break;
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+	}
+#elif defined(UTF8_NEON)
+	const uint16x8_t mask = vdupq_n_u16(0xFF80);
+
+	for (; i + 16 <= len; i += 16)
+	{
+		uint16x8_t a = vld1q_u16((const uint16_t*)(src + i));
+		uint16x8_t b = vld1q_u16((const uint16_t*)(src + i + 8));
+		uint64x2_t hi = vreinterpretq_u64_u16(vandq_u16(vorrq_u16(a, b), mask));
+
+		if ((vgetq_lane_u64(hi, 0) | vgetq_lane_u64(hi, 1)) != 0)
+			break;
+
+		vst1q_u8((uint8_t*)(dst + i), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+	}
+#else
+	for (; i < len && src[i] < 0x80; ++i)
+		dst[i] = (char)src[i];
+#endif
+
+	return i;
+}
+
+/**
+* @name: Utf16ToUtf8
+*
+* @param dst
+* receives the UTF-8 bytes, must have room for UTF8_MAX_BYTES(len) bytes
+*
+* @param src
+* UTF-16 code units to convert, need not be NUL terminated
+*
+* @param len
+* number of code units in src
+*
+* @return
+* number of bytes written to dst
+*
+* runs of ASCII are copied with the widest vector unit available; everything
+* else goes through a scalar loop that replaces unpaired surrogates with
+* U+FFFD, just like WideCharToMultiByte does
+*/
+size_t Utf16ToUtf8(char* dst, const wchar_t* src, size_t len)
+{
+	size_t i = 0;
+	size_t o = 0;
+
+	while (i < len)
+	{
+		size_t n = AsciiRun(dst + o, src + i, len - i);
+		size_t end = 0;
+
+		i += n;
+		o += n;
+
+		end = (len - i < SCALAR_RUN) ? len : i + SCALAR_RUN;
+
+		while (i < end)
+		{
+			UINT c = src[i++];
+
+			if (c < 0x80)
+			{
+				dst[o++] = (char)c;
+			}
+			else if (c < 0x800)
+			{
+				dst[o++] = (char)(0xC0 | (c >> 6));
+				dst[o++] = (char)(0x80 | (c & 0x3F));
+			}
+			else if (c >= 0xD800 && c <= 0xDFFF)
+			{
+				/* the low surrogate may lie past end, but never past len */
+				if (c <= 0xDBFF && i < len && src[i] >= 0xDC00 && src[i] <= 0xDFFF)
+				{
+					c = 0x10000 + ((c - 0xD800) << 10) + (src[i++] - 0xDC00);
+					dst[o++] = (char)(0xF0 | (c >> 18));
+					dst[o++] = (char)(0x80 | ((c >> 12) & 0x3F));
+					dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+					dst[o++] = (char)(0x80 | (c & 0x3F));
+				}
+				else
+				{
+					dst[o++] = (char)0xEF;
+					dst[o++] = (char)0xBF;
+					dst[o++] = (char)0xBD;
+				}
+			}
+			else
+			{
+				dst[o++] = (char)(0xE0 | (c >> 12));
+				dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+				dst[o++] = (char)(0x80 | (c & 0x3F));
+			}
+		}
+	}
+
+	return o;
+}
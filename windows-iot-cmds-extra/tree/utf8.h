@@ -0,0 +1,14 @@
+﻿/*
+* PROJECT:     Windows IoT extra commands
+* LICENSE:     GNU GPLv2 only as published by the Free Software Foundation
+* PURPOSE:     UTF-16 to UTF-8 transcoding for the tree.com output path
+*/
+
+#pragma once
+
+#include <windows.h>
+
+/* worst case number of UTF-8 bytes produced for len UTF-16 code units */
+#define UTF8_MAX_BYTES(len) ((len) * 3)
+
+size_t Utf16ToUtf8(char* dst, const wchar_t* src, size_t len);